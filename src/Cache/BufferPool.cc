@@ -0,0 +1,278 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "BufferPool.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace carta;
+
+std::atomic<bool> BufferPoolBase::_huge_pages(false);
+
+void BufferPoolBase::SetHugePages(bool enabled) {
+    _huge_pages = enabled;
+}
+
+static int FloorLog2(size_t value) {
+    int log2(0);
+    while (value >>= 1) {
+        ++log2;
+    }
+    return log2;
+}
+
+size_t BufferPoolBase::SizeClass(size_t size) {
+    if (size <= 4) {
+        return size;
+    }
+    int shift = FloorLog2(size - 1) - 2;
+    return (((size - 1) >> shift) + 1) << shift;
+}
+
+size_t BufferPoolBase::FloorSizeClass(size_t capacity) {
+    if (capacity <= 4) {
+        return capacity;
+    }
+    int shift = FloorLog2(capacity) - 2;
+    return (capacity >> shift) << shift;
+}
+
+void BufferPoolBase::AdviseHugePages(void* data, size_t bytes) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (!_huge_pages || bytes < (size_t)BUFFER_POOL_HUGE_PAGE_MIN_SIZE * 1024 * 1024) {
+        return;
+    }
+
+    // madvise needs a page-aligned range; advise the aligned part of the buffer
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t start = ((size_t)data + page_size - 1) / page_size * page_size;
+    size_t end = ((size_t)data + bytes) / page_size * page_size;
+    if (end > start) {
+        madvise((void*)start, end - start, MADV_HUGEPAGE);
+    }
+#endif
+}
+
+namespace {
+
+template <typename Buffer>
+struct SharedFreeList {
+    std::unordered_map<size_t, std::vector<Buffer>> buffers; // by size class
+    size_t bytes = 0;
+    std::mutex buffer_pool_mutex;
+};
+
+// Never destroyed, so that buffers released by static objects at exit can still be returned
+template <typename Buffer>
+SharedFreeList<Buffer>& GetSharedFreeList() {
+    static auto* free_list = new SharedFreeList<Buffer>();
+    return *free_list;
+}
+
+} // namespace
+
+template <typename Buffer>
+thread_local typename BufferPool<Buffer>::LocalFreeList BufferPool<Buffer>::_local;
+template <typename Buffer>
+thread_local bool BufferPool<Buffer>::_local_destroyed(false);
+
+template <typename Buffer>
+std::atomic<size_t> BufferPool<Buffer>::_local_hits(0);
+template <typename Buffer>
+std::atomic<size_t> BufferPool<Buffer>::_global_hits(0);
+template <typename Buffer>
+std::atomic<size_t> BufferPool<Buffer>::_misses(0);
+template <typename Buffer>
+std::atomic<size_t> BufferPool<Buffer>::_returned(0);
+template <typename Buffer>
+std::atomic<size_t> BufferPool<Buffer>::_dropped(0);
+template <typename Buffer>
+std::atomic<size_t> BufferPool<Buffer>::_pooled_bytes(0);
+
+template <typename Buffer>
+bool BufferPool<Buffer>::LocalFreeList::HasRoom(size_t buffer_bytes) const {
+    return buffers.size() < BUFFER_POOL_LOCAL_COUNT && bytes + buffer_bytes <= (size_t)BUFFER_POOL_LOCAL_CAPACITY * 1024 * 1024;
+}
+
+template <typename Buffer>
+void BufferPool<Buffer>::LocalFreeList::MoveToShared() {
+    auto& shared = GetSharedFreeList<Buffer>();
+    size_t dropped_bytes(0), dropped_count(0);
+    {
+        std::unique_lock<std::mutex> guard(shared.buffer_pool_mutex);
+        for (auto& [size_class, buffer] : buffers) {
+            size_t buffer_bytes = Bytes(size_class);
+            if (shared.bytes + buffer_bytes <= (size_t)BUFFER_POOL_CAPACITY * 1024 * 1024) {
+                shared.buffers[size_class].push_back(std::move(buffer));
+                shared.bytes += buffer_bytes;
+            } else {
+                dropped_bytes += buffer_bytes;
+                ++dropped_count;
+            }
+        }
+    }
+
+    buffers.clear();
+    bytes = 0;
+    _pooled_bytes -= dropped_bytes;
+    _dropped += dropped_count;
+}
+
+template <typename Buffer>
+BufferPool<Buffer>::LocalFreeList::~LocalFreeList() {
+    // Buffers of a thread which exits can still be used by other threads
+    MoveToShared();
+    _local_destroyed = true;
+}
+
+template <typename Buffer>
+size_t BufferPool<Buffer>::Bytes(size_t size_class) {
+    return size_class * sizeof(typename Buffer::value_type);
+}
+
+template <typename Buffer>
+Buffer BufferPool<Buffer>::Take(size_t size) {
+    Buffer buffer;
+    size_t size_class = SizeClass(size);
+    size_t bytes = Bytes(size_class);
+    if (bytes < BUFFER_POOL_MIN_SIZE) {
+        buffer.resize(size);
+        return buffer;
+    }
+
+    // Free list of this thread
+    if (!_local_destroyed) {
+        auto& local_buffers = _local.buffers;
+        for (size_t i = 0; i < local_buffers.size(); ++i) {
+            if (local_buffers[i].first == size_class) {
+                buffer = std::move(local_buffers[i].second);
+                local_buffers[i] = std::move(local_buffers.back());
+                local_buffers.pop_back();
+                _local.bytes -= bytes;
+                _pooled_bytes -= bytes;
+                ++_local_hits;
+                buffer.resize(size);
+                return buffer;
+            }
+        }
+    }
+
+    // Shared free list. More buffers of the size class are moved to the free list of this thread, so that the next takes are local.
+    auto& shared = GetSharedFreeList<Buffer>();
+    {
+        std::unique_lock<std::mutex> guard(shared.buffer_pool_mutex);
+        auto it = shared.buffers.find(size_class);
+        if (it != shared.buffers.end() && !it->second.empty()) {
+            buffer = std::move(it->second.back());
+            it->second.pop_back();
+            shared.bytes -= bytes;
+
+            for (int i = 1; i < BUFFER_POOL_BATCH_SIZE && !it->second.empty() && !_local_destroyed && _local.HasRoom(bytes); ++i) {
+                _local.buffers.emplace_back(size_class, std::move(it->second.back()));
+                it->second.pop_back();
+                shared.bytes -= bytes;
+                _local.bytes += bytes;
+            }
+            guard.unlock();
+
+            _pooled_bytes -= bytes;
+            ++_global_hits;
+            buffer.resize(size);
+            return buffer;
+        }
+    }
+
+    // Allocate a new buffer with the full size class, so that it can be reused for any size in the class
+    ++_misses;
+    buffer.reserve(size_class);
+    AdviseHugePages(buffer.data(), bytes);
+    buffer.resize(size);
+    return buffer;
+}
+
+template <typename Buffer>
+typename BufferPool<Buffer>::BufferPtr BufferPool<Buffer>::TakeShared(size_t size) {
+    return BufferPtr(new Buffer(Take(size)), [](Buffer* buffer) {
+        Return(std::move(*buffer));
+        delete buffer;
+    });
+}
+
+template <typename Buffer>
+void BufferPool<Buffer>::Return(Buffer&& buffer) {
+    size_t size_class = FloorSizeClass(buffer.capacity());
+    size_t bytes = Bytes(size_class);
+    if (bytes < BUFFER_POOL_MIN_SIZE) {
+        return;
+    }
+
+    if (!_local_destroyed) {
+        // A thread which returns more buffers than it takes passes them on to the shared free list in one batch
+        if (!_local.HasRoom(bytes)) {
+            _local.MoveToShared();
+        }
+        if (_local.HasRoom(bytes)) {
+            _local.buffers.emplace_back(size_class, std::move(buffer));
+            _local.bytes += bytes;
+            _pooled_bytes += bytes;
+            ++_returned;
+            return;
+        }
+    }
+
+    auto& shared = GetSharedFreeList<Buffer>();
+    std::unique_lock<std::mutex> guard(shared.buffer_pool_mutex);
+    if (shared.bytes + bytes <= (size_t)BUFFER_POOL_CAPACITY * 1024 * 1024) {
+        shared.buffers[size_class].push_back(std::move(buffer));
+        shared.bytes += bytes;
+        guard.unlock();
+
+        _pooled_bytes += bytes;
+        ++_returned;
+        return;
+    }
+
+    ++_dropped;
+}
+
+template <typename Buffer>
+BufferPoolStats BufferPool<Buffer>::GetStats() {
+    BufferPoolStats stats;
+    stats.local_hits = _local_hits;
+    stats.global_hits = _global_hits;
+    stats.misses = _misses;
+    stats.returned = _returned;
+    stats.dropped = _dropped;
+    stats.pooled_bytes = _pooled_bytes;
+    return stats;
+}
+
+template <typename Buffer>
+void BufferPool<Buffer>::Clear() {
+    if (!_local_destroyed) {
+        _pooled_bytes -= _local.bytes;
+        _local.buffers.clear();
+        _local.bytes = 0;
+    }
+
+    auto& shared = GetSharedFreeList<Buffer>();
+    std::unique_lock<std::mutex> guard(shared.buffer_pool_mutex);
+    _pooled_bytes -= shared.bytes;
+    shared.buffers.clear();
+    shared.bytes = 0;
+}
+
+namespace carta {
+template class BufferPool<std::vector<float>>;
+template class BufferPool<std::vector<char>>;
+template class BufferPool<std::string>;
+} // namespace carta
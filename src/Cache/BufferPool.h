@@ -0,0 +1,104 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# BufferPool.h: reusable buffers for image planes, tiles, compressed data and outgoing messages
+
+#ifndef CARTA_BACKEND__BUFFER_POOL_H_
+#define CARTA_BACKEND__BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define BUFFER_POOL_CAPACITY 256            // MB per buffer type, shared by all threads
+#define BUFFER_POOL_LOCAL_CAPACITY 16       // MB per buffer type and thread
+#define BUFFER_POOL_LOCAL_COUNT 8           // buffers per buffer type and thread
+#define BUFFER_POOL_BATCH_SIZE 4            // buffers of one size class taken from the shared free list at once
+#define BUFFER_POOL_MIN_SIZE 4096           // bytes; smaller buffers are not pooled
+#define BUFFER_POOL_HUGE_PAGE_MIN_SIZE 2    // MB; new buffers at least this large may use transparent huge pages
+
+namespace carta {
+
+struct BufferPoolStats {
+    size_t local_hits = 0;   // buffers taken from the free list of the calling thread
+    size_t global_hits = 0;  // buffers taken from the shared free list
+    size_t misses = 0;       // buffers allocated
+    size_t returned = 0;     // buffers kept for reuse
+    size_t dropped = 0;      // buffers freed because the pool was full
+    size_t pooled_bytes = 0; // bytes currently held by free lists
+};
+
+class BufferPoolBase {
+public:
+    // Advise the kernel to back large new buffers with transparent huge pages, which reduces page faults when filling image planes.
+    // Disabled by default; has no effect on platforms without madvise(MADV_HUGEPAGE).
+    static void SetHugePages(bool enabled);
+
+    // Sizes are rounded up to one of four size classes per power of two, so that at most 25% of a buffer is unused
+    static size_t SizeClass(size_t size);
+    // The largest size class which fits into the capacity
+    static size_t FloorSizeClass(size_t capacity);
+
+protected:
+    static void AdviseHugePages(void* data, size_t bytes);
+
+    static std::atomic<bool> _huge_pages;
+};
+
+// Buffers are returned to a small free list of the calling thread first, which needs no locking. When it is full, the whole list is
+// moved to a shared free list, and a thread which takes a buffer from the shared free list also moves a batch of buffers of the same
+// size class to its own list. Buffers which are taken on one thread and returned on another, such as outgoing messages, therefore
+// pass through the shared free list in batches, and most takes are served without locking.
+// Buffer is std::vector<float>, std::vector<char> or std::string; see the aliases below.
+template <typename Buffer>
+class BufferPool : public BufferPoolBase {
+public:
+    using BufferPtr = std::shared_ptr<Buffer>;
+
+    // Returns a buffer of the given size. The contents are unspecified.
+    static Buffer Take(size_t size);
+    // The buffer is returned to the pool when the last reference is released
+    static BufferPtr TakeShared(size_t size);
+    // Any buffer may be returned, not only buffers taken from the pool
+    static void Return(Buffer&& buffer);
+
+    static BufferPoolStats GetStats();
+    // Frees the shared free list and the free list of the calling thread
+    static void Clear();
+
+private:
+    struct LocalFreeList {
+        std::vector<std::pair<size_t, Buffer>> buffers; // size class, buffer
+        size_t bytes = 0;
+        bool HasRoom(size_t buffer_bytes) const;
+        // Moves the buffers to the shared free list, or frees them if it is full
+        void MoveToShared();
+        ~LocalFreeList();
+    };
+
+    static size_t Bytes(size_t size_class);
+
+    static thread_local LocalFreeList _local;
+    static thread_local bool _local_destroyed;
+
+    static std::atomic<size_t> _local_hits;
+    static std::atomic<size_t> _global_hits;
+    static std::atomic<size_t> _misses;
+    static std::atomic<size_t> _returned;
+    static std::atomic<size_t> _dropped;
+    static std::atomic<size_t> _pooled_bytes;
+};
+
+using FloatBufferPool = BufferPool<std::vector<float>>;
+using CharBufferPool = BufferPool<std::vector<char>>;
+using StringBufferPool = BufferPool<std::string>;
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__BUFFER_POOL_H_
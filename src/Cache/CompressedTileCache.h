@@ -0,0 +1,89 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CompressedTileCache.h: cache of encoded raster tiles for an image
+
+#ifndef CARTA_BACKEND__COMPRESSED_TILE_CACHE_H_
+#define CARTA_BACKEND__COMPRESSED_TILE_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Cache/LruByteCache.h"
+
+#define COMPRESSED_TILE_CACHE_CAPACITY 32 // MB per image
+
+namespace carta {
+
+// The requested compression quality is part of the key; the quality actually used is stored with the tile
+struct CompressedTileCacheKey {
+    int32_t layer;
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    int32_t stokes;
+    int32_t compression_type;
+    float compression_quality;
+
+    CompressedTileCacheKey() {}
+    CompressedTileCacheKey(
+        int32_t layer_, int32_t x_, int32_t y_, int32_t z_, int32_t stokes_, int32_t compression_type_, float compression_quality_)
+        : layer(layer_),
+          x(x_),
+          y(y_),
+          z(z_),
+          stokes(stokes_),
+          compression_type(compression_type_),
+          compression_quality(compression_quality_) {}
+
+    bool operator==(const CompressedTileCacheKey& rhs) const {
+        return (layer == rhs.layer) && (x == rhs.x) && (y == rhs.y) && (z == rhs.z) && (stokes == rhs.stokes) &&
+               (compression_type == rhs.compression_type) && (compression_quality == rhs.compression_quality);
+    }
+};
+
+struct CompressedTile {
+    int width;
+    int height;
+    float compression_quality;
+    std::vector<char> image_data;
+    std::vector<int32_t> nan_encodings;
+
+    size_t Bytes() const {
+        return image_data.size() + nan_encodings.size() * sizeof(int32_t);
+    }
+};
+
+} // namespace carta
+
+namespace std {
+template <>
+struct hash<carta::CompressedTileCacheKey> {
+    std::size_t operator()(const carta::CompressedTileCacheKey& k) const {
+        std::size_t seed = std::hash<int32_t>()(k.layer);
+        for (std::size_t value : {std::hash<int32_t>()(k.x), std::hash<int32_t>()(k.y), std::hash<int32_t>()(k.z),
+                 std::hash<int32_t>()(k.stokes), std::hash<int32_t>()(k.compression_type), std::hash<float>()(k.compression_quality)}) {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+} // namespace std
+
+namespace carta {
+
+// Tiles which are requested again (e.g. when panning back or zooming out and in) are not encoded again
+class CompressedTileCache : public LruByteCache<CompressedTileCacheKey, CompressedTile> {
+public:
+    using TilePtr = ValuePtr;
+
+    CompressedTileCache(size_t capacity = (size_t)COMPRESSED_TILE_CACHE_CAPACITY * 1024 * 1024) : LruByteCache(capacity) {} // bytes
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__COMPRESSED_TILE_CACHE_H_
@@ -0,0 +1,90 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# ContourCache.h: cache of traced contour levels for an image
+
+#ifndef CARTA_BACKEND__CONTOUR_CACHE_H_
+#define CARTA_BACKEND__CONTOUR_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Cache/LruByteCache.h"
+
+#define CONTOUR_CACHE_CAPACITY 64 // MB per image
+
+namespace carta {
+
+// Contours of one level only depend on the plane, the smoothing and the level; decimation and compression are applied when the
+// contours are encoded for the client
+struct ContourCacheKey {
+    int32_t z;
+    int32_t stokes;
+    int32_t smoothing_mode;
+    int32_t smoothing_factor;
+    double level;
+
+    ContourCacheKey() {}
+    ContourCacheKey(int32_t z_, int32_t stokes_, int32_t smoothing_mode_, int32_t smoothing_factor_, double level_)
+        : z(z_), stokes(stokes_), smoothing_mode(smoothing_mode_), smoothing_factor(smoothing_factor_), level(level_) {}
+
+    bool operator==(const ContourCacheKey& rhs) const {
+        return (z == rhs.z) && (stokes == rhs.stokes) && (smoothing_mode == rhs.smoothing_mode) &&
+               (smoothing_factor == rhs.smoothing_factor) && (level == rhs.level);
+    }
+};
+
+// Vertices and segment start indices of one partial callback of TraceLevel
+struct ContourChunk {
+    double progress;
+    std::vector<float> vertices;
+    std::vector<int32_t> indices;
+};
+
+// The chunks of a level in the order in which they were sent, the last one with progress 1
+struct ContourLevel {
+    std::vector<ContourChunk> chunks;
+
+    size_t Bytes() const {
+        size_t bytes(0);
+        for (auto& chunk : chunks) {
+            bytes += chunk.vertices.size() * sizeof(float) + chunk.indices.size() * sizeof(int32_t);
+        }
+        return bytes;
+    }
+};
+
+} // namespace carta
+
+namespace std {
+template <>
+struct hash<carta::ContourCacheKey> {
+    std::size_t operator()(const carta::ContourCacheKey& k) const {
+        std::size_t seed = std::hash<int32_t>()(k.z);
+        for (std::size_t value : {std::hash<int32_t>()(k.stokes), std::hash<int32_t>()(k.smoothing_mode),
+                 std::hash<int32_t>()(k.smoothing_factor), std::hash<double>()(k.level)}) {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+} // namespace std
+
+namespace carta {
+
+// Contours of planes which are shown again (e.g. when an animation is replayed) and of levels which are kept when the levels are
+// changed are not traced again
+class ContourCache : public LruByteCache<ContourCacheKey, ContourLevel> {
+public:
+    using LevelPtr = ValuePtr;
+
+    ContourCache(size_t capacity = (size_t)CONTOUR_CACHE_CAPACITY * 1024 * 1024) : LruByteCache(capacity) {} // bytes
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__CONTOUR_CACHE_H_
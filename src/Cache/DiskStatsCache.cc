@@ -0,0 +1,313 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# DiskStatsCache.cc: statistics and histograms of an image, stored in the user folder for the next time the image is opened
+
+#include "DiskStatsCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "Logger/Logger.h"
+#include "Util/FileSystem.h"
+
+static const char DISK_STATS_CACHE_MAGIC[8] = {'C', 'A', 'R', 'T', 'A', 'S', 'T', 'S'};
+static const uint32_t DISK_STATS_CACHE_MAX_BINS(1 << 24);
+
+namespace carta {
+
+std::string DiskStatsCache::_folder;
+uint64_t DiskStatsCache::_max_size(DISK_STATS_CACHE_MAX_SIZE);
+std::mutex DiskStatsCache::_index_mutex;
+std::unordered_map<std::string, DiskStatsCache::IndexEntry> DiskStatsCache::_index;
+uint64_t DiskStatsCache::_index_size(0);
+uint64_t DiskStatsCache::_use_count(0);
+
+void DiskStatsCache::SetFolder(const std::string& folder, uint64_t max_size) {
+    std::error_code error_code;
+    if (!folder.empty() && !fs::exists(folder, error_code) && !fs::create_directories(folder, error_code)) {
+        spdlog::warn("Could not create stats cache folder {}: {}", folder, error_code.message());
+        return;
+    }
+
+    // Files written in earlier runs are ordered by their modify time, which is updated when they are loaded
+    std::vector<std::pair<fs::file_time_type, std::pair<std::string, uint64_t>>> files;
+    if (!folder.empty()) {
+        for (auto& entry : fs::directory_iterator(folder, error_code)) {
+            if (entry.is_regular_file(error_code) && entry.path().extension() == ".stats") {
+                auto size = entry.file_size(error_code);
+                auto modify_time = entry.last_write_time(error_code);
+                if (!error_code) {
+                    files.push_back({modify_time, {entry.path().string(), size}});
+                }
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::unique_lock<std::mutex> lock(_index_mutex);
+    _folder = folder;
+    _max_size = max_size;
+    _index.clear();
+    _index_size = 0;
+    _use_count = 0;
+    for (auto& [modify_time, file] : files) {
+        _index[file.first] = {file.second, ++_use_count};
+        _index_size += file.second;
+    }
+}
+
+bool DiskStatsCache::Enabled() {
+    return !_folder.empty();
+}
+
+std::string DiskStatsCache::GetPath(const std::string& filename, const std::string& hdu) {
+    if (!Enabled() || filename.empty()) {
+        return std::string();
+    }
+
+    // There is one file per image; the modify time and size are checked when it is read
+    std::string selected_hdu = hdu.empty() ? "0" : hdu;
+    size_t id = std::hash<std::string>()(fs::absolute(filename).string() + ":" + selected_hdu);
+    return (fs::path(_folder) / fmt::format("{:016x}.stats", id)).string();
+}
+
+uint64_t DiskStatsCache::GetImageSize(const std::string& filename) {
+    std::error_code error_code;
+    if (!fs::is_directory(filename, error_code)) {
+        auto size = fs::file_size(filename, error_code);
+        return error_code ? 0 : size;
+    }
+
+    uint64_t size(0);
+    for (auto& entry : fs::recursive_directory_iterator(filename, error_code)) {
+        if (entry.is_regular_file(error_code)) {
+            auto file_size = entry.file_size(error_code);
+            size += error_code ? 0 : file_size;
+        }
+    }
+    return size;
+}
+
+void DiskStatsCache::UpdateIndex(const std::string& path, uint64_t size) {
+    std::unique_lock<std::mutex> lock(_index_mutex);
+    auto& entry = _index[path];
+    _index_size += size - entry.size;
+    entry = {size, ++_use_count};
+
+    while (_index_size > _max_size && _index.size() > 1) {
+        auto oldest = std::min_element(_index.begin(), _index.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.second.last_used < rhs.second.last_used; });
+        std::error_code error_code;
+        fs::remove(oldest->first, error_code);
+        spdlog::debug("Removed least recently used stats cache file {}", oldest->first);
+        _index_size -= oldest->second.size;
+        _index.erase(oldest);
+    }
+}
+
+// Values are written in native byte order; the magic bytes and version reject files from a different layout
+template <typename T>
+static void Write(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void Write(std::ofstream& out, const std::string& value) {
+    Write(out, (uint32_t)value.size());
+    out.write(value.data(), value.size());
+}
+
+template <typename T>
+static bool Read(std::ifstream& in, T& value) {
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+static bool Read(std::ifstream& in, std::string& value) {
+    uint32_t size;
+    if (!Read(in, size) || size > (1 << 16)) {
+        return false;
+    }
+    value.resize(size);
+    return (bool)in.read(value.data(), size);
+}
+
+static void WriteStats(std::ofstream& out, const DiskStatsCache::StatsMap& stats_map) {
+    Write(out, (uint32_t)stats_map.size());
+    for (auto& [key, stats] : stats_map) {
+        Write(out, (int32_t)key);
+        Write(out, (uint64_t)stats.num_pixels);
+        for (double value : {stats.sum, stats.mean, stats.stdDev, stats.rms, stats.sumSq}) {
+            Write(out, value);
+        }
+        Write(out, stats.min_val);
+        Write(out, stats.max_val);
+    }
+}
+
+static bool ReadStats(std::ifstream& in, DiskStatsCache::StatsMap& stats_map) {
+    uint32_t count;
+    if (!Read(in, count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        int32_t key;
+        uint64_t num_pixels;
+        BasicStats<float> stats;
+        if (!Read(in, key) || !Read(in, num_pixels) || !Read(in, stats.sum) || !Read(in, stats.mean) || !Read(in, stats.stdDev) ||
+            !Read(in, stats.rms) || !Read(in, stats.sumSq) || !Read(in, stats.min_val) || !Read(in, stats.max_val)) {
+            return false;
+        }
+        stats.num_pixels = num_pixels;
+        stats_map[key] = stats;
+    }
+    return true;
+}
+
+static void WriteHistograms(std::ofstream& out, const DiskStatsCache::HistogramMap& histogram_map) {
+    uint32_t count(0);
+    for (auto& [key, histograms] : histogram_map) {
+        count += histograms.size();
+    }
+    Write(out, count);
+
+    for (auto& [key, histograms] : histogram_map) {
+        for (auto& histogram : histograms) {
+            auto& bins = histogram.GetHistogramBins();
+            Write(out, (int32_t)key);
+            Write(out, histogram.GetMinVal());
+            Write(out, histogram.GetMaxVal());
+            Write(out, (uint32_t)bins.size());
+            out.write(reinterpret_cast<const char*>(bins.data()), bins.size() * sizeof(int));
+        }
+    }
+}
+
+static bool ReadHistograms(std::ifstream& in, DiskStatsCache::HistogramMap& histogram_map) {
+    uint32_t count;
+    if (!Read(in, count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        int32_t key;
+        float min_val, max_val;
+        uint32_t num_bins;
+        if (!Read(in, key) || !Read(in, min_val) || !Read(in, max_val) || !Read(in, num_bins) || num_bins == 0 ||
+            num_bins > DISK_STATS_CACHE_MAX_BINS) {
+            return false;
+        }
+        std::vector<int> bins(num_bins);
+        if (!in.read(reinterpret_cast<char*>(bins.data()), num_bins * sizeof(int))) {
+            return false;
+        }
+
+        // Histograms which are already in the map were calculated for the open image and are kept
+        auto& histograms = histogram_map[key];
+        bool found(false);
+        for (auto& histogram : histograms) {
+            found |= histogram.GetNbins() == num_bins;
+        }
+        if (!found) {
+            Histogram histogram(num_bins, min_val, max_val, nullptr, 0);
+            histogram.SetHistogramBins(bins);
+            histograms.push_back(histogram);
+        }
+    }
+    return true;
+}
+
+bool DiskStatsCache::Load(const SharedImageId& image_id, uint64_t image_size, StatsMap& image_basic_stats, HistogramMap& image_histograms,
+    StatsMap& cube_basic_stats, HistogramMap& cube_histograms) {
+    std::string path = GetPath(image_id.filename, image_id.hdu);
+    std::error_code error_code;
+    if (path.empty() || !image_id.IsValid() || !fs::exists(path, error_code)) {
+        return false;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(DISK_STATS_CACHE_MAGIC)];
+    uint32_t version, modify_time;
+    uint64_t size;
+    std::string filename, hdu;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, DISK_STATS_CACHE_MAGIC, sizeof(magic)) != 0 || !Read(in, version) ||
+        version != DISK_STATS_CACHE_VERSION || !Read(in, filename) || !Read(in, hdu) || !Read(in, modify_time) || !Read(in, size)) {
+        return false;
+    }
+
+    // Also checks the names, in case of a hash collision
+    if (filename != fs::absolute(image_id.filename).string() || hdu != image_id.hdu || modify_time != image_id.modify_time ||
+        size != image_size) {
+        return false;
+    }
+
+    // Read into copies, so that the maps are unchanged if the file is truncated
+    StatsMap image_stats_read, cube_stats_read;
+    HistogramMap image_histograms_read(image_histograms), cube_histograms_read(cube_histograms);
+    if (!ReadStats(in, image_stats_read) || !ReadStats(in, cube_stats_read) || !ReadHistograms(in, image_histograms_read) ||
+        !ReadHistograms(in, cube_histograms_read)) {
+        spdlog::warn("Could not read stats cache file {}", path);
+        return false;
+    }
+
+    image_basic_stats.insert(image_stats_read.begin(), image_stats_read.end());
+    cube_basic_stats.insert(cube_stats_read.begin(), cube_stats_read.end());
+    image_histograms = std::move(image_histograms_read);
+    cube_histograms = std::move(cube_histograms_read);
+    spdlog::debug("Loaded stats of {} from {}", image_id.filename, path);
+
+    // The modify time orders the files by their last use when the folder is read again
+    in.close();
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error_code);
+    auto file_size = fs::file_size(path, error_code);
+    UpdateIndex(path, error_code ? 0 : file_size);
+    return true;
+}
+
+bool DiskStatsCache::Save(const SharedImageId& image_id, uint64_t image_size, const StatsMap& image_basic_stats,
+    const HistogramMap& image_histograms, const StatsMap& cube_basic_stats, const HistogramMap& cube_histograms) {
+    std::string path = GetPath(image_id.filename, image_id.hdu);
+    if (path.empty() || !image_id.IsValid()) {
+        return false;
+    }
+
+    // Write to a temporary file first, so that other sessions which open the image never read a partial file
+    std::string temp_path = fmt::format("{}.{:x}.tmp", path, std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(DISK_STATS_CACHE_MAGIC, sizeof(DISK_STATS_CACHE_MAGIC));
+        Write(out, (uint32_t)DISK_STATS_CACHE_VERSION);
+        Write(out, fs::absolute(image_id.filename).string());
+        Write(out, image_id.hdu);
+        Write(out, (uint32_t)image_id.modify_time);
+        Write(out, image_size);
+        WriteStats(out, image_basic_stats);
+        WriteStats(out, cube_basic_stats);
+        WriteHistograms(out, image_histograms);
+        WriteHistograms(out, cube_histograms);
+
+        out.close();
+        if (!out) {
+            spdlog::warn("Could not write stats cache file {}", temp_path);
+            std::error_code error_code;
+            fs::remove(temp_path, error_code);
+            return false;
+        }
+    }
+
+    std::error_code error_code;
+    fs::rename(temp_path, path, error_code);
+    if (error_code) {
+        spdlog::warn("Could not write stats cache file {}: {}", path, error_code.message());
+        fs::remove(temp_path, error_code);
+        return false;
+    }
+    auto file_size = fs::file_size(path, error_code);
+    UpdateIndex(path, error_code ? 0 : file_size);
+    return true;
+}
+
+} // namespace carta
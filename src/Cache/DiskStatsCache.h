@@ -0,0 +1,71 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# DiskStatsCache.h: statistics and histograms of an image, stored in the user folder for the next time the image is opened
+
+#ifndef CARTA_BACKEND__DISK_STATS_CACHE_H_
+#define CARTA_BACKEND__DISK_STATS_CACHE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Cache/SharedImageCache.h"
+#include "ImageStats/BasicStatsCalculator.h"
+#include "ImageStats/Histogram.h"
+
+#define DISK_STATS_CACHE_FOLDER "cache/stats" // relative to the user folder
+#define DISK_STATS_CACHE_VERSION 1
+#define DISK_STATS_CACHE_MAX_SIZE 268435456 // bytes; the least recently used files are removed above this size
+
+namespace carta {
+
+// The per-plane and cube statistics and histograms of a Frame, keyed as in the Frame. The file of an image is only used if the
+// image file has the same path, HDU, modify time and size as when it was written; it is replaced when the stats of a modified
+// image are saved. The size of the folder is limited by removing the files which were least recently loaded or saved.
+class DiskStatsCache {
+public:
+    using StatsMap = std::unordered_map<int, BasicStats<float>>;
+    using HistogramMap = std::unordered_map<int, std::vector<Histogram>>;
+
+    // The cache is disabled unless a folder is set
+    static void SetFolder(const std::string& folder, uint64_t max_size = DISK_STATS_CACHE_MAX_SIZE);
+    static bool Enabled();
+    static std::string GetPath(const std::string& filename, const std::string& hdu);
+
+    // Total size of the files of an image; CASA and MIRIAD images are folders, so this is found once when the image is opened
+    static uint64_t GetImageSize(const std::string& filename);
+
+    // Adds the stored stats to the maps; returns false if nothing is stored for this version of the image
+    static bool Load(const SharedImageId& image_id, uint64_t image_size, StatsMap& image_basic_stats, HistogramMap& image_histograms,
+        StatsMap& cube_basic_stats, HistogramMap& cube_histograms);
+    static bool Save(const SharedImageId& image_id, uint64_t image_size, const StatsMap& image_basic_stats,
+        const HistogramMap& image_histograms, const StatsMap& cube_basic_stats, const HistogramMap& cube_histograms);
+
+private:
+    struct IndexEntry {
+        uint64_t size;
+        uint64_t last_used;
+    };
+
+    // Marks a file as used, and removes the least recently used files while the folder is larger than the maximum size
+    static void UpdateIndex(const std::string& path, uint64_t size);
+
+    static std::string _folder;
+    static uint64_t _max_size;
+
+    // Files in the folder, read once when it is set so that a save does not list the folder
+    static std::mutex _index_mutex;
+    static std::unordered_map<std::string, IndexEntry> _index;
+    static uint64_t _index_size;
+    static uint64_t _use_count;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__DISK_STATS_CACHE_H_
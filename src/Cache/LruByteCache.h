@@ -0,0 +1,59 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# LruByteCache.h: per-image LRU cache of immutable values with a byte budget
+
+#ifndef CARTA_BACKEND__LRU_BYTE_CACHE_H_
+#define CARTA_BACKEND__LRU_BYTE_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "Cache/SharedImageCache.h"
+
+namespace carta {
+
+// Values must provide size_t Bytes() const, which may not change once the value is added, and keys a std::hash specialization.
+// All functions lock the cache.
+template <typename KeyType, typename ValueType>
+class LruByteCache {
+public:
+    using Key = KeyType;
+    using ValuePtr = std::shared_ptr<const ValueType>;
+
+    LruByteCache(size_t capacity); // bytes
+
+    // Returns nullptr if the value is not in the cache
+    ValuePtr Get(const Key& key);
+    // Replaces the value if the key is in the cache; values larger than the capacity are not cached
+    void Add(const Key& key, ValuePtr value);
+    void Clear();
+    size_t GetSize();
+
+    // Cached values are discarded if the image file has been modified
+    void SetSharedImageId(const SharedImageId& image_id);
+
+private:
+    using ValuePair = std::pair<Key, ValuePtr>;
+
+    void ClearUnlocked();
+
+    SharedImageId _shared_image_id;
+    std::list<ValuePair> _queue;
+    std::unordered_map<Key, typename std::list<ValuePair>::iterator> _map;
+    size_t _capacity; // bytes
+    size_t _size;     // bytes
+    std::mutex _lru_cache_mutex;
+};
+
+} // namespace carta
+
+#include "LruByteCache.tcc"
+
+#endif // CARTA_BACKEND__LRU_BYTE_CACHE_H_
@@ -0,0 +1,86 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND__LRU_BYTE_CACHE_TCC_
+#define CARTA_BACKEND__LRU_BYTE_CACHE_TCC_
+
+namespace carta {
+
+template <typename KeyType, typename ValueType>
+LruByteCache<KeyType, ValueType>::LruByteCache(size_t capacity) : _capacity(capacity), _size(0) {}
+
+template <typename KeyType, typename ValueType>
+typename LruByteCache<KeyType, ValueType>::ValuePtr LruByteCache<KeyType, ValueType>::Get(const Key& key) {
+    std::unique_lock<std::mutex> guard(_lru_cache_mutex);
+    auto it = _map.find(key);
+    if (it == _map.end()) {
+        return nullptr;
+    }
+
+    // Move to the front of the queue
+    _queue.splice(_queue.begin(), _queue, it->second);
+    return it->second->second;
+}
+
+template <typename KeyType, typename ValueType>
+void LruByteCache<KeyType, ValueType>::Add(const Key& key, ValuePtr value) {
+    if (!value || value->Bytes() > _capacity) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(_lru_cache_mutex);
+    auto it = _map.find(key);
+    if (it != _map.end()) {
+        // Another thread calculated the same value
+        _size -= it->second->second->Bytes();
+        _queue.erase(it->second);
+    }
+
+    _queue.push_front(std::make_pair(key, value));
+    _map[key] = _queue.begin();
+    _size += value->Bytes();
+
+    // Evict the least recently used values
+    while (_size > _capacity) {
+        auto& last = _queue.back();
+        _size -= last.second->Bytes();
+        _map.erase(last.first);
+        _queue.pop_back();
+    }
+}
+
+template <typename KeyType, typename ValueType>
+void LruByteCache<KeyType, ValueType>::Clear() {
+    std::unique_lock<std::mutex> guard(_lru_cache_mutex);
+    ClearUnlocked();
+}
+
+template <typename KeyType, typename ValueType>
+size_t LruByteCache<KeyType, ValueType>::GetSize() {
+    std::unique_lock<std::mutex> guard(_lru_cache_mutex);
+    return _size;
+}
+
+template <typename KeyType, typename ValueType>
+void LruByteCache<KeyType, ValueType>::SetSharedImageId(const SharedImageId& image_id) {
+    std::unique_lock<std::mutex> guard(_lru_cache_mutex);
+    if (!(image_id == _shared_image_id)) {
+        ClearUnlocked();
+        _shared_image_id = image_id;
+    }
+}
+
+template <typename KeyType, typename ValueType>
+void LruByteCache<KeyType, ValueType>::ClearUnlocked() {
+    // Assumes that the lock is held
+    _map.clear();
+    _queue.clear();
+    _size = 0;
+}
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__LRU_BYTE_CACHE_TCC_
@@ -0,0 +1,136 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "MipPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ThreadingManager/ThreadingManager.h"
+
+using namespace carta;
+
+MipPyramid::MipPyramid() : _image(nullptr), _width(0), _height(0) {}
+
+void MipPyramid::Reset(const float* image, int64_t width, int64_t height) {
+    std::unique_lock<std::mutex> lock(_levels_mutex);
+    _image = image;
+    _width = width;
+    _height = height;
+    _levels.clear();
+}
+
+bool MipPyramid::GetBlockMeans(float* dest, int64_t x, int64_t y, int64_t dest_width, int64_t dest_height, int mip) {
+    if (mip < 2 || (mip & (mip - 1)) || x % mip || y % mip) {
+        return false;
+    }
+    int index = __builtin_ctz(mip);
+    Level* level = GetLevel(index);
+    if (!level) {
+        return false;
+    }
+
+    const int64_t level_x = x / mip;
+    const int64_t level_y = y / mip;
+    if (level_x + dest_width > level->width || level_y + dest_height > level->height) {
+        return false;
+    }
+
+    FillRows(level, level_y, level_y + dest_height);
+    for (int64_t j = 0; j < dest_height; j++) {
+        const float* sums = level->sums.get() + (level_y + j) * level->width + level_x;
+        const float* counts = level->counts.get() + (level_y + j) * level->width + level_x;
+        float* dest_row = dest + j * dest_width;
+        for (int64_t i = 0; i < dest_width; i++) {
+            dest_row[i] = counts[i] ? sums[i] / counts[i] : NAN;
+        }
+    }
+    return true;
+}
+
+MipPyramid::Level* MipPyramid::GetLevel(int index) {
+    std::unique_lock<std::mutex> lock(_levels_mutex);
+    if (!_image) {
+        return nullptr;
+    }
+    // Levels are allocated up to the requested one; their rows are only computed when needed
+    while (_levels.size() < (size_t)index) {
+        int64_t previous_width = _levels.empty() ? _width : _levels.back()->width;
+        int64_t previous_height = _levels.empty() ? _height : _levels.back()->height;
+        auto level = std::make_unique<Level>();
+        level->width = (previous_width + 1) / 2;
+        level->height = (previous_height + 1) / 2;
+        size_t size = level->width * level->height;
+        level->sums.reset(new float[size]);
+        level->counts.reset(new float[size]);
+        level->bands.reset(new std::once_flag[(level->height + MIP_PYRAMID_BAND_HEIGHT - 1) / MIP_PYRAMID_BAND_HEIGHT]);
+        level->previous = _levels.empty() ? nullptr : _levels.back().get();
+        _levels.push_back(std::move(level));
+    }
+    return _levels[index - 1].get();
+}
+
+void MipPyramid::FillRows(Level* level, int64_t row_start, int64_t row_end) {
+    row_end = std::min(row_end, level->height);
+    for (int64_t band = row_start / MIP_PYRAMID_BAND_HEIGHT; band * MIP_PYRAMID_BAND_HEIGHT < row_end; band++) {
+        std::call_once(level->bands[band], [&]() { FillBand(level, band); });
+    }
+}
+
+void MipPyramid::FillBand(Level* level, int64_t band) {
+    const int64_t row_start = band * MIP_PYRAMID_BAND_HEIGHT;
+    const int64_t row_end = std::min(row_start + MIP_PYRAMID_BAND_HEIGHT, level->height);
+    const int64_t width = level->width;
+
+    Level* previous = level->previous;
+    if (!previous) {
+        // Sums and counts of the finite values of each 2x2 block of the image
+        ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+        for (int64_t j = row_start; j < row_end; j++) {
+            int64_t rows = std::min((int64_t)2, _height - 2 * j);
+            for (int64_t i = 0; i < width; i++) {
+                int64_t columns = std::min((int64_t)2, _width - 2 * i);
+                float sum = 0;
+                float count = 0;
+                for (int64_t y = 0; y < rows; y++) {
+                    const float* values = _image + (2 * j + y) * _width + 2 * i;
+                    for (int64_t x = 0; x < columns; x++) {
+                        if (std::isfinite(values[x])) {
+                            sum += values[x];
+                            count++;
+                        }
+                    }
+                }
+                level->sums[j * width + i] = sum;
+                level->counts[j * width + i] = count;
+            }
+        }
+        return;
+    }
+
+    // Sums of the 2x2 blocks of the previous level, whose rows are computed first
+    FillRows(previous, 2 * row_start, 2 * row_end);
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t j = row_start; j < row_end; j++) {
+        int64_t rows = std::min((int64_t)2, previous->height - 2 * j);
+        for (int64_t i = 0; i < width; i++) {
+            int64_t columns = std::min((int64_t)2, previous->width - 2 * i);
+            float sum = 0;
+            float count = 0;
+            for (int64_t y = 0; y < rows; y++) {
+                int64_t previous_index = (2 * j + y) * previous->width + 2 * i;
+                for (int64_t x = 0; x < columns; x++) {
+                    sum += previous->sums[previous_index + x];
+                    count += previous->counts[previous_index + x];
+                }
+            }
+            level->sums[j * width + i] = sum;
+            level->counts[j * width + i] = count;
+        }
+    }
+}
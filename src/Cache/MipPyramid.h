@@ -0,0 +1,60 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# MipPyramid.h: cascaded 2x2 block sums of an image plane, for mean-filtered downsampled tiles
+
+#ifndef CARTA_BACKEND__MIP_PYRAMID_H_
+#define CARTA_BACKEND__MIP_PYRAMID_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define MIP_PYRAMID_BAND_HEIGHT 64 // rows of a level which are computed together
+
+namespace carta {
+
+// Level k holds the sum and the count of the finite values of each 2^k x 2^k block of the image, computed from the 2x2 blocks of
+// level k - 1 (or of the image, for level 1). The mean of a block is then the same as the one computed by BlockSmooth, which skips
+// NaN and infinite values, but each level costs a quarter of the previous one instead of a pass over the full image. Levels are
+// computed lazily, in bands of rows, when tiles need them.
+class MipPyramid {
+public:
+    MipPyramid();
+
+    // Discards all levels; the pyramid is then computed from the given image. Must not be called concurrently with GetBlockMeans.
+    void Reset(const float* image, int64_t width, int64_t height);
+
+    // Fills dest with the means of the mip x mip blocks of the image starting at (x, y), as BlockSmooth does. Only possible if mip
+    // is a power of two (at least 2) and x and y are multiples of mip; returns false otherwise.
+    bool GetBlockMeans(float* dest, int64_t x, int64_t y, int64_t dest_width, int64_t dest_height, int mip);
+
+private:
+    struct Level {
+        int64_t width;
+        int64_t height;
+        std::unique_ptr<float[]> sums;
+        std::unique_ptr<float[]> counts;
+        std::unique_ptr<std::once_flag[]> bands;
+        Level* previous; // nullptr for level 1, which is computed from the image
+    };
+
+    Level* GetLevel(int index);
+    // Computes the rows [row_start, row_end) of a level, if not done yet
+    void FillRows(Level* level, int64_t row_start, int64_t row_end);
+    void FillBand(Level* level, int64_t band);
+
+    const float* _image;
+    int64_t _width;
+    int64_t _height;
+    std::vector<std::unique_ptr<Level>> _levels; // level k is at index k - 1
+    std::mutex _levels_mutex;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__MIP_PYRAMID_H_
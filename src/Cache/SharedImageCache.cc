@@ -0,0 +1,105 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "SharedImageCache.h"
+
+#include "Logger/Logger.h"
+
+namespace carta {
+
+std::list<SharedImageCache::DataPair> SharedImageCache::_queue;
+std::unordered_map<SharedImageCache::Key, std::list<SharedImageCache::DataPair>::iterator> SharedImageCache::_map;
+size_t SharedImageCache::_capacity = (size_t)DEFAULT_SHARED_IMAGE_CACHE_SIZE * 1024 * 1024;
+size_t SharedImageCache::_size = 0;
+std::mutex SharedImageCache::_shared_cache_mutex;
+
+void SharedImageCache::SetCapacity(size_t capacity_mb) {
+    std::unique_lock<std::mutex> guard(_shared_cache_mutex);
+    _capacity = capacity_mb * 1024 * 1024;
+    Evict();
+}
+
+size_t SharedImageCache::GetCapacity() {
+    std::unique_lock<std::mutex> guard(_shared_cache_mutex);
+    return _capacity;
+}
+
+size_t SharedImageCache::GetSize() {
+    std::unique_lock<std::mutex> guard(_shared_cache_mutex);
+    return _size;
+}
+
+bool SharedImageCache::Enabled() {
+    std::unique_lock<std::mutex> guard(_shared_cache_mutex);
+    return _capacity > 0;
+}
+
+SharedImageCache::DataPtr SharedImageCache::Get(const Key& key) {
+    if (!key.image.IsValid()) {
+        return nullptr;
+    }
+
+    std::unique_lock<std::mutex> guard(_shared_cache_mutex);
+    auto it = _map.find(key);
+    if (it == _map.end()) {
+        return nullptr;
+    }
+
+    // Move to the front of the queue
+    _queue.splice(_queue.begin(), _queue, it->second);
+    return it->second->second;
+}
+
+SharedImageCache::DataPtr SharedImageCache::Add(const Key& key, DataPtr data) {
+    if (!data || !key.image.IsValid()) {
+        return data;
+    }
+
+    std::unique_lock<std::mutex> guard(_shared_cache_mutex);
+    if (_capacity == 0) {
+        return data;
+    }
+
+    auto it = _map.find(key);
+    if (it != _map.end()) {
+        // Another session loaded the same data first; share that copy
+        _queue.splice(_queue.begin(), _queue, it->second);
+        return it->second->second;
+    }
+
+    _queue.push_front(std::make_pair(key, data));
+    _map[key] = _queue.begin();
+    _size += data->size() * sizeof(float);
+    Evict();
+
+    return data;
+}
+
+void SharedImageCache::Clear() {
+    std::unique_lock<std::mutex> guard(_shared_cache_mutex);
+    _map.clear();
+    _queue.clear();
+    _size = 0;
+}
+
+void SharedImageCache::Evict() {
+    // Assumes that the lock is held. Drop the least recently used entries which are not referenced anywhere else.
+    auto it = _queue.end();
+    while (_size > _capacity && it != _queue.begin()) {
+        --it;
+        if (it->second.use_count() == 1) {
+            _size -= it->second->size() * sizeof(float);
+            _map.erase(it->first);
+            it = _queue.erase(it);
+        }
+    }
+
+    if (_size > _capacity) {
+        spdlog::debug("Shared image cache is over budget: {} MB in use by open images", _size / (1024 * 1024));
+    }
+}
+
+} // namespace carta
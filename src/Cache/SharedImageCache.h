@@ -0,0 +1,112 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SharedImageCache.h: process-wide cache of image planes and tiles, shared between sessions
+
+#ifndef CARTA_BACKEND__SHARED_IMAGE_CACHE_H_
+#define CARTA_BACKEND__SHARED_IMAGE_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define DEFAULT_SHARED_IMAGE_CACHE_SIZE 1024 // MB
+#define SHARED_CACHE_FULL_PLANE -1
+
+namespace carta {
+
+// Identifies the image file (and version of the file) which the cached data belongs to
+struct SharedImageId {
+    std::string filename;
+    std::string hdu;
+    unsigned int modify_time = 0;
+
+    SharedImageId() = default;
+    SharedImageId(const std::string& filename_, const std::string& hdu_, unsigned int modify_time_)
+        : filename(filename_), hdu(hdu_), modify_time(modify_time_) {}
+
+    // Images without a file on disk (generated or LEL images) cannot be shared
+    bool IsValid() const {
+        return !filename.empty() && (modify_time > 0);
+    }
+    bool operator==(const SharedImageId& rhs) const {
+        return (filename == rhs.filename) && (hdu == rhs.hdu) && (modify_time == rhs.modify_time);
+    }
+};
+
+// x and y are the tile origin, or SHARED_CACHE_FULL_PLANE for a full image plane
+struct SharedImageCacheKey {
+    SharedImageId image;
+    int32_t z;
+    int32_t stokes;
+    int32_t x;
+    int32_t y;
+
+    SharedImageCacheKey() : z(0), stokes(0), x(SHARED_CACHE_FULL_PLANE), y(SHARED_CACHE_FULL_PLANE) {}
+    SharedImageCacheKey(const SharedImageId& image_, int32_t z_, int32_t stokes_, int32_t x_ = SHARED_CACHE_FULL_PLANE,
+        int32_t y_ = SHARED_CACHE_FULL_PLANE)
+        : image(image_), z(z_), stokes(stokes_), x(x_), y(y_) {}
+
+    bool operator==(const SharedImageCacheKey& rhs) const {
+        return (z == rhs.z) && (stokes == rhs.stokes) && (x == rhs.x) && (y == rhs.y) && (image == rhs.image);
+    }
+};
+
+} // namespace carta
+
+namespace std {
+template <>
+struct hash<carta::SharedImageCacheKey> {
+    std::size_t operator()(const carta::SharedImageCacheKey& k) const {
+        std::size_t seed = std::hash<std::string>()(k.image.filename);
+        for (std::size_t value : {std::hash<std::string>()(k.image.hdu), std::hash<unsigned int>()(k.image.modify_time),
+                 std::hash<int32_t>()(k.z), std::hash<int32_t>()(k.stokes), std::hash<int32_t>()(k.x), std::hash<int32_t>()(k.y)}) {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+} // namespace std
+
+namespace carta {
+
+// LRU cache with a global memory budget. Entries which are still referenced by a frame or a tile cache are never evicted,
+// so the budget may be exceeded temporarily while many different planes are open.
+class SharedImageCache {
+public:
+    using Key = SharedImageCacheKey;
+    using DataPtr = std::shared_ptr<std::vector<float>>;
+
+    static void SetCapacity(size_t capacity_mb);
+    static size_t GetCapacity();
+    static size_t GetSize();
+    static bool Enabled();
+
+    // Returns nullptr if the data is not in the cache
+    static DataPtr Get(const Key& key);
+    // Returns the cached data, which is not the data passed in if another thread added it first
+    static DataPtr Add(const Key& key, DataPtr data);
+    static void Clear();
+
+private:
+    using DataPair = std::pair<Key, DataPtr>;
+
+    static void Evict();
+
+    static std::list<DataPair> _queue;
+    static std::unordered_map<Key, std::list<DataPair>::iterator> _map;
+    static size_t _capacity; // bytes
+    static size_t _size;     // bytes
+    static std::mutex _shared_cache_mutex;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__SHARED_IMAGE_CACHE_H_
@@ -6,18 +6,13 @@
 
 #include "TileCache.h"
 
-#include <functional>
+#include <algorithm>
 
 #include "Util/Image.h"
 
-// TILE POOL
-
 using namespace carta;
 
-TileCache::TileCache(int capacity) : _capacity(capacity), _z(0), _stokes(0), _pool(std::make_shared<TilePool>()) {
-    std::unique_lock<std::mutex> guard(_tile_cache_mutex);
-    _pool->Grow(capacity);
-}
+TileCache::TileCache(size_t capacity) : _capacity(capacity), _size(0), _chunk_width(CHUNK_SIZE), _chunk_height(CHUNK_SIZE) {}
 
 TilePtr TileCache::Peek(Key key) {
     // This is a read-only operation which it is safe to do in parallel.
@@ -35,29 +30,51 @@ TilePtr TileCache::Get(Key key, std::shared_ptr<FileLoader> loader, std::mutex&
     std::unique_lock<std::mutex> guard(_tile_cache_mutex);
 
     if (_map.find(key) == _map.end()) { // Not in cache
-        // Load 2x2 chunk of tiles from image
+        // Another session may already have loaded this tile
+        auto shared_tile = SharedImageCache::Get(SharedKey(key));
+        if (shared_tile) {
+            Insert(key, shared_tile);
+            return shared_tile;
+        }
+
+        // Load the chunk of tiles which contains this tile from the image
         valid = LoadChunk(ChunkKey(key), loader, image_mutex);
     } else {
         Touch(key);
     }
 
-    if (valid) {
+    // The tile may already have been evicted if the capacity is smaller than a chunk
+    if (valid && _map.find(key) != _map.end()) {
         return UnsafePeek(key);
     }
 
     return nullptr;
 }
 
-void TileCache::Reset(int32_t z, int32_t stokes, int capacity) {
+void TileCache::Reset(size_t capacity) {
     std::unique_lock<std::mutex> guard(_tile_cache_mutex);
     if (capacity > 0) {
-        _pool->Grow(capacity - _capacity);
         _capacity = capacity;
     }
     _map.clear();
     _queue.clear();
-    _z = z;
-    _stokes = stokes;
+    _size = 0;
+}
+
+void TileCache::SetSharedImageId(const SharedImageId& image_id) {
+    std::unique_lock<std::mutex> guard(_tile_cache_mutex);
+    if (!(image_id == _shared_image_id)) {
+        _map.clear();
+        _queue.clear();
+        _size = 0;
+        _shared_image_id = image_id;
+    }
+}
+
+void TileCache::SetChunkShape(int chunk_width, int chunk_height) {
+    std::unique_lock<std::mutex> guard(_tile_cache_mutex);
+    _chunk_width = chunk_width;
+    _chunk_height = chunk_height;
 }
 
 TilePtr TileCache::UnsafePeek(Key key) {
@@ -74,95 +91,66 @@ void TileCache::Touch(Key key) {
     _map[key] = _queue.begin();
 }
 
-TileCache::Key TileCache::ChunkKey(Key tile_key) {
-    return Key((tile_key.x / CHUNK_SIZE) * CHUNK_SIZE, (tile_key.y / CHUNK_SIZE) * CHUNK_SIZE);
-}
-
-bool TileCache::LoadChunk(Key chunk_key, std::shared_ptr<FileLoader> loader, std::mutex& image_mutex) {
-    // load a chunk from the file
-    int data_width;
-    int data_height;
-
-    if (!loader->GetChunk(_chunk, data_width, data_height, chunk_key.x, chunk_key.y, _z, _stokes, image_mutex)) {
-        return false;
-    };
+void TileCache::Insert(Key key, TilePtr tile) {
+    // Assumes that the tile is not in the cache
+    size_t tile_bytes = tile->size() * sizeof(float);
 
-    // split the chunk into four tiles
-    std::vector<TilePtr> tiles;
-    std::vector<int> tile_widths;
-    std::vector<int> tile_heights;
-
-    for (int tile_row = 0; tile_row < 2; tile_row++) {
-        for (int tile_col = 0; tile_col < 2; tile_col++) {
-            tile_widths.push_back(std::max(0, std::min(TILE_SIZE, data_width - tile_col * TILE_SIZE)));
-            tile_heights.push_back(std::max(0, std::min(TILE_SIZE, data_height - tile_row * TILE_SIZE)));
-            tiles.push_back(_pool->Pull());
-            tiles.back()->resize(tile_widths.back() * tile_heights.back());
-        }
+    // Evict oldest tiles, from any plane, if necessary
+    while (!_queue.empty() && _size + tile_bytes > _capacity) {
+        _size -= _queue.back().second->size() * sizeof(float);
+        _map.erase(_queue.back().first);
+        _queue.pop_back();
     }
 
-    std::function<void(TileIter, int, TileIter&)> do_nothing = [&](TileIter start, int width, TileIter& destination) {};
-
-    std::function<void(TileIter, int, TileIter&)> do_copy = [&](TileIter start, int width, TileIter& destination) {
-        std::copy(start, start + width, destination);
-        std::advance(destination, width);
-    };
-
-    auto left_copy = do_copy;
-    auto right_copy = (data_width > TILE_SIZE) ? do_copy : do_nothing;
-
-    auto pos = _chunk.begin();
-    auto row_read_end = pos;
-
-    for (int tr : {0, 1}) {
-        auto row_height = tile_heights[tr * 2];
-
-        if (!row_height) {
-            continue;
-        }
-
-        auto left = tiles[tr * 2]->begin();
-        auto right = tiles[tr * 2 + 1]->begin();
-
-        auto left_width = tile_widths[tr * 2];
-        auto right_width = tile_widths[tr * 2 + 1];
+    // Insert the new tile
+    _queue.push_front(std::make_pair(key, tile));
+    _map[key] = _queue.begin();
+    _size += tile_bytes;
+}
 
-        row_read_end += data_width * row_height;
+SharedImageCache::Key TileCache::SharedKey(Key key) const {
+    return SharedImageCache::Key(_shared_image_id, key.z, key.stokes, key.x, key.y);
+}
 
-        while (pos < row_read_end) {
-            left_copy(pos, left_width, left);
-            right_copy(pos + TILE_SIZE, right_width, right);
-            std::advance(pos, data_width);
-        }
-    }
+TileCache::Key TileCache::ChunkKey(Key tile_key) const {
+    return Key((tile_key.x / _chunk_width) * _chunk_width, (tile_key.y / _chunk_height) * _chunk_height, tile_key.z, tile_key.stokes);
+}
 
-    // insert the 4 tiles into the cache
-    std::vector<std::pair<int, int>> offsets = {{0, 0}, {TILE_SIZE, 0}, {0, TILE_SIZE}, {TILE_SIZE, TILE_SIZE}};
-    auto tile_offset = offsets.begin();
-    for (auto& t : tiles) {
-        Key key(chunk_key.x + tile_offset->first, chunk_key.y + tile_offset->second);
+bool TileCache::LoadChunk(Key chunk_key, std::shared_ptr<FileLoader> loader, std::mutex& image_mutex) {
+    // load a chunk from the file; the chunk shape is clipped to the image
+    int data_width(_chunk_width);
+    int data_height(_chunk_height);
 
-        if (key.x < chunk_key.x + data_width && key.y < chunk_key.y + data_height) {
-            // this tile is within the bounds of the image
+    if (!loader->GetChunk(_chunk, data_width, data_height, chunk_key.x, chunk_key.y, chunk_key.z, chunk_key.stokes, image_mutex)) {
+        return false;
+    };
 
-            // If the tile is not in the map
-            if (_map.find(key) == _map.end()) { // add if not found
-                // Evict oldest tile if necessary
-                if (_map.size() == _capacity) {
-                    _map.erase(_queue.back().first);
-                    _queue.pop_back();
-                }
+    // split the chunk into tiles
+    for (int tile_y = 0; tile_y < data_height; tile_y += TILE_SIZE) {
+        int tile_height = std::min(TILE_SIZE, data_height - tile_y);
 
-                // Insert the new tile
-                _queue.push_front(std::make_pair(key, t));
-                _map[key] = _queue.begin();
+        for (int tile_x = 0; tile_x < data_width; tile_x += TILE_SIZE) {
+            Key key(chunk_key.x + tile_x, chunk_key.y + tile_y, chunk_key.z, chunk_key.stokes);
 
-            } else { // touch the tile
+            if (_map.find(key) != _map.end()) { // touch the tile
                 Touch(key);
+                continue;
             }
-        }
 
-        std::advance(tile_offset, 1);
+            // copy the rows of the tile
+            int tile_width = std::min(TILE_SIZE, data_width - tile_x);
+            auto tile = FloatBufferPool::TakeShared(tile_width * tile_height);
+            auto source = _chunk.begin() + (size_t)tile_y * data_width + tile_x;
+            auto destination = tile->begin();
+            for (int row = 0; row < tile_height; ++row) {
+                std::copy(source, source + tile_width, destination);
+                std::advance(source, data_width);
+                std::advance(destination, tile_width);
+            }
+
+            // Use the shared copy if another session added this tile in the meantime
+            Insert(key, SharedImageCache::Add(SharedKey(key), tile));
+        }
     }
 
     return true;
@@ -13,11 +13,13 @@
 #include <unordered_map>
 #include <vector>
 
+#include "Cache/BufferPool.h"
+#include "Cache/SharedImageCache.h"
 #include "Cache/TileCacheKey.h"
-#include "Cache/TilePool.h"
 #include "ImageData/FileLoader.h"
 
-#define MAX_TILE_CACHE_CAPACITY 4096
+#define MAX_TILE_CACHE_CAPACITY 4096 // tiles
+#define TILE_CACHE_NUM_PLANES 4      // number of planes the default capacity allows for
 
 namespace carta {
 
@@ -27,35 +29,43 @@ class TileCache {
 public:
     using Key = TileCacheKey;
 
-    TileCache() {}
-    TileCache(int capacity);
+    TileCache() : TileCache(0) {}
+    TileCache(size_t capacity); // bytes
 
     // This is read-only and does not lock the cache
     TilePtr Peek(Key key);
 
-    // These functions lock the cache
+    // These functions lock the cache. Tiles from all planes share a single LRU queue and byte budget.
     TilePtr Get(Key key, std::shared_ptr<FileLoader> loader, std::mutex& image_mutex);
-    void Reset(int32_t z, int32_t stokes, int capacity = 0);
+    void Reset(size_t capacity = 0);
 
-    static Key ChunkKey(Key tile_key);
+    // Tiles are shared with other sessions through the SharedImageCache if the image is valid.
+    // Cached tiles are discarded if the image file has been modified.
+    void SetSharedImageId(const SharedImageId& image_id);
+
+    // Chunks of tiles are read from the image in the shape given by the loader, which follows the storage of the image
+    void SetChunkShape(int chunk_width, int chunk_height);
+    Key ChunkKey(Key tile_key) const;
 
 private:
     using TilePair = std::pair<Key, TilePtr>;
-    using TileIter = std::vector<float>::iterator;
 
     TilePtr UnsafePeek(Key key);
     void Touch(Key key);
+    void Insert(Key key, TilePtr tile);
+    SharedImageCache::Key SharedKey(Key key) const;
     bool LoadChunk(Key chunk_key, std::shared_ptr<FileLoader> loader, std::mutex& image_mutex);
 
-    int32_t _z;
-    int32_t _stokes;
+    SharedImageId _shared_image_id;
     std::list<TilePair> _queue;
     std::unordered_map<Key, std::list<TilePair>::iterator> _map;
-    int _capacity;
+    size_t _capacity; // bytes
+    size_t _size;     // bytes
     std::mutex _tile_cache_mutex;
 
     std::vector<float> _chunk;
-    std::shared_ptr<TilePool> _pool;
+    int _chunk_width;  // multiple of TILE_SIZE
+    int _chunk_height; // multiple of TILE_SIZE
 };
 
 } // namespace carta
@@ -7,15 +7,20 @@
 #ifndef CARTA_BACKEND_TILECACHEKEY_H
 #define CARTA_BACKEND_TILECACHEKEY_H
 
+#include <cstdint>
+#include <functional>
+
 namespace carta {
 struct TileCacheKey {
     TileCacheKey() {}
-    TileCacheKey(int32_t x, int32_t y) : x(x), y(y) {}
+    TileCacheKey(int32_t x, int32_t y, int32_t z, int32_t stokes) : x(x), y(y), z(z), stokes(stokes) {}
     bool operator==(const TileCacheKey& other) const {
-        return (x == other.x && y == other.y);
+        return (x == other.x && y == other.y && z == other.z && stokes == other.stokes);
     }
     int32_t x;
     int32_t y;
+    int32_t z;
+    int32_t stokes;
 };
 
 } // namespace carta
@@ -24,7 +29,11 @@ namespace std {
 template <>
 struct hash<carta::TileCacheKey> {
     std::size_t operator()(const carta::TileCacheKey& k) const {
-        return std::hash<int32_t>()(k.x) ^ (std::hash<int32_t>()(k.x) << 1);
+        std::size_t seed = std::hash<int32_t>()(k.x);
+        for (std::size_t value : {std::hash<int32_t>()(k.y), std::hash<int32_t>()(k.z), std::hash<int32_t>()(k.stokes)}) {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
     }
 };
 } // namespace std
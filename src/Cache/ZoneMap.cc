@@ -0,0 +1,154 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "ZoneMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ThreadingManager/ThreadingManager.h"
+
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+using namespace carta;
+
+ZoneMap::ZoneMap() : _image(nullptr), _width(0), _height(0) {}
+
+void ZoneMap::Reset(const float* image, int64_t width, int64_t height) {
+    _image = image;
+    _width = width;
+    _height = height;
+    if (_image) {
+        size_t num_blocks = NumBlocksX() * NumBlocksY();
+        _blocks.resize(num_blocks);
+        _filled.reset(new std::once_flag[num_blocks]);
+    } else {
+        _blocks.clear();
+        _filled.reset();
+    }
+}
+
+const ZoneMapBlock* ZoneMap::GetBlocks() {
+    if (!_image) {
+        return nullptr;
+    }
+
+    const int64_t num_blocks_x = NumBlocksX();
+    const int64_t num_blocks_y = NumBlocksY();
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t block_y = 0; block_y < num_blocks_y; block_y++) {
+        for (int64_t block_x = 0; block_x < num_blocks_x; block_x++) {
+            GetBlock(block_x, block_y);
+        }
+    }
+    return _blocks.data();
+}
+
+int64_t ZoneMap::NumBlocksX() const {
+    return (_width + ZONE_MAP_BLOCK_SIZE - 1) / ZONE_MAP_BLOCK_SIZE;
+}
+
+int64_t ZoneMap::NumBlocksY() const {
+    return (_height + ZONE_MAP_BLOCK_SIZE - 1) / ZONE_MAP_BLOCK_SIZE;
+}
+
+bool ZoneMap::IsAllNan(int64_t x_min, int64_t y_min, int64_t x_max, int64_t y_max) {
+    x_max = std::min(x_max, _width);
+    y_max = std::min(y_max, _height);
+    if (!_image || x_min < 0 || y_min < 0 || x_min >= x_max || y_min >= y_max) {
+        return false;
+    }
+
+    // Blocks which are only partly in the region are checked pixel by pixel
+    for (int64_t block_y = y_min / ZONE_MAP_BLOCK_SIZE; block_y * ZONE_MAP_BLOCK_SIZE < y_max; block_y++) {
+        for (int64_t block_x = x_min / ZONE_MAP_BLOCK_SIZE; block_x * ZONE_MAP_BLOCK_SIZE < x_max; block_x++) {
+            const auto& block = GetBlock(block_x, block_y);
+            if (block.nan_count == 0) {
+                return false;
+            } else if (block.min > block.max) {
+                // There are only NaN values in the block
+                continue;
+            }
+            int64_t x_start = std::max(x_min, block_x * ZONE_MAP_BLOCK_SIZE);
+            int64_t x_end = std::min(x_max, (block_x + 1) * ZONE_MAP_BLOCK_SIZE);
+            int64_t y_start = std::max(y_min, block_y * ZONE_MAP_BLOCK_SIZE);
+            int64_t y_end = std::min(y_max, (block_y + 1) * ZONE_MAP_BLOCK_SIZE);
+            for (int64_t y = y_start; y < y_end; y++) {
+                const float* row = _image + y * _width;
+                for (int64_t x = x_start; x < x_end; x++) {
+                    if (!std::isnan(row[x])) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+const ZoneMapBlock& ZoneMap::GetBlock(int64_t block_x, int64_t block_y) {
+    int64_t index = block_y * NumBlocksX() + block_x;
+    std::call_once(_filled[index], [&]() { FillBlock(block_x, block_y); });
+    return _blocks[index];
+}
+
+void ZoneMap::FillBlock(int64_t block_x, int64_t block_y) {
+    const int64_t x_start = block_x * ZONE_MAP_BLOCK_SIZE;
+    const int64_t x_end = std::min(x_start + ZONE_MAP_BLOCK_SIZE, _width);
+    const int64_t y_start = block_y * ZONE_MAP_BLOCK_SIZE;
+    const int64_t y_end = std::min(y_start + ZONE_MAP_BLOCK_SIZE, _height);
+
+    // _mm_min_ps and _mm_max_ps return their second argument if either one is NaN, so NaN values are skipped. The counts are
+    // accumulated by subtracting the comparison masks, which are -1 where they are true.
+    const int64_t simd_end = x_start + ((x_end - x_start) & ~3);
+    __m128 min_vals = _mm_set1_ps(INFINITY);
+    __m128 max_vals = _mm_set1_ps(-INFINITY);
+    __m128i nan_counts = _mm_setzero_si128();
+    __m128i finite_counts = _mm_setzero_si128();
+    const __m128 zeros = _mm_setzero_ps();
+
+    float min_val = INFINITY;
+    float max_val = -INFINITY;
+    int32_t nan_count = 0;
+    int32_t finite_count = 0;
+    for (int64_t y = y_start; y < y_end; y++) {
+        const float* row = _image + y * _width;
+        for (int64_t x = x_start; x < simd_end; x += 4) {
+            __m128 values = _mm_loadu_ps(row + x);
+            min_vals = _mm_min_ps(values, min_vals);
+            max_vals = _mm_max_ps(values, max_vals);
+            nan_counts = _mm_sub_epi32(nan_counts, _mm_castps_si128(_mm_cmpunord_ps(values, values)));
+            finite_counts = _mm_sub_epi32(finite_counts, _mm_castps_si128(_mm_cmpeq_ps(_mm_sub_ps(values, values), zeros)));
+        }
+        for (int64_t x = simd_end; x < x_end; x++) {
+            // std::min and std::max return their first argument if the second one is NaN
+            float value = row[x];
+            min_val = std::min(min_val, value);
+            max_val = std::max(max_val, value);
+            nan_count += std::isnan(value);
+            finite_count += std::isfinite(value);
+        }
+    }
+
+    float min_array[4], max_array[4];
+    int32_t nan_array[4], finite_array[4];
+    _mm_storeu_ps(min_array, min_vals);
+    _mm_storeu_ps(max_array, max_vals);
+    _mm_storeu_si128((__m128i*)nan_array, nan_counts);
+    _mm_storeu_si128((__m128i*)finite_array, finite_counts);
+    for (int k = 0; k < 4; k++) {
+        min_val = std::min(min_val, min_array[k]);
+        max_val = std::max(max_val, max_array[k]);
+        nan_count += nan_array[k];
+        finite_count += finite_array[k];
+    }
+    _blocks[block_y * NumBlocksX() + block_x] = {min_val, max_val, nan_count, finite_count};
+}
@@ -0,0 +1,65 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# ZoneMap.h: value range and NaN count of each block of an image plane, to skip blocks in scans of the plane
+
+#ifndef CARTA_BACKEND__ZONE_MAP_H_
+#define CARTA_BACKEND__ZONE_MAP_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define ZONE_MAP_BLOCK_SIZE 64 // width and height of a block in pixels
+
+namespace carta {
+
+struct ZoneMapBlock {
+    float min;            // of the values which are not NaN; +inf if there are none
+    float max;            // of the values which are not NaN; -inf if there are none
+    int32_t nan_count;    // number of NaN values
+    int32_t finite_count; // number of finite values; the others are infinite
+};
+
+// Blocks of ZONE_MAP_BLOCK_SIZE x ZONE_MAP_BLOCK_SIZE pixels (smaller at the right and bottom edges). Each block is computed the first
+// time it is used after Reset, so checks of a few tiles do not scan the whole image.
+class ZoneMap {
+public:
+    ZoneMap();
+
+    // Discards the blocks; they are then computed from the given image. Must not be called concurrently with the other functions.
+    void Reset(const float* image, int64_t width, int64_t height);
+
+    // Computes all blocks (in parallel), or returns nullptr if there is no image. Block (i, j), which starts at pixel
+    // (i * ZONE_MAP_BLOCK_SIZE, j * ZONE_MAP_BLOCK_SIZE), is at index j * NumBlocksX() + i.
+    const ZoneMapBlock* GetBlocks();
+    int64_t NumBlocksX() const;
+    int64_t NumBlocksY() const;
+
+    // Whether all pixels of the region [x_min, x_max) x [y_min, y_max) are NaN; false if there is no image
+    bool IsAllNan(int64_t x_min, int64_t y_min, int64_t x_max, int64_t y_max);
+
+    // Whether a block may have a pixel which is NaN or below the level next to a pixel which is not below it, i.e. whether a contour
+    // at the level may cross the block.
+    static bool MayCross(const ZoneMapBlock& block, float level) {
+        return (block.nan_count > 0 || block.min < level) && block.max >= level;
+    }
+
+private:
+    const ZoneMapBlock& GetBlock(int64_t block_x, int64_t block_y);
+    void FillBlock(int64_t block_x, int64_t block_y);
+
+    const float* _image;
+    int64_t _width;
+    int64_t _height;
+    std::vector<ZoneMapBlock> _blocks;
+    std::unique_ptr<std::once_flag[]> _filled;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__ZONE_MAP_H_
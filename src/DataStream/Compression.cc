@@ -6,10 +6,15 @@
 
 #include "Compression.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstring>
 
 #include <zfp.h>
+#include <zstd.h>
+
+#include "Util/Simd.h"
 
 #ifdef _ARM_ARCH_
 #include <sse2neon/sse2neon.h>
@@ -19,46 +24,148 @@
 
 namespace carta {
 
-int Compress(std::vector<float>& array, size_t offset, std::vector<char>& compression_buffer, size_t& compressed_size, uint32_t nx,
-    uint32_t ny, uint32_t precision) {
-    int status = 0;     /* return value: 0 = success */
-    zfp_type type;      /* array scalar type */
-    zfp_field* field;   /* array meta data */
-    zfp_stream* zfp;    /* compressed stream */
-    size_t buffer_size; /* byte size of compressed buffer */
-    bitstream* stream;  /* bit stream to write to or read from */
+// ZFP stream, field and bit stream are reused by each thread instead of being allocated for every tile
+struct ZfpContext {
+    zfp_stream* zfp;
+    zfp_field* field;
+    bitstream* stream;
+    void* stream_buffer;
+    size_t stream_size;
 
-    type = zfp_type_float;
-    field = zfp_field_2d(array.data() + offset, type, nx, ny);
+    ZfpContext() : zfp(zfp_stream_open(nullptr)), field(zfp_field_alloc()), stream(nullptr), stream_buffer(nullptr), stream_size(0) {
+        zfp_field_set_type(field, zfp_type_float);
+    }
+    ~ZfpContext() {
+        if (stream) {
+            stream_close(stream);
+        }
+        zfp_field_free(field);
+        zfp_stream_close(zfp);
+    }
 
-    /* allocate meta data for a compressed stream */
-    zfp = zfp_stream_open(nullptr);
+    void SetBuffer(void* buffer, size_t size) {
+        if (!stream || buffer != stream_buffer || size != stream_size) {
+            if (stream) {
+                stream_close(stream);
+            }
+            stream = stream_open(buffer, size);
+            stream_buffer = buffer;
+            stream_size = size;
+            zfp_stream_set_bit_stream(zfp, stream);
+        }
+        zfp_stream_rewind(zfp);
+    }
+};
 
-    /* set compression mode and parameters via one of three functions */
-    zfp_stream_set_precision(zfp, precision);
+static thread_local ZfpContext zfp_context;
+
+// The buffer is grown to the maximum compressed size if necessary; the compressed data is written at its start
+template <typename B>
+static int CompressToBuffer(
+    std::vector<float>& array, size_t offset, B& compression_buffer, size_t& compressed_size, uint32_t nx, uint32_t ny, uint32_t prec) {
+    auto& context = zfp_context;
+    zfp_field_set_pointer(context.field, array.data() + offset);
+    zfp_field_set_size_2d(context.field, nx, ny);
+    zfp_stream_set_precision(context.zfp, prec);
 
-    /* allocate buffer for compressed data */
-    buffer_size = zfp_stream_maximum_size(zfp, field);
+    size_t buffer_size = zfp_stream_maximum_size(context.zfp, context.field);
     if (compression_buffer.size() < buffer_size) {
         compression_buffer.resize(buffer_size);
     }
-    stream = stream_open(compression_buffer.data(), buffer_size);
-    zfp_stream_set_bit_stream(zfp, stream);
-    zfp_stream_rewind(zfp);
+    context.SetBuffer(compression_buffer.data(), buffer_size);
 
-    compressed_size = zfp_compress(zfp, field);
-    if (!compressed_size) {
-        status = 1;
-    }
+    compressed_size = zfp_compress(context.zfp, context.field);
+    return compressed_size ? 0 : 1;
+}
 
-    /* clean up */
-    zfp_field_free(field);
-    zfp_stream_close(zfp);
-    stream_close(stream);
+int Compress(std::vector<float>& array, size_t offset, std::vector<char>& compression_buffer, size_t& compressed_size, uint32_t nx,
+    uint32_t ny, uint32_t precision) {
+    return CompressToBuffer(array, offset, compression_buffer, compressed_size, nx, ny, precision);
+}
 
+int Compress(std::vector<float>& array, size_t offset, std::string& compression_buffer, uint32_t nx, uint32_t ny, uint32_t precision) {
+    size_t compressed_size(0);
+    int status = CompressToBuffer(array, offset, compression_buffer, compressed_size, nx, ny, precision);
+    compression_buffer.resize(compressed_size); // does not reallocate
     return status;
 }
 
+// Compression ratio of a mosaic of 4x4 blocks taken from a regular grid over the tile; ZFP compresses each block independently,
+// so this estimates the ratio of the whole tile. Returns 0 if the tile is too small to sample.
+static float EstimateCompressionRatio(std::vector<float>& array, uint32_t nx, uint32_t ny, uint32_t precision) {
+    uint32_t sample_columns = nx / (4 * TILE_SAMPLE_STRIDE);
+    uint32_t sample_rows = ny / (4 * TILE_SAMPLE_STRIDE);
+    if (sample_columns < TILE_SAMPLE_MIN_BLOCKS || sample_rows < TILE_SAMPLE_MIN_BLOCKS) {
+        return 0;
+    }
+
+    thread_local std::vector<float> sample;
+    thread_local std::vector<char> sample_buffer;
+    uint32_t sample_width = 4 * sample_columns;
+    sample.resize(16 * sample_columns * sample_rows);
+
+    for (uint32_t j = 0; j < sample_rows; ++j) {
+        for (uint32_t i = 0; i < sample_columns; ++i) {
+            size_t x = 4 * (i * TILE_SAMPLE_STRIDE + TILE_SAMPLE_STRIDE / 2);
+            size_t y = 4 * (j * TILE_SAMPLE_STRIDE + TILE_SAMPLE_STRIDE / 2);
+            for (uint32_t row = 0; row < 4; ++row) {
+                auto source = array.begin() + (y + row) * nx + x;
+                std::copy(source, source + 4, sample.begin() + (4 * j + row) * sample_width + 4 * i);
+            }
+        }
+    }
+
+    size_t compressed_size(0);
+    if (CompressToBuffer(sample, 0, sample_buffer, compressed_size, sample_width, 4 * sample_rows, precision)) {
+        return 0;
+    }
+    return (float)(sizeof(float) * sample.size()) / compressed_size;
+}
+
+uint32_t CompressTile(
+    std::vector<float>& array, std::string& compression_buffer, uint32_t nx, uint32_t ny, uint32_t precision, uint32_t high_precision) {
+    if (precision >= high_precision) {
+        Compress(array, 0, compression_buffer, nx, ny, precision);
+        return precision;
+    }
+
+    size_t data_size = sizeof(float) * nx * ny;
+    float sample_ratio = EstimateCompressionRatio(array, nx, ny, precision);
+
+    if (sample_ratio > 0) {
+        // Choose the precision from the sample, so that the tile is compressed once
+        bool use_high_precision = (sample_ratio > TILE_HIGH_PRECISION_RATIO) &&
+                                  (EstimateCompressionRatio(array, nx, ny, high_precision) > TILE_HIGH_PRECISION_MIN_RATIO);
+        if (!use_high_precision) {
+            Compress(array, 0, compression_buffer, nx, ny, precision);
+            return precision;
+        }
+
+        Compress(array, 0, compression_buffer, nx, ny, high_precision);
+        if (!compression_buffer.empty() && (float)data_size / compression_buffer.size() > TILE_HIGH_PRECISION_MIN_RATIO) {
+            return high_precision;
+        }
+
+        // The sample was not representative
+        Compress(array, 0, compression_buffer, nx, ny, precision);
+        return precision;
+    }
+
+    // Small tiles are compressed with the default precision first
+    Compress(array, 0, compression_buffer, nx, ny, precision);
+    if (compression_buffer.empty() || (float)data_size / compression_buffer.size() <= TILE_HIGH_PRECISION_RATIO) {
+        return precision;
+    }
+
+    std::string compression_buffer_hq;
+    Compress(array, 0, compression_buffer_hq, nx, ny, high_precision);
+    if (!compression_buffer_hq.empty() && (float)data_size / compression_buffer_hq.size() > TILE_HIGH_PRECISION_MIN_RATIO) {
+        compression_buffer.swap(compression_buffer_hq);
+        return high_precision;
+    }
+    return precision;
+}
+
 int Decompress(std::vector<float>& array, std::vector<char>& compression_buffer, int nx, int ny, int precision) {
     int status = 0;    /* return value: 0 = success */
     zfp_type type;     /* array scalar type */
@@ -86,71 +193,418 @@ int Decompress(std::vector<float>& array, std::vector<char>& compression_buffer,
     return status;
 }
 
-// Removes NaNs from an array and returns run-length encoded list of NaNs
+// zstd contexts and scratch buffers are reused by each thread
+struct LosslessContext {
+    ZSTD_CCtx* cctx;
+    ZSTD_DCtx* dctx;
+    std::vector<uint32_t> deltas;
+    std::vector<char> planes;
+
+    LosslessContext() : cctx(ZSTD_createCCtx()), dctx(ZSTD_createDCtx()) {}
+    ~LosslessContext() {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+};
+
+static thread_local LosslessContext lossless_context;
+
+// Transposes the bytes of 4 32-bit values, so that byte k of value i moves to byte i of value k
+alignas(16) static const std::array<uint8_t, 16> byte_transpose = {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15};
+
+int CompressLossless(
+    const std::vector<float>& array, size_t offset, std::string& compression_buffer, uint32_t nx, uint32_t ny, int compression_level) {
+    auto& context = lossless_context;
+    const size_t length = (size_t)nx * ny;
+    const uint32_t* values = reinterpret_cast<const uint32_t*>(array.data() + offset);
+
+    // XOR with the left neighbour, or the value above for the first column; similar neighbours share sign, exponent and high
+    // mantissa bits, which become zero
+    auto& deltas = context.deltas;
+    deltas.resize(length);
+    for (size_t y = 0; y < ny; ++y) {
+        const uint32_t* row = values + y * nx;
+        uint32_t* delta_row = deltas.data() + y * nx;
+        if (nx) {
+            delta_row[0] = row[0] ^ (y ? row[-(int64_t)nx] : 0);
+        }
+        for (size_t x = 1; x < nx; ++x) {
+            delta_row[x] = row[x] ^ row[x - 1];
+        }
+    }
+
+    // Split into 4 byte planes
+    auto& planes = context.planes;
+    planes.resize(4 * length);
+    const size_t blocked_length = 4 * (length / 4);
+    const __m128i transpose = _mm_load_si128((const __m128i*)byte_transpose.data());
+    for (size_t i = 0; i < blocked_length; i += 4) {
+        __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&deltas[i]), transpose);
+        alignas(16) uint32_t plane_values[4];
+        _mm_store_si128((__m128i*)plane_values, bytes);
+        for (int k = 0; k < 4; ++k) {
+            std::memcpy(&planes[k * length + i], &plane_values[k], 4);
+        }
+    }
+    for (size_t i = blocked_length; i < length; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            planes[k * length + i] = (deltas[i] >> (8 * k)) & 0xFF;
+        }
+    }
+
+    compression_buffer.resize(ZSTD_compressBound(planes.size()));
+    size_t compressed_size = ZSTD_compressCCtx(
+        context.cctx, compression_buffer.data(), compression_buffer.size(), planes.data(), planes.size(), compression_level);
+    if (ZSTD_isError(compressed_size)) {
+        compression_buffer.clear();
+        return 1;
+    }
+    compression_buffer.resize(compressed_size);
+    return 0;
+}
+
+int DecompressLossless(std::vector<float>& array, const std::string& compression_buffer, uint32_t nx, uint32_t ny) {
+    auto& context = lossless_context;
+    const size_t length = (size_t)nx * ny;
+    auto& planes = context.planes;
+    planes.resize(4 * length);
+    size_t decompressed_size =
+        ZSTD_decompressDCtx(context.dctx, planes.data(), planes.size(), compression_buffer.data(), compression_buffer.size());
+    if (ZSTD_isError(decompressed_size) || decompressed_size != planes.size()) {
+        return 1;
+    }
+
+    array.resize(length);
+    uint32_t* values = reinterpret_cast<uint32_t*>(array.data());
+    for (size_t i = 0; i < length; ++i) {
+        uint32_t delta(0);
+        for (int k = 0; k < 4; ++k) {
+            delta |= (uint32_t)(uint8_t)planes[k * length + i] << (8 * k);
+        }
+        values[i] = delta;
+    }
+
+    // Undo the XOR with the neighbours
+    for (size_t y = 0; y < ny; ++y) {
+        uint32_t* row = values + y * nx;
+        if (nx && y) {
+            row[0] ^= row[-(int64_t)nx];
+        }
+        for (size_t x = 1; x < nx; ++x) {
+            row[x] ^= row[x - 1];
+        }
+    }
+    return 0;
+}
+
+template <typename T>
+struct ProfileBits {};
+template <>
+struct ProfileBits<float> {
+    using Type = uint32_t;
+    static constexpr zfp_type zfp = zfp_type_float;
+};
+template <>
+struct ProfileBits<double> {
+    using Type = uint64_t;
+    static constexpr zfp_type zfp = zfp_type_double;
+};
+
+template <typename T>
+int CompressProfile(const T* values, size_t count, std::string& compression_buffer, ProfileCodec codec, uint32_t precision) {
+    using Bits = typename ProfileBits<T>::Type;
+    const size_t offset = compression_buffer.size();
+    const size_t data_size = count * sizeof(T);
+
+    if (codec == ProfileCodec::Zstd) {
+        // XOR with the previous value, and split into byte planes
+        auto& planes = lossless_context.planes;
+        planes.resize(data_size);
+        Bits previous(0);
+        for (size_t i = 0; i < count; ++i) {
+            Bits value;
+            std::memcpy(&value, &values[i], sizeof(T));
+            Bits delta = value ^ previous;
+            previous = value;
+            for (size_t k = 0; k < sizeof(T); ++k) {
+                planes[k * count + i] = (delta >> (8 * k)) & 0xFF;
+            }
+        }
+
+        compression_buffer.resize(offset + ZSTD_compressBound(data_size));
+        size_t compressed_size = ZSTD_compressCCtx(lossless_context.cctx, compression_buffer.data() + offset,
+            compression_buffer.size() - offset, planes.data(), data_size, PROFILE_COMPRESSION_LEVEL);
+        if (ZSTD_isError(compressed_size)) {
+            compression_buffer.resize(offset);
+            return 1;
+        }
+        compression_buffer.resize(offset + compressed_size);
+        return 0;
+    }
+
+    if (codec == ProfileCodec::Zfp) {
+        zfp_field* field = zfp_field_1d(const_cast<T*>(values), ProfileBits<T>::zfp, count);
+        zfp_stream* zfp = zfp_stream_open(nullptr);
+        zfp_stream_set_precision(zfp, precision);
+        size_t buffer_size = zfp_stream_maximum_size(zfp, field);
+        compression_buffer.resize(offset + buffer_size);
+        bitstream* stream = stream_open(compression_buffer.data() + offset, buffer_size);
+        zfp_stream_set_bit_stream(zfp, stream);
+        zfp_stream_rewind(zfp);
+
+        size_t compressed_size = zfp_compress(zfp, field);
+        compression_buffer.resize(offset + compressed_size);
+
+        zfp_field_free(field);
+        zfp_stream_close(zfp);
+        stream_close(stream);
+        return compressed_size ? 0 : 1;
+    }
+
+    compression_buffer.append(reinterpret_cast<const char*>(values), data_size);
+    return 0;
+}
+
+template <typename T>
+int DecompressProfile(std::vector<T>& values, size_t count, const char* data, size_t size, ProfileCodec codec, uint32_t precision) {
+    using Bits = typename ProfileBits<T>::Type;
+    const size_t data_size = count * sizeof(T);
+    values.resize(count);
+
+    if (codec == ProfileCodec::Zstd) {
+        auto& planes = lossless_context.planes;
+        planes.resize(data_size);
+        size_t decompressed_size = ZSTD_decompressDCtx(lossless_context.dctx, planes.data(), data_size, data, size);
+        if (ZSTD_isError(decompressed_size) || decompressed_size != data_size) {
+            return 1;
+        }
+        Bits previous(0);
+        for (size_t i = 0; i < count; ++i) {
+            Bits delta(0);
+            for (size_t k = 0; k < sizeof(T); ++k) {
+                delta |= (Bits)(uint8_t)planes[k * count + i] << (8 * k);
+            }
+            previous ^= delta;
+            std::memcpy(&values[i], &previous, sizeof(T));
+        }
+        return 0;
+    }
+
+    if (codec == ProfileCodec::Zfp) {
+        zfp_field* field = zfp_field_1d(values.data(), ProfileBits<T>::zfp, count);
+        zfp_stream* zfp = zfp_stream_open(nullptr);
+        zfp_stream_set_precision(zfp, precision);
+        bitstream* stream = stream_open(const_cast<char*>(data), size);
+        zfp_stream_set_bit_stream(zfp, stream);
+        zfp_stream_rewind(zfp);
+
+        int status = zfp_decompress(zfp, field) ? 0 : 1;
+
+        zfp_field_free(field);
+        zfp_stream_close(zfp);
+        stream_close(stream);
+        return status;
+    }
+
+    if (size != data_size) {
+        return 1;
+    }
+    std::memcpy(values.data(), data, data_size);
+    return 0;
+}
+
+template int CompressProfile<float>(const float*, size_t, std::string&, ProfileCodec, uint32_t);
+template int CompressProfile<double>(const double*, size_t, std::string&, ProfileCodec, uint32_t);
+template int DecompressProfile<float>(std::vector<float>&, size_t, const char*, size_t, ProfileCodec, uint32_t);
+template int DecompressProfile<double>(std::vector<double>&, size_t, const char*, size_t, ProfileCodec, uint32_t);
+
+// Bit i of masks[k] is set if values[16 * k + i] is NaN
+typedef void (*NanMaskFunction)(const float* values, size_t num_blocks, uint16_t* masks);
+
+static void NanMasksSSE(const float* values, size_t num_blocks, uint16_t* masks) {
+    for (size_t k = 0; k < num_blocks; k++, values += 16) {
+        uint32_t mask = 0;
+        for (int i = 0; i < 4; i++) {
+            __m128 v = _mm_loadu_ps(values + 4 * i);
+            mask |= _mm_movemask_ps(_mm_cmpunord_ps(v, v)) << (4 * i);
+        }
+        masks[k] = mask;
+    }
+}
+
+#ifdef SIMD_DISPATCH
+SIMD_TARGET_AVX static void NanMasksAVX(const float* values, size_t num_blocks, uint16_t* masks) {
+    for (size_t k = 0; k < num_blocks; k++, values += 16) {
+        __m256 v0 = _mm256_loadu_ps(values);
+        __m256 v1 = _mm256_loadu_ps(values + 8);
+        masks[k] = _mm256_movemask_ps(_mm256_cmp_ps(v0, v0, _CMP_UNORD_Q)) | (_mm256_movemask_ps(_mm256_cmp_ps(v1, v1, _CMP_UNORD_Q)) << 8);
+    }
+}
+
+SIMD_TARGET_AVX512 static void NanMasksAVX512(const float* values, size_t num_blocks, uint16_t* masks) {
+    for (size_t k = 0; k < num_blocks; k++, values += 16) {
+        __m512 v = _mm512_loadu_ps(values);
+        masks[k] = _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q);
+    }
+}
+#endif
+
+// NaN masks of the complete blocks of 16 values, in a buffer reused by each thread
+static const uint16_t* NanMasks(const float* values, size_t num_blocks) {
+    thread_local std::vector<uint16_t> masks;
+    masks.resize(num_blocks);
+
+    NanMaskFunction nan_masks = NanMasksSSE;
+#ifdef SIMD_DISPATCH
+    auto simd_level = GetSimdLevel();
+    if (simd_level >= SimdLevel::AVX512) {
+        nan_masks = NanMasksAVX512;
+    } else if (simd_level >= SimdLevel::AVX) {
+        nan_masks = NanMasksAVX;
+    }
+#endif
+    nan_masks(values, num_blocks, masks.data());
+    return masks.data();
+}
+
+// Appends the lengths of the runs which end within the 16 values starting at index start
+static inline void AddRunLengths(uint32_t mask, int start, bool& prev, int32_t& prev_index, std::vector<int32_t>& encoded_array) {
+    uint32_t changes = (mask ^ ((mask << 1) | (uint32_t)prev)) & 0xFFFF;
+    while (changes) {
+        int i = start + __builtin_ctz(changes);
+        encoded_array.push_back(i - prev_index);
+        prev_index = i;
+        changes &= changes - 1;
+    }
+    prev = (mask >> 15) & 1;
+}
+
+// Removes NaNs from an array and returns run-length encoded list of NaNs.
+// NaNs are classified 16 values at a time; runs without NaNs or without valid values are skipped as a whole.
 std::vector<int32_t> GetNanEncodingsSimple(std::vector<float>& array, int offset, int length) {
     int32_t prev_index = offset;
     bool prev = false;
     std::vector<int32_t> encoded_array;
+    float* data = array.data();
     // Find first non-NaN number in the array
     float prev_valid_num = 0;
     for (auto i = offset; i < offset + length; i++) {
-        if (!std::isnan(array[i])) {
-            prev_valid_num = array[i];
+        if (!std::isnan(data[i])) {
+            prev_valid_num = data[i];
             break;
         }
     }
 
-    // Generate RLE list and replace NaNs with neighbouring valid values. Ideally, this should take into account
-    // the width and height of the image, and look for neighbouring values in vertical and horizontal directions,
-    // but this is only an issue with NaNs right at the edge of images.
-    for (auto i = offset; i < offset + length; i++) {
-        bool current = std::isnan(array[i]);
+    // Generate RLE list and replace NaNs with the previous valid value
+    const int end = offset + length;
+    const uint16_t* masks = NanMasks(data + offset, length / 16);
+    int i = offset;
+    for (; i + 16 <= end; i += 16) {
+        uint32_t mask = *masks++;
+        AddRunLengths(mask, i, prev, prev_index, encoded_array);
+        if (mask == 0) {
+            prev_valid_num = data[i + 15];
+        } else if (mask == 0xFFFF) {
+            __m128 fill = _mm_set1_ps(prev_valid_num);
+            for (int j = 0; j < 16; j += 4) {
+                _mm_storeu_ps(data + i + j, fill);
+            }
+        } else {
+            for (int j = 0; j < 16; j++) {
+                if ((mask >> j) & 1) {
+                    data[i + j] = prev_valid_num;
+                } else {
+                    prev_valid_num = data[i + j];
+                }
+            }
+        }
+    }
+
+    for (; i < end; i++) {
+        bool current = std::isnan(data[i]);
         if (current != prev) {
             encoded_array.push_back(i - prev_index);
             prev_index = i;
             prev = current;
         }
         if (current) {
-            array[i] = prev_valid_num;
+            data[i] = prev_valid_num;
         } else {
-            prev_valid_num = array[i];
+            prev_valid_num = data[i];
         }
     }
-    encoded_array.push_back(offset + length - prev_index);
+    encoded_array.push_back(end - prev_index);
     return encoded_array;
 }
 
+// Replaces NaNs in a 4x4 block with the average of the valid values in the block, unless the block has no NaNs or no valid values
+static inline void FillNanBlock(float* block, int w) {
+    __m128 rows[4];
+    __m128 nan_rows[4];
+    __m128 sum = _mm_setzero_ps();
+    int nan_count = 0;
+    for (int y = 0; y < 4; y++) {
+        rows[y] = _mm_loadu_ps(block + y * w);
+        nan_rows[y] = _mm_cmpunord_ps(rows[y], rows[y]);
+        nan_count += __builtin_popcount(_mm_movemask_ps(nan_rows[y]));
+        sum = _mm_add_ps(sum, _mm_andnot_ps(nan_rows[y], rows[y]));
+    }
+
+    if (nan_count == 0 || nan_count == 16) {
+        return;
+    }
+
+    alignas(16) float column_sums[4];
+    _mm_store_ps(column_sums, sum);
+    __m128 average = _mm_set1_ps((column_sums[0] + column_sums[1] + column_sums[2] + column_sums[3]) / (16 - nan_count));
+    for (int y = 0; y < 4; y++) {
+        _mm_storeu_ps(block + y * w, _mm_blendv_ps(rows[y], average, nan_rows[y]));
+    }
+}
+
 std::vector<int32_t> GetNanEncodingsBlock(std::vector<float>& array, int offset, int w, int h) {
     // Generate RLE NaN list
-    int length = w * h;
+    const int length = w * h;
+    const int end = offset + length;
     int32_t prev_index = offset;
     bool prev = false;
     std::vector<int32_t> encoded_array;
+    float* data = array.data();
 
-    for (auto i = offset; i < offset + length; i++) {
-        bool current = std::isnan(array[i]);
+    const uint16_t* masks = NanMasks(data + offset, length / 16);
+    int index = offset;
+    for (; index + 16 <= end; index += 16) {
+        AddRunLengths(*masks++, index, prev, prev_index, encoded_array);
+    }
+    for (; index < end; index++) {
+        bool current = std::isnan(data[index]);
         if (current != prev) {
-            encoded_array.push_back(i - prev_index);
-            prev_index = i;
+            encoded_array.push_back(index - prev_index);
+            prev_index = index;
             prev = current;
         }
     }
-    encoded_array.push_back(offset + length - prev_index);
+    encoded_array.push_back(end - prev_index);
 
     // Skip all-NaN images and NaN-free images
     if (encoded_array.size() > 1) {
-        // Calculate average of 4x4 blocks (matching blocks used in ZFP), and replace NaNs with block average
-        for (auto i = 0; i < w; i += 4) {
-            for (auto j = 0; j < h; j += 4) {
+        // Replace NaNs with the average of their 4x4 block (matching blocks used in ZFP)
+        for (auto j = 0; j < h; j += 4) {
+            for (auto i = 0; i < w; i += 4) {
                 int block_start = offset + j * w + i;
-                int valid_count = 0;
-                float sum = 0;
                 // Limit the block size when at the edges of the image
                 int block_width = std::min(4, w - i);
                 int block_height = std::min(4, h - j);
+                if (block_width == 4 && block_height == 4) {
+                    FillNanBlock(data + block_start, w);
+                    continue;
+                }
+
+                int valid_count = 0;
+                float sum = 0;
                 for (int x = 0; x < block_width; x++) {
                     for (int y = 0; y < block_height; y++) {
-                        float v = array[block_start + (y * w) + x];
+                        float v = data[block_start + (y * w) + x];
                         if (!std::isnan(v)) {
                             valid_count++;
                             sum += v;
@@ -158,14 +612,12 @@ std::vector<int32_t> GetNanEncodingsBlock(std::vector<float>& array, int offset,
                     }
                 }
 
-                // Only process blocks which have at least one valid value AND at least one NaN. All-NaN blocks won't affect ZFP compression
                 if (valid_count && valid_count != block_width * block_height) {
                     float average = sum / valid_count;
                     for (int x = 0; x < block_width; x++) {
                         for (int y = 0; y < block_height; y++) {
-                            float v = array[block_start + (y * w) + x];
-                            if (std::isnan(v)) {
-                                array[block_start + (y * w) + x] = average;
+                            if (std::isnan(data[block_start + (y * w) + x])) {
+                                data[block_start + (y * w) + x] = average;
                             }
                         }
                     }
@@ -199,6 +651,47 @@ void RoundAndEncodeVertices(const std::vector<float>& array, std::vector<int32_t
     EncodeIntegers(dest, true);
 }
 
+// zstd context and scratch buffer for contour vertices, reused by each thread
+struct VertexContext {
+    ZSTD_CCtx* cctx;
+    int num_workers;
+    std::vector<int32_t> encoded_vertices;
+
+    VertexContext() : cctx(ZSTD_createCCtx()), num_workers(0) {}
+    ~VertexContext() {
+        ZSTD_freeCCtx(cctx);
+    }
+};
+
+static thread_local VertexContext vertex_context;
+
+int CompressVertices(const std::vector<float>& vertices, std::string& compression_buffer, float rounding_factor, int compression_level) {
+    auto& context = vertex_context;
+    auto& encoded_vertices = context.encoded_vertices;
+    RoundAndEncodeVertices(vertices, encoded_vertices, rounding_factor);
+    const size_t src_size = encoded_vertices.size() * sizeof(int32_t);
+
+    int num_workers = (compression_level >= VERTEX_MT_MIN_LEVEL && src_size >= VERTEX_MT_MIN_SIZE) ? VERTEX_MT_WORKERS : 0;
+    if (num_workers != context.num_workers) {
+        // Fails if zstd was built without multithreading support, in which case the chunk is compressed by this thread
+        ZSTD_CCtx_setParameter(context.cctx, ZSTD_c_nbWorkers, num_workers);
+        context.num_workers = num_workers;
+    }
+    ZSTD_CCtx_setParameter(context.cctx, ZSTD_c_compressionLevel, compression_level);
+
+    compression_buffer.resize(ZSTD_compressBound(src_size));
+    size_t compressed_size =
+        ZSTD_compress2(context.cctx, compression_buffer.data(), compression_buffer.size(), encoded_vertices.data(), src_size);
+    if (ZSTD_isError(compressed_size)) {
+        ZSTD_CCtx_reset(context.cctx, ZSTD_reset_session_and_parameters);
+        context.num_workers = 0;
+        compression_buffer.clear();
+        return 1;
+    }
+    compression_buffer.resize(compressed_size);
+    return 0;
+}
+
 void EncodeIntegers(std::vector<int32_t>& array, bool strided) {
     const int num_values = array.size();
     const int blocked_length = 4 * (num_values / 4);
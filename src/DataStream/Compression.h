@@ -9,17 +9,54 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
 
+#define TILE_HIGH_PRECISION_RATIO 20     // minimum compression ratio at the requested precision to try high precision
+#define TILE_HIGH_PRECISION_MIN_RATIO 10 // minimum compression ratio at high precision
+#define TILE_SAMPLE_STRIDE 4             // every 4th 4x4 block in each direction is sampled
+#define TILE_SAMPLE_MIN_BLOCKS 4         // minimum sample width and height in blocks
+#define LOSSLESS_COMPRESSION_LEVEL 1     // zstd level for lossless tiles
+#define PROFILE_COMPRESSION_LEVEL 3      // zstd level for lossless profiles
+#define VERTEX_MT_MIN_LEVEL 10           // minimum zstd level at which contour vertices are compressed by multiple threads
+#define VERTEX_MT_MIN_SIZE 4194304       // minimum size of encoded contour vertices for multithreaded compression, in bytes
+#define VERTEX_MT_WORKERS 4              // number of zstd worker threads for multithreaded compression
+
 namespace carta {
 
+enum class ProfileCodec : uint8_t { None = 0, Zstd = 1, Zfp = 2 };
+
 int Compress(std::vector<float>& array, size_t offset, std::vector<char>& compression_buffer, std::size_t& compressed_size, uint32_t nx,
     uint32_t ny, uint32_t precision);
+// Compresses into the string, which is resized to the compressed size; e.g. directly into a protobuf bytes field
+int Compress(std::vector<float>& array, size_t offset, std::string& compression_buffer, uint32_t nx, uint32_t ny, uint32_t precision);
+// Compresses a tile with the given precision, or with high_precision if the data compresses well enough: if the ratio at the
+// given precision is above TILE_HIGH_PRECISION_RATIO and the ratio at high_precision is still above TILE_HIGH_PRECISION_MIN_RATIO.
+// For tiles of at least 64x64 pixels the ratios are estimated from a sample of the tile, so that it is usually only compressed
+// once. Returns the precision used.
+uint32_t CompressTile(
+    std::vector<float>& array, std::string& compression_buffer, uint32_t nx, uint32_t ny, uint32_t precision, uint32_t high_precision);
 int Decompress(std::vector<float>& array, std::vector<char>& compression_buffer, int nx, int ny, int precision);
+// Lossless codec: each value is XORed with its left neighbour (the value above in the first column), the bytes are split into
+// four planes, and the planes are compressed with zstd. NaNs are kept, so no NaN encodings are needed.
+int CompressLossless(const std::vector<float>& array, size_t offset, std::string& compression_buffer, uint32_t nx, uint32_t ny,
+    int compression_level = LOSSLESS_COMPRESSION_LEVEL);
+int DecompressLossless(std::vector<float>& array, const std::string& compression_buffer, uint32_t nx, uint32_t ny);
+// Profile codecs for float or double values: Zstd XORs each value with the previous one, splits the bytes into planes and compresses
+// them with zstd (lossless); Zfp compresses the values as a 1D ZFP field with the given precision. The compressed data is appended to
+// the string.
+template <typename T>
+int CompressProfile(const T* values, size_t count, std::string& compression_buffer, ProfileCodec codec, uint32_t precision);
+template <typename T>
+int DecompressProfile(std::vector<T>& values, size_t count, const char* data, size_t size, ProfileCodec codec, uint32_t precision);
 std::vector<int32_t> GetNanEncodingsSimple(std::vector<float>& array, int offset, int length);
 std::vector<int32_t> GetNanEncodingsBlock(std::vector<float>& array, int offset, int w, int h);
 
 void RoundAndEncodeVertices(const std::vector<float>& array, std::vector<int32_t>& dest, float rounding_factor);
+// Rounds and encodes the vertices, and compresses them with zstd into the string, which is resized to the compressed size. The zstd
+// context and the buffer of encoded vertices are reused by each thread. Large chunks at high levels use zstd worker threads, if zstd
+// was built with multithreading support.
+int CompressVertices(const std::vector<float>& vertices, std::string& compression_buffer, float rounding_factor, int compression_level);
 void EncodeIntegers(std::vector<int32_t>& array, bool strided = false);
 
 } // namespace carta
@@ -6,24 +6,45 @@
 
 #include "Contouring.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <limits>
 #include <vector>
 
 #include "../Logger/Logger.h"
+#include "Cache/ZoneMap.h"
 #include "ThreadingManager/ThreadingManager.h"
+#include "Util/Simd.h"
+
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
 
 namespace carta {
 
+// End of a segment traced within the rows [row_start, row_end) of cells: the column of the cell which it entered in the strip above
+// or below, or -1 if it ended. A closed segment is started by TraceLevel at the first top edge which it crosses downwards, given as
+// j * width + i of the cell below the edge, with the index of the vertex on that edge.
+struct SegmentEnd {
+    int64_t column = -1;
+    bool below = false;
+    int64_t first_crossing = std::numeric_limits<int64_t>::max();
+    size_t first_crossing_vertex = 0;
+};
+
 // Contour tracing code adapted from SAOImage DS9: https://github.com/SAOImageDS9/SAOImageDS9
-void TraceSegment(const float* image, std::vector<bool>& visited, int64_t width, int64_t height, double scale, double offset, double level,
-    int x_cell, int y_cell, int side, vector<float>& vertices) {
+// With first_iteration false, the segment continues into the cell from its given side, without repeating the vertex on that side.
+// Cells which are entered through their top edge are marked in visited, which holds the rows [row_start, row_end).
+SegmentEnd TraceSegment(const float* image, std::vector<bool>& visited, int64_t width, int64_t height, int64_t row_start, int64_t row_end,
+    double scale, double offset, double level, int x_cell, int y_cell, int side, bool first_iteration, vector<float>& vertices) {
     int64_t i = x_cell;
     int64_t j = y_cell;
     int orig_side = side;
+    SegmentEnd end;
 
-    bool first_iteration = true;
     bool done = (i < 0 || i >= width - 1 || (j < 0 && j >= height - 1));
 
     while (!done) {
@@ -39,6 +60,7 @@ void TraceSegment(const float* image, std::vector<bool>& visited, int64_t width,
 
         double x = 0;
         double y = 0;
+        bool crossed_down = false;
         if (first_iteration) {
             first_iteration = false;
             switch (side) {
@@ -64,7 +86,7 @@ void TraceSegment(const float* image, std::vector<bool>& visited, int64_t width,
 
         } else {
             if (side == Edge::TopEdge) {
-                visited[j * width + i] = true;
+                visited[(j - row_start) * width + i] = true;
             }
 
             do {
@@ -109,6 +131,7 @@ void TraceSegment(const float* image, std::vector<bool>& visited, int64_t width,
                         break;
                 }
             } while (!flag);
+            crossed_down = (side == Edge::BottomEdge);
 
             if (++side == Edge::None) {
                 side = Edge::TopEdge;
@@ -121,29 +144,167 @@ void TraceSegment(const float* image, std::vector<bool>& visited, int64_t width,
             }
             if (i < 0 || i >= width - 1 || j < 0 || j >= height - 1) {
                 done = true;
+                crossed_down = false;
+            } else if (j < row_start || j >= row_end) {
+                done = true;
+                end.column = i;
+                end.below = (j >= row_end);
             }
         }
 
+        if (crossed_down && j * width + i < end.first_crossing) {
+            end.first_crossing = j * width + i;
+            end.first_crossing_vertex = vertices.size();
+        }
+
         // Shift to pixel center
         double x_val = x + 0.5;
         double y_val = y + 0.5;
         vertices.push_back(scale * x_val + offset);
         vertices.push_back(scale * y_val + offset);
     }
+    return end;
 }
 
+// Pre-scan of a row for the first i in [start, end) which may start a segment, i.e. (isnan(a) || a < level) && level <= b for
+// a = row[i] and b = row[i + 1]; returns end if there is none. The level is the smallest float not below the double-precision
+// level, which gives the same comparisons. Each kernel returns the position at which the scalar loop continues.
+typedef int64_t (*CrossingScanFunction)(const float* row, int64_t start, int64_t end, float level);
+
+static int64_t FindCrossingSSE(const float* row, int64_t start, int64_t end, float level) {
+    const __m128 levels = _mm_set1_ps(level);
+    int64_t i = start;
+    for (; i + 4 <= end; i += 4) {
+        __m128 below = _mm_cmpnge_ps(_mm_loadu_ps(row + i), levels);
+        __m128 above = _mm_cmpge_ps(_mm_loadu_ps(row + i + 1), levels);
+        int mask = _mm_movemask_ps(_mm_and_ps(below, above));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i;
+}
+
+#ifdef SIMD_DISPATCH
+SIMD_TARGET_AVX static int64_t FindCrossingAVX(const float* row, int64_t start, int64_t end, float level) {
+    const __m256 levels = _mm256_set1_ps(level);
+    int64_t i = start;
+    for (; i + 8 <= end; i += 8) {
+        __m256 below = _mm256_cmp_ps(_mm256_loadu_ps(row + i), levels, _CMP_NGE_UQ);
+        __m256 above = _mm256_cmp_ps(_mm256_loadu_ps(row + i + 1), levels, _CMP_GE_OQ);
+        int mask = _mm256_movemask_ps(_mm256_and_ps(below, above));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX512 static int64_t FindCrossingAVX512(const float* row, int64_t start, int64_t end, float level) {
+    const __m512 levels = _mm512_set1_ps(level);
+    int64_t i = start;
+    for (; i + 16 <= end; i += 16) {
+        __mmask16 below = _mm512_cmp_ps_mask(_mm512_loadu_ps(row + i), levels, _CMP_NGE_UQ);
+        __mmask16 mask = _mm512_mask_cmp_ps_mask(below, _mm512_loadu_ps(row + i + 1), levels, _CMP_GE_OQ);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i;
+}
+#endif
+
+static int64_t FindCrossing(CrossingScanFunction scan, const float* row, int64_t start, int64_t end, float level) {
+    int64_t i = scan(row, start, end, level);
+    for (; i < end; i++) {
+        if (!(row[i] >= level) && level <= row[i + 1]) {
+            break;
+        }
+    }
+    return i;
+}
+
+static CrossingScanFunction GetCrossingScanFunction() {
+#ifdef SIMD_DISPATCH
+    auto simd_level = GetSimdLevel();
+    if (simd_level >= SimdLevel::AVX512) {
+        return FindCrossingAVX512;
+    } else if (simd_level >= SimdLevel::AVX) {
+        return FindCrossingAVX;
+    }
+#endif
+    return FindCrossingSSE;
+}
+
+// Smallest float which is not below the level
+static float GetFloatLevel(double level) {
+    float float_level = level;
+    if (float_level < level) {
+        float_level = std::nextafter(float_level, std::numeric_limits<float>::infinity());
+    }
+    return float_level;
+}
+
+// Skips the blocks of the row which no segment can cross, if there is a zone map of the image; zone_row holds the blocks of the row
+static int64_t FindCrossing(
+    CrossingScanFunction scan, const float* row, int64_t start, int64_t end, float level, const ZoneMapBlock* zone_row) {
+    if (!zone_row) {
+        return FindCrossing(scan, row, start, end, level);
+    }
+    while (start < end) {
+        const int64_t block_x = start / ZONE_MAP_BLOCK_SIZE;
+        const int64_t next_block_start = (block_x + 1) * ZONE_MAP_BLOCK_SIZE;
+        const int64_t block_end = std::min(next_block_start, end);
+        const ZoneMapBlock& block = zone_row[block_x];
+        if (ZoneMap::MayCross(block, level)) {
+            int64_t i = FindCrossing(scan, row, start, block_end, level);
+            if (i < block_end) {
+                return i;
+            }
+        } else if (block_end == next_block_start && (block.nan_count > 0 || block.min < level) && zone_row[block_x + 1].max >= level) {
+            // The last pixel of the block is compared with the first one of the next block, if the blocks allow it to cross
+            int64_t i = std::max(start, block_end - 1);
+            if (!(row[i] >= level) && level <= row[i + 1]) {
+                return i;
+            }
+        }
+        start = block_end;
+    }
+    return end;
+}
+
+static void TraceLevelInStrips(const float* image, int64_t width, int64_t height, double scale, double offset, double level,
+    vector<float>& vertices, vector<int32_t>& indices, int chunk_size, ContourCallback& partial_callback, int num_strips,
+    const ZoneMapBlock* zone_map);
+
 void TraceLevel(const float* image, int64_t width, int64_t height, double scale, double offset, double level, vector<float>& vertices,
-    vector<int32_t>& indices, int chunk_size, ContourCallback& partial_callback) {
+    vector<int32_t>& indices, int chunk_size, ContourCallback& partial_callback, int num_strips, const ZoneMapBlock* zone_map) {
+    num_strips = std::min<int64_t>(num_strips, height - 1);
+    if (num_strips > 1 && width > 1) {
+        TraceLevelInStrips(
+            image, width, height, scale, offset, level, vertices, indices, chunk_size, partial_callback, num_strips, zone_map);
+        return;
+    }
+
     const int64_t num_pixels = width * height;
     const size_t vertex_cutoff = 2 * chunk_size;
     int64_t checked_pixels = 0;
     vector<bool> visited(num_pixels);
     int64_t i, j;
 
+    // Full chunks are passed to the callback (which encodes and sends them) in a task, while this thread continues tracing into the
+    // other pair of buffers. Waiting for the previous task before starting the next one keeps the chunks of a level in order.
+    vector<float> pending_vertices;
+    vector<int32_t> pending_indices;
+
     auto test_for_chunk_overflow = [&]() {
         if (vertex_cutoff && vertices.size() > vertex_cutoff) {
             double progress = std::min(0.99, checked_pixels / double(num_pixels));
-            partial_callback(level, progress, vertices, indices);
+#pragma omp taskwait
+            pending_vertices.swap(vertices);
+            pending_indices.swap(indices);
+#pragma omp task default(shared) firstprivate(progress)
+            partial_callback(level, progress, pending_vertices, pending_indices);
             vertices.clear();
             indices.clear();
         }
@@ -156,7 +317,7 @@ void TraceLevel(const float* image, int64_t width, int64_t height, double scale,
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
             indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i, j, Edge::TopEdge, vertices);
+            TraceSegment(image, visited, width, height, 0, height - 1, scale, offset, level, i, j, Edge::TopEdge, true, vertices);
             test_for_chunk_overflow();
         }
         checked_pixels++;
@@ -169,7 +330,7 @@ void TraceLevel(const float* image, int64_t width, int64_t height, double scale,
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
             indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i - 1, j, Edge::RightEdge, vertices);
+            TraceSegment(image, visited, width, height, 0, height - 1, scale, offset, level, i - 1, j, Edge::RightEdge, true, vertices);
             test_for_chunk_overflow();
         }
         checked_pixels++;
@@ -182,7 +343,7 @@ void TraceLevel(const float* image, int64_t width, int64_t height, double scale,
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
             indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i, j - 1, Edge::BottomEdge, vertices);
+            TraceSegment(image, visited, width, height, 0, height - 1, scale, offset, level, i, j - 1, Edge::BottomEdge, true, vertices);
             test_for_chunk_overflow();
         }
         checked_pixels++;
@@ -195,42 +356,378 @@ void TraceLevel(const float* image, int64_t width, int64_t height, double scale,
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
             indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i, j, Edge::LeftEdge, vertices);
+            TraceSegment(image, visited, width, height, 0, height - 1, scale, offset, level, i, j, Edge::LeftEdge, true, vertices);
             test_for_chunk_overflow();
         }
         checked_pixels++;
     }
 
-    // Search each row of the image
-    for (j = 1; j < height - 1; j++) {
-        for (i = 0; i < width - 1; i++) {
-            float pt_a = image[(j)*width + i];
-            float pt_b = image[(j)*width + i + 1];
+    // Search each row of the image, skipping to the pixels where a segment may start
+    CrossingScanFunction scan = GetCrossingScanFunction();
+    float float_level = GetFloatLevel(level);
 
-            if (!visited[j * width + i] && (isnan(pt_a) || pt_a < level) && level <= pt_b) {
+    const int64_t edge_pixels = checked_pixels;
+    const int64_t num_blocks_x = (width + ZONE_MAP_BLOCK_SIZE - 1) / ZONE_MAP_BLOCK_SIZE;
+    for (j = 1; j < height - 1; j++) {
+        const float* row = image + j * width;
+        const ZoneMapBlock* zone_row = zone_map ? zone_map + (j / ZONE_MAP_BLOCK_SIZE) * num_blocks_x : nullptr;
+        for (i = FindCrossing(scan, row, 0, width - 1, float_level, zone_row); i < width - 1;
+             i = FindCrossing(scan, row, i + 1, width - 1, float_level, zone_row)) {
+            if (!visited[j * width + i]) {
+                checked_pixels = edge_pixels + (j - 1) * (width - 1) + i;
                 indices.push_back(vertices.size());
-                TraceSegment(image, visited, width, height, scale, offset, level, i, j, TopEdge, vertices);
+                TraceSegment(image, visited, width, height, 0, height - 1, scale, offset, level, i, j, TopEdge, true, vertices);
                 test_for_chunk_overflow();
             }
-            checked_pixels++;
         }
     }
+#pragma omp taskwait
+    partial_callback(level, 1.0, vertices, indices);
+}
+
+// Whether a segment crosses the edge between a and b into the cell below it, as the scan for segment starts tests it
+static inline bool IsSegmentStart(float a, float b, double level) {
+    return (isnan(a) || a < level) && level <= b;
+}
+
+// Whether a segment crosses the edge from a to b into the cell below it, as TraceSegment tests it
+static inline bool CrossesDown(float a, float b, double level) {
+    double a_val = isnan(a) ? -std::numeric_limits<float>::max() : a;
+    double b_val = isnan(b) ? -std::numeric_limits<float>::max() : b;
+    return b_val >= level && level > a_val;
+}
+
+// Part of a segment which starts on the image boundary or crosses between strips
+struct ContourFragment {
+    size_t vertex_start;
+    size_t vertex_end;
+    int64_t position; // scan position at which TraceLevel starts the segment, or -1 if the fragment continues from another strip
+    SegmentEnd end;
+};
+
+// Segment which starts within a strip, at the scan position of TraceLevel. Its vertices end where those of the next one start.
+struct StripSegment {
+    int64_t position;
+    size_t vertex_start;
+    int32_t fragment; // fragment which continues the segment into another strip, or -1 if it is closed within the strip
+};
+
+// Segments traced within the rows [row_start, row_end) of cells
+struct ContourStrip {
+    int64_t row_start;
+    int64_t row_end;
+    vector<float> vertices;
+    vector<ContourFragment> fragments;
+    vector<StripSegment> segments;
+    vector<int32_t> top_entries;    // fragment which continues a segment entering through the top edge of each column, or -1
+    vector<int32_t> bottom_entries; // fragment which continues a segment entering through the bottom edge of each column, or -1
+};
+
+static void TraceStrip(const float* image, int64_t width, int64_t height, double scale, double offset, double level,
+    CrossingScanFunction scan, float float_level, const ZoneMapBlock* zone_map, ContourStrip& strip) {
+    const int64_t row_start = strip.row_start;
+    const int64_t row_end = strip.row_end;
+    const int64_t edge_pixels = 2 * (width - 1) + 2 * (height - 1);
+    vector<bool> visited((row_end - row_start) * width);
+    strip.top_entries.assign(width - 1, -1);
+    strip.bottom_entries.assign(width - 1, -1);
+
+    auto trace_fragment = [&](int64_t i, int64_t j, int side, bool first_iteration, int64_t position) {
+        ContourFragment fragment;
+        fragment.vertex_start = strip.vertices.size();
+        fragment.position = position;
+        fragment.end = TraceSegment(
+            image, visited, width, height, row_start, row_end, scale, offset, level, i, j, side, first_iteration, strip.vertices);
+        fragment.vertex_end = strip.vertices.size();
+        strip.fragments.push_back(fragment);
+        return (int32_t)strip.fragments.size() - 1;
+    };
+
+    // Segments starting on the image boundary, at the same scan positions as in TraceLevel
+    if (row_start == 0) {
+        for (int64_t i = 0; i < width - 1; i++) {
+            if (IsSegmentStart(image[i], image[i + 1], level)) {
+                trace_fragment(i, 0, Edge::TopEdge, true, i);
+            }
+        }
+    }
+    for (int64_t j = row_start; j < row_end; j++) {
+        if (IsSegmentStart(image[j * width + width - 1], image[(j + 1) * width + width - 1], level)) {
+            trace_fragment(width - 2, j, Edge::RightEdge, true, (width - 1) + j);
+        }
+    }
+    if (row_end == height - 1) {
+        const float* row = image + (height - 1) * width;
+        for (int64_t i = width - 2; i >= 0; i--) {
+            if (IsSegmentStart(row[i + 1], row[i], level)) {
+                trace_fragment(i, height - 2, Edge::BottomEdge, true, (width - 1) + (height - 1) + (width - 2 - i));
+            }
+        }
+    }
+    for (int64_t j = row_end - 1; j >= row_start; j--) {
+        if (IsSegmentStart(image[(j + 1) * width], image[j * width], level)) {
+            trace_fragment(0, j, Edge::LeftEdge, true, 2 * (width - 1) + (height - 1) + (height - 2 - j));
+        }
+    }
+
+    // Segments continuing from the strips above and below
+    if (row_start > 0) {
+        const float* row = image + row_start * width;
+        for (int64_t i = 0; i < width - 1; i++) {
+            if (CrossesDown(row[i], row[i + 1], level)) {
+                strip.top_entries[i] = trace_fragment(i, row_start, Edge::TopEdge, false, -1);
+            }
+        }
+    }
+    if (row_end < height - 1) {
+        const float* row = image + row_end * width;
+        for (int64_t i = 0; i < width - 1; i++) {
+            if (CrossesDown(row[i + 1], row[i], level)) {
+                strip.bottom_entries[i] = trace_fragment(i, row_end - 1, Edge::BottomEdge, false, -1);
+            }
+        }
+    }
+
+    // The remaining top edge crossings belong to segments which are closed within the strip
+    const int64_t num_blocks_x = (width + ZONE_MAP_BLOCK_SIZE - 1) / ZONE_MAP_BLOCK_SIZE;
+    for (int64_t j = row_start + 1; j < row_end; j++) {
+        const float* row = image + j * width;
+        const ZoneMapBlock* zone_row = zone_map ? zone_map + (j / ZONE_MAP_BLOCK_SIZE) * num_blocks_x : nullptr;
+        for (int64_t i = FindCrossing(scan, row, 0, width - 1, float_level, zone_row); i < width - 1;
+             i = FindCrossing(scan, row, i + 1, width - 1, float_level, zone_row)) {
+            if (!visited[(j - row_start) * width + i]) {
+                StripSegment segment{edge_pixels + (j - 1) * (width - 1) + i, strip.vertices.size(), -1};
+                auto end = TraceSegment(
+                    image, visited, width, height, row_start, row_end, scale, offset, level, i, j, Edge::TopEdge, true, strip.vertices);
+                if (end.column >= 0) {
+                    strip.fragments.push_back({segment.vertex_start, strip.vertices.size(), -1, end});
+                    segment.fragment = strip.fragments.size() - 1;
+                }
+                strip.segments.push_back(segment);
+            }
+        }
+    }
+}
+
+// Traces a level in horizontal strips in parallel, then joins the fragments of segments which cross between strips. Segments are
+// passed to the callback in the same order, starting at the same vertex, as TraceLevel gives them when tracing the whole image.
+static void TraceLevelInStrips(const float* image, int64_t width, int64_t height, double scale, double offset, double level,
+    vector<float>& vertices, vector<int32_t>& indices, int chunk_size, ContourCallback& partial_callback, int num_strips,
+    const ZoneMapBlock* zone_map) {
+    const int64_t num_pixels = width * height;
+    const int64_t edge_pixels = 2 * (width - 1) + 2 * (height - 1);
+    const size_t vertex_cutoff = 2 * chunk_size;
+    CrossingScanFunction scan = GetCrossingScanFunction();
+    float float_level = GetFloatLevel(level);
+
+    vector<ContourStrip> strips(num_strips);
+    for (int s = 0; s < num_strips; s++) {
+        strips[s].row_start = (height - 1) * s / num_strips;
+        strips[s].row_end = (height - 1) * (s + 1) / num_strips;
+#pragma omp task default(shared) firstprivate(s)
+        TraceStrip(image, width, height, scale, offset, level, scan, float_level, zone_map, strips[s]);
+    }
+#pragma omp taskwait
+
+    // Link each fragment to the fragment which continues its segment in another strip
+    using FragmentId = std::pair<int, int32_t>; // strip and fragment
+    const FragmentId no_fragment(-1, -1);
+    vector<vector<FragmentId>> next_fragments(num_strips);
+    vector<vector<bool>> linked(num_strips);
+    for (int s = 0; s < num_strips; s++) {
+        next_fragments[s].resize(strips[s].fragments.size(), no_fragment);
+        linked[s].resize(strips[s].fragments.size(), false);
+    }
+    auto get_fragment = [&](FragmentId id) -> const ContourFragment& { return strips[id.first].fragments[id.second]; };
+    auto link_segment = [&](FragmentId first) {
+        linked[first.first][first.second] = true;
+        for (FragmentId id = first;;) {
+            const SegmentEnd& end = get_fragment(id).end;
+            FragmentId next = no_fragment;
+            if (end.column >= 0) {
+                next.first = end.below ? id.first + 1 : id.first - 1;
+                next.second = end.below ? strips[next.first].top_entries[end.column] : strips[next.first].bottom_entries[end.column];
+            }
+            if (next == first) {
+                next_fragments[id.first][id.second] = first;
+                return true;
+            } else if (next.second < 0 || linked[next.first][next.second]) {
+                return false;
+            }
+            next_fragments[id.first][id.second] = next;
+            linked[next.first][next.second] = true;
+            id = next;
+        }
+    };
+
+    // Segments which start on the image boundary or in a strip, or which are closed across strips
+    struct SegmentStart {
+        int64_t position;
+        FragmentId fragment;
+        size_t vertex;
+        bool closed; // whether the segment ends where it started, repeating its first vertex
+    };
+    vector<SegmentStart> boundary_segments;
+    for (int s = 0; s < num_strips; s++) {
+        for (int32_t f = 0; f < strips[s].fragments.size(); f++) {
+            const auto& fragment = strips[s].fragments[f];
+            if (fragment.position >= 0) {
+                link_segment({s, f});
+                boundary_segments.push_back({fragment.position, {s, f}, fragment.vertex_start, false});
+            }
+        }
+        for (auto& segment : strips[s].segments) {
+            if (segment.fragment >= 0) {
+                link_segment({s, segment.fragment});
+            }
+        }
+    }
+    std::sort(boundary_segments.begin(), boundary_segments.end(),
+        [](const SegmentStart& a, const SegmentStart& b) { return a.position < b.position; });
+
+    // The other fragments belong to segments which are closed across strips. TraceLevel starts them at their first crossing.
+    vector<SegmentStart> closed_segments;
+    for (int s = 0; s < num_strips; s++) {
+        for (int32_t f = 0; f < strips[s].fragments.size(); f++) {
+            if (linked[s][f]) {
+                continue;
+            }
+            FragmentId first(s, f);
+            SegmentStart segment_start{0, first, strips[s].fragments[f].vertex_start, link_segment(first)};
+            int64_t first_crossing = std::numeric_limits<int64_t>::max();
+            for (FragmentId id = first; segment_start.closed;) {
+                const auto& end = get_fragment(id).end;
+                if (end.first_crossing < first_crossing) {
+                    first_crossing = end.first_crossing;
+                    segment_start.fragment = id;
+                    segment_start.vertex = end.first_crossing_vertex;
+                }
+                id = next_fragments[id.first][id.second];
+                if (id == first) {
+                    break;
+                }
+            }
+            if (first_crossing == std::numeric_limits<int64_t>::max()) {
+                first_crossing = 0;
+                segment_start.closed = false;
+            }
+            int64_t i = first_crossing % width;
+            int64_t j = first_crossing / width;
+            segment_start.position = edge_pixels + (j - 1) * (width - 1) + i;
+            closed_segments.push_back(segment_start);
+        }
+    }
+    std::sort(closed_segments.begin(), closed_segments.end(),
+        [](const SegmentStart& a, const SegmentStart& b) { return a.position < b.position; });
+
+    // Join the fragments of each segment, and pass full chunks to the callback as TraceLevel does
+    vector<float> pending_vertices;
+    vector<int32_t> pending_indices;
+
+    auto append_vertices = [&](int s, size_t start, size_t end) {
+        const float* strip_vertices = strips[s].vertices.data();
+        vertices.insert(vertices.end(), strip_vertices + start, strip_vertices + end);
+    };
+    auto append_segment = [&](const SegmentStart& segment_start) {
+        indices.push_back(vertices.size());
+        FragmentId first = segment_start.fragment;
+        append_vertices(first.first, segment_start.vertex, get_fragment(first).vertex_end);
+        for (FragmentId id = next_fragments[first.first][first.second]; id.second >= 0 && id != first;
+             id = next_fragments[id.first][id.second]) {
+            append_vertices(id.first, get_fragment(id).vertex_start, get_fragment(id).vertex_end);
+        }
+        if (segment_start.closed) {
+            append_vertices(first.first, get_fragment(first).vertex_start, segment_start.vertex + 2);
+        }
+    };
+    auto test_for_chunk_overflow = [&](int64_t position) {
+        if (vertex_cutoff && vertices.size() > vertex_cutoff) {
+            double progress = std::min(0.99, position / double(num_pixels));
+#pragma omp taskwait
+            pending_vertices.swap(vertices);
+            pending_indices.swap(indices);
+#pragma omp task default(shared) firstprivate(progress)
+            partial_callback(level, progress, pending_vertices, pending_indices);
+            vertices.clear();
+            indices.clear();
+        }
+    };
+
+    for (const auto& segment_start : boundary_segments) {
+        append_segment(segment_start);
+        test_for_chunk_overflow(segment_start.position);
+    }
+
+    auto closed_segment = closed_segments.begin();
+    for (int s = 0; s < num_strips; s++) {
+        const auto& strip = strips[s];
+        // The vertices of consecutive segments within the strip are copied together, when a chunk is full or another segment follows
+        size_t run_start(0), run_end(0);
+        auto append_run = [&]() {
+            append_vertices(s, run_start, run_end);
+            run_start = run_end;
+        };
+
+        for (size_t k = 0; k < strip.segments.size(); k++) {
+            const auto& segment = strip.segments[k];
+            if (closed_segment != closed_segments.end() && closed_segment->position < segment.position) {
+                append_run();
+            }
+            for (; closed_segment != closed_segments.end() && closed_segment->position < segment.position; ++closed_segment) {
+                append_segment(*closed_segment);
+                test_for_chunk_overflow(closed_segment->position);
+            }
+
+            if (segment.fragment >= 0) {
+                append_run();
+                append_segment({segment.position, {s, segment.fragment}, segment.vertex_start, false});
+                test_for_chunk_overflow(segment.position);
+                continue;
+            }
+            if (run_start == run_end) {
+                run_start = run_end = segment.vertex_start;
+            }
+            indices.push_back(vertices.size() + (segment.vertex_start - run_start));
+            run_end = (k + 1 < strip.segments.size()) ? strip.segments[k + 1].vertex_start : strip.vertices.size();
+            if (vertex_cutoff && vertices.size() + (run_end - run_start) > vertex_cutoff) {
+                append_run();
+                test_for_chunk_overflow(segment.position);
+            }
+        }
+        append_run();
+    }
+    for (; closed_segment != closed_segments.end(); ++closed_segment) {
+        append_segment(*closed_segment);
+        test_for_chunk_overflow(closed_segment->position);
+    }
+#pragma omp taskwait
     partial_callback(level, 1.0, vertices, indices);
 }
 
 void TraceContours(float* image, int64_t width, int64_t height, double scale, double offset, const std::vector<double>& levels,
     std::vector<std::vector<float>>& vertex_data, std::vector<std::vector<int32_t>>& index_data, int chunk_size,
-    ContourCallback& partial_callback) {
+    ContourCallback& partial_callback, ZoneMap* zone_map) {
     auto t_start_contours = std::chrono::high_resolution_clock::now();
     vertex_data.resize(levels.size());
     index_data.resize(levels.size());
 
     ThreadManager::ApplyThreadLimit();
+    // With fewer levels than threads, each level is also traced in strips, by the threads which have no level to trace
+    int num_threads = omp_get_max_threads();
+    int num_strips(1);
+    if (!levels.empty() && levels.size() < num_threads) {
+        int threads_per_level = (num_threads + levels.size() - 1) / levels.size();
+        num_strips = std::min<int64_t>(CONTOUR_STRIPS_PER_THREAD * threads_per_level, (height - 1) / CONTOUR_MIN_STRIP_HEIGHT);
+    }
+    // Computed here if needed, rather than by the first level
+    const ZoneMapBlock* zone_map_blocks = zone_map ? zone_map->GetBlocks() : nullptr;
+
 #pragma omp parallel for
     for (int64_t l = 0; l < levels.size(); l++) {
         vertex_data[l].clear();
         index_data[l].clear();
-        TraceLevel(image, width, height, scale, offset, levels[l], vertex_data[l], index_data[l], chunk_size, partial_callback);
+        TraceLevel(image, width, height, scale, offset, levels[l], vertex_data[l], index_data[l], chunk_size, partial_callback, num_strips,
+            zone_map_blocks);
     }
 
     if (spdlog::get(PERF_TAG)) {
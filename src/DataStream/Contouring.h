@@ -11,17 +11,26 @@
 #include <functional>
 #include <vector>
 
+#include "Cache/ZoneMap.h"
+
+#define CONTOUR_MIN_STRIP_HEIGHT 64 // rows; a level is not split into smaller strips for tracing in parallel
+#define CONTOUR_STRIPS_PER_THREAD 2 // strips of a level per thread tracing it, to balance strips with more or fewer contours
+
 namespace carta {
 
 typedef const std::function<void(double, double, const std::vector<float>&, const std::vector<int32_t>&)> ContourCallback;
 
 enum Edge { TopEdge, RightEdge, BottomEdge, LeftEdge, None };
 
-void TraceContourLevel(float* image, int64_t width, int64_t height, double scale, double offset, double level,
-    std::vector<double>& vertex_data, std::vector<int32_t>& indices);
+// Traces a single level. With more than one strip, the strips are traced in tasks, and the segments are joined across strips; the
+// segments and chunks passed to the callback are the same for any number of strips. The search for segments skips the blocks of
+// the zone map of the image (if given) which the level cannot cross.
+void TraceLevel(const float* image, int64_t width, int64_t height, double scale, double offset, double level, std::vector<float>& vertices,
+    std::vector<int32_t>& indices, int chunk_size, ContourCallback& partial_callback, int num_strips = 1,
+    const ZoneMapBlock* zone_map = nullptr);
 void TraceContours(float* image, int64_t width, int64_t height, double scale, double offset, const std::vector<double>& levels,
     std::vector<std::vector<float>>& vertex_data, std::vector<std::vector<int32_t>>& index_data, int chunk_size,
-    ContourCallback& partial_callback);
+    ContourCallback& partial_callback, ZoneMap* zone_map = nullptr);
 
 } // namespace carta
 
@@ -27,6 +27,152 @@ void MakeKernel(vector<float>& kernel, double sigma) {
     }
 }
 
+// Convolves a row in blocks of the SIMD width, skipping NaN and infinite values; returns the number of pixels done
+typedef int64_t (*KernelRowFunction)(
+    const float* kernel, int64_t kernel_radius, const float* src_row, float* dest_row, int64_t dest_width, int64_t jump_size);
+
+static int64_t RunKernelRowSSE(
+    const float* kernel, int64_t kernel_radius, const float* src_row, float* dest_row, int64_t dest_width, int64_t jump_size) {
+    const int64_t block_limit = 4 * (dest_width / 4);
+    for (int64_t dest_x = 0; dest_x < block_limit; dest_x += 4) {
+        __m128 sum = _mm_setzero_ps();
+        __m128 weight = _mm_setzero_ps();
+        for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
+            __m128 val = _mm_loadu_ps(src_row + dest_x + i * jump_size);
+            __m128 w = _mm_set_ps1(kernel[i + kernel_radius]);
+            __m128 mask = _mm_andnot_ps(IsInfinity(val), _mm_cmpeq_ps(val, val));
+            w = _mm_and_ps(w, mask);
+            val = _mm_and_ps(val, mask);
+            sum += val * w;
+            weight += w;
+        }
+        sum /= weight;
+        _mm_storeu_ps(dest_row + dest_x, sum);
+    }
+    return block_limit;
+}
+
+#ifdef SIMD_DISPATCH
+SIMD_TARGET_AVX static inline __m256 IsInfinity(__m256 x) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0);
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    x = _mm256_andnot_ps(sign_mask, x);
+    x = _mm256_cmp_ps(x, inf, _CMP_EQ_OQ);
+    return x;
+}
+
+SIMD_TARGET_AVX static inline float _mm256_reduce_add_ps(__m256 x) {
+    __m256 t1 = _mm256_hadd_ps(x, x);
+    __m256 t2 = _mm256_hadd_ps(t1, t1);
+    __m128 t3 = _mm256_extractf128_ps(t2, 1);
+    __m128 t4 = _mm_add_ss(_mm256_castps256_ps128(t2), t3);
+    return _mm_cvtss_f32(t4);
+}
+
+// Finite values are those for which x - x is zero (not NaN)
+SIMD_TARGET_AVX512 static inline __mmask16 IsFinite(__m512 x) {
+    return _mm512_cmp_ps_mask(_mm512_sub_ps(x, x), _mm512_setzero_ps(), _CMP_EQ_OQ);
+}
+
+SIMD_TARGET_AVX static int64_t RunKernelRowAVX(
+    const float* kernel, int64_t kernel_radius, const float* src_row, float* dest_row, int64_t dest_width, int64_t jump_size) {
+    const int64_t block_limit = 8 * (dest_width / 8);
+    for (int64_t dest_x = 0; dest_x < block_limit; dest_x += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        __m256 weight = _mm256_setzero_ps();
+        for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
+            __m256 val = _mm256_loadu_ps(src_row + dest_x + i * jump_size);
+            __m256 w = _mm256_set1_ps(kernel[i + kernel_radius]);
+            __m256 mask = _mm256_andnot_ps(IsInfinity(val), _mm256_cmp_ps(val, val, _CMP_EQ_OQ));
+            w = _mm256_and_ps(w, mask);
+            val = _mm256_and_ps(val, mask);
+            sum += val * w;
+            weight += w;
+        }
+        sum /= weight;
+        _mm256_storeu_ps(dest_row + dest_x, sum);
+    }
+    return block_limit;
+}
+
+SIMD_TARGET_AVX2 static int64_t RunKernelRowAVX2(
+    const float* kernel, int64_t kernel_radius, const float* src_row, float* dest_row, int64_t dest_width, int64_t jump_size) {
+    const int64_t block_limit = 8 * (dest_width / 8);
+    for (int64_t dest_x = 0; dest_x < block_limit; dest_x += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        __m256 weight = _mm256_setzero_ps();
+        for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
+            __m256 val = _mm256_loadu_ps(src_row + dest_x + i * jump_size);
+            __m256 w = _mm256_set1_ps(kernel[i + kernel_radius]);
+            __m256 mask = _mm256_andnot_ps(IsInfinity(val), _mm256_cmp_ps(val, val, _CMP_EQ_OQ));
+            w = _mm256_and_ps(w, mask);
+            val = _mm256_and_ps(val, mask);
+            sum = _mm256_fmadd_ps(val, w, sum);
+            weight = _mm256_add_ps(weight, w);
+        }
+        _mm256_storeu_ps(dest_row + dest_x, _mm256_div_ps(sum, weight));
+    }
+    return block_limit;
+}
+
+SIMD_TARGET_AVX512 static int64_t RunKernelRowAVX512(
+    const float* kernel, int64_t kernel_radius, const float* src_row, float* dest_row, int64_t dest_width, int64_t jump_size) {
+    const int64_t block_limit = 16 * (dest_width / 16);
+    for (int64_t dest_x = 0; dest_x < block_limit; dest_x += 16) {
+        __m512 sum = _mm512_setzero_ps();
+        __m512 weight = _mm512_setzero_ps();
+        for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
+            __m512 val = _mm512_loadu_ps(src_row + dest_x + i * jump_size);
+            __mmask16 mask = IsFinite(val);
+            __m512 w = _mm512_maskz_mov_ps(mask, _mm512_set1_ps(kernel[i + kernel_radius]));
+            sum = _mm512_mask3_fmadd_ps(val, w, sum, mask);
+            weight = _mm512_add_ps(weight, w);
+        }
+        _mm512_storeu_ps(dest_row + dest_x, _mm512_div_ps(sum, weight));
+    }
+    return block_limit;
+}
+#endif
+
+static KernelRowFunction GetKernelRowFunction() {
+#ifdef SIMD_DISPATCH
+    auto simd_level = GetSimdLevel();
+    if (simd_level >= SimdLevel::AVX512) {
+        return RunKernelRowAVX512;
+    } else if (simd_level >= SimdLevel::AVX2) {
+        return RunKernelRowAVX2;
+    } else if (simd_level >= SimdLevel::AVX) {
+        return RunKernelRowAVX;
+    }
+#endif
+    return RunKernelRowSSE;
+}
+
+// Convolves a row of dest_width pixels with the SIMD kernel, and the remainder of the row with the scalar version, skipping NaN
+// and infinite values as the SIMD kernels do
+static void ConvolveRow(KernelRowFunction run_kernel_row, const float* kernel, int64_t kernel_radius, const float* src_row,
+    float* dest_row, int64_t dest_width, int64_t jump_size) {
+    const int64_t dest_block_limit = run_kernel_row(kernel, kernel_radius, src_row, dest_row, dest_width, jump_size);
+    for (int64_t dest_x = dest_block_limit; dest_x < dest_width; dest_x++) {
+        float sum = 0.0;
+        float weight = 0.0;
+        for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
+            float val = src_row[dest_x + i * jump_size];
+            if (std::isfinite(val)) {
+                float w = kernel[i + kernel_radius];
+                sum += val * w;
+                weight += w;
+            }
+        }
+        if (weight > 0.0) {
+            sum /= weight;
+        } else {
+            sum = NAN;
+        }
+        dest_row[dest_x] = sum;
+    }
+}
+
 bool RunKernel(const vector<float>& kernel, const float* src_data, float* dest_data, const int64_t src_width, const int64_t src_height,
     const int64_t dest_width, const int64_t dest_height, const bool vertical) {
     const int64_t kernel_radius = (kernel.size() - 1) / 2;
@@ -40,73 +186,17 @@ bool RunKernel(const vector<float>& kernel, const float* src_data, float* dest_d
     }
 
     const int64_t jump_size = vertical ? src_width : 1;
-    const int64_t dest_block_limit = SIMD_WIDTH * ((dest_width) / SIMD_WIDTH);
     const int64_t x_offset = vertical ? 0 : kernel_radius;
     const int64_t y_offset = vertical ? kernel_radius : 0;
+    // Handle rows in steps of 4, 8 or 16 using SSE, AVX or AVX-512
+    KernelRowFunction run_kernel_row = GetKernelRowFunction();
 
     ThreadManager::ApplyThreadLimit();
 #pragma omp parallel for
     for (int64_t dest_y = 0; dest_y < dest_height; dest_y++) {
         int64_t src_y = dest_y + y_offset;
-        // Handle row in steps of 4 or 8 using SSE or AVX
-        for (int64_t dest_x = 0; dest_x < dest_block_limit; dest_x += SIMD_WIDTH) {
-            int64_t dest_index = dest_x + dest_width * dest_y;
-            int64_t src_x = dest_x + x_offset;
-#ifdef __AVX__
-            __m256 sum = _mm256_setzero_ps();
-            __m256 weight = _mm256_setzero_ps();
-            for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
-                int64_t src_index = src_x + i * jump_size + src_width * src_y;
-                __m256 val = _mm256_loadu_ps(src_data + src_index);
-                __m256 w = _mm256_set1_ps(kernel[i + kernel_radius]);
-                __m256 mask = _mm256_andnot_ps(IsInfinity(val), _mm256_cmp_ps(val, val, _CMP_EQ_OQ));
-                w = _mm256_and_ps(w, mask);
-                val = _mm256_and_ps(val, mask);
-                sum += val * w;
-                weight += w;
-            }
-            sum /= weight;
-            _mm256_storeu_ps(dest_data + dest_index, sum);
-#else
-            __m128 sum = _mm_setzero_ps();
-            __m128 weight = _mm_setzero_ps();
-            for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
-                int64_t src_index = src_x + i * jump_size + src_width * src_y;
-                __m128 val = _mm_loadu_ps(src_data + src_index);
-                __m128 w = _mm_set_ps1(kernel[i + kernel_radius]);
-                __m128 mask = _mm_andnot_ps(IsInfinity(val), _mm_cmpeq_ps(val, val));
-                w = _mm_and_ps(w, mask);
-                val = _mm_and_ps(val, mask);
-                sum += val * w;
-                weight += w;
-            }
-            sum /= weight;
-            _mm_storeu_ps(dest_data + dest_index, sum);
-#endif
-        }
-
-        // Handle remainder of each block
-        for (int64_t dest_x = dest_block_limit; dest_x < dest_width; dest_x++) {
-            int64_t dest_index = dest_x + dest_width * dest_y;
-            int64_t src_x = dest_x + x_offset;
-            float sum = 0.0;
-            float weight = 0.0;
-            for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
-                int64_t src_index = src_x + i * jump_size + src_width * src_y;
-                float val = src_data[src_index];
-                if (!isnan(val)) {
-                    float w = kernel[i + kernel_radius];
-                    sum += val * w;
-                    weight += w;
-                }
-            }
-            if (weight > 0.0) {
-                sum /= weight;
-            } else {
-                sum = NAN;
-            }
-            dest_data[dest_index] = sum;
-        }
+        ConvolveRow(run_kernel_row, kernel.data(), kernel_radius, src_data + src_width * src_y + x_offset, dest_data + dest_width * dest_y,
+            dest_width, jump_size);
     }
 
     return true;
@@ -116,7 +206,7 @@ bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width,
     int smoothing_factor) {
     float sigma = (smoothing_factor - 1) / 2.0f;
     int mask_size = (smoothing_factor - 1) * 2 + 1;
-    const int apron_height = smoothing_factor - 1;
+    const int64_t apron_height = smoothing_factor - 1;
     int64_t calculated_dest_width = src_width - 2 * (smoothing_factor - 1);
     int64_t calculated_dest_height = src_height - 2 * (smoothing_factor - 1);
 
@@ -126,46 +216,51 @@ bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width,
         return false;
     }
 
+    if (dest_width <= 0 || dest_height <= 0) {
+        return true;
+    }
+
     std::vector<float> kernel(mask_size);
     MakeKernel(kernel, sigma);
+    KernelRowFunction run_kernel_row = GetKernelRowFunction();
 
-    double target_pixels = (SMOOTHING_TEMP_BUFFER_SIZE_MB * 1e6) / sizeof(float);
-    int64_t target_buffer_height = target_pixels / dest_width;
-    if (target_buffer_height < 4 * apron_height) {
-        target_buffer_height = 4 * apron_height;
-    }
-    int64_t buffer_height = min(target_buffer_height, src_height);
+    // The image is smoothed in tiles, each by a single thread: the horizontal pass of the tile rows and their aprons goes into a
+    // buffer small enough to stay in cache, which the vertical pass then reads. Tiles are as high as the buffer allows.
+    const int64_t tile_width = min((int64_t)SMOOTHING_TILE_WIDTH, dest_width);
+    const int64_t buffer_rows = (SMOOTHING_TILE_SIZE_KB * 1024) / (sizeof(float) * tile_width);
+    const int64_t tile_height = min(max(buffer_rows - 2 * apron_height, (int64_t)SMOOTHING_MIN_TILE_HEIGHT), dest_height);
+    const int64_t num_tile_columns = (dest_width + tile_width - 1) / tile_width;
+    const int64_t num_tile_rows = (dest_height + tile_height - 1) / tile_height;
 
-    int64_t line_offset = 0;
     auto t_start = std::chrono::high_resolution_clock::now();
-    std::unique_ptr<float[]> temp_array(new float[dest_width * buffer_height]);
-    auto source_ptr = src_data;
-    auto dest_ptr = dest_data;
-    const auto temp_ptr = temp_array.get();
-
-    while (line_offset < dest_height) {
-        int64_t num_lines = buffer_height - 2 * apron_height;
-        // clamp last iteration
-        if (line_offset + num_lines > dest_height) {
-            num_lines = dest_height - line_offset;
-        }
-        RunKernel(kernel, source_ptr, temp_ptr, src_width, src_height, dest_width, num_lines + 2 * apron_height, false);
-        RunKernel(kernel, temp_array.get(), dest_ptr, dest_width, num_lines + 2 * apron_height, dest_width, num_lines, true);
-
-        line_offset += num_lines;
-        source_ptr += num_lines * src_width;
-        dest_ptr += num_lines * dest_width;
-    }
-
-    // Fill in original NaNs
     ThreadManager::ApplyThreadLimit();
-#pragma omp parallel for
-    for (int64_t j = 0; j < dest_height; j++) {
-        for (int64_t i = 0; i < dest_width; i++) {
-            auto src_index = (j + apron_height) * src_width + (i + apron_height);
-            auto origVal = src_data[src_index];
-            if (isnan(origVal)) {
-                dest_data[j * dest_width + i] = NAN;
+#pragma omp parallel
+    {
+        std::vector<float> buffer(tile_width * (tile_height + 2 * apron_height));
+#pragma omp for schedule(dynamic)
+        for (int64_t tile = 0; tile < num_tile_rows * num_tile_columns; tile++) {
+            const int64_t x_start = (tile % num_tile_columns) * tile_width;
+            const int64_t y_start = (tile / num_tile_columns) * tile_height;
+            const int64_t width = min(tile_width, dest_width - x_start);
+            const int64_t height = min(tile_height, dest_height - y_start);
+
+            // Horizontal pass of the source rows [y_start, y_start + height + 2 * apron_height), with the buffer row stride tile_width
+            for (int64_t j = 0; j < height + 2 * apron_height; j++) {
+                ConvolveRow(run_kernel_row, kernel.data(), apron_height, src_data + (y_start + j) * src_width + x_start + apron_height,
+                    buffer.data() + j * tile_width, width, 1);
+            }
+
+            // Vertical pass into the destination, and fill in original NaNs
+            for (int64_t j = 0; j < height; j++) {
+                float* dest_row = dest_data + (y_start + j) * dest_width + x_start;
+                ConvolveRow(run_kernel_row, kernel.data(), apron_height, buffer.data() + (j + apron_height) * tile_width, dest_row, width,
+                    tile_width);
+                const float* src_row = src_data + (y_start + j + apron_height) * src_width + x_start + apron_height;
+                for (int64_t i = 0; i < width; i++) {
+                    if (isnan(src_row[i])) {
+                        dest_row[i] = NAN;
+                    }
+                }
             }
         }
     }
@@ -181,9 +276,15 @@ bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width,
 
 bool BlockSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int64_t x_offset, int64_t y_offset, int smoothing_factor) {
-#ifdef __AVX__
+#ifdef SIMD_DISPATCH
+    auto simd_level = GetSimdLevel();
+    // AVX-512 version, only for 16x down-sampling and above
+    if (simd_level >= SimdLevel::AVX512 && smoothing_factor % 16 == 0) {
+        return BlockSmoothAVX512(
+            src_data, dest_data, src_width, src_height, dest_width, dest_height, x_offset, y_offset, smoothing_factor);
+    }
     // AVX version, only for 8x down-sampling and above
-    if (smoothing_factor % 8 == 0) {
+    if (simd_level >= SimdLevel::AVX && smoothing_factor % 8 == 0) {
         return BlockSmoothAVX(src_data, dest_data, src_width, src_height, dest_width, dest_height, x_offset, y_offset, smoothing_factor);
     }
 #endif
@@ -253,9 +354,9 @@ bool BlockSmoothSSE(const float* src_data, float* dest_data, int64_t src_width,
     return true;
 }
 
-#ifdef __AVX__
-bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
-    int64_t x_offset, int64_t y_offset, int smoothing_factor) {
+#ifdef SIMD_DISPATCH
+SIMD_TARGET_AVX bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor) {
     ThreadManager::ApplyThreadLimit();
 #pragma omp parallel for
     for (int64_t j = 0; j < dest_height; ++j) {
@@ -307,6 +408,56 @@ bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width,
     }
     return true;
 }
+
+SIMD_TARGET_AVX512 bool BlockSmoothAVX512(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height,
+    int64_t dest_width, int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor) {
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t j = 0; j < dest_height; ++j) {
+        for (auto i = 0; i < dest_width; i++) {
+            int64_t image_row = y_offset + (j * smoothing_factor);
+            int64_t image_col = x_offset + (i * smoothing_factor);
+
+            const __m512 v1 = _mm512_set1_ps(1.0f);
+            __m512 count = _mm512_setzero_ps();
+            __m512 total = _mm512_setzero_ps();
+
+            int rows_left = min(smoothing_factor, (int)(src_height - image_row));
+            int columns_left = min(smoothing_factor, (int)(src_width - image_col));
+            int blocks_left = columns_left / 16;
+
+            for (auto row_index = 0; row_index < rows_left; row_index++) {
+                const float* ptr = src_data + ((image_row + row_index) * src_width) + image_col;
+                for (auto col_index = 0; col_index < blocks_left; col_index++) {
+                    __m512 row = _mm512_loadu_ps(ptr);
+                    __mmask16 mask = IsFinite(row);
+                    count = _mm512_mask_add_ps(count, mask, count, v1);
+                    total = _mm512_mask_add_ps(total, mask, total, row);
+                    ptr += 16;
+                }
+            }
+
+            // reduce
+            float pixel_sum = _mm512_reduce_add_ps(total);
+            float pixel_count = _mm512_reduce_add_ps(count);
+
+            if (columns_left != smoothing_factor) {
+                // Add right edge of block
+                for (auto row_index = 0; row_index < rows_left; row_index++) {
+                    for (auto col_index = blocks_left * 16; col_index < columns_left; col_index++) {
+                        auto pix_val = src_data[(image_row + row_index) * src_width + image_col + col_index];
+                        if (std::isfinite(pix_val)) {
+                            pixel_count++;
+                            pixel_sum += pix_val;
+                        }
+                    }
+                }
+            }
+            dest_data[j * dest_width + i] = pixel_count ? pixel_sum / pixel_count : NAN;
+        }
+    }
+    return true;
+}
 #endif
 
 bool BlockSmoothScalar(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
@@ -339,16 +490,58 @@ bool BlockSmoothScalar(const float* src_data, float* dest_data, int64_t src_widt
     return true;
 }
 
+// Strided copy of a row; the AVX2 and AVX-512 kernels gather a block of pixels at a time and return the number of pixels done
+typedef int64_t (*NearestNeighborRowFunction)(const float* src_row, float* dest_row, int64_t dest_width, int smoothing_factor);
+
+static int64_t NearestNeighborRowScalar(const float* src_row, float* dest_row, int64_t dest_width, int smoothing_factor) {
+    for (int64_t i = 0; i < dest_width; i++) {
+        dest_row[i] = src_row[i * smoothing_factor];
+    }
+    return dest_width;
+}
+
+#ifdef SIMD_DISPATCH
+SIMD_TARGET_AVX2 static int64_t NearestNeighborRowAVX2(const float* src_row, float* dest_row, int64_t dest_width, int smoothing_factor) {
+    const int64_t block_limit = 8 * (dest_width / 8);
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(smoothing_factor));
+    for (int64_t i = 0; i < block_limit; i += 8) {
+        _mm256_storeu_ps(dest_row + i, _mm256_i32gather_ps(src_row + i * smoothing_factor, offsets, 4));
+    }
+    return block_limit;
+}
+
+SIMD_TARGET_AVX512 static int64_t NearestNeighborRowAVX512(
+    const float* src_row, float* dest_row, int64_t dest_width, int smoothing_factor) {
+    const int64_t block_limit = 16 * (dest_width / 16);
+    const __m512i offsets = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(smoothing_factor));
+    for (int64_t i = 0; i < block_limit; i += 16) {
+        _mm512_storeu_ps(dest_row + i, _mm512_i32gather_ps(offsets, src_row + i * smoothing_factor, 4));
+    }
+    return block_limit;
+}
+#endif
+
 void NearestNeighbor(const float* src_data, float* dest_data, int64_t src_width, int64_t dest_width, int64_t dest_height, int64_t x_offset,
     int64_t y_offset, int smoothing_factor) {
+    NearestNeighborRowFunction nearest_neighbor_row = NearestNeighborRowScalar;
+#ifdef SIMD_DISPATCH
+    auto simd_level = GetSimdLevel();
+    if (simd_level >= SimdLevel::AVX512) {
+        nearest_neighbor_row = NearestNeighborRowAVX512;
+    } else if (simd_level >= SimdLevel::AVX2) {
+        nearest_neighbor_row = NearestNeighborRowAVX2;
+    }
+#endif
+
     ThreadManager::ApplyThreadLimit();
 #pragma omp parallel for
     for (size_t j = 0; j < dest_height; ++j) {
-        for (auto i = 0; i < dest_width; i++) {
-            auto image_row = y_offset + j * smoothing_factor;
-            auto image_col = x_offset + i * smoothing_factor;
-            dest_data[j * dest_width + i] = src_data[(image_row * src_width) + image_col];
-        }
+        auto image_row = y_offset + j * smoothing_factor;
+        const float* src_row = src_data + (image_row * src_width) + x_offset;
+        float* dest_row = dest_data + j * dest_width;
+        int64_t done = nearest_neighbor_row(src_row, dest_row, dest_width, smoothing_factor);
+        NearestNeighborRowScalar(src_row + done * smoothing_factor, dest_row + done, dest_width - done, smoothing_factor);
     }
 }
 
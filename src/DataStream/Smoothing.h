@@ -21,31 +21,13 @@
 #include <x86intrin.h>
 #endif
 
-#define SMOOTHING_TEMP_BUFFER_SIZE_MB 200
+#include "Util/Simd.h"
 
-namespace carta {
-
-#ifdef __AVX__
-#define SIMD_WIDTH 8
-
-static inline __m256 IsInfinity(__m256 x) {
-    const __m256 sign_mask = _mm256_set1_ps(-0.0);
-    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
-    x = _mm256_andnot_ps(sign_mask, x);
-    x = _mm256_cmp_ps(x, inf, _CMP_EQ_OQ);
-    return x;
-}
+#define SMOOTHING_TILE_WIDTH 512      // columns of the tiles smoothed by each thread
+#define SMOOTHING_TILE_SIZE_KB 256    // target size of the intermediate buffer of a tile, to keep it in L2 cache
+#define SMOOTHING_MIN_TILE_HEIGHT 16  // rows
 
-static inline float _mm256_reduce_add_ps(__m256 x) {
-    __m256 t1 = _mm256_hadd_ps(x, x);
-    __m256 t2 = _mm256_hadd_ps(t1, t1);
-    __m128 t3 = _mm256_extractf128_ps(t2, 1);
-    __m128 t4 = _mm_add_ss(_mm256_castps256_ps128(t2), t3);
-    return _mm_cvtss_f32(t4);
-}
-#else
-#define SIMD_WIDTH 4
-#endif
+namespace carta {
 
 static inline __m128 IsInfinity(__m128 x) {
     const __m128 sign_mask = _mm_set_ps1(-0.0f);
@@ -67,9 +49,12 @@ bool BlockSmoothScalar(const float* src_data, float* dest_data, int64_t src_widt
     int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor);
 bool BlockSmoothSSE(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int64_t x_offset, int64_t y_offset, int smoothing_factor);
-#ifdef __AVX__
+#ifdef SIMD_DISPATCH
+// Only supported if GetSimdLevel() is at least AVX and AVX512, respectively
 bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int64_t x_offset, int64_t y_offset, int smoothing_factor);
+bool BlockSmoothAVX512(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor);
 #endif
 
 void NearestNeighbor(const float* src_data, float* dest_data, int64_t src_width, int64_t dest_width, int64_t dest_height, int64_t x_offset,
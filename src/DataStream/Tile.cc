@@ -5,3 +5,88 @@
 */
 
 #include "Tile.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+using namespace carta;
+
+std::vector<Tile> Tile::GetPrefetchTiles(const std::vector<Tile>& tiles, int32_t image_width, int32_t image_height,
+    int32_t tile_width, int32_t tile_height, size_t max_tiles) {
+    std::vector<Tile> prefetch_tiles;
+    if (tiles.empty()) {
+        return prefetch_tiles;
+    }
+
+    // Use the finest requested layer; coarser tiles are only requested as placeholders
+    int32_t layer = 0;
+    for (const auto& tile : tiles) {
+        layer = std::max(layer, tile.layer);
+    }
+    int32_t max_layer = MipToLayer(1, image_width, image_height, tile_width, tile_height);
+
+    std::unordered_set<int32_t> seen;
+    int32_t x_min(4096), x_max(-1), y_min(4096), y_max(-1);
+    for (const auto& tile : tiles) {
+        seen.insert(Encode(tile.x, tile.y, tile.layer));
+        if (tile.layer == layer) {
+            x_min = std::min(x_min, tile.x);
+            x_max = std::max(x_max, tile.x);
+            y_min = std::min(y_min, tile.y);
+            y_max = std::max(y_max, tile.y);
+        }
+    }
+
+    auto add_tile = [&](int32_t x, int32_t y, int32_t l) {
+        if (prefetch_tiles.size() >= max_tiles || l < 0 || l > max_layer) {
+            return;
+        }
+        int32_t mip = LayerToMip(l, image_width, image_height, tile_width, tile_height);
+        int32_t num_tiles_x = ceil((double)image_width / (tile_width * mip));
+        int32_t num_tiles_y = ceil((double)image_height / (tile_height * mip));
+        if (x < 0 || y < 0 || x >= num_tiles_x || y >= num_tiles_y) {
+            return;
+        }
+        int32_t encoded = Encode(x, y, l);
+        if (encoded >= 0 && seen.insert(encoded).second) {
+            prefetch_tiles.push_back(Tile{x, y, l});
+        }
+    };
+
+    // Ring around the view, for panning
+    for (int32_t x = x_min - 1; x <= x_max + 1; x++) {
+        add_tile(x, y_min - 1, layer);
+        add_tile(x, y_max + 1, layer);
+    }
+    for (int32_t y = y_min; y <= y_max; y++) {
+        add_tile(x_min - 1, y, layer);
+        add_tile(x_max + 1, y, layer);
+    }
+
+    // Same view in the next coarser layer, for zooming out
+    for (int32_t y = y_min / 2; y <= y_max / 2; y++) {
+        for (int32_t x = x_min / 2; x <= x_max / 2; x++) {
+            add_tile(x, y, layer - 1);
+        }
+    }
+
+    // Same view in the next finer layer, for zooming in; from the centre outwards, since the view shrinks
+    if (layer < max_layer) {
+        std::vector<Tile> finer_tiles;
+        for (int32_t y = 2 * y_min; y <= 2 * y_max + 1; y++) {
+            for (int32_t x = 2 * x_min; x <= 2 * x_max + 1; x++) {
+                finer_tiles.push_back(Tile{x, y, layer + 1});
+            }
+        }
+        float x_centre = x_min + x_max + 0.5;
+        float y_centre = y_min + y_max + 0.5;
+        std::stable_sort(finer_tiles.begin(), finer_tiles.end(), [&](const Tile& a, const Tile& b) {
+            return std::hypot(a.x - x_centre, a.y - y_centre) < std::hypot(b.x - x_centre, b.y - y_centre);
+        });
+        for (const auto& tile : finer_tiles) {
+            add_tile(tile.x, tile.y, tile.layer);
+        }
+    }
+
+    return prefetch_tiles;
+}
@@ -10,6 +10,7 @@
 #include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
 namespace carta {
 
@@ -48,6 +49,11 @@ struct Tile {
         double max_mip = std::max(total_tiles_x, total_tiles_y);
         return ceil(log2(max_mip / mip));
     }
+
+    // Tiles which are likely to be requested next: a ring around the requested tiles, then the same view in the next
+    // coarser and finer layers. Requested tiles are not included.
+    static std::vector<Tile> GetPrefetchTiles(const std::vector<Tile>& tiles, int32_t image_width, int32_t image_height,
+        int32_t tile_width, int32_t tile_height, size_t max_tiles);
 };
 
 } // namespace carta
@@ -6,10 +6,13 @@
 
 #include "Frame.h"
 
+#include <omp.h>
 #include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <fstream>
+#include <future>
+#include <numeric>
 #include <thread>
 
 #include <casacore/images/Images/SubImage.h>
@@ -20,11 +23,13 @@
 #include <casacore/lattices/LRegions/LattRegionHolder.h>
 #include <casacore/tables/DataMan/TiledFileAccess.h>
 
+#include "Cache/BufferPool.h"
 #include "DataStream/Compression.h"
 #include "DataStream/Contouring.h"
 #include "DataStream/Smoothing.h"
 #include "ImageStats/StatsCalculator.h"
 #include "Logger/Logger.h"
+#include "ThreadingManager/ThreadingManager.h"
 
 static const int HIGH_COMPRESSION_QUALITY(32);
 
@@ -34,6 +39,7 @@ Frame::Frame(uint32_t session_id, std::shared_ptr<FileLoader> loader, const std:
     : _session_id(session_id),
       _valid(true),
       _loader(loader),
+      _hdu(hdu),
       _tile_cache(0),
       _x_axis(0),
       _y_axis(1),
@@ -41,9 +47,12 @@ Frame::Frame(uint32_t session_id, std::shared_ptr<FileLoader> loader, const std:
       _stokes_axis(-1),
       _z_index(default_z),
       _stokes_index(DEFAULT_STOKES),
+      _last_z_step(0),
       _depth(1),
       _num_stokes(1),
       _image_cache_valid(false),
+      _stats_modified(false),
+      _image_size(0),
       _moment_generator(nullptr) {
     // Initialize for operator==
     _contour_settings = {std::vector<double>(), CARTA::SmoothingMode::NoSmoothing, 0, 0, 0, 0, 0};
@@ -83,8 +92,11 @@ Frame::Frame(uint32_t session_id, std::shared_ptr<FileLoader> loader, const std:
     _depth = (_z_axis >= 0 ? _image_shape(_z_axis) : 1);
     _num_stokes = (_stokes_axis >= 0 ? _image_shape(_stokes_axis) : 1);
 
-    // load full image cache for loaders that don't use the tile cache and mipmaps
-    if (!(_loader->UseTileCache() && _loader->HasMip(2)) && !FillImageCache()) {
+    // mipmaps, swizzled data and statistics from the sidecar, if one has been written for this image
+    _loader->OpenSidecar(hdu);
+
+    // load full image cache for loaders that don't use the tile cache; otherwise it is loaded when needed
+    if (!_loader->UseTileCache() && !FillImageCache()) {
         _open_image_error = fmt::format("Cannot load image data. Check log.");
         _valid = false;
         return;
@@ -94,9 +106,23 @@ Frame::Frame(uint32_t session_id, std::shared_ptr<FileLoader> loader, const std:
     if (_loader->UseTileCache()) {
         int tiles_x = (_width - 1) / TILE_SIZE + 1;
         int tiles_y = (_height - 1) / TILE_SIZE + 1;
-        int tile_cache_capacity = std::min(MAX_TILE_CACHE_CAPACITY, 2 * (tiles_x + tiles_y));
-        _tile_cache.Reset(_z_index, _stokes_index, tile_cache_capacity);
+        int tile_cache_capacity = std::min(MAX_TILE_CACHE_CAPACITY, 2 * (tiles_x + tiles_y) * TILE_CACHE_NUM_PLANES);
+        _tile_cache.Reset((size_t)tile_cache_capacity * TILE_SIZE * TILE_SIZE * sizeof(float));
+        _tile_cache.SetSharedImageId(GetSharedImageId());
+
+        int chunk_width, chunk_height;
+        _loader->GetChunkShape(chunk_width, chunk_height);
+        _tile_cache.SetChunkShape(chunk_width, chunk_height);
+    }
+
+    _compressed_tile_cache.SetSharedImageId(GetSharedImageId());
+    _contour_cache.SetSharedImageId(GetSharedImageId());
+
+    // Stats and histograms calculated when the image was last opened
+    if (DiskStatsCache::Enabled() && GetSharedImageId().IsValid()) {
+        _image_size = DiskStatsCache::GetImageSize(GetSharedImageId().filename);
     }
+    DiskStatsCache::Load(GetSharedImageId(), _image_size, _image_basic_stats, _image_histograms, _cube_basic_stats, _cube_histograms);
 
     // set default histogram requirements
     InitImageHistogramConfigs();
@@ -335,24 +361,29 @@ bool Frame::SetImageChannels(int new_z, int new_stokes, std::string& message) {
             bool z_ok(CheckZ(new_z));
             bool stokes_ok(CheckStokes(new_stokes));
             if (z_ok && stokes_ok) {
+                _last_z_step = (new_stokes == _stokes_index) ? new_z - _z_index : 0;
                 _z_index = new_z;
                 _stokes_index = new_stokes;
 
                 // invalidate the image cache
                 InvalidateImageCache();
 
-                if (!(_loader->UseTileCache() && _loader->HasMip(2)) || IsComputedStokes(_stokes_index)) {
+                if (!_loader->UseTileCache() || IsComputedStokes(_stokes_index)) {
                     // Reload the full channel cache for loaders which use it
                     FillImageCache();
                 } else {
                     // Don't reload the full channel cache here because we may not need it
 
                     if (_loader->UseTileCache()) {
-                        // invalidate / clear the full resolution tile cache
-                        _tile_cache.Reset(_z_index, _stokes_index);
+                        // Tiles are keyed by z and stokes, so they stay valid unless the file has been modified
+                        _tile_cache.SetSharedImageId(GetSharedImageId());
                     }
                 }
 
+                // Encoded tiles and traced contours are keyed by z and stokes
+                _compressed_tile_cache.SetSharedImageId(GetSharedImageId());
+                _contour_cache.SetSharedImageId(GetSharedImageId());
+
                 updated = true;
             } else {
                 message = fmt::format("Channel {} or Stokes {} is invalid in image", new_z, new_stokes);
@@ -362,13 +393,17 @@ bool Frame::SetImageChannels(int new_z, int new_stokes, std::string& message) {
     return updated;
 }
 
+int Frame::LastZStep() {
+    return _last_z_step;
+}
+
 bool Frame::SetCursor(float x, float y) {
     bool changed = ((x != _cursor.x) || (y != _cursor.y));
     _cursor = PointXy(x, y);
     return changed;
 }
 
-bool Frame::FillImageCache() {
+bool Frame::FillImageCache(const std::function<bool()>& is_cancelled) {
     // get image data for z, stokes
 
     bool write_lock(true);
@@ -382,11 +417,33 @@ bool Frame::FillImageCache() {
     auto t_start_set_image_cache = std::chrono::high_resolution_clock::now();
     StokesSlicer stokes_slicer = GetImageSlicer(AxisRange(_z_index), _stokes_index);
     _image_cache_size = stokes_slicer.slicer.length().product();
-    _image_cache = std::make_unique<float[]>(_image_cache_size);
-    if (!GetSlicerData(stokes_slicer, _image_cache.get())) {
-        spdlog::error("Session {}: {}", _session_id, "Loading image cache failed.");
+
+    // Use the plane loaded by another session for the same file, if available
+    SharedImageCache::Key shared_key(GetSharedImageId(), _z_index, _stokes_index);
+    auto plane = SharedImageCache::Get(shared_key);
+    if (plane && plane->size() == (size_t)_image_cache_size) {
+        _image_cache = std::shared_ptr<float[]>(plane, plane->data());
+        _mip_pyramid.Reset(_image_cache.get(), _width, _height);
+        _zone_map.Reset(_image_cache.get(), _width, _height);
+        _image_cache_valid = true;
+        spdlog::debug("Session {}: using shared image cache for z={}, stokes={}", _session_id, _z_index, _stokes_index);
+        return true;
+    }
+
+    // The plane is discarded if the channel changes while it is read
+    int z(_z_index), stokes(_stokes_index);
+    auto plane_cancelled = [&]() { return ZStokesChanged(z, stokes) || (is_cancelled && is_cancelled()); };
+    plane = FloatBufferPool::TakeShared(_image_cache_size);
+    if (!GetPlaneData(z, stokes, plane->data(), plane_cancelled)) {
+        if (!plane_cancelled()) {
+            spdlog::error("Session {}: {}", _session_id, "Loading image cache failed.");
+        }
         return false;
     }
+    plane = SharedImageCache::Add(shared_key, plane);
+    _image_cache = std::shared_ptr<float[]>(plane, plane->data());
+    _mip_pyramid.Reset(_image_cache.get(), _width, _height);
+    _zone_map.Reset(_image_cache.get(), _width, _height);
 
     auto t_end_set_image_cache = std::chrono::high_resolution_clock::now();
     auto dt_set_image_cache =
@@ -402,6 +459,12 @@ void Frame::InvalidateImageCache() {
     bool write_lock(true);
     queuing_rw_mutex_scoped cache_lock(&_cache_mutex, write_lock);
     _image_cache_valid = false;
+    _mip_pyramid.Reset(nullptr, 0, 0);
+    _zone_map.Reset(nullptr, 0, 0);
+}
+
+SharedImageId Frame::GetSharedImageId() {
+    return SharedImageId(_loader->GetFileName(), _hdu, _loader->GetModifyTime());
 }
 
 void Frame::GetZMatrix(std::vector<float>& z_matrix, size_t z, size_t stokes) {
@@ -448,11 +511,19 @@ bool Frame::GetRasterData(std::vector<float>& image_data, CARTA::ImageBounds& bo
     bool write_lock(false);
     queuing_rw_mutex_scoped cache_lock(&_cache_mutex, write_lock);
 
+    // Regions without data, such as the corners of rotated images, are filled without filtering
+    if (_zone_map.IsAllNan(x, y, x + req_width, y + req_height)) {
+        std::fill(image_data.begin(), image_data.end(), NAN);
+        return true;
+    }
+
     auto t_start_raster_data_filter = std::chrono::high_resolution_clock::now();
     if (mean_filter && mip > 1) {
-        // Perform down-sampling by calculating the mean for each MIPxMIP block
-        BlockSmooth(
-            _image_cache.get(), image_data.data(), num_image_columns, num_image_rows, row_length_region, num_rows_region, x, y, mip);
+        // Perform down-sampling by calculating the mean for each MIPxMIP block, from the pyramid level if the blocks are aligned with it
+        if (!_mip_pyramid.GetBlockMeans(image_data.data(), x, y, row_length_region, num_rows_region, mip)) {
+            BlockSmooth(
+                _image_cache.get(), image_data.data(), num_image_columns, num_image_rows, row_length_region, num_rows_region, x, y, mip);
+        }
     } else {
         // Nearest neighbour filtering
         NearestNeighbor(_image_cache.get(), image_data.data(), num_image_columns, row_length_region, num_rows_region, x, y, mip);
@@ -489,6 +560,20 @@ bool Frame::FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Ti
     tile_ptr->set_x(tile.x);
     tile_ptr->set_y(tile.y);
 
+    // A cached tile skips both the NaN encoding and the compression
+    CompressedTileCache::Key cache_key(tile.layer, tile.x, tile.y, z, stokes, compression_type, compression_quality);
+    if (compression_type == CARTA::CompressionType::ZFP || compression_type == LOSSLESS_COMPRESSION_TYPE) {
+        auto cached_tile = _compressed_tile_cache.Get(cache_key);
+        if (cached_tile) {
+            raster_tile_data.set_compression_quality(cached_tile->compression_quality);
+            tile_ptr->set_width(cached_tile->width);
+            tile_ptr->set_height(cached_tile->height);
+            tile_ptr->set_nan_encodings(cached_tile->nan_encodings.data(), sizeof(int32_t) * cached_tile->nan_encodings.size());
+            tile_ptr->set_image_data(cached_tile->image_data.data(), cached_tile->image_data.size());
+            return !(ZStokesChanged(z, stokes));
+        }
+    }
+
     std::shared_ptr<std::vector<float>> tile_data_ptr;
     int tile_width;
     int tile_height;
@@ -503,6 +588,29 @@ bool Frame::FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Ti
         if (compression_type == CARTA::CompressionType::NONE) {
             tile_ptr->set_image_data(tile_data_ptr->data(), sizeof(float) * tile_data_ptr->size());
             return true;
+        } else if (compression_type == LOSSLESS_COMPRESSION_TYPE) {
+            // NaNs are kept by the lossless codec, so there are no NaN encodings
+            auto t_start_compress_tile_data = std::chrono::high_resolution_clock::now();
+            CompressLossless(*tile_data_ptr, 0, *tile_ptr->mutable_image_data(), tile_width, tile_height);
+            raster_tile_data.set_compression_quality(0);
+
+            if (!ZStokesChanged(z, stokes)) {
+                auto compressed_tile = std::make_shared<CompressedTile>();
+                compressed_tile->width = tile_width;
+                compressed_tile->height = tile_height;
+                compressed_tile->compression_quality = 0;
+                compressed_tile->image_data.assign(tile_ptr->image_data().begin(), tile_ptr->image_data().end());
+                _compressed_tile_cache.Add(cache_key, compressed_tile);
+            }
+
+            auto t_end_compress_tile_data = std::chrono::high_resolution_clock::now();
+            auto dt_compress_tile_data =
+                std::chrono::duration_cast<std::chrono::microseconds>(t_end_compress_tile_data - t_start_compress_tile_data).count();
+            spdlog::performance("Compress {}x{} tile data losslessly in {:.3f} ms at {:.3f} MPix/s, compression ratio {:.3f}", tile_width,
+                tile_height, dt_compress_tile_data * 1e-3, (float)(tile_width * tile_height) / dt_compress_tile_data,
+                (float)tile_image_data_size / tile_ptr->image_data().size());
+
+            return !(ZStokesChanged(z, stokes));
         } else if (compression_type == CARTA::CompressionType::ZFP) {
             auto nan_encodings = GetNanEncodingsBlock(*tile_data_ptr, 0, tile_width, tile_height);
             tile_ptr->set_nan_encodings(nan_encodings.data(), sizeof(int32_t) * nan_encodings.size());
@@ -513,36 +621,26 @@ bool Frame::FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Ti
 
             auto t_start_compress_tile_data = std::chrono::high_resolution_clock::now();
 
-            // compress the data with the default precision
-            std::vector<char> compression_buffer;
-            size_t compressed_size;
+            // compress the data directly into the message, with a higher precision if the tile compresses well
             int precision = lround(compression_quality);
-            Compress(*tile_data_ptr, 0, compression_buffer, compressed_size, tile_width, tile_height, precision);
-            float compression_ratio = (float)tile_image_data_size / (float)compressed_size;
-            bool use_high_precision(false);
-
-            if (precision < HIGH_COMPRESSION_QUALITY && compression_ratio > 20) {
-                // re-compress the data with a higher precision
-                std::vector<char> compression_buffer_hq;
-                size_t compressed_size_hq;
-                Compress(*tile_data_ptr, 0, compression_buffer_hq, compressed_size_hq, tile_width, tile_height, HIGH_COMPRESSION_QUALITY);
-                float compression_ratio_hq = (float)tile_image_data_size / (float)compressed_size_hq;
-
-                if (compression_ratio_hq > 10) {
-                    // set compression data with high precision
-                    raster_tile_data.set_compression_quality(HIGH_COMPRESSION_QUALITY);
-                    tile_ptr->set_image_data(compression_buffer_hq.data(), compressed_size_hq);
-
-                    spdlog::debug("Using high compression quality. Previous compression ratio: {:.3f}", compression_ratio);
-                    compression_ratio = compression_ratio_hq;
-                    use_high_precision = true;
-                }
+            int used_precision = CompressTile(*tile_data_ptr, *tile_ptr->mutable_image_data(), tile_width, tile_height, precision,
+                std::max(precision, HIGH_COMPRESSION_QUALITY));
+            float compression_ratio = (float)tile_image_data_size / (float)tile_ptr->image_data().size();
+            if (used_precision != precision) {
+                raster_tile_data.set_compression_quality(HIGH_COMPRESSION_QUALITY);
+                spdlog::debug("Using high compression quality for tile (layer:{}, x:{}, y:{}).", tile.layer, tile.x, tile.y);
+            } else {
+                raster_tile_data.set_compression_quality(compression_quality);
             }
 
-            if (!use_high_precision) {
-                // set compression data with default precision
-                raster_tile_data.set_compression_quality(compression_quality);
-                tile_ptr->set_image_data(compression_buffer.data(), compressed_size);
+            if (!ZStokesChanged(z, stokes)) {
+                auto compressed_tile = std::make_shared<CompressedTile>();
+                compressed_tile->width = tile_width;
+                compressed_tile->height = tile_height;
+                compressed_tile->compression_quality = raster_tile_data.compression_quality();
+                compressed_tile->image_data.assign(tile_ptr->image_data().begin(), tile_ptr->image_data().end());
+                compressed_tile->nan_encodings = std::move(nan_encodings);
+                _compressed_tile_cache.Add(cache_key, compressed_tile);
             }
 
             spdlog::debug(
@@ -562,6 +660,68 @@ bool Frame::FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Ti
     return false;
 }
 
+void Frame::PrefetchRasterTiles(const std::vector<Tile>& tiles, int z, int stokes, CARTA::CompressionType compression_type,
+    float compression_quality, const std::function<bool()>& is_cancelled) {
+    std::shared_lock lock(GetActiveTaskMutex());
+
+    // Encoded tiles are kept in the compressed tile cache; uncompressed tiles only warm the tile cache
+    CARTA::RasterTileData raster_tile_data;
+    for (const auto& tile : tiles) {
+        if (!_connected || is_cancelled() || ZStokesChanged(z, stokes)) {
+            return;
+        }
+        FillRasterTileData(raster_tile_data, tile, z, stokes, compression_type, compression_quality);
+    }
+}
+
+void Frame::PrefetchImageCache(const std::function<bool()>& is_cancelled) {
+    // Downsampled tiles are computed from the full image cache if the loader has no mipmaps
+    if (_image_cache_valid || !_loader->UseTileCache() || _loader->HasMip(2)) {
+        return;
+    }
+
+    std::shared_lock lock(GetActiveTaskMutex());
+    if (_connected) {
+        FillImageCache([&]() { return !_connected || is_cancelled(); });
+    }
+}
+
+void Frame::PrefetchImageChannel(const std::vector<Tile>& tiles, int z, int stokes, const std::function<bool()>& is_cancelled) {
+    if (!CheckZ(z) || !CheckStokes(stokes) || IsComputedStokes(stokes)) {
+        return;
+    }
+
+    std::shared_lock lock(GetActiveTaskMutex());
+
+    // The next channel is no longer needed if the user moves to a different channel
+    int current_z(_z_index), current_stokes(_stokes_index);
+    auto prefetch_cancelled = [&]() { return !_connected || is_cancelled() || ZStokesChanged(current_z, current_stokes); };
+
+    if (_loader->UseTileCache() && _loader->HasMip(2)) {
+        // Full-resolution tiles are read in chunks into the tile cache; downsampled tiles are read from the mipmaps
+        for (const auto& tile : tiles) {
+            if (prefetch_cancelled()) {
+                return;
+            }
+            if (Tile::LayerToMip(tile.layer, _width, _height, TILE_SIZE, TILE_SIZE) == 1) {
+                _tile_cache.Get(TileCache::Key(tile.x * TILE_SIZE, tile.y * TILE_SIZE, z, stokes), _loader, _image_mutex);
+            }
+        }
+        return;
+    }
+
+    // Otherwise load the whole plane into the shared image cache, where FillImageCache will find it
+    SharedImageCache::Key shared_key(GetSharedImageId(), z, stokes);
+    if (!SharedImageCache::Enabled() || !shared_key.image.IsValid() || SharedImageCache::Get(shared_key) || prefetch_cancelled()) {
+        return;
+    }
+
+    auto plane = FloatBufferPool::TakeShared(_width * _height);
+    if (GetPlaneData(z, stokes, plane->data(), prefetch_cancelled)) {
+        SharedImageCache::Add(shared_key, plane);
+    }
+}
+
 bool Frame::GetRasterTileData(std::shared_ptr<std::vector<float>>& tile_data_ptr, const Tile& tile, int& width, int& height) {
     int mip = Tile::LayerToMip(tile.layer, _width, _height, TILE_SIZE, TILE_SIZE);
     int tile_size_original = TILE_SIZE * mip;
@@ -586,19 +746,20 @@ bool Frame::GetRasterTileData(std::shared_ptr<std::vector<float>>& tile_data_ptr
         loaded_data = _loader->GetDownsampledRasterData(tile_data, _z_index, _stokes_index, bounds, mip, _image_mutex);
     } else if (!_image_cache_valid && _loader->UseTileCache()) {
         // Load a tile from the tile cache only if this is supported *and* the full image cache isn't populated
-        tile_data_ptr = _tile_cache.Get(TileCache::Key(bounds.x_min(), bounds.y_min()), _loader, _image_mutex);
+        TileCache::Key key(bounds.x_min(), bounds.y_min(), _z_index, _stokes_index);
+        tile_data_ptr = _tile_cache.Get(key, _loader, _image_mutex);
         if (tile_data_ptr) {
             return true;
         }
     }
 
-    // Fall back to using the full image cache.
-    if (!loaded_data) {
+    // Fall back to using the full image cache, which is loaded on demand for downsampled tiles without mipmaps
+    if (!loaded_data && (_image_cache_valid || FillImageCache())) {
         loaded_data = GetRasterData(tile_data, bounds, mip, true);
     }
 
     if (loaded_data) {
-        tile_data_ptr = std::make_shared<std::vector<float>>(tile_data);
+        tile_data_ptr = std::make_shared<std::vector<float>>(std::move(tile_data));
     }
 
     return loaded_data;
@@ -620,8 +781,61 @@ bool Frame::SetContourParameters(const CARTA::SetContourParameters& message) {
 }
 
 bool Frame::ContourImage(ContourCallback& partial_contour_callback) {
+    // Levels which were traced before for this plane and smoothing are sent from the cache, and only the others are traced
+    bool smoothing = _contour_settings.smoothing_mode != CARTA::SmoothingMode::NoSmoothing && _contour_settings.smoothing_factor > 1;
+    int smoothing_mode = smoothing ? _contour_settings.smoothing_mode : CARTA::SmoothingMode::NoSmoothing;
+    int smoothing_factor = smoothing ? _contour_settings.smoothing_factor : 1;
+    int z(CurrentZ()), stokes(CurrentStokes());
+
+    std::vector<double> levels;
+    std::vector<double> repeated_levels;
+    for (double level : _contour_settings.levels) {
+        auto cached_level = _contour_cache.Get(ContourCache::Key(z, stokes, smoothing_mode, smoothing_factor, level));
+        if (cached_level) {
+            for (const auto& chunk : cached_level->chunks) {
+                partial_contour_callback(level, chunk.progress, chunk.vertices, chunk.indices);
+            }
+        } else if (std::find(levels.begin(), levels.end(), level) != levels.end()) {
+            repeated_levels.push_back(level);
+        } else {
+            levels.push_back(level);
+        }
+    }
+    if (levels.empty()) {
+        return true;
+    }
+
+    // Chunks are recorded as they are sent; the chunks of a level are sent one at a time
+    std::vector<std::shared_ptr<ContourLevel>> traced_levels(levels.size());
+    for (auto& traced_level : traced_levels) {
+        traced_level = std::make_shared<ContourLevel>();
+    }
+    ContourCallback callback = [&](double level, double progress, const std::vector<float>& vertices, const std::vector<int32_t>& indices) {
+        size_t l = std::find(levels.begin(), levels.end(), level) - levels.begin();
+        if (l < traced_levels.size()) {
+            traced_levels[l]->chunks.push_back({progress, vertices, indices});
+        }
+        partial_contour_callback(level, progress, vertices, indices);
+    };
+    auto cache_traced_levels = [&]() {
+        // The image cache may have been filled with another plane while the contours were traced
+        if (!ZStokesChanged(z, stokes)) {
+            for (size_t l = 0; l < levels.size(); ++l) {
+                _contour_cache.Add(ContourCache::Key(z, stokes, smoothing_mode, smoothing_factor, levels[l]), traced_levels[l]);
+            }
+        }
+        for (double level : repeated_levels) {
+            auto l = std::find(levels.begin(), levels.end(), level) - levels.begin();
+            for (const auto& chunk : traced_levels[l]->chunks) {
+                partial_contour_callback(level, chunk.progress, chunk.vertices, chunk.indices);
+            }
+        }
+    };
+
     // Always use the full image cache (for now)
-    FillImageCache();
+    if (!FillImageCache()) {
+        return false;
+    }
 
     double scale = 1.0;
     double offset = 0;
@@ -630,9 +844,10 @@ bool Frame::ContourImage(ContourCallback& partial_contour_callback) {
     std::vector<std::vector<int>> index_data;
     queuing_rw_mutex_scoped cache_lock(&_cache_mutex, false);
 
-    if (_contour_settings.smoothing_mode == CARTA::SmoothingMode::NoSmoothing || _contour_settings.smoothing_factor <= 1) {
-        TraceContours(_image_cache.get(), _width, _height, scale, offset, _contour_settings.levels, vertex_data, index_data,
-            _contour_settings.chunk_size, partial_contour_callback);
+    if (!smoothing) {
+        TraceContours(_image_cache.get(), _width, _height, scale, offset, levels, vertex_data, index_data, _contour_settings.chunk_size,
+            callback, &_zone_map);
+        cache_traced_levels();
         return true;
     } else if (_contour_settings.smoothing_mode == CARTA::SmoothingMode::GaussianBlur) {
         // Smooth the image from cache
@@ -651,8 +866,12 @@ bool Frame::ContourImage(ContourCallback& partial_contour_callback) {
         if (smooth_successful) {
             // Perform contouring with an offset based on the Gaussian smoothing apron size
             offset = _contour_settings.smoothing_factor - 1;
-            TraceContours(dest_array.get(), dest_width, dest_height, scale, offset, _contour_settings.levels, vertex_data, index_data,
-                _contour_settings.chunk_size, partial_contour_callback);
+            // A zone map of the smoothed image costs about as much as the search of one level, which it speeds up for the others
+            ZoneMap zone_map;
+            zone_map.Reset(dest_array.get(), dest_width, dest_height);
+            TraceContours(dest_array.get(), dest_width, dest_height, scale, offset, levels, vertex_data, index_data,
+                _contour_settings.chunk_size, callback, levels.size() > 1 ? &zone_map : nullptr);
+            cache_traced_levels();
             return true;
         }
     } else {
@@ -672,8 +891,11 @@ bool Frame::ContourImage(ContourCallback& partial_contour_callback) {
             scale = _contour_settings.smoothing_factor;
             size_t dest_width = ceil(double(image_bounds.x_max()) / _contour_settings.smoothing_factor);
             size_t dest_height = ceil(double(image_bounds.y_max()) / _contour_settings.smoothing_factor);
-            TraceContours(dest_vector.data(), dest_width, dest_height, scale, offset, _contour_settings.levels, vertex_data, index_data,
-                _contour_settings.chunk_size, partial_contour_callback);
+            ZoneMap zone_map;
+            zone_map.Reset(dest_vector.data(), dest_width, dest_height);
+            TraceContours(dest_vector.data(), dest_width, dest_height, scale, offset, levels, vertex_data, index_data,
+                _contour_settings.chunk_size, callback, levels.size() > 1 ? &zone_map : nullptr);
+            cache_traced_levels();
             return true;
         }
         spdlog::warn("Smoothing mode not implemented yet!");
@@ -850,6 +1072,7 @@ bool Frame::FillHistogramFromFrameCache(int z, int stokes, int num_bins, CARTA::
 bool Frame::GetBasicStats(int z, int stokes, BasicStats<float>& stats) {
     // Return basic stats from cache, or calculate (no loader option); also used for cube histogram
     if (z == ALL_Z) { // cube
+        std::lock_guard<std::mutex> guard(_stats_mutex);
         if (_cube_basic_stats.count(stokes)) {
             stats = _cube_basic_stats[stokes]; // get from cache
             return true;
@@ -857,19 +1080,23 @@ bool Frame::GetBasicStats(int z, int stokes, BasicStats<float>& stats) {
         return false; // calculate and cache in Session
     } else {
         int cache_key(CacheKey(z, stokes));
+        std::unique_lock<std::mutex> lock(_stats_mutex);
         if (_image_basic_stats.count(cache_key)) {
             stats = _image_basic_stats[cache_key]; // get from cache
             return true;
         }
+        lock.unlock();
 
         if ((z == CurrentZ()) && (stokes == CurrentStokes())) {
             // calculate histogram from image cache
-            if ((_image_cache_size == 0) && !FillImageCache()) {
+            if (!FillImageCache()) {
                 // cannot calculate
                 return false;
             }
             CalcBasicStats(stats, _image_cache.get(), _image_cache_size);
+            lock.lock();
             _image_basic_stats[cache_key] = stats;
+            _stats_modified = true;
             return true;
         }
 
@@ -879,7 +1106,9 @@ bool Frame::GetBasicStats(int z, int stokes, BasicStats<float>& stats) {
         CalcBasicStats(stats, data.data(), data.size());
 
         // cache results
+        lock.lock();
         _image_basic_stats[cache_key] = stats;
+        _stats_modified = true;
         return true;
     }
     return false;
@@ -888,6 +1117,7 @@ bool Frame::GetBasicStats(int z, int stokes, BasicStats<float>& stats) {
 bool Frame::GetCachedImageHistogram(int z, int stokes, int num_bins, Histogram& hist) {
     // Get image histogram results from cache
     int cache_key(CacheKey(z, stokes));
+    std::lock_guard<std::mutex> guard(_stats_mutex);
     if (_image_histograms.count(cache_key)) {
         // get from cache if correct num_bins
         auto results_for_key = _image_histograms[cache_key];
@@ -904,6 +1134,7 @@ bool Frame::GetCachedImageHistogram(int z, int stokes, int num_bins, Histogram&
 
 bool Frame::GetCachedCubeHistogram(int stokes, int num_bins, Histogram& hist) {
     // Get cube histogram results from cache
+    std::lock_guard<std::mutex> guard(_stats_mutex);
     if (_cube_histograms.count(stokes)) {
         for (auto& result : _cube_histograms[stokes]) {
             // get from cache if correct num_bins
@@ -932,7 +1163,7 @@ bool Frame::CalculateHistogram(int region_id, int z, int stokes, int num_bins, B
 
     if ((z == CurrentZ()) && (stokes == CurrentStokes())) {
         // calculate histogram from current image cache
-        if ((_image_cache_size == 0) && !FillImageCache()) {
+        if (!FillImageCache()) {
             return false;
         }
         bool write_lock(false);
@@ -948,12 +1179,130 @@ bool Frame::CalculateHistogram(int region_id, int z, int stokes, int num_bins, B
     // cache image histogram
     if ((region_id == IMAGE_REGION_ID) || (Depth() == 1)) {
         int cache_key(CacheKey(z, stokes));
+        std::lock_guard<std::mutex> guard(_stats_mutex);
         _image_histograms[cache_key].push_back(hist);
+        _stats_modified = true;
     }
 
     return true;
 }
 
+bool Frame::CalculateCubeHistogram(int stokes, int num_bins, BasicStats<float>& cube_stats, Histogram& cube_histogram,
+    const std::function<bool(float, const Histogram*)>& progress_callback) {
+    if (num_bins == AUTO_BIN_SIZE) {
+        num_bins = AutoBinSize();
+    }
+    const size_t depth(Depth());
+
+    // Stats of planes which were calculated before, e.g. for image histograms
+    std::vector<BasicStats<float>> z_stats(depth);
+    std::vector<bool> have_z_stats(depth, false);
+    std::unique_lock<std::mutex> stats_lock(_stats_mutex);
+    for (size_t z = 0; z < depth; ++z) {
+        auto cached_stats = _image_basic_stats.find(CacheKey(z, stokes));
+        if (cached_stats != _image_basic_stats.end()) {
+            z_stats[z] = cached_stats->second;
+            have_z_stats[z] = true;
+        }
+    }
+    stats_lock.unlock();
+    cube_stats = BasicStats<float>();
+    bool have_cube_stats = GetBasicStats(ALL_Z, stokes, cube_stats);
+    if (!have_cube_stats && std::all_of(have_z_stats.begin(), have_z_stats.end(), [](bool have_stats) { return have_stats; })) {
+        for (auto& stats : z_stats) {
+            cube_stats.join(stats);
+        }
+        have_cube_stats = true;
+    }
+
+    // If the range of the cube is known, each plane is binned into it, and the partial histogram is sent with the progress. Otherwise
+    // each plane is binned into a provisional histogram as its stats are calculated, which is rebinned into the range of the cube at
+    // the end, so that each plane is only read once.
+    std::vector<size_t> planes(depth);
+    std::iota(planes.begin(), planes.end(), 0);
+    ProvisionalHistogram provisional_histogram(have_cube_stats ? 1 : num_bins);
+    bool have_histogram(false);
+    size_t num_planes_done(0);
+
+    // Each plane is processed by all OpenMP threads, while the next plane is read
+    ThreadManager::ApplyThreadLimit();
+    bool read_all_planes = ReadCubePlanes(stokes, planes, [&](size_t z, const std::vector<float>& data) {
+        if (!have_cube_stats) {
+            if (!have_z_stats[z]) {
+                CalcBasicStats(z_stats[z], data.data(), data.size());
+                have_z_stats[z] = true;
+            }
+            provisional_histogram.Fill(data.data(), data.size(), z_stats[z].min_val, z_stats[z].max_val);
+            return progress_callback((float)++num_planes_done / depth, nullptr);
+        }
+
+        // The stats of the plane are calculated while it is binned, if they are not known
+        Histogram z_histogram = have_z_stats[z] ? CalcHistogram(num_bins, cube_stats, data.data(), data.size())
+                                                : CalcHistogram(num_bins, cube_stats, data.data(), data.size(), z_stats[z]);
+        have_z_stats[z] = true;
+        if (have_histogram) {
+            cube_histogram.Add(z_histogram);
+        } else {
+            cube_histogram = std::move(z_histogram);
+            have_histogram = true;
+        }
+        return progress_callback((float)++num_planes_done / depth, &cube_histogram);
+    });
+    if (!read_all_planes) {
+        return false;
+    }
+
+    if (!have_cube_stats) {
+        for (auto& stats : z_stats) {
+            cube_stats.join(stats);
+        }
+        if (cube_stats.num_pixels) {
+            cube_histogram = provisional_histogram.GetHistogram(num_bins, cube_stats.min_val, cube_stats.max_val);
+        } else {
+            cube_histogram = CalcHistogram(num_bins, cube_stats, nullptr, 0);
+        }
+        have_histogram = true;
+    }
+
+    // Cache plane stats
+    stats_lock.lock();
+    for (size_t z = 0; z < depth; ++z) {
+        int cache_key(CacheKey(z, stokes));
+        if (!_image_basic_stats.count(cache_key)) {
+            _image_basic_stats[cache_key] = z_stats[z];
+            _stats_modified = true;
+        }
+    }
+    return have_histogram;
+}
+
+bool Frame::ReadCubePlanes(
+    int stokes, const std::vector<size_t>& planes, const std::function<bool(size_t, const std::vector<float>&)>& plane_callback) {
+    // The next plane is read on another thread while the callback processes the current plane, so that reads overlap with the
+    // calculations and at most two planes are in memory
+    std::vector<float> data, next_data;
+    std::future<void> next_read;
+    auto read_plane = [&](size_t z) { next_read = std::async(std::launch::async, [&, z]() { GetZMatrix(next_data, z, stokes); }); };
+
+    if (!planes.empty()) {
+        read_plane(planes[0]);
+    }
+    for (size_t i = 0; i < planes.size(); ++i) {
+        next_read.get();
+        data.swap(next_data);
+        if (i + 1 < planes.size()) {
+            read_plane(planes[i + 1]);
+        }
+        if (!plane_callback(planes[i], data)) {
+            if (next_read.valid()) {
+                next_read.wait();
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
 bool Frame::GetCubeHistogramConfig(HistogramConfig& config) {
     bool have_config(!_cube_histogram_configs.empty());
     if (have_config) {
@@ -963,11 +1312,38 @@ bool Frame::GetCubeHistogramConfig(HistogramConfig& config) {
 }
 
 void Frame::CacheCubeStats(int stokes, BasicStats<float>& stats) {
+    std::lock_guard<std::mutex> guard(_stats_mutex);
     _cube_basic_stats[stokes] = stats;
+    _stats_modified = true;
 }
 
 void Frame::CacheCubeHistogram(int stokes, Histogram& hist) {
+    std::lock_guard<std::mutex> guard(_stats_mutex);
     _cube_histograms[stokes].push_back(hist);
+    _stats_modified = true;
+}
+
+void Frame::SaveStats() {
+    // Saved as soon as a calculation finishes, since the backend may exit without closing its frames
+    std::unique_lock<std::mutex> save_lock(_stats_save_mutex);
+    if (!_valid || !DiskStatsCache::Enabled() || !GetSharedImageId().IsValid()) {
+        return;
+    }
+
+    // The maps are copied, so that calculations can cache results while the copy is written
+    std::unique_lock<std::mutex> stats_lock(_stats_mutex);
+    if (!_stats_modified.exchange(false)) {
+        return;
+    }
+    auto image_basic_stats = _image_basic_stats;
+    auto image_histograms = _image_histograms;
+    auto cube_basic_stats = _cube_basic_stats;
+    auto cube_histograms = _cube_histograms;
+    stats_lock.unlock();
+
+    if (!DiskStatsCache::Save(GetSharedImageId(), _image_size, image_basic_stats, image_histograms, cube_basic_stats, cube_histograms)) {
+        _stats_modified = true;
+    }
 }
 
 // ****************************************************
@@ -1102,7 +1478,10 @@ bool Frame::FillSpatialProfileData(PointXy point, std::vector<CARTA::SetSpatialR
     } else if (_loader->UseTileCache()) {
         int tile_x = tile_index(x);
         int tile_y = tile_index(y);
-        auto tile = _tile_cache.Get(TileCache::Key(tile_x, tile_y), _loader, _image_mutex);
+        auto tile = _tile_cache.Get(TileCache::Key(tile_x, tile_y, CurrentZ(), CurrentStokes()), _loader, _image_mutex);
+        if (!tile) {
+            return false;
+        }
         auto tile_width = tile_size(tile_x, _width);
         cursor_value_with_current_stokes = (*tile)[((y - tile_y) * tile_width) + (x - tile_x)];
     }
@@ -1216,14 +1595,18 @@ bool Frame::FillSpatialProfileData(PointXy point, std::vector<CARTA::SetSpatialR
                         if (config.coordinate().back() == 'x') {
                             int tile_y = tile_index(y);
                             bool ignore_interrupt(_ignore_interrupt_X_mutex.try_lock());
+                            auto point_key = TileCache::Key(tile_index(point.x), tile_index(point.y), CurrentZ(), CurrentStokes());
 
                             for (int tile_x = tile_index(start); tile_x <= tile_index(end - 1); tile_x += TILE_SIZE) {
-                                auto key = TileCache::Key(tile_x, tile_y);
+                                auto key = TileCache::Key(tile_x, tile_y, CurrentZ(), CurrentStokes());
                                 // The cursor/point region has moved outside this chunk row
-                                if (!ignore_interrupt && (tile_index(point.y, CHUNK_SIZE) != TileCache::ChunkKey(key).y)) {
+                                if (!ignore_interrupt && (_tile_cache.ChunkKey(point_key).y != _tile_cache.ChunkKey(key).y)) {
                                     return have_profile;
                                 }
                                 auto tile = _tile_cache.Get(key, _loader, _image_mutex);
+                                if (!tile) {
+                                    return false;
+                                }
                                 auto tile_width = tile_size(tile_x, _width);
                                 auto tile_height = tile_size(tile_y, _height);
 
@@ -1240,14 +1623,18 @@ bool Frame::FillSpatialProfileData(PointXy point, std::vector<CARTA::SetSpatialR
                         } else if (config.coordinate().back() == 'y') {
                             int tile_x = tile_index(x);
                             bool ignore_interrupt(_ignore_interrupt_Y_mutex.try_lock());
+                            auto point_key = TileCache::Key(tile_index(point.x), tile_index(point.y), CurrentZ(), CurrentStokes());
 
                             for (int tile_y = tile_index(start); tile_y <= tile_index(end - 1); tile_y += TILE_SIZE) {
-                                auto key = TileCache::Key(tile_x, tile_y);
+                                auto key = TileCache::Key(tile_x, tile_y, CurrentZ(), CurrentStokes());
                                 // The point region has moved outside this chunk column
-                                if (!ignore_interrupt && (tile_index(point.x, CHUNK_SIZE) != TileCache::ChunkKey(key).x)) {
+                                if (!ignore_interrupt && (_tile_cache.ChunkKey(point_key).x != _tile_cache.ChunkKey(key).x)) {
                                     return have_profile;
                                 }
                                 auto tile = _tile_cache.Get(key, _loader, _image_mutex);
+                                if (!tile) {
+                                    return false;
+                                }
                                 auto tile_width = tile_size(tile_x, _width);
                                 auto tile_height = tile_size(tile_y, _height);
 
@@ -1683,6 +2070,24 @@ bool Frame::GetRegionData(const StokesRegion& stokes_region, std::vector<float>&
     return false;
 }
 
+bool Frame::GetPlaneData(int z, int stokes, float* data, const std::function<bool()>& is_cancelled) {
+    if (!_loader->UseTileCache() && !is_cancelled) {
+        return GetSlicerData(GetImageSlicer(AxisRange(z), stokes), data);
+    }
+
+    // Read in strips of rows, so that tiles can be read from the file in between
+    bool data_ok(true);
+    for (int y = 0; data_ok && (y < _height); y += CHUNK_SIZE) {
+        if (is_cancelled && is_cancelled()) {
+            return false;
+        }
+        int y_end = std::min((int)_height, y + CHUNK_SIZE) - 1;
+        auto strip_slicer = GetImageSlicer(AxisRange(ALL_X), AxisRange(y, y_end), AxisRange(z), stokes);
+        data_ok = GetSlicerData(strip_slicer, data + (size_t)y * _width);
+    }
+    return data_ok;
+}
+
 bool Frame::GetSlicerData(const StokesSlicer& stokes_slicer, float* data) {
     // Get image data with a slicer applied
     casacore::Array<float> tmp(stokes_slicer.slicer.length(), data, casacore::StorageInitPolicy::SHARE);
@@ -1703,8 +2108,10 @@ bool Frame::GetRegionStats(const StokesRegion& stokes_region, const std::vector<
     ulock.unlock();
 
     if (subimage_ok) {
+        // ImageStatistics is used for stats which are not calculated natively
         std::lock_guard<std::mutex> guard(_image_mutex);
-        return CalcStatsValues(stats_values, required_stats, sub_image, per_z);
+        return CalcRegionStatsValues(stats_values, required_stats, sub_image, per_z) ||
+               CalcStatsValues(stats_values, required_stats, sub_image, per_z);
     }
 
     return subimage_ok;
@@ -1720,8 +2127,10 @@ bool Frame::GetSlicerStats(const StokesSlicer& stokes_slicer, std::vector<CARTA:
     ulock.unlock();
 
     if (subimage_ok) {
+        // ImageStatistics is used for stats which are not calculated natively
         std::lock_guard<std::mutex> guard(_image_mutex);
-        return CalcStatsValues(stats_values, required_stats, sub_image, per_z);
+        return CalcRegionStatsValues(stats_values, required_stats, sub_image, per_z) ||
+               CalcStatsValues(stats_values, required_stats, sub_image, per_z);
     }
     return subimage_ok;
 }
@@ -12,13 +12,20 @@
 
 #include <algorithm>
 #include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <unordered_map>
 
+#include "Cache/CompressedTileCache.h"
+#include "Cache/ContourCache.h"
+#include "Cache/DiskStatsCache.h"
+#include "Cache/MipPyramid.h"
 #include "Cache/RequirementsCache.h"
+#include "Cache/SharedImageCache.h"
 #include "Cache/TileCache.h"
+#include "Cache/ZoneMap.h"
 #include "DataStream/Contouring.h"
 #include "DataStream/Tile.h"
 #include "ImageData/FileLoader.h"
@@ -34,8 +41,14 @@
 #include "Util/Message.h"
 #include "VectorFieldSettings.h"
 
+
 namespace carta {
 
+// Lossless raster tiles (byte planes compressed with zstd), with the value after CARTA::CompressionType::SZ. Once carta-protobuf
+// defines this value, the assertion fails and the enum value should be used instead.
+constexpr CARTA::CompressionType LOSSLESS_COMPRESSION_TYPE = static_cast<CARTA::CompressionType>(CARTA::CompressionType::SZ + 1);
+static_assert(CARTA::CompressionType_MAX < LOSSLESS_COMPRESSION_TYPE, "CARTA::CompressionType defines the lossless compression type");
+
 struct ContourSettings {
     std::vector<double> levels;
     CARTA::SmoothingMode smoothing_mode;
@@ -84,7 +97,6 @@ static std::unordered_map<CARTA::PolarizationType, std::string> ComputedStokesNa
 class Frame {
 public:
     Frame(uint32_t session_id, std::shared_ptr<FileLoader> loader, const std::string& hdu, int default_z = DEFAULT_Z);
-    ~Frame(){};
 
     bool IsValid();
     std::string GetErrorMessage();
@@ -119,6 +131,8 @@ public:
         return _required_animation_tiles;
     };
     bool SetImageChannels(int new_z, int new_stokes, std::string& message);
+    // Change in z for the last SetImageChannels, or 0 if the stokes changed
+    int LastZStep();
 
     // Cursor
     bool SetCursor(float x, float y);
@@ -126,6 +140,12 @@ public:
     // Raster data
     bool FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes,
         CARTA::CompressionType compression_type, float compression_quality);
+    // Warm the tile caches without sending any data. Stops as soon as is_cancelled returns true or z or stokes changes.
+    void PrefetchRasterTiles(const std::vector<Tile>& tiles, int z, int stokes, CARTA::CompressionType compression_type,
+        float compression_quality, const std::function<bool()>& is_cancelled);
+    // The plane prefetches stop between strips of rows when is_cancelled returns true or the current z or stokes changes
+    void PrefetchImageCache(const std::function<bool()>& is_cancelled);
+    void PrefetchImageChannel(const std::vector<Tile>& tiles, int z, int stokes, const std::function<bool()>& is_cancelled);
 
     // Functions used for smoothing and contouring
     bool SetContourParameters(const CARTA::SetContourParameters& message);
@@ -140,9 +160,17 @@ public:
         std::function<void(CARTA::RegionHistogramData histogram_data)> region_histogram_callback, int region_id, int file_id);
     bool GetBasicStats(int z, int stokes, BasicStats<float>& stats);
     bool CalculateHistogram(int region_id, int z, int stokes, int num_bins, BasicStats<float>& stats, Histogram& hist);
+    // Cube histogram; each plane is read once. If the range of the cube is known, the planes are binned exactly into it and the
+    // callback is called with the progress and the partial histogram. Otherwise the planes are binned into a provisional histogram
+    // which is rebinned into the range of the cube at the end, and the callback is only called with the progress. It returns false
+    // to cancel.
+    bool CalculateCubeHistogram(int stokes, int num_bins, BasicStats<float>& cube_stats, Histogram& cube_histogram,
+        const std::function<bool(float, const Histogram*)>& progress_callback);
     bool GetCubeHistogramConfig(HistogramConfig& config);
     void CacheCubeStats(int stokes, BasicStats<float>& stats);
     void CacheCubeHistogram(int stokes, Histogram& hist);
+    // Writes the stats to the DiskStatsCache if any were calculated since they were loaded or last saved
+    void SaveStats();
 
     // Stats: image
     bool SetStatsRequirements(int region_id, const std::vector<CARTA::SetStatsRequirements_StatsConfig>& stats_configs);
@@ -171,6 +199,9 @@ public:
     // Returns data vector
     bool GetRegionData(const StokesRegion& stokes_region, std::vector<float>& data);
     bool GetSlicerData(const StokesSlicer& stokes_slicer, float* data);
+    // Full xy plane; read in strips, with the image mutex released in between, if the loader reads tiles directly or if the read
+    // can be cancelled. Returns false if is_cancelled returns true before a strip.
+    bool GetPlaneData(int z, int stokes, float* data, const std::function<bool()>& is_cancelled = nullptr);
     // Returns stats_values map for spectral profiles and stats data
     bool GetRegionStats(const StokesRegion& stokes_region, const std::vector<CARTA::StatsType>& required_stats, bool per_z,
         std::map<CARTA::StatsType, std::vector<double>>& stats_values);
@@ -228,9 +259,10 @@ protected:
     // Check whether z or stokes has changed
     bool ZStokesChanged(int z, int stokes);
 
-    // Cache image plane data for current z, stokes
-    bool FillImageCache();
+    // Cache image plane data for current z, stokes; returns false if z or stokes changes while the plane is read
+    bool FillImageCache(const std::function<bool()>& is_cancelled = nullptr);
     void InvalidateImageCache();
+    SharedImageId GetSharedImageId();
 
     // Downsampled data from image cache
     bool GetRasterData(std::vector<float>& image_data, CARTA::ImageBounds& bounds, int mip, bool mean_filter = true);
@@ -238,6 +270,9 @@ protected:
 
     // Fill vector for given z and stokes
     void GetZMatrix(std::vector<float>& z_matrix, size_t z, size_t stokes);
+    // Calls the callback with the data of each plane in turn, until it returns false
+    bool ReadCubePlanes(
+        int stokes, const std::vector<size_t>& planes, const std::function<bool(size_t, const std::vector<float>&)>& plane_callback);
 
     // Histograms: z is single z index or ALL_Z for cube
     int AutoBinSize();
@@ -277,11 +312,13 @@ protected:
 
     // Image loader for image type
     std::shared_ptr<FileLoader> _loader;
+    std::string _hdu;
 
     // Shape and axis info: X, Y, Z, Stokes
     casacore::IPosition _image_shape;
     int _x_axis, _y_axis, _z_axis, _spectral_axis, _stokes_axis;
     int _z_index, _stokes_index; // current index
+    int _last_z_step;
     size_t _width, _height, _depth, _num_stokes;
 
     // Image settings
@@ -296,15 +333,23 @@ protected:
     // Image data cache and mutex
     //    std::vector<float> _image_cache; // image data for current z, stokes
     long long int _image_cache_size;
-    std::unique_ptr<float[]> _image_cache;
+    std::shared_ptr<float[]> _image_cache; // may be shared with other sessions through the SharedImageCache
     bool _image_cache_valid;       // cached image data is valid for current z and stokes
     queuing_rw_mutex _cache_mutex; // allow concurrent reads but lock for write
     std::mutex _image_mutex;       // only one disk access at a time
     bool _cache_loaded;            // channel cache is set
     TileCache _tile_cache;         // cache for full-resolution image tiles
+    MipPyramid _mip_pyramid;       // block sums of the image cache for downsampled tiles
+    ZoneMap _zone_map;             // value ranges of the blocks of the image cache, for contours and all-NaN regions
     std::mutex _ignore_interrupt_X_mutex;
     std::mutex _ignore_interrupt_Y_mutex;
 
+    // Cache for encoded raster tiles at all resolutions
+    CompressedTileCache _compressed_tile_cache;
+
+    // Cache for traced contour levels of all planes
+    ContourCache _contour_cache;
+
     // Use a shared lock for long time calculations, use an exclusive lock for the object destruction
     mutable std::shared_mutex _active_task_mutex;
 
@@ -321,6 +366,10 @@ protected:
     std::unordered_map<int, std::vector<Histogram>> _image_histograms, _cube_histograms;
     std::unordered_map<int, BasicStats<float>> _image_basic_stats, _cube_basic_stats;
     std::unordered_map<int, std::map<CARTA::StatsType, double>> _image_stats;
+    std::atomic<bool> _stats_modified; // basic stats or histograms were calculated since they were loaded or saved
+    uint64_t _image_size;              // size of the image files, which identifies the version of the image in the DiskStatsCache
+    std::mutex _stats_mutex;           // stats cache maps
+    std::mutex _stats_save_mutex;      // saves to the DiskStatsCache are written one at a time
 
     // Moment generator
     std::unique_ptr<MomentGenerator> _moment_generator;
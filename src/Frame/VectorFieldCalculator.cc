@@ -249,12 +249,9 @@ void FillTileData(CARTA::TileData* tile, int32_t x, int32_t y, int32_t layer, in
             // Get and fill the NaN data
             auto nan_encodings = GetNanEncodingsBlock(array, 0, tile_width, tile_height);
             tile->set_nan_encodings(nan_encodings.data(), sizeof(int32_t) * nan_encodings.size());
-            // Compress and fill the data
-            std::vector<char> compression_buffer;
-            size_t compressed_size;
+            // Compress the data directly into the tile
             int precision = lround(compression_quality);
-            Compress(array, 0, compression_buffer, compressed_size, tile_width, tile_height, precision);
-            tile->set_image_data(compression_buffer.data(), compressed_size);
+            Compress(array, 0, *tile->mutable_image_data(), tile_width, tile_height, precision);
         } else {
             tile->set_image_data(array.data(), sizeof(float) * array.size());
         }
@@ -21,12 +21,25 @@ public:
 
     void OpenFile(const std::string& hdu) override;
 
+    bool UseTileCache() const override;
+
+protected:
+    bool SupportsSidecar() const override;
+
 private:
     casacore::TempImage<float>* ConvertImageToFloat(casacore::LatticeBase* lattice);
 };
 
 CasaLoader::CasaLoader(const std::string& filename) : FileLoader(filename) {}
 
+bool CasaLoader::UseTileCache() const {
+    return HasDefaultAxisOrder();
+}
+
+bool CasaLoader::SupportsSidecar() const {
+    return true;
+}
+
 void CasaLoader::OpenFile(const std::string& /*hdu*/) {
     if (!_image) {
         bool converted(false);
@@ -13,6 +13,7 @@
 
 #include "Logger/Logger.h"
 #include "Util/File.h"
+#include "Util/FileSystem.h"
 
 #include "CasaLoader.h"
 #include "CompListLoader.h"
@@ -125,6 +126,42 @@ bool FileLoader::ImageUpdated() {
     return changed;
 }
 
+unsigned int FileLoader::GetModifyTime() const {
+    return _modify_time;
+}
+
+bool FileLoader::SupportsSidecar() const {
+    return false;
+}
+
+void FileLoader::OpenSidecar(const std::string& hdu) {
+    if (!SupportsSidecar() || !Hdf5Sidecar::Enabled()) {
+        return;
+    }
+
+    // The modify time in the sidecar name is only set once the image has been checked for updates
+    if (_modify_time == 0) {
+        ImageUpdated();
+    }
+
+    std::string path = Hdf5Sidecar::GetPath(_filename, hdu, _modify_time);
+    if (path.empty()) {
+        return;
+    }
+
+    if (fs::exists(path)) {
+        try {
+            _sidecar = std::make_unique<Hdf5Sidecar>(path, _num_dims);
+            spdlog::debug("Using sidecar {} for {}", path, _filename);
+        } catch (casacore::AipsError& err) {
+            spdlog::warn("Could not open sidecar {}: {}", path, err.getMesg());
+        }
+    } else if ((size_t)_image_shape.product() * sizeof(float) >= (size_t)SIDECAR_MIN_IMAGE_SIZE_MB * 1024 * 1024) {
+        // Used the next time the image is opened
+        Hdf5Sidecar::Generate(_filename, hdu, _modify_time);
+    }
+}
+
 bool FileLoader::HasData(FileInfo::Data dl) const {
     switch (dl) {
         case FileInfo::Data::Image:
@@ -142,7 +179,7 @@ bool FileLoader::HasData(FileInfo::Data dl) const {
             break;
     }
 
-    return false;
+    return _sidecar && _sidecar->HasData(dl);
 }
 
 casacore::DataType FileLoader::GetDataType() {
@@ -472,13 +509,28 @@ bool FileLoader::GetBeams(std::vector<CARTA::Beam>& beams, std::string& error) {
 }
 
 const casacore::IPosition FileLoader::GetStatsDataShape(FileInfo::Data ds) {
+    if (_sidecar) {
+        return _sidecar->GetStatsDataShape(ds);
+    }
     throw casacore::AipsError("getStatsDataShape not implemented in this loader");
 }
 
 std::unique_ptr<casacore::ArrayBase> FileLoader::GetStatsData(FileInfo::Data ds) {
+    if (_sidecar) {
+        return _sidecar->GetStatsData(ds);
+    }
     throw casacore::AipsError("getStatsData not implemented in this loader");
 }
 
+// Sums are stored as double in sidecars, and as float in IDIA HDF5 images
+static std::vector<double> StatsSumValues(const casacore::ArrayBase* data) {
+    if (auto double_data = dynamic_cast<const casacore::Array<casacore::Double>*>(data)) {
+        return double_data->tovector();
+    }
+    auto float_data = static_cast<const casacore::Array<casacore::Float>*>(data);
+    return std::vector<double>(float_data->begin(), float_data->end());
+}
+
 void FileLoader::LoadStats2DBasic(FileInfo::Data ds) {
     if (HasData(ds)) {
         const casacore::IPosition& stat_dims = GetStatsDataShape(ds);
@@ -508,7 +560,8 @@ void FileLoader::LoadStats2DBasic(FileInfo::Data ds) {
                     break;
                 }
                 case FileInfo::Data::STATS_2D_SUM: {
-                    auto it = static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    auto values = StatsSumValues(data.get());
+                    auto it = values.begin();
                     for (size_t s = 0; s < _num_stokes; s++) {
                         for (size_t z = 0; z < _depth; z++) {
                             _z_stats[s][z].basic_stats[CARTA::StatsType::Sum] = *it++;
@@ -517,7 +570,8 @@ void FileLoader::LoadStats2DBasic(FileInfo::Data ds) {
                     break;
                 }
                 case FileInfo::Data::STATS_2D_SUMSQ: {
-                    auto it = static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    auto values = StatsSumValues(data.get());
+                    auto it = values.begin();
                     for (size_t s = 0; s < _num_stokes; s++) {
                         for (size_t z = 0; z < _depth; z++) {
                             _z_stats[s][z].basic_stats[CARTA::StatsType::SumSq] = *it++;
@@ -630,14 +684,16 @@ void FileLoader::LoadStats3DBasic(FileInfo::Data ds) {
                     break;
                 }
                 case FileInfo::Data::STATS_3D_SUM: {
-                    auto it = static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    auto values = StatsSumValues(data.get());
+                    auto it = values.begin();
                     for (size_t s = 0; s < _num_stokes; s++) {
                         _cube_stats[s].basic_stats[CARTA::StatsType::Sum] = *it++;
                     }
                     break;
                 }
                 case FileInfo::Data::STATS_3D_SUMSQ: {
-                    auto it = static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    auto values = StatsSumValues(data.get());
+                    auto it = values.begin();
                     for (size_t s = 0; s < _num_stokes; s++) {
                         _cube_stats[s].basic_stats[CARTA::StatsType::SumSq] = *it++;
                     }
@@ -829,41 +885,317 @@ FileInfo::ImageStats& FileLoader::GetImageStats(int current_stokes, int z) {
 
 bool FileLoader::GetCursorSpectralData(
     std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) {
-    // Must be implemented in subclasses
-    return false;
+    // Implemented in subclasses, or uses the swizzled data in the sidecar
+    if (!_sidecar || !_sidecar->HasData(FileInfo::Data::SWIZZLED) || IsComputedStokes(stokes)) {
+        return false;
+    }
+
+    casacore::Slicer slicer;
+    if (_num_dims == 4) {
+        slicer = casacore::Slicer(
+            casacore::IPosition(4, 0, cursor_y, cursor_x, stokes), casacore::IPosition(4, _depth, count_y, count_x, 1));
+    } else if (_num_dims == 3) {
+        slicer = casacore::Slicer(casacore::IPosition(3, 0, cursor_y, cursor_x), casacore::IPosition(3, _depth, count_y, count_x));
+    } else {
+        return false;
+    }
+
+    data.resize(_depth * count_y * count_x);
+    casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
+    std::lock_guard<std::mutex> lguard(image_mutex);
+    return _sidecar->GetSwizzledData(tmp, slicer);
 }
 
 bool FileLoader::UseRegionSpectralData(const casacore::IPosition& region_shape, std::mutex& image_mutex) {
-    // Must be implemented in subclasses; should call before GetRegionSpectralData
-    return false;
+    // Requires swizzled data, in the image or in its sidecar
+    std::unique_lock<std::mutex> ulock(image_mutex);
+    bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
+    ulock.unlock();
+    if (!has_swizzled) {
+        return false;
+    }
+
+    int width = region_shape(0);
+    int height = region_shape(1);
+    int depth = _depth;
+
+    // Using the normal dataset may be faster if the region is wider than it is deep.
+    // This is an initial estimate; we need to examine casacore's algorithm in more detail.
+    if (height * depth < width) {
+        return false;
+    }
+
+    return true;
 }
 
 bool FileLoader::GetRegionSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask,
     const casacore::IPosition& origin, std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) {
-    // Must be implemented in subclasses
-    return false;
+    // Return calculated stats if valid and complete,
+    // or return accumulated stats for the next incomplete "x" slice of swizzled data (chan vs y).
+    // Calling function should check for complete progress when x-range of region is complete
+    // Mask is 2D mask for region only
+
+    std::unique_lock<std::mutex> ulock(image_mutex);
+    bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
+    ulock.unlock();
+    if (!has_swizzled || IsComputedStokes(stokes)) {
+        return false;
+    }
+
+    // Check if region stats calculated
+    auto region_stats_id = FileInfo::RegionStatsId(region_id, stokes);
+    casacore::IPosition mask_shape(mask.shape());
+    if (_region_stats.count(region_stats_id) && _region_stats[region_stats_id].IsValid(origin, mask_shape) &&
+        _region_stats[region_stats_id].IsCompleted()) {
+        results = _region_stats[region_stats_id].stats;
+        progress = 1.0;
+        return true;
+    }
+
+    int width = mask_shape(0);
+    int height = mask_shape(1);
+    int depth = _depth;
+    double beam_area = CalculateBeamArea();
+    bool has_flux = !std::isnan(beam_area);
+
+    if (_region_stats.find(region_stats_id) == _region_stats.end()) { // region stats never calculated
+        _region_stats.emplace(
+            std::piecewise_construct, std::forward_as_tuple(region_id, stokes), std::forward_as_tuple(origin, mask_shape, depth, has_flux));
+    } else if (!_region_stats[region_stats_id].IsValid(origin, mask_shape)) { // region stats expired
+        _region_stats[region_stats_id].origin = origin;
+        _region_stats[region_stats_id].shape = mask_shape;
+        _region_stats[region_stats_id].completed = false;
+        _region_stats[region_stats_id].latest_x = 0;
+    }
+
+    int x_min = origin(0);
+    int y_min = origin(1);
+
+    auto& stats = _region_stats[region_stats_id].stats;
+    auto& num_pixels = stats[CARTA::StatsType::NumPixels];
+    auto& nan_count = stats[CARTA::StatsType::NanCount];
+    auto& sum = stats[CARTA::StatsType::Sum];
+    auto& mean = stats[CARTA::StatsType::Mean];
+    auto& rms = stats[CARTA::StatsType::RMS];
+    auto& sigma = stats[CARTA::StatsType::Sigma];
+    auto& sum_sq = stats[CARTA::StatsType::SumSq];
+    auto& min = stats[CARTA::StatsType::Min];
+    auto& max = stats[CARTA::StatsType::Max];
+    auto& extrema = stats[CARTA::StatsType::Extrema];
+    double* flux = has_flux ? stats[CARTA::StatsType::FluxDensity].data() : nullptr;
+
+    // get the start of X
+    size_t x_start = _region_stats[region_stats_id].latest_x;
+
+    // Set initial values of stats, or those set to NAN in previous iterations
+    for (size_t z = 0; z < depth; z++) {
+        if ((x_start == 0) || (num_pixels[z] == 0)) {
+            min[z] = std::numeric_limits<float>::max();
+            max[z] = std::numeric_limits<float>::lowest();
+            num_pixels[z] = 0;
+            nan_count[z] = 0;
+            sum[z] = 0;
+            sum_sq[z] = 0;
+        }
+    }
+
+    // Lambda to calculate additional stats
+    auto calculate_stats = [&]() {
+        double sum_z, sum_sq_z;
+        uint64_t num_pixels_z;
+
+        for (size_t z = 0; z < depth; z++) {
+            if (num_pixels[z]) {
+                sum_z = sum[z];
+                sum_sq_z = sum_sq[z];
+                num_pixels_z = num_pixels[z];
+
+                mean[z] = sum_z / num_pixels_z;
+                rms[z] = sqrt(sum_sq_z / num_pixels_z);
+                sigma[z] = num_pixels_z > 1 ? sqrt((sum_sq_z - (sum_z * sum_z / num_pixels_z)) / (num_pixels_z - 1)) : 0;
+                extrema[z] = (abs(min[z]) > abs(max[z]) ? min[z] : max[z]);
+
+                if (has_flux) {
+                    flux[z] = sum_z / beam_area;
+                }
+            } else {
+                // if there are no valid values, set all stats to NaN except the value and NaN counts
+                for (auto& kv : stats) {
+                    switch (kv.first) {
+                        case CARTA::StatsType::NanCount:
+                        case CARTA::StatsType::NumPixels:
+                            break;
+                        default:
+                            kv.second[z] = NAN;
+                            break;
+                    }
+                }
+            }
+        }
+    };
+
+    size_t delta_x = INIT_DELTA_Z; // since data is swizzled, third axis is x not z
+    size_t max_x = x_start + delta_x;
+    if (max_x > width) {
+        max_x = width;
+    }
+    std::vector<float> slice_data;
+
+    for (size_t x = x_start; x < max_x; ++x) {
+        if (!GetCursorSpectralData(slice_data, stokes, x + x_min, 1, y_min, height, image_mutex)) {
+            return false;
+        }
+
+        for (size_t y = 0; y < height; y++) {
+            // skip all Z values for masked pixels
+            if (!mask.getAt(casacore::IPosition(2, x, y))) {
+                continue;
+            }
+
+            for (size_t z = 0; z < depth; z++) {
+                double v = slice_data[y * depth + z];
+
+                // skip all NaN pixels
+                if (std::isfinite(v)) {
+                    num_pixels[z] += 1;
+                    sum[z] += v;
+                    sum_sq[z] += v * v;
+                    min[z] = std::min(min[z], v);
+                    max[z] = std::max(max[z], v);
+                }
+            }
+        }
+    }
+
+    // Calculate partial stats
+    calculate_stats();
+
+    results = _region_stats[region_stats_id].stats;
+    if (max_x == width) {
+        progress = 1.0;
+    } else {
+        progress = (float)max_x / width;
+    }
+
+    // Update starting x for next time
+    _region_stats[region_stats_id].latest_x = max_x;
+
+    if (progress >= 1.0) {
+        // the stats calculation is completed
+        _region_stats[region_stats_id].completed = true;
+
+        if (region_id == TEMP_REGION_ID) {
+            // clear for next temp region
+            _region_stats.erase(region_stats_id);
+        }
+    }
+
+    return true;
 }
 
 bool FileLoader::GetDownsampledRasterData(
     std::vector<float>& data, int z, int stokes, CARTA::ImageBounds& bounds, int mip, std::mutex& image_mutex) {
-    // Must be implemented in subclasses
-    return false;
+    // Implemented in subclasses, or uses the mipmaps in the sidecar
+    if (!_sidecar || !_sidecar->HasMip(mip) || IsComputedStokes(stokes)) {
+        return false;
+    }
+
+    const int xmin = std::ceil((float)bounds.x_min() / mip);
+    const int ymin = std::ceil((float)bounds.y_min() / mip);
+    const int xmax = std::ceil((float)bounds.x_max() / mip);
+    const int ymax = std::ceil((float)bounds.y_max() / mip);
+
+    const int w = xmax - xmin;
+    const int h = ymax - ymin;
+
+    casacore::Slicer slicer;
+    if (_num_dims == 4) {
+        slicer = casacore::Slicer(casacore::IPosition(4, xmin, ymin, z, stokes), casacore::IPosition(4, w, h, 1, 1));
+    } else if (_num_dims == 3) {
+        slicer = casacore::Slicer(casacore::IPosition(3, xmin, ymin, z), casacore::IPosition(3, w, h, 1));
+    } else if (_num_dims == 2) {
+        slicer = casacore::Slicer(casacore::IPosition(2, xmin, ymin), casacore::IPosition(2, w, h));
+    } else {
+        return false;
+    }
+
+    data.resize(w * h);
+    casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
+    std::lock_guard<std::mutex> lguard(image_mutex);
+    return _sidecar->GetMipData(tmp, slicer, mip);
 }
 
 bool FileLoader::GetChunk(
     std::vector<float>& data, int& data_width, int& data_height, int min_x, int min_y, int z, int stokes, std::mutex& image_mutex) {
-    // Must be implemented in subclasses
-    return false;
+    // Subset read of one chunk; only used if UseTileCache() is true, which requires x, y, [z, [stokes]] axis order
+    bool data_ok(false);
+
+    data_width = std::min(data_width, (int)_width - min_x);
+    data_height = std::min(data_height, (int)_height - min_y);
+
+    StokesSource stokes_source(stokes, AxisRange(z), AxisRange(min_x, min_x + data_width - 1), AxisRange(min_y, min_y + data_height - 1));
+    if (!stokes_source.IsOriginalImage()) { // Reset the start position of the slicer as 0 for the computed stokes image
+        stokes = 0;
+        z = 0;
+        min_x = 0;
+        min_y = 0;
+    }
+
+    casacore::Slicer slicer;
+    if (_num_dims == 4) {
+        slicer = casacore::Slicer(casacore::IPosition(4, min_x, min_y, z, stokes), casacore::IPosition(4, data_width, data_height, 1, 1));
+    } else if (_num_dims == 3) {
+        slicer = casacore::Slicer(casacore::IPosition(3, min_x, min_y, z), casacore::IPosition(3, data_width, data_height, 1));
+    } else if (_num_dims == 2) {
+        slicer = casacore::Slicer(casacore::IPosition(2, min_x, min_y), casacore::IPosition(2, data_width, data_height));
+    }
+
+    data.resize(data_width * data_height);
+    casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
+
+    std::lock_guard<std::mutex> lguard(image_mutex);
+    try {
+        data_ok = GetSlice(tmp, StokesSlicer(stokes_source, slicer));
+    } catch (casacore::AipsError& err) {
+        spdlog::warn("Could not load image tile. AIPS ERROR: {}", err.getMesg());
+    }
+
+    return data_ok;
+}
+
+void FileLoader::GetChunkShape(int& chunk_width, int& chunk_height) {
+    // Storage tiles larger than the default chunk, e.g. HDF5 chunks or full rows, are read whole; smaller tiles fit in the default chunk
+    chunk_width = CHUNK_SIZE;
+    chunk_height = CHUNK_SIZE;
+    if (!_image || _num_dims < 2) {
+        return;
+    }
+
+    auto round_up = [](int size) { return ((size - 1) / TILE_SIZE + 1) * TILE_SIZE; };
+    casacore::IPosition storage_shape = _image->niceCursorShape(MAX_CHUNK_PIXELS);
+    int storage_width = std::min((int)storage_shape(0), (int)_width);
+    int storage_height = std::min((int)storage_shape(1), (int)_height);
+    int width = (storage_width > CHUNK_SIZE ? round_up(storage_width) : CHUNK_SIZE);
+    int height = (storage_height > CHUNK_SIZE ? round_up(storage_height) : CHUNK_SIZE);
+    if ((size_t)width * height <= MAX_CHUNK_PIXELS) {
+        chunk_width = width;
+        chunk_height = height;
+    }
 }
 
 bool FileLoader::HasMip(int mip) const {
-    return false;
+    return _sidecar && _sidecar->HasMip(mip);
 }
 
 bool FileLoader::UseTileCache() const {
     return false;
 }
 
+bool FileLoader::HasDefaultAxisOrder() const {
+    bool xy = (_render_axes.size() == 2) && (_render_axes[0] == 0) && (_render_axes[1] == 1);
+    return xy && ((_num_dims < 3) || (_z_axis == 2)) && ((_num_dims < 4) || (_stokes_axis == 3));
+}
+
 std::string FileLoader::GetFileName() {
     return _filename;
 }
@@ -18,6 +18,7 @@
 #include <carta-protobuf/enums.pb.h>
 
 #include "ImageData/FileInfo.h"
+#include "ImageData/Hdf5Sidecar.h"
 #include "Util/Casacore.h"
 #include "Util/Image.h"
 
@@ -105,8 +106,11 @@ public:
         float& progress);
     virtual bool GetDownsampledRasterData(
         std::vector<float>& data, int z, int stokes, CARTA::ImageBounds& bounds, int mip, std::mutex& image_mutex);
+    // Chunk shape in the data width and height, which are clipped to the image
     virtual bool GetChunk(
         std::vector<float>& data, int& data_width, int& data_height, int min_x, int min_y, int z, int stokes, std::mutex& image_mutex);
+    // Shape of the chunks read into the tile cache, in multiples of TILE_SIZE
+    virtual void GetChunkShape(int& chunk_width, int& chunk_height);
 
     virtual bool HasMip(int mip) const;
     virtual bool UseTileCache() const;
@@ -125,6 +129,11 @@ public:
 
     // Modify time changed
     bool ImageUpdated();
+    unsigned int GetModifyTime() const;
+
+    // Use the HDF5 sidecar for this image if there is one, otherwise start writing it for large images.
+    // Must be called after FindCoordinateAxes.
+    void OpenSidecar(const std::string& hdu);
 
     // Handle images created from LEL expression
     virtual bool SaveFile(const CARTA::FileType type, const std::string& output_filename, std::string& message);
@@ -152,6 +161,16 @@ protected:
     bool _has_pixel_mask;
     casacore::DataType _data_type;
 
+    // Whether the image axes are x, y, [z, [stokes]], so that chunks can be read directly into the tile cache
+    bool HasDefaultAxisOrder() const;
+
+    // Optional mipmaps, swizzled data and statistics for images which do not contain them
+    std::unique_ptr<Hdf5Sidecar> _sidecar;
+    virtual bool SupportsSidecar() const;
+
+    // Region spectral stats accumulated from the swizzled data, one x-slice at a time
+    std::map<FileInfo::RegionStatsId, FileInfo::RegionSpectralStats> _region_stats;
+
     // Storage for z-plane and cube statistics
     std::vector<std::vector<FileInfo::ImageStats>> _z_stats;
     std::vector<FileInfo::ImageStats> _cube_stats;
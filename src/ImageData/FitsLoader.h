@@ -26,6 +26,12 @@ public:
 
     void OpenFile(const std::string& hdu) override;
 
+    bool UseTileCache() const override;
+    void GetChunkShape(int& chunk_width, int& chunk_height) override;
+
+protected:
+    bool SupportsSidecar() const override;
+
 private:
     std::string _unzip_file;
     casacore::uInt _hdu_num;
@@ -45,6 +51,21 @@ FitsLoader::~FitsLoader() {
     }
 }
 
+bool FitsLoader::UseTileCache() const {
+    return HasDefaultAxisOrder();
+}
+
+void FitsLoader::GetChunkShape(int& chunk_width, int& chunk_height) {
+    // Rows are contiguous in a FITS file, so chunks are strips of full rows at least as large as the default chunk
+    chunk_width = std::min((((int)_width - 1) / TILE_SIZE + 1) * TILE_SIZE, (MAX_CHUNK_PIXELS / TILE_SIZE / TILE_SIZE) * TILE_SIZE);
+    chunk_height = std::max(TILE_SIZE, ((CHUNK_SIZE * CHUNK_SIZE / chunk_width) / TILE_SIZE) * TILE_SIZE);
+}
+
+bool FitsLoader::SupportsSidecar() const {
+    // Compressed files would be decompressed again to write the sidecar
+    return !_is_gz;
+}
+
 void FitsLoader::OpenFile(const std::string& hdu) {
     // Convert string to FITS hdu number
     casacore::uInt hdu_num(FileInfo::GetFitsHdu(hdu));
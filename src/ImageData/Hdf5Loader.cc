@@ -242,192 +242,6 @@ bool Hdf5Loader::GetCursorSpectralData(
     return data_ok;
 }
 
-bool Hdf5Loader::UseRegionSpectralData(const casacore::IPosition& region_shape, std::mutex& image_mutex) {
-    std::unique_lock<std::mutex> ulock(image_mutex);
-    bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
-    ulock.unlock();
-    if (!has_swizzled) {
-        return false;
-    }
-
-    int width = region_shape(0);
-    int height = region_shape(1);
-    int depth = _depth;
-
-    // Using the normal dataset may be faster if the region is wider than it is deep.
-    // This is an initial estimate; we need to examine casacore's algorithm in more detail.
-    if (height * depth < width) {
-        return false;
-    }
-
-    return true;
-}
-
-bool Hdf5Loader::GetRegionSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask,
-    const casacore::IPosition& origin, std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) {
-    // Return calculated stats if valid and complete,
-    // or return accumulated stats for the next incomplete "x" slice of swizzled data (chan vs y).
-    // Calling function should check for complete progress when x-range of region is complete
-    // Mask is 2D mask for region only
-
-    std::unique_lock<std::mutex> ulock(image_mutex);
-    bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
-    ulock.unlock();
-    if (!has_swizzled) {
-        return false;
-    }
-
-    // Check if region stats calculated
-    auto region_stats_id = FileInfo::RegionStatsId(region_id, stokes);
-    casacore::IPosition mask_shape(mask.shape());
-    if (_region_stats.count(region_stats_id) && _region_stats[region_stats_id].IsValid(origin, mask_shape) &&
-        _region_stats[region_stats_id].IsCompleted()) {
-        results = _region_stats[region_stats_id].stats;
-        progress = 1.0;
-        return true;
-    }
-
-    int width = mask_shape(0);
-    int height = mask_shape(1);
-    int depth = _depth;
-    double beam_area = CalculateBeamArea();
-    bool has_flux = !std::isnan(beam_area);
-
-    if (_region_stats.find(region_stats_id) == _region_stats.end()) { // region stats never calculated
-        _region_stats.emplace(
-            std::piecewise_construct, std::forward_as_tuple(region_id, stokes), std::forward_as_tuple(origin, mask_shape, depth, has_flux));
-    } else if (!_region_stats[region_stats_id].IsValid(origin, mask_shape)) { // region stats expired
-        _region_stats[region_stats_id].origin = origin;
-        _region_stats[region_stats_id].shape = mask_shape;
-        _region_stats[region_stats_id].completed = false;
-        _region_stats[region_stats_id].latest_x = 0;
-    }
-
-    int x_min = origin(0);
-    int y_min = origin(1);
-
-    auto& stats = _region_stats[region_stats_id].stats;
-    auto& num_pixels = stats[CARTA::StatsType::NumPixels];
-    auto& nan_count = stats[CARTA::StatsType::NanCount];
-    auto& sum = stats[CARTA::StatsType::Sum];
-    auto& mean = stats[CARTA::StatsType::Mean];
-    auto& rms = stats[CARTA::StatsType::RMS];
-    auto& sigma = stats[CARTA::StatsType::Sigma];
-    auto& sum_sq = stats[CARTA::StatsType::SumSq];
-    auto& min = stats[CARTA::StatsType::Min];
-    auto& max = stats[CARTA::StatsType::Max];
-    auto& extrema = stats[CARTA::StatsType::Extrema];
-    double* flux = has_flux ? stats[CARTA::StatsType::FluxDensity].data() : nullptr;
-
-    // get the start of X
-    size_t x_start = _region_stats[region_stats_id].latest_x;
-
-    // Set initial values of stats, or those set to NAN in previous iterations
-    for (size_t z = 0; z < depth; z++) {
-        if ((x_start == 0) || (num_pixels[z] == 0)) {
-            min[z] = std::numeric_limits<float>::max();
-            max[z] = std::numeric_limits<float>::lowest();
-            num_pixels[z] = 0;
-            nan_count[z] = 0;
-            sum[z] = 0;
-            sum_sq[z] = 0;
-        }
-    }
-
-    // Lambda to calculate additional stats
-    auto calculate_stats = [&]() {
-        double sum_z, sum_sq_z;
-        uint64_t num_pixels_z;
-
-        for (size_t z = 0; z < depth; z++) {
-            if (num_pixels[z]) {
-                sum_z = sum[z];
-                sum_sq_z = sum_sq[z];
-                num_pixels_z = num_pixels[z];
-
-                mean[z] = sum_z / num_pixels_z;
-                rms[z] = sqrt(sum_sq_z / num_pixels_z);
-                sigma[z] = num_pixels_z > 1 ? sqrt((sum_sq_z - (sum_z * sum_z / num_pixels_z)) / (num_pixels_z - 1)) : 0;
-                extrema[z] = (abs(min[z]) > abs(max[z]) ? min[z] : max[z]);
-
-                if (has_flux) {
-                    flux[z] = sum_z / beam_area;
-                }
-            } else {
-                // if there are no valid values, set all stats to NaN except the value and NaN counts
-                for (auto& kv : stats) {
-                    switch (kv.first) {
-                        case CARTA::StatsType::NanCount:
-                        case CARTA::StatsType::NumPixels:
-                            break;
-                        default:
-                            kv.second[z] = NAN;
-                            break;
-                    }
-                }
-            }
-        }
-    };
-
-    size_t delta_x = INIT_DELTA_Z; // since data is swizzled, third axis is x not z
-    size_t max_x = x_start + delta_x;
-    if (max_x > width) {
-        max_x = width;
-    }
-    std::vector<float> slice_data;
-
-    for (size_t x = x_start; x < max_x; ++x) {
-        if (!GetCursorSpectralData(slice_data, stokes, x + x_min, 1, y_min, height, image_mutex)) {
-            return false;
-        }
-
-        for (size_t y = 0; y < height; y++) {
-            // skip all Z values for masked pixels
-            if (!mask.getAt(casacore::IPosition(2, x, y))) {
-                continue;
-            }
-
-            for (size_t z = 0; z < depth; z++) {
-                double v = slice_data[y * depth + z];
-
-                // skip all NaN pixels
-                if (std::isfinite(v)) {
-                    num_pixels[z] += 1;
-                    sum[z] += v;
-                    sum_sq[z] += v * v;
-                    min[z] = std::min(min[z], v);
-                    max[z] = std::max(max[z], v);
-                }
-            }
-        }
-    }
-
-    // Calculate partial stats
-    calculate_stats();
-
-    results = _region_stats[region_stats_id].stats;
-    if (max_x == width) {
-        progress = 1.0;
-    } else {
-        progress = (float)max_x / width;
-    }
-
-    // Update starting x for next time
-    _region_stats[region_stats_id].latest_x = max_x;
-
-    if (progress >= 1.0) {
-        // the stats calculation is completed
-        _region_stats[region_stats_id].completed = true;
-
-        if (region_id == TEMP_REGION_ID) {
-            // clear for next temp region
-            _region_stats.erase(region_stats_id);
-        }
-    }
-
-    return true;
-}
-
 bool Hdf5Loader::GetDownsampledRasterData(
     std::vector<float>& data, int z, int stokes, CARTA::ImageBounds& bounds, int mip, std::mutex& image_mutex) {
     if (!HasMip(mip)) {
@@ -469,44 +283,6 @@ bool Hdf5Loader::GetDownsampledRasterData(
     return data_ok;
 }
 
-bool Hdf5Loader::GetChunk(
-    std::vector<float>& data, int& data_width, int& data_height, int min_x, int min_y, int z, int stokes, std::mutex& image_mutex) {
-    bool data_ok(false);
-
-    data_width = std::min(CHUNK_SIZE, (int)_width - min_x);
-    data_height = std::min(CHUNK_SIZE, (int)_height - min_y);
-
-    StokesSource stokes_source(stokes, AxisRange(z), AxisRange(min_x, min_x + data_width - 1), AxisRange(min_y, min_y + data_height - 1));
-    if (!stokes_source.IsOriginalImage()) { // Reset the start position of the slicer as 0 for the computed stokes image
-        stokes = 0;
-        z = 0;
-        min_x = 0;
-        min_y = 0;
-    }
-
-    casacore::Slicer slicer;
-    if (_num_dims == 4) {
-        slicer = casacore::Slicer(casacore::IPosition(4, min_x, min_y, z, stokes), casacore::IPosition(4, data_width, data_height, 1, 1));
-    } else if (_num_dims == 3) {
-        slicer = casacore::Slicer(casacore::IPosition(3, min_x, min_y, z), casacore::IPosition(3, data_width, data_height, 1));
-    } else if (_num_dims == 2) {
-        slicer = casacore::Slicer(casacore::IPosition(2, min_x, min_y), casacore::IPosition(2, data_width, data_height));
-    }
-
-    data.resize(data_width * data_height);
-    casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
-
-    std::lock_guard<std::mutex> lguard(image_mutex);
-    try {
-        GetSlice(tmp, StokesSlicer(stokes_source, slicer));
-        data_ok = true;
-    } catch (casacore::AipsError& err) {
-        std::cerr << "Could not load image tile. AIPS ERROR: " << err.getMesg() << std::endl;
-    }
-
-    return data_ok;
-}
-
 bool Hdf5Loader::UseTileCache() const {
     return _layout == H5D_CHUNKED;
 }
@@ -0,0 +1,544 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# Hdf5Sidecar.cc: IDIA-schema HDF5 file holding mipmaps, swizzled data and statistics for a FITS, CASA or MIRIAD image
+
+#include "Hdf5Sidecar.h"
+
+#include <chrono>
+#include <cmath>
+#include <regex>
+#include <thread>
+
+#include <casacore/casa/HDF5/HDF5DataSet.h>
+#include <casacore/casa/HDF5/HDF5Group.h>
+
+#include "DataStream/Smoothing.h"
+#include "ImageData/FileLoader.h"
+#include "ImageStats/StatsCalculator.h"
+#include "Logger/Logger.h"
+#include "Util/FileSystem.h"
+
+namespace carta {
+
+std::string Hdf5Sidecar::_folder;
+size_t Hdf5Sidecar::_swizzle_buffer_size = SIDECAR_SWIZZLE_BUFFER_SIZE;
+std::mutex Hdf5Sidecar::_generate_mutex;
+std::unordered_set<std::string> Hdf5Sidecar::_in_progress;
+
+Hdf5Sidecar::Hdf5Sidecar(const std::string& path, size_t num_dims) : _num_dims(num_dims) {
+    // Throws casacore::AipsError if the file cannot be opened
+    _file = new casacore::HDF5File(path);
+    _group = std::make_unique<casacore::HDF5Group>(*_file, SIDECAR_GROUP, true);
+
+    std::string swizzled_name = DataSetToString(FileInfo::Data::SWIZZLED, _num_dims);
+    if (!swizzled_name.empty() && casacore::HDF5Group::exists(*_group, swizzled_name)) {
+        _swizzled = std::make_unique<casacore::HDF5Lattice<float>>(_file, swizzled_name, SIDECAR_GROUP);
+    }
+
+    if (casacore::HDF5Group::exists(*_group, "MipMaps/DATA")) {
+        casacore::HDF5Group mipmap_group(_group->getHid(), "MipMaps/DATA", true);
+        for (auto& name : casacore::HDF5Group::linkNames(mipmap_group)) {
+            std::regex re("DATA_XY_(\\d+)");
+            std::smatch match;
+            if (std::regex_match(name, match, re) && match.size() > 1) {
+                _mipmaps[std::stoi(match.str(1))] =
+                    std::make_unique<casacore::HDF5Lattice<float>>(_file, fmt::format("MipMaps/DATA/{}", name), SIDECAR_GROUP);
+            }
+        }
+    }
+}
+
+bool Hdf5Sidecar::HasMip(int mip) const {
+    return _mipmaps.find(mip) != _mipmaps.end();
+}
+
+bool Hdf5Sidecar::HasData(FileInfo::Data ds) const {
+    if (ds == FileInfo::Data::SWIZZLED) {
+        return _swizzled != nullptr;
+    }
+
+    std::string ds_name(DataSetToString(ds, _num_dims));
+    return !ds_name.empty() && casacore::HDF5Group::exists(*_group, ds_name);
+}
+
+bool Hdf5Sidecar::GetMipData(casacore::Array<float>& data, const casacore::Slicer& slicer, int mip) {
+    if (!HasMip(mip)) {
+        return false;
+    }
+
+    try {
+        _mipmaps[mip]->doGetSlice(data, slicer);
+        return true;
+    } catch (casacore::AipsError& err) {
+        spdlog::warn("Could not load mipmap data from sidecar. AIPS ERROR: {}", err.getMesg());
+    }
+    return false;
+}
+
+bool Hdf5Sidecar::GetSwizzledData(casacore::Array<float>& data, const casacore::Slicer& slicer) {
+    if (!_swizzled) {
+        return false;
+    }
+
+    try {
+        _swizzled->doGetSlice(data, slicer);
+        return true;
+    } catch (casacore::AipsError& err) {
+        spdlog::warn("Could not load swizzled data from sidecar. AIPS ERROR: {}", err.getMesg());
+    }
+    return false;
+}
+
+// Counts are written as Int64, sums as Double and everything else as Float, so the native type is known here
+static bool IsSumData(FileInfo::Data ds) {
+    switch (ds) {
+        case FileInfo::Data::STATS_2D_SUM:
+        case FileInfo::Data::STATS_2D_SUMSQ:
+        case FileInfo::Data::STATS_3D_SUM:
+        case FileInfo::Data::STATS_3D_SUMSQ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool IsCountData(FileInfo::Data ds) {
+    switch (ds) {
+        case FileInfo::Data::STATS_2D_NANS:
+        case FileInfo::Data::STATS_2D_HIST:
+        case FileInfo::Data::STATS_3D_NANS:
+        case FileInfo::Data::STATS_3D_HIST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const casacore::IPosition Hdf5Sidecar::GetStatsDataShape(FileInfo::Data ds) {
+    std::string ds_name(DataSetToString(ds, _num_dims));
+    if (IsCountData(ds)) {
+        return casacore::HDF5DataSet(*_group, ds_name, (const casacore::Int64*)0).shape();
+    }
+    if (IsSumData(ds)) {
+        return casacore::HDF5DataSet(*_group, ds_name, (const casacore::Double*)0).shape();
+    }
+    return casacore::HDF5DataSet(*_group, ds_name, (const casacore::Float*)0).shape();
+}
+
+template <typename T>
+static std::unique_ptr<casacore::ArrayBase> ReadStatsData(const casacore::HDF5Group& group, const std::string& name) {
+    casacore::HDF5DataSet data_set(group, name, (const T*)0);
+
+    if (data_set.shape().size() == 0) {
+        // Scalar datasets are not handled by casacore
+        T value;
+        casacore::HDF5DataType data_type((T*)0);
+        H5Dread(data_set.getHid(), data_type.getHidMem(), H5S_ALL, H5S_ALL, H5P_DEFAULT, &value);
+        return std::unique_ptr<casacore::ArrayBase>(new casacore::Array<T>(casacore::IPosition(1, 1), value));
+    }
+
+    std::unique_ptr<casacore::ArrayBase> data(new casacore::Array<T>());
+    data_set.get(casacore::Slicer(casacore::IPosition(data_set.shape().size(), 0), data_set.shape()), *data.get());
+    return data;
+}
+
+std::unique_ptr<casacore::ArrayBase> Hdf5Sidecar::GetStatsData(FileInfo::Data ds) {
+    std::string ds_name(DataSetToString(ds, _num_dims));
+    if (IsCountData(ds)) {
+        return ReadStatsData<casacore::Int64>(*_group, ds_name);
+    }
+    if (IsSumData(ds)) {
+        return ReadStatsData<casacore::Double>(*_group, ds_name);
+    }
+    return ReadStatsData<casacore::Float>(*_group, ds_name);
+}
+
+void Hdf5Sidecar::SetFolder(const std::string& folder, size_t swizzle_buffer_size) {
+    std::error_code error_code;
+    if (!folder.empty() && !fs::exists(folder, error_code) && !fs::create_directories(folder, error_code)) {
+        spdlog::warn("Could not create sidecar folder {}: {}", folder, error_code.message());
+        return;
+    }
+    _folder = folder;
+    _swizzle_buffer_size = swizzle_buffer_size;
+}
+
+bool Hdf5Sidecar::Enabled() {
+    return !_folder.empty();
+}
+
+std::string Hdf5Sidecar::GetPath(const std::string& filename, const std::string& hdu, unsigned int modify_time) {
+    if (!Enabled() || filename.empty() || modify_time == 0) {
+        return std::string();
+    }
+
+    // The modify time is part of the name, so a sidecar is never used for a different version of the image
+    std::string selected_hdu = hdu.empty() ? "0" : hdu;
+    size_t id = std::hash<std::string>()(fs::absolute(filename).string() + ":" + selected_hdu);
+    return (fs::path(_folder) / fmt::format("{:016x}_{}_v{}.hdf5", id, modify_time, SIDECAR_VERSION)).string();
+}
+
+void Hdf5Sidecar::Generate(const std::string& filename, const std::string& hdu, unsigned int modify_time) {
+    std::string path = GetPath(filename, hdu, modify_time);
+    if (path.empty()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_generate_mutex);
+    if (_in_progress.count(path) || fs::exists(path)) {
+        return;
+    }
+    _in_progress.insert(path);
+    lock.unlock();
+
+    std::thread([filename, hdu, path]() {
+        RemoveOutdated(path);
+        Write(filename, hdu, path);
+        std::unique_lock<std::mutex> lock(_generate_mutex);
+        _in_progress.erase(path);
+    }).detach();
+}
+
+std::string Hdf5Sidecar::DataSetToString(FileInfo::Data ds, size_t num_dims) {
+    static std::unordered_map<int, std::string> names = {
+        {(int)FileInfo::Data::YX, "SwizzledData/YX"},
+        {(int)FileInfo::Data::ZYX, "SwizzledData/ZYX"},
+        {(int)FileInfo::Data::ZYXW, "SwizzledData/ZYXW"},
+        {(int)FileInfo::Data::STATS, "Statistics"},
+        {(int)FileInfo::Data::STATS_2D, "Statistics/XY"},
+        {(int)FileInfo::Data::STATS_2D_MIN, "Statistics/XY/MIN"},
+        {(int)FileInfo::Data::STATS_2D_MAX, "Statistics/XY/MAX"},
+        {(int)FileInfo::Data::STATS_2D_SUM, "Statistics/XY/SUM"},
+        {(int)FileInfo::Data::STATS_2D_SUMSQ, "Statistics/XY/SUM_SQ"},
+        {(int)FileInfo::Data::STATS_2D_NANS, "Statistics/XY/NAN_COUNT"},
+        {(int)FileInfo::Data::STATS_2D_HIST, "Statistics/XY/HISTOGRAM"},
+        {(int)FileInfo::Data::STATS_3D, "Statistics/XYZ"},
+        {(int)FileInfo::Data::STATS_3D_MIN, "Statistics/XYZ/MIN"},
+        {(int)FileInfo::Data::STATS_3D_MAX, "Statistics/XYZ/MAX"},
+        {(int)FileInfo::Data::STATS_3D_SUM, "Statistics/XYZ/SUM"},
+        {(int)FileInfo::Data::STATS_3D_SUMSQ, "Statistics/XYZ/SUM_SQ"},
+        {(int)FileInfo::Data::STATS_3D_NANS, "Statistics/XYZ/NAN_COUNT"},
+    };
+
+    if (ds == FileInfo::Data::SWIZZLED) {
+        switch (num_dims) {
+            case 3:
+                return names[(int)FileInfo::Data::ZYX];
+            case 4:
+                return names[(int)FileInfo::Data::ZYXW];
+            default:
+                return "";
+        }
+    }
+
+    return (names.find((int)ds) != names.end()) ? names[(int)ds] : "";
+}
+
+template <typename T>
+static void WriteStatsData(const casacore::HDF5Group& group, const std::string& name, const casacore::IPosition& shape, const T* data) {
+    if (shape.empty()) {
+        // Scalar datasets are not handled by casacore
+        casacore::HDF5DataType data_type((T*)0);
+        hid_t space_id = H5Screate(H5S_SCALAR);
+        hid_t data_set_id =
+            H5Dcreate2(group.getHid(), name.c_str(), data_type.getHidFile(), space_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(data_set_id, data_type.getHidMem(), H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+        H5Dclose(data_set_id);
+        H5Sclose(space_id);
+        return;
+    }
+
+    casacore::HDF5DataSet data_set(group, name, shape, shape, (const T*)0);
+    data_set.put(casacore::Slicer(casacore::IPosition(shape.size(), 0), shape), data);
+}
+
+bool Hdf5Sidecar::Write(const std::string& filename, const std::string& hdu, const std::string& path) {
+    // Use a separate loader so that the sidecar does not compete with sessions for the image mutex
+    std::unique_ptr<FileLoader> loader(FileLoader::GetLoader(filename));
+    if (!loader) {
+        return false;
+    }
+
+    std::string temp_path = path + ".tmp";
+    auto t_start_sidecar = std::chrono::high_resolution_clock::now();
+
+    try {
+        loader->OpenFile(hdu);
+
+        casacore::IPosition shape;
+        int spectral_axis, z_axis, stokes_axis;
+        std::string message;
+        if (!loader->FindCoordinateAxes(shape, spectral_axis, z_axis, stokes_axis, message)) {
+            spdlog::debug("Sidecar not written for {}: {}", filename, message);
+            return false;
+        }
+
+        size_t num_dims = shape.size();
+        std::vector<int> render_axes = loader->GetRenderAxes();
+        if ((render_axes[0] != 0) || (render_axes[1] != 1) || (num_dims > 2 && z_axis != 2) || (num_dims > 3 && stokes_axis != 3)) {
+            spdlog::debug("Sidecar not written for {}: unsupported axis order", filename);
+            return false;
+        }
+
+        size_t width = shape(0);
+        size_t height = shape(1);
+        size_t depth = num_dims > 2 ? shape(2) : 1;
+        size_t num_stokes = num_dims > 3 ? shape(3) : 1;
+        size_t plane_size = width * height;
+        int num_bins = int(std::max(sqrt(width * height), 2.0)); // same as Frame::AutoBinSize
+
+        spdlog::info("Writing sidecar for {} to {}", filename, path);
+
+        {
+            casacore::CountedPtr<casacore::HDF5File> file(new casacore::HDF5File(temp_path, casacore::ByteIO::New));
+            casacore::HDF5Group group(*file, SIDECAR_GROUP);
+            casacore::HDF5Group mipmaps_group(group, "MipMaps");
+            casacore::HDF5Group mipmaps_data_group(mipmaps_group, "DATA");
+            casacore::HDF5Group stats_group(group, "Statistics");
+            casacore::HDF5Group stats_2d_group(stats_group, "XY");
+
+            // Mipmaps down to the level where the whole image fits into a single tile
+            std::vector<int> mips;
+            std::vector<std::unique_ptr<casacore::HDF5Lattice<float>>> mip_lattices;
+            for (int mip = 2; (size_t)(mip / 2) * TILE_SIZE < std::max(width, height); mip *= 2) {
+                casacore::IPosition mip_shape(shape);
+                mip_shape(0) = (width - 1) / mip + 1;
+                mip_shape(1) = (height - 1) / mip + 1;
+                casacore::IPosition tile_shape(num_dims, 1);
+                tile_shape(0) = std::min((int)mip_shape(0), TILE_SIZE);
+                tile_shape(1) = std::min((int)mip_shape(1), TILE_SIZE);
+                mips.push_back(mip);
+                mip_lattices.push_back(std::make_unique<casacore::HDF5Lattice<float>>(
+                    casacore::TiledShape(mip_shape, tile_shape), file, fmt::format("MipMaps/DATA/DATA_XY_{}", mip), SIDECAR_GROUP));
+            }
+
+            // Swizzled data for spectral profiles
+            std::unique_ptr<casacore::HDF5Lattice<float>> swizzled_lattice;
+            std::unique_ptr<casacore::HDF5Group> swizzled_group;
+            // Chunks are as deep as CHUNK_SIZE planes; the buffer holds that depth for as many chunk rows as fit (at least one), so
+            // that each chunk is written once. If whole planes fit, they are swizzled as they are read; otherwise row strips are read
+            // again.
+            size_t swizzled_depth = std::min(depth, (size_t)CHUNK_SIZE);
+            size_t swizzled_rows = _swizzle_buffer_size / (swizzled_depth * width) / 8 * 8;
+            swizzled_rows = std::min(height, std::max(swizzled_rows, (size_t)8));
+            bool swizzle_planes = (swizzled_rows == height);
+            if (num_dims > 2 && depth > 1) {
+                swizzled_group = std::make_unique<casacore::HDF5Group>(group, "SwizzledData");
+                casacore::IPosition swizzled_shape(shape);
+                swizzled_shape(0) = depth;
+                swizzled_shape(1) = height;
+                swizzled_shape(2) = width;
+                casacore::IPosition tile_shape(num_dims, 1);
+                tile_shape(0) = swizzled_depth;
+                tile_shape(1) = std::min((int)height, 8); // divides swizzled_rows
+                tile_shape(2) = std::min((int)width, 8);
+                swizzled_lattice = std::make_unique<casacore::HDF5Lattice<float>>(casacore::TiledShape(swizzled_shape, tile_shape), file,
+                    DataSetToString(FileInfo::Data::SWIZZLED, num_dims), SIDECAR_GROUP);
+            }
+
+            // Per-plane and per-cube statistics, z varying fastest
+            size_t num_planes = depth * num_stokes;
+            std::vector<float> min_vals(num_planes), max_vals(num_planes);
+            std::vector<double> sums(num_planes), sums_sq(num_planes);
+            std::vector<casacore::Int64> nan_counts(num_planes), histograms(num_planes * num_bins);
+            std::vector<BasicStats<float>> cube_stats(num_stokes);
+
+            std::vector<float> plane(plane_size);
+            std::vector<float> swizzled;
+            if (swizzled_lattice) {
+                swizzled.resize(swizzled_depth * swizzled_rows * width);
+            }
+            std::vector<float> mip_data;
+
+            // Writes a block of swizzled planes, z varying fastest, then y
+            auto put_swizzled = [&](size_t block_start, size_t block_depth, size_t y_start, size_t num_rows, size_t s) {
+                casacore::IPosition swizzled_start(num_dims, 0);
+                swizzled_start(0) = block_start;
+                swizzled_start(1) = y_start;
+                casacore::IPosition swizzled_count(swizzled_lattice->shape());
+                swizzled_count(0) = block_depth;
+                swizzled_count(1) = num_rows;
+                if (num_dims > 3) {
+                    swizzled_start(3) = s;
+                    swizzled_count(3) = 1;
+                }
+                casacore::Array<float> swizzled_array(swizzled_count, swizzled.data(), casacore::StorageInitPolicy::SHARE);
+                swizzled_lattice->putSlice(swizzled_array, swizzled_start);
+            };
+
+            for (size_t s = 0; s < num_stokes; s++) {
+                for (size_t z = 0; z < depth; z++) {
+                    casacore::IPosition start(num_dims, 0);
+                    casacore::IPosition count(shape);
+                    if (num_dims > 2) {
+                        start(2) = z;
+                        count(2) = 1;
+                    }
+                    if (num_dims > 3) {
+                        start(3) = s;
+                        count(3) = 1;
+                    }
+
+                    casacore::Array<float> plane_array(count, plane.data(), casacore::StorageInitPolicy::SHARE);
+                    if (!loader->GetSlice(plane_array, StokesSlicer(StokesSource(s, AxisRange(z)), casacore::Slicer(start, count)))) {
+                        throw casacore::AipsError("Could not read image plane");
+                    }
+
+                    size_t index = s * depth + z;
+                    BasicStats<float> stats;
+                    CalcBasicStats(stats, plane.data(), plane_size);
+                    min_vals[index] = stats.num_pixels ? stats.min_val : NAN;
+                    max_vals[index] = stats.num_pixels ? stats.max_val : NAN;
+                    sums[index] = stats.sum;
+                    sums_sq[index] = stats.sumSq;
+                    nan_counts[index] = plane_size - stats.num_pixels;
+                    if (stats.num_pixels) {
+                        Histogram histogram = CalcHistogram(num_bins, stats, plane.data(), plane_size);
+                        std::copy(histogram.GetHistogramBins().begin(), histogram.GetHistogramBins().end(),
+                            histograms.begin() + index * num_bins);
+                    }
+                    cube_stats[s].join(stats);
+
+                    for (size_t i = 0; i < mips.size(); i++) {
+                        int mip = mips[i];
+                        casacore::IPosition mip_count(count);
+                        mip_count(0) = (width - 1) / mip + 1;
+                        mip_count(1) = (height - 1) / mip + 1;
+                        mip_data.resize(mip_count(0) * mip_count(1));
+                        BlockSmooth(plane.data(), mip_data.data(), width, height, mip_count(0), mip_count(1), 0, 0, mip);
+                        casacore::Array<float> mip_array(mip_count, mip_data.data(), casacore::StorageInitPolicy::SHARE);
+                        mip_lattices[i]->putSlice(mip_array, start);
+                    }
+
+                    if (swizzled_lattice && swizzle_planes) {
+                        size_t block_start = z - z % swizzled_depth;
+                        size_t block_depth = std::min(swizzled_depth, depth - block_start);
+                        size_t zi = z - block_start;
+                        for (size_t y = 0; y < height; y++) {
+                            for (size_t x = 0; x < width; x++) {
+                                swizzled[zi + block_depth * (y + height * x)] = plane[y * width + x];
+                            }
+                        }
+
+                        if (zi + 1 == block_depth) {
+                            put_swizzled(block_start, block_depth, 0, height, s);
+                        }
+                    }
+                }
+            }
+
+            if (swizzled_lattice && !swizzle_planes) {
+                // Full rows of each block are read, so that reads from row-major images stay contiguous
+                std::vector<float> strip(swizzled.size());
+                for (size_t s = 0; s < num_stokes; s++) {
+                    for (size_t block_start = 0; block_start < depth; block_start += swizzled_depth) {
+                        size_t block_depth = std::min(swizzled_depth, depth - block_start);
+                        for (size_t y_start = 0; y_start < height; y_start += swizzled_rows) {
+                            size_t num_rows = std::min(swizzled_rows, height - y_start);
+                            casacore::IPosition start(num_dims, 0);
+                            start(1) = y_start;
+                            start(2) = block_start;
+                            casacore::IPosition count(shape);
+                            count(1) = num_rows;
+                            count(2) = block_depth;
+                            if (num_dims > 3) {
+                                start(3) = s;
+                                count(3) = 1;
+                            }
+
+                            casacore::Array<float> strip_array(count, strip.data(), casacore::StorageInitPolicy::SHARE);
+                            StokesSource stokes_source(s, AxisRange(block_start, block_start + block_depth - 1));
+                            if (!loader->GetSlice(strip_array, StokesSlicer(stokes_source, casacore::Slicer(start, count)))) {
+                                throw casacore::AipsError("Could not read image rows");
+                            }
+
+                            for (size_t zi = 0; zi < block_depth; zi++) {
+                                for (size_t y = 0; y < num_rows; y++) {
+                                    for (size_t x = 0; x < width; x++) {
+                                        swizzled[zi + block_depth * (y + num_rows * x)] = strip[x + width * (y + num_rows * zi)];
+                                    }
+                                }
+                            }
+                            put_swizzled(block_start, block_depth, y_start, num_rows, s);
+                        }
+                    }
+                }
+            }
+
+            // Shapes follow the IDIA schema: scalar for 2D images, [z] for 3D, [z, stokes] for 4D
+            casacore::IPosition stats_2d_shape;
+            if (num_dims == 3) {
+                stats_2d_shape = casacore::IPosition(1, depth);
+            } else if (num_dims == 4) {
+                stats_2d_shape = casacore::IPosition(2, depth, num_stokes);
+            }
+            casacore::IPosition hist_2d_shape(1, num_bins);
+            hist_2d_shape.append(stats_2d_shape);
+
+            WriteStatsData(group, "Statistics/XY/MIN", stats_2d_shape, min_vals.data());
+            WriteStatsData(group, "Statistics/XY/MAX", stats_2d_shape, max_vals.data());
+            WriteStatsData(group, "Statistics/XY/SUM", stats_2d_shape, sums.data());
+            WriteStatsData(group, "Statistics/XY/SUM_SQ", stats_2d_shape, sums_sq.data());
+            WriteStatsData(group, "Statistics/XY/NAN_COUNT", stats_2d_shape, nan_counts.data());
+            WriteStatsData(group, "Statistics/XY/HISTOGRAM", hist_2d_shape, histograms.data());
+
+            if (num_dims > 2) {
+                casacore::HDF5Group stats_3d_group(stats_group, "XYZ");
+                casacore::IPosition stats_3d_shape = (num_dims == 4) ? casacore::IPosition(1, num_stokes) : casacore::IPosition();
+                std::vector<float> cube_min(num_stokes), cube_max(num_stokes);
+                std::vector<double> cube_sum(num_stokes), cube_sum_sq(num_stokes);
+                std::vector<casacore::Int64> cube_nans(num_stokes);
+                for (size_t s = 0; s < num_stokes; s++) {
+                    cube_min[s] = cube_stats[s].num_pixels ? cube_stats[s].min_val : NAN;
+                    cube_max[s] = cube_stats[s].num_pixels ? cube_stats[s].max_val : NAN;
+                    cube_sum[s] = cube_stats[s].sum;
+                    cube_sum_sq[s] = cube_stats[s].sumSq;
+                    cube_nans[s] = plane_size * depth - cube_stats[s].num_pixels;
+                }
+                WriteStatsData(group, "Statistics/XYZ/MIN", stats_3d_shape, cube_min.data());
+                WriteStatsData(group, "Statistics/XYZ/MAX", stats_3d_shape, cube_max.data());
+                WriteStatsData(group, "Statistics/XYZ/SUM", stats_3d_shape, cube_sum.data());
+                WriteStatsData(group, "Statistics/XYZ/SUM_SQ", stats_3d_shape, cube_sum_sq.data());
+                WriteStatsData(group, "Statistics/XYZ/NAN_COUNT", stats_3d_shape, cube_nans.data());
+            }
+        } // close the file before renaming it
+
+        // Only complete sidecars are ever visible under the final name
+        fs::rename(temp_path, path);
+    } catch (casacore::AipsError& err) {
+        spdlog::warn("Could not write sidecar for {}: {}", filename, err.getMesg());
+        std::error_code error_code;
+        fs::remove(temp_path, error_code);
+        return false;
+    } catch (fs::filesystem_error& err) {
+        spdlog::warn("Could not write sidecar for {}: {}", filename, err.what());
+        return false;
+    }
+
+    auto t_end_sidecar = std::chrono::high_resolution_clock::now();
+    auto dt_sidecar = std::chrono::duration_cast<std::chrono::microseconds>(t_end_sidecar - t_start_sidecar).count();
+    spdlog::performance("Write sidecar for {} in {:.3f} ms", filename, dt_sidecar * 1e-3);
+
+    return true;
+}
+
+void Hdf5Sidecar::RemoveOutdated(const std::string& path) {
+    // Sidecars for older versions of the same image share the prefix before the modify time
+    fs::path sidecar_path(path);
+    std::string prefix = sidecar_path.filename().string();
+    prefix = prefix.substr(0, prefix.find('_') + 1);
+
+    std::error_code error_code;
+    for (auto& entry : fs::directory_iterator(sidecar_path.parent_path(), error_code)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) == 0 && entry.path() != sidecar_path) {
+            fs::remove(entry.path(), error_code);
+        }
+    }
+}
+
+} // namespace carta
@@ -0,0 +1,72 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# Hdf5Sidecar.h: IDIA-schema HDF5 file holding mipmaps, swizzled data and statistics for a FITS, CASA or MIRIAD image
+
+#ifndef CARTA_BACKEND_IMAGEDATA_HDF5SIDECAR_H_
+#define CARTA_BACKEND_IMAGEDATA_HDF5SIDECAR_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <casacore/casa/HDF5/HDF5File.h>
+#include <casacore/casa/HDF5/HDF5Group.h>
+#include <casacore/lattices/Lattices/HDF5Lattice.h>
+
+#include "ImageData/FileInfo.h"
+
+#define SIDECAR_MIN_IMAGE_SIZE_MB 1024
+#define SIDECAR_GROUP "0"
+#define SIDECAR_VERSION 3                     // in the file name; version 3 has swizzled chunks CHUNK_SIZE deep
+#define SIDECAR_SWIZZLE_BUFFER_SIZE 33554432  // pixels of swizzled data buffered before they are written
+
+namespace carta {
+
+// The sidecar does not contain the image data or headers; the original loader is still used for those.
+// Sidecars are only generated for images with x, y, [z, [stokes]] axis order.
+class Hdf5Sidecar {
+public:
+    Hdf5Sidecar(const std::string& path, size_t num_dims);
+
+    bool HasMip(int mip) const;
+    bool HasData(FileInfo::Data ds) const;
+
+    bool GetMipData(casacore::Array<float>& data, const casacore::Slicer& slicer, int mip);
+    bool GetSwizzledData(casacore::Array<float>& data, const casacore::Slicer& slicer);
+    const casacore::IPosition GetStatsDataShape(FileInfo::Data ds);
+    std::unique_ptr<casacore::ArrayBase> GetStatsData(FileInfo::Data ds);
+
+    // Sidecars are disabled unless a folder is set
+    static void SetFolder(const std::string& folder, size_t swizzle_buffer_size = SIDECAR_SWIZZLE_BUFFER_SIZE);
+    static bool Enabled();
+    static std::string GetPath(const std::string& filename, const std::string& hdu, unsigned int modify_time);
+
+    // Write the sidecar in a background thread, unless it is already being written
+    static void Generate(const std::string& filename, const std::string& hdu, unsigned int modify_time);
+
+private:
+    static std::string DataSetToString(FileInfo::Data ds, size_t num_dims);
+    static bool Write(const std::string& filename, const std::string& hdu, const std::string& path);
+    static void RemoveOutdated(const std::string& path);
+
+    casacore::CountedPtr<casacore::HDF5File> _file;
+    std::unique_ptr<casacore::HDF5Group> _group;
+    std::unique_ptr<casacore::HDF5Lattice<float>> _swizzled;
+    std::unordered_map<int, std::unique_ptr<casacore::HDF5Lattice<float>>> _mipmaps;
+    size_t _num_dims;
+
+    static std::string _folder;
+    static size_t _swizzle_buffer_size;
+    static std::mutex _generate_mutex;
+    static std::unordered_set<std::string> _in_progress;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGEDATA_HDF5SIDECAR_H_
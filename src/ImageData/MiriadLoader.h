@@ -21,10 +21,23 @@ public:
     bool CanOpenFile(std::string& error) override;
 
     void OpenFile(const std::string& hdu) override;
+
+    bool UseTileCache() const override;
+
+protected:
+    bool SupportsSidecar() const override;
 };
 
 MiriadLoader::MiriadLoader(const std::string& filename) : FileLoader(filename) {}
 
+bool MiriadLoader::UseTileCache() const {
+    return HasDefaultAxisOrder();
+}
+
+bool MiriadLoader::SupportsSidecar() const {
+    return true;
+}
+
 bool MiriadLoader::CanOpenFile(std::string& error) {
     // Some MIRIAD images throw an error in the miriad libs which cannot be caught in casacore::MIRIADImage, which crashes the backend.
     // If the following checks pass, it should be safe to open the MiriadImage.
@@ -0,0 +1,149 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "BasicStatsCalculator.h"
+
+#include "Util/Simd.h"
+
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace carta {
+
+// Each kernel handles a multiple of its SIMD width and returns the number of values done. Values which are not finite are masked
+// out: val - val is zero for finite values, and NaN for infinities and NaNs. Sums are accumulated in double precision.
+typedef size_t (*BasicStatsFunction)(
+    const float* data, size_t data_size, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares);
+
+// Also used on ARM, where sse2neon translates it to NEON
+static size_t AccumulateBasicStatsSSE(
+    const float* data, size_t data_size, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    const size_t block_limit = 4 * (data_size / 4);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 min_vals = _mm_set1_ps(min_val);
+    __m128 max_vals = _mm_set1_ps(max_val);
+    __m128d sums = _mm_setzero_pd();
+    __m128d sums_squares = _mm_setzero_pd();
+    size_t count = 0;
+    for (size_t i = 0; i < block_limit; i += 4) {
+        __m128 vals = _mm_loadu_ps(data + i);
+        __m128 mask = _mm_cmpeq_ps(_mm_sub_ps(vals, vals), zero);
+        min_vals = _mm_min_ps(min_vals, _mm_blendv_ps(min_vals, vals, mask));
+        max_vals = _mm_max_ps(max_vals, _mm_blendv_ps(max_vals, vals, mask));
+        count += __builtin_popcount(_mm_movemask_ps(mask));
+        vals = _mm_and_ps(vals, mask);
+        __m128d low = _mm_cvtps_pd(vals);
+        __m128d high = _mm_cvtps_pd(_mm_movehl_ps(vals, vals));
+        sums = _mm_add_pd(sums, _mm_add_pd(low, high));
+        sums_squares = _mm_add_pd(sums_squares, _mm_add_pd(_mm_mul_pd(low, low), _mm_mul_pd(high, high)));
+    }
+
+    alignas(16) float min_array[4], max_array[4];
+    alignas(16) double sum_array[2], sum_squares_array[2];
+    _mm_store_ps(min_array, min_vals);
+    _mm_store_ps(max_array, max_vals);
+    _mm_store_pd(sum_array, sums);
+    _mm_store_pd(sum_squares_array, sums_squares);
+    for (int j = 0; j < 4; j++) {
+        min_val = std::min(min_val, min_array[j]);
+        max_val = std::max(max_val, max_array[j]);
+    }
+    num_pixels += count;
+    sum += sum_array[0] + sum_array[1];
+    sum_squares += sum_squares_array[0] + sum_squares_array[1];
+    return block_limit;
+}
+
+#ifdef SIMD_DISPATCH
+SIMD_TARGET_AVX static size_t AccumulateBasicStatsAVX(
+    const float* data, size_t data_size, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    const size_t block_limit = 8 * (data_size / 8);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 min_vals = _mm256_set1_ps(min_val);
+    __m256 max_vals = _mm256_set1_ps(max_val);
+    __m256d sums = _mm256_setzero_pd();
+    __m256d sums_squares = _mm256_setzero_pd();
+    size_t count = 0;
+    for (size_t i = 0; i < block_limit; i += 8) {
+        __m256 vals = _mm256_loadu_ps(data + i);
+        __m256 mask = _mm256_cmp_ps(_mm256_sub_ps(vals, vals), zero, _CMP_EQ_OQ);
+        min_vals = _mm256_min_ps(min_vals, _mm256_blendv_ps(min_vals, vals, mask));
+        max_vals = _mm256_max_ps(max_vals, _mm256_blendv_ps(max_vals, vals, mask));
+        count += __builtin_popcount(_mm256_movemask_ps(mask));
+        vals = _mm256_and_ps(vals, mask);
+        __m256d low = _mm256_cvtps_pd(_mm256_castps256_ps128(vals));
+        __m256d high = _mm256_cvtps_pd(_mm256_extractf128_ps(vals, 1));
+        sums = _mm256_add_pd(sums, _mm256_add_pd(low, high));
+        sums_squares = _mm256_add_pd(sums_squares, _mm256_add_pd(_mm256_mul_pd(low, low), _mm256_mul_pd(high, high)));
+    }
+
+    alignas(32) float min_array[8], max_array[8];
+    alignas(32) double sum_array[4], sum_squares_array[4];
+    _mm256_store_ps(min_array, min_vals);
+    _mm256_store_ps(max_array, max_vals);
+    _mm256_store_pd(sum_array, sums);
+    _mm256_store_pd(sum_squares_array, sums_squares);
+    for (int j = 0; j < 8; j++) {
+        min_val = std::min(min_val, min_array[j]);
+        max_val = std::max(max_val, max_array[j]);
+    }
+    num_pixels += count;
+    sum += (sum_array[0] + sum_array[1]) + (sum_array[2] + sum_array[3]);
+    sum_squares += (sum_squares_array[0] + sum_squares_array[1]) + (sum_squares_array[2] + sum_squares_array[3]);
+    return block_limit;
+}
+
+SIMD_TARGET_AVX512 static size_t AccumulateBasicStatsAVX512(
+    const float* data, size_t data_size, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    const size_t block_limit = 16 * (data_size / 16);
+    const __m512 zero = _mm512_setzero_ps();
+    __m512 min_vals = _mm512_set1_ps(min_val);
+    __m512 max_vals = _mm512_set1_ps(max_val);
+    __m512d sums = _mm512_setzero_pd();
+    __m512d sums_squares = _mm512_setzero_pd();
+    size_t count = 0;
+    for (size_t i = 0; i < block_limit; i += 16) {
+        __m512 vals = _mm512_loadu_ps(data + i);
+        __mmask16 mask = _mm512_cmp_ps_mask(_mm512_sub_ps(vals, vals), zero, _CMP_EQ_OQ);
+        min_vals = _mm512_mask_min_ps(min_vals, mask, min_vals, vals);
+        max_vals = _mm512_mask_max_ps(max_vals, mask, max_vals, vals);
+        count += __builtin_popcount(mask);
+        vals = _mm512_maskz_mov_ps(mask, vals);
+        __m512d low = _mm512_cvtps_pd(_mm512_castps512_ps256(vals));
+        __m512d high = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(vals), 1)));
+        sums = _mm512_add_pd(sums, _mm512_add_pd(low, high));
+        sums_squares = _mm512_add_pd(sums_squares, _mm512_add_pd(_mm512_mul_pd(low, low), _mm512_mul_pd(high, high)));
+    }
+
+    min_val = std::min(min_val, _mm512_reduce_min_ps(min_vals));
+    max_val = std::max(max_val, _mm512_reduce_max_ps(max_vals));
+    num_pixels += count;
+    sum += _mm512_reduce_add_pd(sums);
+    sum_squares += _mm512_reduce_add_pd(sums_squares);
+    return block_limit;
+}
+#endif
+
+void AccumulateBasicStats(
+    const float* data, size_t data_size, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    BasicStatsFunction accumulate = AccumulateBasicStatsSSE;
+#ifdef SIMD_DISPATCH
+    auto simd_level = GetSimdLevel();
+    if (simd_level >= SimdLevel::AVX512) {
+        accumulate = AccumulateBasicStatsAVX512;
+    } else if (simd_level >= SimdLevel::AVX) {
+        accumulate = AccumulateBasicStatsAVX;
+    }
+#endif
+    size_t done = accumulate(data, data_size, min_val, max_val, num_pixels, sum, sum_squares);
+    // Remainder of the chunk
+    AccumulateBasicStats<float>(data + done, data_size - done, min_val, max_val, num_pixels, sum, sum_squares);
+}
+
+} // namespace carta
@@ -8,6 +8,8 @@
 #define CARTA_BACKEND_IMAGESTATS_BASICSTATSCALCULATOR_H_
 
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
 
 namespace carta {
 
@@ -27,10 +29,42 @@ struct BasicStats {
     void join(BasicStats<T>& other);
 };
 
+// Neumaier summation of partial sums. The SIMD kernels sum chunks of values in double precision, which is nearly exact for float
+// data; the chunk sums are added with compensation, so that the sums of planes with billions of values keep double precision.
+struct CompensatedSum {
+    double sum = 0;
+    double compensation = 0;
+
+    void Add(double value) {
+        double total = sum + value;
+        if (std::abs(sum) >= std::abs(value)) {
+            compensation += (sum - total) + value;
+        } else {
+            compensation += (value - total) + sum;
+        }
+        sum = total;
+    }
+    void Add(const CompensatedSum& other) {
+        Add(other.sum);
+        Add(other.compensation);
+    }
+    double Get() const {
+        return sum + compensation;
+    }
+};
+
+// Accumulates the min, max, count, sum and sum of squares of the finite values of a chunk of data. The float version uses SIMD
+// kernels for the instruction set chosen at runtime.
+template <typename T>
+void AccumulateBasicStats(
+    const T* data, size_t data_size, T& min_val, T& max_val, size_t& num_pixels, double& sum, double& sum_squares);
+void AccumulateBasicStats(
+    const float* data, size_t data_size, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares);
+
 template <typename T>
 class BasicStatsCalculator {
     T _min_val, _max_val;
-    double _sum, _sum_squares;
+    CompensatedSum _sum, _sum_squares;
     size_t _num_pixels;
     const T* _data;
     size_t _data_size;
@@ -40,6 +74,8 @@ public:
 
     void join(BasicStatsCalculator& other); // NOLINT
     void reduce();
+    // Adds the values of a chunk of data (in one thread), e.g. while the same data is binned into a histogram
+    void Accumulate(const T* data, size_t data_size);
 
     BasicStats<T> GetStats() const;
 };
@@ -11,6 +11,8 @@
 
 #include <cmath>
 
+#define BASIC_STATS_CHUNK_SIZE 4096 // values accumulated by each call of the SIMD kernel
+
 namespace carta {
 
 template <typename T>
@@ -46,29 +48,52 @@ template <typename T>
 BasicStatsCalculator<T>::BasicStatsCalculator(const T* data, size_t data_size)
     : _min_val(std::numeric_limits<T>::max()),
       _max_val(std::numeric_limits<T>::lowest()),
-      _sum(0),
-      _sum_squares(0),
       _num_pixels(0),
       _data(data),
       _data_size(data_size) {}
 
 template <typename T>
-void BasicStatsCalculator<T>::reduce() {
-    size_t i;
-#pragma omp parallel for private(i) shared(_data) reduction(min: _min_val) reduction(max:_max_val) reduction(+:_num_pixels) reduction(+:_sum) reduction(+:_sum_squares)
-    for (i = 0; i < _data_size; i++) {
-        T val = _data[i];
+void AccumulateBasicStats(
+    const T* data, size_t data_size, T& min_val, T& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    for (size_t i = 0; i < data_size; i++) {
+        T val = data[i];
         if (std::isfinite(val)) {
-            if (val < _min_val) {
-                _min_val = val;
+            if (val < min_val) {
+                min_val = val;
             }
-            if (val > _max_val) {
-                _max_val = val;
+            if (val > max_val) {
+                max_val = val;
             }
-            _num_pixels++;
-            _sum += (double)val;
-            _sum_squares += std::pow(val, 2);
+            num_pixels++;
+            sum += (double)val;
+            sum_squares += std::pow(val, 2);
+        }
+    }
+}
+
+template <typename T>
+void BasicStatsCalculator<T>::Accumulate(const T* data, size_t data_size) {
+    for (size_t i = 0; i < data_size; i += BASIC_STATS_CHUNK_SIZE) {
+        double chunk_sum(0), chunk_sum_squares(0);
+        AccumulateBasicStats(data + i, std::min((size_t)BASIC_STATS_CHUNK_SIZE, data_size - i), _min_val, _max_val, _num_pixels,
+            chunk_sum, chunk_sum_squares);
+        _sum.Add(chunk_sum);
+        _sum_squares.Add(chunk_sum_squares);
+    }
+}
+
+template <typename T>
+void BasicStatsCalculator<T>::reduce() {
+    const int64_t data_size = _data_size;
+#pragma omp parallel
+    {
+        BasicStatsCalculator<T> thread_stats(_data, 0);
+#pragma omp for schedule(static)
+        for (int64_t i = 0; i < data_size; i += BASIC_STATS_CHUNK_SIZE) {
+            thread_stats.Accumulate(_data + i, std::min((int64_t)BASIC_STATS_CHUNK_SIZE, data_size - i));
         }
+#pragma omp critical(basic_stats_reduce)
+        join(thread_stats);
     }
 }
 
@@ -77,27 +102,29 @@ void BasicStatsCalculator<T>::join(BasicStatsCalculator<T>& other) { // NOLINT
     _min_val = std::min(_min_val, other._min_val);
     _max_val = std::max(_max_val, other._max_val);
     _num_pixels += other._num_pixels;
-    _sum += other._sum;
-    _sum_squares += other._sum_squares;
+    _sum.Add(other._sum);
+    _sum_squares.Add(other._sum_squares);
 }
 
 template <typename T>
 BasicStats<T> BasicStatsCalculator<T>::GetStats() const {
+    double sum = _sum.Get();
+    double sum_squares = _sum_squares.Get();
     double mean;
     double stdDev;
     double rms;
 
     if (_num_pixels > 0) {
-        mean = _sum / _num_pixels;
-        stdDev = _num_pixels > 1 ? sqrt((_sum_squares - (_sum * _sum / _num_pixels)) / (_num_pixels - 1)) : NAN;
-        rms = sqrt(_sum_squares / _num_pixels);
+        mean = sum / _num_pixels;
+        stdDev = _num_pixels > 1 ? sqrt((sum_squares - (sum * sum / _num_pixels)) / (_num_pixels - 1)) : NAN;
+        rms = sqrt(sum_squares / _num_pixels);
     } else {
         mean = NAN;
         stdDev = NAN;
         rms = NAN;
     }
 
-    return BasicStats<T>{_num_pixels, _sum, mean, stdDev, _min_val, _max_val, rms, _sum_squares};
+    return BasicStats<T>{_num_pixels, sum, mean, stdDev, _min_val, _max_val, rms, sum_squares};
 }
 
 } // namespace carta
@@ -9,19 +9,132 @@
 #include <omp.h>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <numeric>
 
 #include "Logger/Logger.h"
 #include "ThreadingManager/ThreadingManager.h"
+#include "Util/Simd.h"
+
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#define HISTOGRAM_BLOCK_SIZE 1024 // values binned at a time by each thread
 
 using namespace carta;
 
+// Bin index of each value, or -1 for values outside the histogram range and NaNs. Each kernel handles a multiple of its SIMD width
+// and returns the number of values done.
+typedef size_t (*BinIndexFunction)(
+    const float* data, size_t count, float min_val, float max_val, float bin_width, int32_t num_bins, int32_t* indices);
+
+static size_t BinIndicesScalar(
+    const float* data, size_t count, float min_val, float max_val, float bin_width, int32_t num_bins, int32_t* indices) {
+    const float last_bin = num_bins - 1;
+    for (size_t i = 0; i < count; i++) {
+        float val = data[i];
+        bool in_range = min_val <= val && val <= max_val;
+        float bin = in_range ? (val - min_val) / bin_width : 0.0f;
+        // Also puts the NaN quotients of a zero-width histogram into the last bin
+        bin = bin < last_bin ? bin : last_bin;
+        indices[i] = in_range ? (int32_t)bin : -1;
+    }
+    return count;
+}
+
+// The min instructions return the second operand if either is NaN, as the scalar version does
+static size_t BinIndicesSSE(
+    const float* data, size_t count, float min_val, float max_val, float bin_width, int32_t num_bins, int32_t* indices) {
+    const size_t block_limit = 4 * (count / 4);
+    const __m128 min_vals = _mm_set1_ps(min_val);
+    const __m128 max_vals = _mm_set1_ps(max_val);
+    const __m128 bin_widths = _mm_set1_ps(bin_width);
+    const __m128 last_bin = _mm_set1_ps(num_bins - 1);
+    const __m128i outside = _mm_set1_epi32(-1);
+    for (size_t i = 0; i < block_limit; i += 4) {
+        __m128 vals = _mm_loadu_ps(data + i);
+        __m128 in_range = _mm_and_ps(_mm_cmple_ps(min_vals, vals), _mm_cmple_ps(vals, max_vals));
+        __m128 bins = _mm_and_ps(_mm_div_ps(_mm_sub_ps(vals, min_vals), bin_widths), in_range);
+        __m128i bin_indices = _mm_cvttps_epi32(_mm_min_ps(bins, last_bin));
+        bin_indices = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(outside), _mm_castsi128_ps(bin_indices), in_range));
+        _mm_storeu_si128((__m128i*)(indices + i), bin_indices);
+    }
+    return block_limit;
+}
+
+#ifdef SIMD_DISPATCH
+SIMD_TARGET_AVX static size_t BinIndicesAVX(
+    const float* data, size_t count, float min_val, float max_val, float bin_width, int32_t num_bins, int32_t* indices) {
+    const size_t block_limit = 8 * (count / 8);
+    const __m256 min_vals = _mm256_set1_ps(min_val);
+    const __m256 max_vals = _mm256_set1_ps(max_val);
+    const __m256 bin_widths = _mm256_set1_ps(bin_width);
+    const __m256 last_bin = _mm256_set1_ps(num_bins - 1);
+    const __m256i outside = _mm256_set1_epi32(-1);
+    for (size_t i = 0; i < block_limit; i += 8) {
+        __m256 vals = _mm256_loadu_ps(data + i);
+        __m256 in_range = _mm256_and_ps(_mm256_cmp_ps(min_vals, vals, _CMP_LE_OQ), _mm256_cmp_ps(vals, max_vals, _CMP_LE_OQ));
+        __m256 bins = _mm256_and_ps(_mm256_div_ps(_mm256_sub_ps(vals, min_vals), bin_widths), in_range);
+        __m256i bin_indices = _mm256_cvttps_epi32(_mm256_min_ps(bins, last_bin));
+        bin_indices = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(outside), _mm256_castsi256_ps(bin_indices), in_range));
+        _mm256_storeu_si256((__m256i*)(indices + i), bin_indices);
+    }
+    return block_limit;
+}
+
+SIMD_TARGET_AVX512 static size_t BinIndicesAVX512(
+    const float* data, size_t count, float min_val, float max_val, float bin_width, int32_t num_bins, int32_t* indices) {
+    const size_t block_limit = 16 * (count / 16);
+    const __m512 min_vals = _mm512_set1_ps(min_val);
+    const __m512 max_vals = _mm512_set1_ps(max_val);
+    const __m512 bin_widths = _mm512_set1_ps(bin_width);
+    const __m512 last_bin = _mm512_set1_ps(num_bins - 1);
+    const __m512i outside = _mm512_set1_epi32(-1);
+    for (size_t i = 0; i < block_limit; i += 16) {
+        __m512 vals = _mm512_loadu_ps(data + i);
+        __mmask16 in_range = _mm512_cmp_ps_mask(min_vals, vals, _CMP_LE_OQ) & _mm512_cmp_ps_mask(vals, max_vals, _CMP_LE_OQ);
+        __m512 bins = _mm512_maskz_div_ps(in_range, _mm512_sub_ps(vals, min_vals), bin_widths);
+        __m512i bin_indices = _mm512_mask_cvttps_epi32(outside, in_range, _mm512_min_ps(bins, last_bin));
+        _mm512_storeu_si512(indices + i, bin_indices);
+    }
+    return block_limit;
+}
+#endif
+
+static void BinIndices(const float* data, size_t count, float min_val, float max_val, float bin_width, int32_t num_bins, int32_t* indices) {
+    BinIndexFunction bin_indices = BinIndicesSSE;
+#ifdef SIMD_DISPATCH
+    auto simd_level = GetSimdLevel();
+    if (simd_level >= SimdLevel::AVX512) {
+        bin_indices = BinIndicesAVX512;
+    } else if (simd_level >= SimdLevel::AVX) {
+        bin_indices = BinIndicesAVX;
+    }
+#endif
+    size_t done = bin_indices(data, count, min_val, max_val, bin_width, num_bins, indices);
+    BinIndicesScalar(data + done, count - done, min_val, max_val, bin_width, num_bins, indices + done);
+}
+
 Histogram::Histogram(int num_bins, float min_value, float max_value, const float* data, const size_t data_size)
     : _bin_width((max_value - min_value) / num_bins),
       _min_val(min_value),
       _max_val(max_value),
       _bin_center(min_value + (_bin_width * 0.5)),
       _histogram_bins(num_bins, 0) {
-    Fill(data, data_size);
+    Fill(data, data_size, nullptr);
+}
+
+Histogram::Histogram(
+    int num_bins, float min_value, float max_value, const float* data, const size_t data_size, BasicStats<float>& stats)
+    : _bin_width((max_value - min_value) / num_bins),
+      _min_val(min_value),
+      _max_val(max_value),
+      _bin_center(min_value + (_bin_width * 0.5)),
+      _histogram_bins(num_bins, 0) {
+    Fill(data, data_size, &stats);
 }
 
 Histogram::Histogram(const Histogram& h)
@@ -45,24 +158,38 @@ bool Histogram::Add(const Histogram& h) {
     return true;
 }
 
-void Histogram::Fill(const float* data, const size_t data_size) {
+void Histogram::Fill(const float* data, const size_t data_size, BasicStats<float>* stats) {
     std::vector<int64_t> temp_bins;
     const auto num_elements = data_size;
     const size_t num_bins = GetNbins();
+    BasicStatsCalculator<float> stats_calculator(data, 0);
     ThreadManager::ApplyThreadLimit();
 #pragma omp parallel
     {
         auto num_threads = omp_get_num_threads();
         auto thread_index = omp_get_thread_num();
+        BasicStatsCalculator<float> thread_stats(data, 0);
 #pragma omp single
         { temp_bins.resize(num_bins * num_threads); }
 #pragma omp for
-        for (int64_t i = 0; i < num_elements; i++) {
-            auto val = data[i];
-            if (_min_val <= val && val <= _max_val) {
-                size_t bin_number = std::clamp((size_t)((val - _min_val) / _bin_width), (size_t)0, num_bins - 1);
-                temp_bins[thread_index * num_bins + bin_number]++;
+        for (int64_t block_start = 0; block_start < num_elements; block_start += HISTOGRAM_BLOCK_SIZE) {
+            int32_t indices[HISTOGRAM_BLOCK_SIZE];
+            size_t count = std::min((size_t)HISTOGRAM_BLOCK_SIZE, num_elements - block_start);
+            if (stats) {
+                // The block is still in the L1 cache when it is binned
+                thread_stats.Accumulate(data + block_start, count);
             }
+            BinIndices(data + block_start, count, _min_val, _max_val, _bin_width, num_bins, indices);
+            int64_t* thread_bins = temp_bins.data() + thread_index * num_bins;
+            for (size_t i = 0; i < count; i++) {
+                if (indices[i] >= 0) {
+                    thread_bins[indices[i]]++;
+                }
+            }
+        }
+        if (stats) {
+#pragma omp critical(histogram_stats)
+            stats_calculator.join(thread_stats);
         }
 #pragma omp for
         for (int64_t i = 0; i < num_bins; i++) {
@@ -71,6 +198,10 @@ void Histogram::Fill(const float* data, const size_t data_size) {
             }
         }
     }
+
+    if (stats) {
+        *stats = stats_calculator.GetStats();
+    }
 }
 
 bool Histogram::ConsistencyCheck(const Histogram& a, const Histogram& b) {
@@ -94,3 +225,115 @@ void Histogram::SetHistogramBins(const std::vector<int>& bins) {
     }
     _histogram_bins = bins;
 }
+
+ProvisionalHistogram::ProvisionalHistogram(int num_bins)
+    : _min_val(0), _bin_width(1), _bins((int64_t)std::max(num_bins, 1) * PROVISIONAL_HISTOGRAM_FINE_BINS, 0), _count(0) {}
+
+void ProvisionalHistogram::Fill(const float* data, const size_t data_size, float min_value, float max_value) {
+    if (!(min_value <= max_value)) {
+        return; // no finite values
+    }
+    Widen(min_value, max_value);
+
+    const int64_t num_bins = _bins.size();
+    const double min_val = _min_val;
+    const double inverse_width = 1.0 / _bin_width;
+    int64_t count(0);
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel reduction(+ : count)
+    {
+        std::vector<int64_t> thread_bins(num_bins, 0);
+#pragma omp for
+        for (int64_t i = 0; i < data_size; i++) {
+            float val = data[i];
+            if (std::isfinite(val)) {
+                int64_t bin = (val - min_val) * inverse_width;
+                thread_bins[std::min(std::max(bin, (int64_t)0), num_bins - 1)]++;
+                count++;
+            }
+        }
+#pragma omp critical(provisional_histogram)
+        for (int64_t i = 0; i < num_bins; i++) {
+            _bins[i] += thread_bins[i];
+        }
+    }
+    _count += count;
+}
+
+void ProvisionalHistogram::Widen(double min_value, double max_value) {
+    const int64_t num_bins = _bins.size();
+    if (_count == 0) {
+        _min_val = min_value;
+        _bin_width = (max_value - min_value) / num_bins;
+        if (!(_bin_width > 0)) {
+            _bin_width = std::max(std::fabs(min_value), 1.0) * std::numeric_limits<float>::epsilon();
+        }
+        return;
+    }
+    if (min_value >= _min_val && max_value < _min_val + num_bins * _bin_width) {
+        return;
+    }
+
+    // Shift the bins and merge 2^k of them into one, with the new bin edges on old bin edges, so that each old bin falls into one new
+    // bin. Only the old bins which hold values need to stay within the range.
+    int64_t first_bin(0), last_bin(num_bins - 1);
+    while (_bins[first_bin] == 0) {
+        ++first_bin;
+    }
+    while (_bins[last_bin] == 0) {
+        --last_bin;
+    }
+    min_value = std::min(min_value, _min_val + first_bin * _bin_width);
+
+    int k(-1);
+    int64_t shift(0);
+    double bin_width(_bin_width / 2);
+    double new_min_val(_min_val);
+    do {
+        ++k;
+        bin_width *= 2;
+        shift = std::ceil((_min_val - min_value) / bin_width);
+        new_min_val = _min_val - shift * bin_width;
+    } while ((last_bin >> std::min(k, 62)) + shift >= num_bins || max_value >= new_min_val + num_bins * bin_width);
+
+    std::vector<int64_t> bins(num_bins, 0);
+    for (int64_t i = first_bin; i <= last_bin; i++) {
+        bins[(i >> std::min(k, 62)) + shift] += _bins[i];
+    }
+    _bins.swap(bins);
+    _min_val = new_min_val;
+    _bin_width = bin_width;
+}
+
+Histogram ProvisionalHistogram::GetHistogram(int num_bins, float min_value, float max_value) const {
+    Histogram histogram(num_bins, min_value, max_value, nullptr, 0);
+    std::vector<int> bins(num_bins, 0);
+    if (_count > 0) {
+        if (!(max_value > min_value)) {
+            // Histogram puts the values of a zero-width range into the last bin
+            bins.back() = _count;
+        } else {
+            std::vector<int64_t> cumulative_counts(_bins.size() + 1, 0);
+            std::partial_sum(_bins.begin(), _bins.end(), cumulative_counts.begin() + 1);
+
+            // Number of values below x, with the values of each fine bin spread evenly across it
+            const int64_t last_bin = _bins.size() - 1;
+            auto count_below = [&](double x) {
+                double position = std::min(std::max((x - _min_val) / _bin_width, 0.0), (double)_bins.size());
+                int64_t bin = std::min((int64_t)position, last_bin);
+                return (int64_t)std::llround(cumulative_counts[bin] + (position - bin) * _bins[bin]);
+            };
+
+            const double bin_width = histogram.GetBinWidth();
+            int64_t previous_count(0);
+            for (int i = 0; i < num_bins - 1; i++) {
+                int64_t count = count_below(min_value + (i + 1) * bin_width);
+                bins[i] = count - previous_count;
+                previous_count = count;
+            }
+            bins.back() = _count - previous_count;
+        }
+    }
+    histogram.SetHistogramBins(bins);
+    return histogram;
+}
@@ -8,8 +8,13 @@
 #define CARTA_BACKEND_IMAGESTATS_HISTOGRAM_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
+#include "BasicStatsCalculator.h"
+
+#define PROVISIONAL_HISTOGRAM_FINE_BINS 64 // provisional bins per histogram bin
+
 namespace carta {
 
 class Histogram {
@@ -19,12 +24,15 @@ class Histogram {
     float _bin_center;                // bin center
     std::vector<int> _histogram_bins; // histogram bin counts
 
-    void Fill(const float* data, const size_t data_size);
+    void Fill(const float* data, const size_t data_size, BasicStats<float>* stats);
     static bool ConsistencyCheck(const Histogram&, const Histogram&);
 
 public:
     Histogram() = default; // required to create empty histograms used in references
     Histogram(int num_bins, float min_value, float max_value, const float* data, const size_t data_size);
+    // If the range is known in advance (e.g. the range of a cube when binning a plane), the basic stats of the data are calculated
+    // while it is binned, instead of in a separate pass
+    Histogram(int num_bins, float min_value, float max_value, const float* data, const size_t data_size, BasicStats<float>& stats);
 
     Histogram(const Histogram& h);
 
@@ -52,6 +60,25 @@ public:
     void SetHistogramBins(const std::vector<int>&);
 };
 
+// Histogram of data whose range is only known at the end, e.g. of a cube whose planes are read once. The values are counted in fine
+// bins over a range which is widened as needed by merging bins, and are rebinned into a Histogram when the range is known; fine bins
+// which straddle a histogram bin edge are split in proportion to the overlap.
+class ProvisionalHistogram {
+    double _min_val;            // lower edge of the fine bins
+    double _bin_width;          // fine bin width
+    std::vector<int64_t> _bins; // fine bin counts
+    int64_t _count;             // number of values counted
+
+    void Widen(double min_value, double max_value);
+
+public:
+    ProvisionalHistogram(int num_bins = 1);
+
+    // Adds the finite values of the data, which lie within [min_value, max_value]
+    void Fill(const float* data, const size_t data_size, float min_value, float max_value);
+    Histogram GetHistogram(int num_bins, float min_value, float max_value) const;
+};
+
 } // namespace carta
 
 #endif // CARTA_BACKEND_IMAGESTATS_HISTOGRAM_H_
@@ -0,0 +1,162 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# QuantileSketch.cc: mergeable t-digest of the values of an image plane, for percentiles without sorting the data
+
+#include "QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <omp.h>
+
+#include "ThreadingManager/ThreadingManager.h"
+
+namespace carta {
+
+// Scale function k(q) = compression / (2 pi) * asin(2q - 1); a centroid spans at most one unit of k
+static double QuantileToScale(double quantile) {
+    return QUANTILE_SKETCH_COMPRESSION / (2 * M_PI) * std::asin(std::min(std::max(2 * quantile - 1, -1.0), 1.0));
+}
+
+static double ScaleToQuantile(double scale) {
+    return (std::sin(std::min(scale * 2 * M_PI / QUANTILE_SKETCH_COMPRESSION, M_PI / 2)) + 1) / 2;
+}
+
+static bool CompareMeans(const QuantileSketch::Centroid& a, const QuantileSketch::Centroid& b) {
+    return a.mean < b.mean;
+}
+
+QuantileSketch::QuantileSketch()
+    : _count(0), _min_val(std::numeric_limits<float>::max()), _max_val(std::numeric_limits<float>::lowest()) {}
+
+QuantileSketch::QuantileSketch(const std::vector<Centroid>& centroids, float min_value, float max_value)
+    : _centroids(centroids), _count(0), _min_val(min_value), _max_val(max_value) {
+    for (auto& centroid : _centroids) {
+        _count += centroid.weight;
+    }
+}
+
+void QuantileSketch::Add(const float* data, const size_t data_size, float min_value, float max_value) {
+    if (!(min_value <= max_value)) {
+        return; // no finite values
+    }
+    _min_val = std::min(_min_val, min_value);
+    _max_val = std::max(_max_val, max_value);
+
+    std::vector<QuantileSketch> thread_sketches;
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel
+    {
+        auto num_threads = omp_get_num_threads();
+        auto thread_index = omp_get_thread_num();
+#pragma omp single
+        { thread_sketches.resize(num_threads); }
+        std::vector<Centroid> values;
+        values.reserve(QUANTILE_SKETCH_CHUNK_SIZE);
+#pragma omp for schedule(static)
+        for (int64_t start = 0; start < (int64_t)data_size; start += QUANTILE_SKETCH_CHUNK_SIZE) {
+            size_t end = std::min((size_t)start + QUANTILE_SKETCH_CHUNK_SIZE, data_size);
+            values.clear();
+            for (size_t i = start; i < end; ++i) {
+                if (std::isfinite(data[i])) {
+                    values.push_back({data[i], 1});
+                }
+            }
+            std::sort(values.begin(), values.end(), CompareMeans);
+            thread_sketches[thread_index].Compress(values);
+        }
+    }
+
+    // Merged in order of the threads, which hold consecutive chunks with a static schedule
+    for (auto& thread_sketch : thread_sketches) {
+        if (!thread_sketch._centroids.empty()) {
+            Compress(thread_sketch._centroids);
+        }
+    }
+}
+
+void QuantileSketch::Merge(const QuantileSketch& other) {
+    if (other._centroids.empty()) {
+        return;
+    }
+    _min_val = std::min(_min_val, other._min_val);
+    _max_val = std::max(_max_val, other._max_val);
+    std::vector<Centroid> centroids(other._centroids);
+    Compress(centroids);
+}
+
+void QuantileSketch::Compress(std::vector<Centroid>& centroids) {
+    std::vector<Centroid> merged(_centroids.size() + centroids.size());
+    std::merge(_centroids.begin(), _centroids.end(), centroids.begin(), centroids.end(), merged.begin(), CompareMeans);
+    _centroids.clear();
+    if (merged.empty()) {
+        return;
+    }
+
+    double total(0);
+    for (auto& centroid : merged) {
+        total += centroid.weight;
+    }
+
+    // Adjacent centroids are combined while the combined centroid spans less than one unit of the scale function
+    double weight_before(0);
+    double quantile_limit = ScaleToQuantile(QuantileToScale(0) + 1) * total;
+    Centroid current = merged[0];
+    for (size_t i = 1; i < merged.size(); ++i) {
+        auto& next = merged[i];
+        if (weight_before + current.weight + next.weight <= quantile_limit) {
+            current.mean += (next.mean - current.mean) * next.weight / (current.weight + next.weight);
+            current.weight += next.weight;
+        } else {
+            weight_before += current.weight;
+            _centroids.push_back(current);
+            quantile_limit = ScaleToQuantile(QuantileToScale(weight_before / total) + 1) * total;
+            current = next;
+        }
+    }
+    _centroids.push_back(current);
+    _count = total;
+}
+
+float QuantileSketch::GetQuantile(double quantile) const {
+    if (_centroids.empty()) {
+        return NAN;
+    }
+    const double target = std::min(std::max(quantile, 0.0), 1.0) * _count;
+
+    // Interpolate between the centroid means, which lie at the centres of their weights, and the extremes at 0 and the count
+    double previous_center(0);
+    double previous_mean(_min_val);
+    double weight_before(0);
+    for (auto& centroid : _centroids) {
+        double center = weight_before + centroid.weight / 2;
+        if (target < center) {
+            double fraction = (target - previous_center) / (center - previous_center);
+            return previous_mean + fraction * (centroid.mean - previous_mean);
+        }
+        previous_center = center;
+        previous_mean = centroid.mean;
+        weight_before += centroid.weight;
+    }
+    if (_count <= previous_center) {
+        return _max_val;
+    }
+    double fraction = (target - previous_center) / (_count - previous_center);
+    return previous_mean + fraction * (_max_val - previous_mean);
+}
+
+std::vector<float> QuantileSketch::GetPercentiles(const std::vector<float>& ranks) const {
+    std::vector<float> percentiles;
+    percentiles.reserve(ranks.size());
+    for (float rank : ranks) {
+        percentiles.push_back(GetQuantile(rank / 100.0));
+    }
+    return percentiles;
+}
+
+} // namespace carta
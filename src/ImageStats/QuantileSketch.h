@@ -0,0 +1,66 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# QuantileSketch.h: mergeable t-digest of the values of an image plane, for percentiles without sorting the data
+
+#ifndef CARTA_BACKEND_IMAGESTATS_QUANTILESKETCH_H_
+#define CARTA_BACKEND_IMAGESTATS_QUANTILESKETCH_H_
+
+#include <cstddef>
+#include <vector>
+
+#define QUANTILE_SKETCH_COMPRESSION 200   // t-digest compression; the digest keeps at most about this many centroids
+#define QUANTILE_SKETCH_CHUNK_SIZE 65536  // values which are sorted and merged into the digest at once
+
+namespace carta {
+
+// Merging t-digest with the arcsine scale function, so that the centroids near the extremes hold few values and high percentiles
+// (e.g. for 99.9% clip levels) are accurate. Sketches of planes are merged into a sketch of the cube.
+class QuantileSketch {
+public:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    QuantileSketch();
+    QuantileSketch(const std::vector<Centroid>& centroids, float min_value, float max_value);
+
+    // Adds all finite values of the data, which lie within [min_value, max_value]. Chunks of the data are sorted and merged into
+    // digests by the OpenMP threads, which are then merged into this sketch.
+    void Add(const float* data, const size_t data_size, float min_value, float max_value);
+    void Merge(const QuantileSketch& other);
+
+    // Quantile in [0, 1]; NaN if no values were added
+    float GetQuantile(double quantile) const;
+    // Ranks in percent, as the percentile ranks of HDF5 images
+    std::vector<float> GetPercentiles(const std::vector<float>& ranks) const;
+
+    double GetCount() const {
+        return _count;
+    }
+    float GetMinVal() const {
+        return _min_val;
+    }
+    float GetMaxVal() const {
+        return _max_val;
+    }
+    const std::vector<Centroid>& GetCentroids() const {
+        return _centroids;
+    }
+
+private:
+    // Merges the centroids, sorted by mean, into _centroids
+    void Compress(std::vector<Centroid>& centroids);
+
+    std::vector<Centroid> _centroids; // sorted by mean
+    double _count;                    // total weight
+    float _min_val, _max_val;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGESTATS_QUANTILESKETCH_H_
@@ -0,0 +1,116 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# RegionStatsCalculator.cc: statistics of the pixels of a region in each xy plane of its bounding box
+
+#include "RegionStatsCalculator.h"
+
+#include <cmath>
+#include <vector>
+
+namespace carta {
+
+void RegionStats::Join(const RegionStats& other) {
+    // The first position is kept for equal values
+    if (other.num_pixels && (other.min_val < min_val || !num_pixels)) {
+        min_val = other.min_val;
+        min_index = other.min_index;
+    }
+    if (other.num_pixels && (other.max_val > max_val || !num_pixels)) {
+        max_val = other.max_val;
+        max_index = other.max_index;
+    }
+    num_pixels += other.num_pixels;
+    nan_count += other.nan_count;
+    sum.Add(other.sum);
+    sum_squares.Add(other.sum_squares);
+}
+
+double RegionStats::Mean() const {
+    return num_pixels ? sum.Get() / num_pixels : NAN;
+}
+
+double RegionStats::Sigma() const {
+    // Sample standard deviation, zero for a single value as in casacore
+    if (!num_pixels) {
+        return NAN;
+    }
+    if (num_pixels == 1) {
+        return 0;
+    }
+    double total = sum.Get();
+    return sqrt(std::max(sum_squares.Get() - (total * total / num_pixels), 0.0) / (num_pixels - 1));
+}
+
+double RegionStats::Rms() const {
+    return num_pixels ? sqrt(sum_squares.Get() / num_pixels) : NAN;
+}
+
+float RegionStats::Extrema() const {
+    return num_pixels ? (std::abs(min_val) > std::abs(max_val) ? min_val : max_val) : NAN;
+}
+
+void CalcRegionStats(const float* data, const bool* mask, size_t plane_size, size_t num_planes, size_t index_offset, bool find_positions,
+    RegionStats* stats) {
+    if (!plane_size || !num_planes) {
+        return;
+    }
+
+    // Chunks do not cross planes, so that each plane of a spectral profile is parallelized as well as a large single plane
+    const size_t chunks_per_plane = (plane_size + BASIC_STATS_CHUNK_SIZE - 1) / BASIC_STATS_CHUNK_SIZE;
+    const int64_t num_chunks = chunks_per_plane * num_planes;
+    std::vector<RegionStats> chunk_stats(num_chunks);
+
+#pragma omp parallel
+    {
+        std::vector<float> masked_data(mask ? BASIC_STATS_CHUNK_SIZE : 0);
+#pragma omp for schedule(static)
+        for (int64_t chunk = 0; chunk < num_chunks; ++chunk) {
+            size_t plane = chunk / chunks_per_plane;
+            size_t start = plane * plane_size + (chunk % chunks_per_plane) * BASIC_STATS_CHUNK_SIZE;
+            size_t size = std::min((size_t)BASIC_STATS_CHUNK_SIZE, (plane + 1) * plane_size - start);
+            const float* values = data + start;
+            size_t region_size = size;
+
+            // Pixels outside the region are set to NaN, which the kernels skip
+            if (mask) {
+                const bool* chunk_mask = mask + start;
+                region_size = 0;
+                for (size_t i = 0; i < size; ++i) {
+                    masked_data[i] = chunk_mask[i] ? values[i] : NAN;
+                    region_size += chunk_mask[i];
+                }
+                values = masked_data.data();
+            }
+
+            auto& chunk_result = chunk_stats[chunk];
+            double sum(0), sum_squares(0);
+            AccumulateBasicStats(values, size, chunk_result.min_val, chunk_result.max_val, chunk_result.num_pixels, sum, sum_squares);
+            chunk_result.sum.Add(sum);
+            chunk_result.sum_squares.Add(sum_squares);
+            chunk_result.nan_count = region_size - chunk_result.num_pixels;
+
+            // The kernels only find the values; a second scan of the chunk, which is in cache, finds their first positions
+            if (find_positions && chunk_result.num_pixels) {
+                for (size_t i = 0; i < size && (chunk_result.min_index < 0 || chunk_result.max_index < 0); ++i) {
+                    if (chunk_result.min_index < 0 && values[i] == chunk_result.min_val) {
+                        chunk_result.min_index = index_offset + start + i;
+                    }
+                    if (chunk_result.max_index < 0 && values[i] == chunk_result.max_val) {
+                        chunk_result.max_index = index_offset + start + i;
+                    }
+                }
+            }
+        }
+    }
+
+    // Joined in order of the chunks, so that the results do not depend on the number of threads
+    for (int64_t chunk = 0; chunk < num_chunks; ++chunk) {
+        stats[chunk / chunks_per_plane].Join(chunk_stats[chunk]);
+    }
+}
+
+} // namespace carta
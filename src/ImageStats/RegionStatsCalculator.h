@@ -0,0 +1,48 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# RegionStatsCalculator.h: statistics of the pixels of a region in each xy plane of its bounding box
+
+#ifndef CARTA_BACKEND_IMAGESTATS_REGIONSTATSCALCULATOR_H_
+#define CARTA_BACKEND_IMAGESTATS_REGIONSTATSCALCULATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "BasicStatsCalculator.h"
+
+namespace carta {
+
+// Stats of the finite values of the pixels in a region. Positions are indices of the first min and max values in the bounding box
+// of the region, or -1 if they were not found.
+struct RegionStats {
+    size_t num_pixels = 0;
+    size_t nan_count = 0; // pixels in the region which are not finite
+    CompensatedSum sum, sum_squares;
+    float min_val = std::numeric_limits<float>::max();
+    float max_val = std::numeric_limits<float>::lowest();
+    int64_t min_index = -1;
+    int64_t max_index = -1;
+
+    // Joins the stats of pixels which follow these pixels in the bounding box
+    void Join(const RegionStats& other);
+
+    double Mean() const;
+    double Sigma() const;
+    double Rms() const;
+    float Extrema() const;
+};
+
+// Adds the stats of each of num_planes consecutive xy planes of data to stats[0..num_planes). Pixels are in the region where the mask
+// is true; a null mask selects all pixels. index_offset is the index of the first pixel of the data in the bounding box. Chunks of the
+// planes are accumulated in parallel with the SIMD kernels of the basic stats.
+void CalcRegionStats(const float* data, const bool* mask, size_t plane_size, size_t num_planes, size_t index_offset, bool find_positions,
+    RegionStats* stats);
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGESTATS_REGIONSTATSCALCULATOR_H_
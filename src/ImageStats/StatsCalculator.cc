@@ -14,6 +14,8 @@
 #include <casacore/casa/Arrays/ArrayMath.h>
 #include <casacore/images/Images/ImageStatistics.h>
 
+#include "RegionStatsCalculator.h"
+
 namespace carta {
 
 void CalcBasicStats(BasicStats<float>& stats, const float* data, const size_t data_size) {
@@ -24,7 +26,7 @@ void CalcBasicStats(BasicStats<float>& stats, const float* data, const size_t da
 }
 
 Histogram CalcHistogram(int num_bins, const BasicStats<float>& stats, const float* data, const size_t data_size) {
-    if ((stats.min_val == std::numeric_limits<float>::max()) || (stats.max_val == std::numeric_limits<float>::min()) || data_size == 0) {
+    if ((stats.min_val == std::numeric_limits<float>::max()) || (stats.max_val == std::numeric_limits<float>::lowest()) || data_size == 0) {
         // empty / NaN region
         return Histogram(1, 0, 0, data, data_size);
     } else {
@@ -32,6 +34,17 @@ Histogram CalcHistogram(int num_bins, const BasicStats<float>& stats, const floa
     }
 }
 
+Histogram CalcHistogram(
+    int num_bins, const BasicStats<float>& range_stats, const float* data, const size_t data_size, BasicStats<float>& stats) {
+    if ((range_stats.min_val == std::numeric_limits<float>::max()) || (range_stats.max_val == std::numeric_limits<float>::lowest()) ||
+        data_size == 0) {
+        CalcBasicStats(stats, data, data_size);
+        return Histogram(1, 0, 0, data, data_size);
+    } else {
+        return Histogram(num_bins, range_stats.min_val, range_stats.max_val, data, data_size, stats);
+    }
+}
+
 bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values, const std::vector<CARTA::StatsType>& requested_stats,
     const casacore::ImageInterface<float>& image, bool per_channel) {
     // Use ImageStatistics to fill statistics values according to type;
@@ -173,4 +186,189 @@ bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_valu
 
     return true;
 }
+
+bool CalcRegionStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values,
+    const std::vector<CARTA::StatsType>& requested_stats, const casacore::ImageInterface<float>& image, bool per_channel,
+    size_t block_size) {
+    bool find_positions(false);
+    double beam_area(NAN);
+    for (auto carta_stats_type : requested_stats) {
+        if (carta_stats_type == CARTA::StatsType::MinPos || carta_stats_type == CARTA::StatsType::MaxPos) {
+            find_positions = !per_channel;
+        } else if (carta_stats_type == CARTA::StatsType::FluxDensity) {
+            // Other brightness units and beams are converted by ImageStatistics
+            auto& image_info = image.imageInfo();
+            casacore::String unit(image.units().getName());
+            unit.upcase();
+            if (unit != "JY/BEAM" || !image_info.hasSingleBeam() || !image.coordinates().hasDirectionCoordinate()) {
+                return false;
+            }
+            beam_area = image_info.getBeamAreaInPixels(-1, -1, image.coordinates().directionCoordinate());
+            if (!std::isfinite(beam_area) || beam_area <= 0) {
+                return false;
+            }
+        }
+    }
+
+    const casacore::IPosition image_shape(image.shape());
+    if (image_shape.size() < 2 || image_shape.product() == 0) {
+        return false;
+    }
+    const size_t width = image_shape(0);
+    const size_t height = image_shape(1);
+    const size_t plane_size = width * height;
+    const size_t num_planes = image_shape.product() / plane_size;
+    const size_t depth = image_shape.size() > 2 ? image_shape(2) : 1;
+    const size_t block_planes = std::max((size_t)1, block_size / plane_size);
+    // Planes larger than a block are read in blocks of rows, so that memory is bounded for any plane size
+    const size_t block_rows = plane_size > block_size ? std::max((size_t)1, block_size / width) : height;
+    std::vector<RegionStats> plane_stats(num_planes);
+
+    try {
+        // Blocks of planes along the third axis; the planes of the other axes are in the order of the ImageStatistics results
+        for (size_t plane = 0; plane < num_planes;) {
+            casacore::IPosition start(image_shape.size(), 0);
+            casacore::IPosition length(image_shape);
+            size_t index(plane);
+            for (size_t axis = 2; axis < image_shape.size(); ++axis) {
+                start(axis) = index % image_shape(axis);
+                index /= image_shape(axis);
+                length(axis) = 1;
+            }
+            size_t count = std::min(block_planes, depth - (plane % depth));
+            if (image_shape.size() > 2) {
+                length(2) = count;
+            }
+
+            // The stats of the row blocks of a plane are joined in order
+            for (size_t row = 0; row < height; row += block_rows) {
+                start(1) = row;
+                length(1) = std::min(block_rows, height - row);
+                casacore::Slicer slicer(start, length);
+
+                casacore::Array<float> data = image.getSlice(slicer);
+                bool delete_data;
+                const float* data_storage = data.getStorage(delete_data);
+
+                casacore::Array<bool> mask;
+                bool delete_mask(false);
+                const bool* mask_storage(nullptr);
+                if (image.isMasked()) {
+                    mask = image.getMaskSlice(slicer);
+                    mask_storage = mask.getStorage(delete_mask);
+                }
+
+                CalcRegionStats(data_storage, mask_storage, length(1) * width, count, plane * plane_size + row * width, find_positions,
+                    &plane_stats[plane]);
+
+                data.freeStorage(data_storage, delete_data);
+                if (mask_storage) {
+                    mask.freeStorage(mask_storage, delete_mask);
+                }
+            }
+            plane += count;
+        }
+    } catch (const casacore::AipsError& err) {
+        return false;
+    }
+
+    if (!per_channel) {
+        for (size_t plane = 1; plane < num_planes; ++plane) {
+            plane_stats[0].Join(plane_stats[plane]);
+        }
+        plane_stats.resize(1);
+    }
+
+    std::map<CARTA::StatsType, std::vector<double>> results;
+    for (auto carta_stats_type : requested_stats) {
+        std::vector<double> values;
+        switch (carta_stats_type) {
+            case CARTA::StatsType::Blc:
+            case CARTA::StatsType::Trc: {
+                const casacore::Slicer& region_slicer = image.region().slicer();
+                casacore::IPosition corner(carta_stats_type == CARTA::StatsType::Blc ? region_slicer.start() : region_slicer.end());
+                for (auto value : corner.asStdVector()) {
+                    values.push_back(value);
+                }
+                break;
+            }
+            case CARTA::StatsType::MinPos:
+            case CARTA::StatsType::MaxPos: {
+                int64_t index = carta_stats_type == CARTA::StatsType::MinPos ? plane_stats[0].min_index : plane_stats[0].max_index;
+                if (find_positions && index >= 0) {
+                    const casacore::IPosition blc(image.region().slicer().start());
+                    casacore::IPosition position(casacore::toIPositionInArray(index, image_shape));
+                    for (size_t axis = 0; axis < position.size(); ++axis) {
+                        values.push_back(blc(axis) + position(axis));
+                    }
+                }
+                break;
+            }
+            case CARTA::StatsType::NumPixels:
+            case CARTA::StatsType::NanCount:
+            case CARTA::StatsType::Sum:
+            case CARTA::StatsType::FluxDensity:
+            case CARTA::StatsType::Mean:
+            case CARTA::StatsType::RMS:
+            case CARTA::StatsType::Sigma:
+            case CARTA::StatsType::SumSq:
+            case CARTA::StatsType::Min:
+            case CARTA::StatsType::Max:
+            case CARTA::StatsType::Extrema: {
+                for (auto& stats : plane_stats) {
+                    double value(NAN); // as ImageStatistics, NaN if there are no pixels
+                    switch (carta_stats_type) {
+                        case CARTA::StatsType::NumPixels:
+                            value = stats.num_pixels ? stats.num_pixels : NAN;
+                            break;
+                        case CARTA::StatsType::NanCount:
+                            value = stats.nan_count;
+                            break;
+                        case CARTA::StatsType::Sum:
+                            value = stats.num_pixels ? stats.sum.Get() : NAN;
+                            break;
+                        case CARTA::StatsType::FluxDensity:
+                            value = stats.num_pixels ? stats.sum.Get() / beam_area : NAN;
+                            break;
+                        case CARTA::StatsType::Mean:
+                            value = stats.Mean();
+                            break;
+                        case CARTA::StatsType::RMS:
+                            value = stats.Rms();
+                            break;
+                        case CARTA::StatsType::Sigma:
+                            value = stats.Sigma();
+                            break;
+                        case CARTA::StatsType::SumSq:
+                            value = stats.num_pixels ? stats.sum_squares.Get() : NAN;
+                            break;
+                        case CARTA::StatsType::Min:
+                            value = stats.num_pixels ? stats.min_val : NAN;
+                            break;
+                        case CARTA::StatsType::Max:
+                            value = stats.num_pixels ? stats.max_val : NAN;
+                            break;
+                        case CARTA::StatsType::Extrema:
+                            value = stats.Extrema();
+                            break;
+                        default:
+                            break;
+                    }
+                    values.push_back(value);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (!values.empty()) {
+            results.emplace(carta_stats_type, values);
+        }
+    }
+
+    stats_values.insert(results.begin(), results.end());
+    return true;
+}
+
 } // namespace carta
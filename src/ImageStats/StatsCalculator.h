@@ -17,14 +17,25 @@
 #include "BasicStatsCalculator.h"
 #include "Histogram.h"
 
+#define REGION_STATS_BLOCK_SIZE 16777216 // pixels read from the image at a time for region stats
+
 namespace carta {
 
 void CalcBasicStats(BasicStats<float>& stats, const float* data, const size_t data_size);
 
 Histogram CalcHistogram(int num_bins, const BasicStats<float>& stats, const float* data, const size_t data_size);
+// Histogram in the range of range_stats, which also calculates the stats of the data
+Histogram CalcHistogram(
+    int num_bins, const BasicStats<float>& range_stats, const float* data, const size_t data_size, BasicStats<float>& stats);
 
 bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values, const std::vector<CARTA::StatsType>& requested_stats,
     const casacore::ImageInterface<float>& image, bool per_channel = true);
+// Same stats as CalcStatsValues, and the NaN count, from the data and mask of the image read in blocks of at most block_size pixels:
+// several planes, or rows of a larger plane. Returns false without results if a stat cannot be calculated natively, e.g. the flux
+// density of an image which is not in Jy/beam with a single beam.
+bool CalcRegionStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values,
+    const std::vector<CARTA::StatsType>& requested_stats, const casacore::ImageInterface<float>& image, bool per_channel = true,
+    size_t block_size = REGION_STATS_BLOCK_SIZE);
 
 } // namespace carta
 
@@ -9,14 +9,19 @@
 
 #include <signal.h>
 
+#include "Cache/BufferPool.h"
+#include "Cache/DiskStatsCache.h"
+#include "Cache/SharedImageCache.h"
 #include "FileList/FileListHandler.h"
 #include "HttpServer/HttpServer.h"
+#include "ImageData/Hdf5Sidecar.h"
 #include "Logger/Logger.h"
 #include "ProgramSettings.h"
 #include "Session/SessionManager.h"
 #include "ThreadingManager/ThreadingManager.h"
 #include "Util/App.h"
 #include "Util/FileSystem.h"
+#include "Util/Simd.h"
 #include "Util/Token.h"
 #include "WebBrowser.h"
 
@@ -60,6 +65,22 @@ int main(int argc, char* argv[]) {
             Session::SetInitExitTimeout(settings.init_wait_time);
         }
 
+        if (settings.shared_cache_size >= 0) {
+            carta::SharedImageCache::SetCapacity(settings.shared_cache_size);
+        }
+
+        if (settings.huge_pages) {
+            carta::BufferPoolBase::SetHugePages(true);
+        }
+
+        if (!settings.sidecar_folder.empty()) {
+            carta::Hdf5Sidecar::SetFolder(settings.sidecar_folder);
+        }
+
+        if (!settings.no_stats_cache) {
+            carta::DiskStatsCache::SetFolder((settings.user_directory / DISK_STATS_CACHE_FOLDER).string());
+        }
+
         std::string executable_path;
         bool have_executable_path(FindExecutablePath(executable_path));
 
@@ -88,6 +109,7 @@ int main(int argc, char* argv[]) {
 
         carta::ThreadManager::StartEventHandlingThreads(settings.event_thread_count);
         carta::ThreadManager::SetThreadLimit(settings.omp_thread_count);
+        spdlog::debug("Using {} kernels", carta::SimdLevelName(carta::GetSimdLevel()));
 
         // One FileListHandler works for all sessions.
         file_list_handler = std::make_shared<FileListHandler>(settings.top_level_folder, settings.starting_folder);
@@ -14,6 +14,9 @@
 
 #include <casacore/images/Images/ImageOpener.h>
 
+#include "Cache/DiskStatsCache.h"
+#include "Cache/SharedImageCache.h"
+#include "ImageData/Hdf5Sidecar.h"
 #include "Util/App.h"
 
 using json = nlohmann::json;
@@ -188,6 +191,10 @@ void ProgramSettings::ApplyCommandLineSettings(int argc, char** argv) {
         ("exit_timeout", "number of seconds to stay alive after last session exits", cxxopts::value<int>(), "<sec>")
         ("initial_timeout", "number of seconds to stay alive at start if no clients connect", cxxopts::value<int>(), "<sec>")
         ("idle_timeout", "number of seconds to keep idle sessions alive", cxxopts::value<int>(), "<sec>")
+        ("shared_cache_size", "memory budget for image data shared between sessions (0 to disable)", cxxopts::value<int>(), "<MB>")
+        ("huge_pages", "use transparent huge pages for large image buffers", cxxopts::value<bool>())
+        ("sidecar_folder", "set folder for HDF5 sidecar files with mipmaps and statistics of large images", cxxopts::value<string>(), "<dir>")
+        ("no_stats_cache", "do not store image statistics and histograms in the user folder", cxxopts::value<bool>())
         ("read_only_mode", "disable write requests", cxxopts::value<bool>())
         ("enable_scripting", "enable HTTP scripting interface", cxxopts::value<bool>())
         ("files", "files to load", cxxopts::value<std::vector<string>>(positional_arguments))
@@ -261,6 +268,25 @@ The 'exit_timeout' and 'initial_timeout' options are provided to shut the
 backend down automatically if it is idle (if no clients are connected). 
 'idle_timeout' allows the backend to kill frontend sessions that are idle (no 
 longer sending messages to the backend).
+
+Image planes and tiles read from disk are shared between all sessions which 
+open the same file. 'shared_cache_size' sets the memory budget for this cache in
+MB (default {} MB). Data still in use by an open image is kept even when the
+budget is exceeded. Setting it to 0 disables sharing. Buffers for image data are
+reused; with 'huge_pages', large buffers are backed by transparent huge pages 
+where the kernel supports them.
+
+If 'sidecar_folder' is set, the backend writes an HDF5 file with mipmaps, 
+rotated data for spectral profiles and per-channel statistics into this folder
+in the background when a FITS, CASA or MIRIAD image of at least {} MB is 
+opened. It is used the next time the same image is opened. Sidecars are 
+replaced when the image is modified.
+
+Statistics and histograms of images and cubes are stored in 
+'{}/{}' in the user's home directory when an image is closed, so that 
+they are not calculated again the next time the same image is opened. They are 
+not used if the image has been modified. This can be disabled with 
+'no_stats_cache'.
     
 Enabling 'read_only_mode' prevents the backend from writing data (for example, 
 saving regions or generated images).
@@ -268,7 +294,8 @@ saving regions or generated images).
 'no_user_config' and 'no_system_config' may be used to ignore the user and 
 global configuration files, respectively.
 )",
-        CARTA_DEFAULT_FRONTEND_FOLDER, DEFAULT_SOCKET_PORT, CARTA_USER_FOLDER_PREFIX, log_levels, CARTA_USER_FOLDER_PREFIX);
+        CARTA_DEFAULT_FRONTEND_FOLDER, DEFAULT_SOCKET_PORT, CARTA_USER_FOLDER_PREFIX, log_levels, CARTA_USER_FOLDER_PREFIX,
+        DEFAULT_SHARED_IMAGE_CACHE_SIZE, SIDECAR_MIN_IMAGE_SIZE_MB, CARTA_USER_FOLDER_PREFIX, DISK_STATS_CACHE_FOLDER);
 
     for (const auto& [name, msg] : deprecated_options) {
         if (result.count(name)) {
@@ -298,6 +325,8 @@ global configuration files, respectively.
     no_browser = result["no_browser"].as<bool>();
     read_only_mode = result["read_only_mode"].as<bool>();
     enable_scripting = result["enable_scripting"].as<bool>();
+    huge_pages = result["huge_pages"].as<bool>();
+    no_stats_cache = result["no_stats_cache"].as<bool>();
 
     no_user_config = result.count("no_user_config") != 0;
     no_system_config = result.count("no_system_config") != 0;
@@ -315,6 +344,8 @@ global configuration files, respectively.
     applyOptionalArgument(init_wait_time, "initial_timeout", result);
 
     applyOptionalArgument(idle_session_wait_time, "idle_timeout", result);
+    applyOptionalArgument(shared_cache_size, "shared_cache_size", result);
+    applyOptionalArgument(sidecar_folder, "sidecar_folder", result);
 
     applyOptionalArgument(browser, "browser", result);
 
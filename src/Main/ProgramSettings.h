@@ -42,6 +42,7 @@ struct ProgramSettings {
     std::vector<std::string> files;
     std::vector<fs::path> file_paths;
     std::string frontend_folder;
+    std::string sidecar_folder;
     bool no_http = false; // Deprecated
     bool no_frontend = false;
     bool no_database = false;
@@ -54,6 +55,9 @@ struct ProgramSettings {
     int wait_time = -1;
     int init_wait_time = -1;
     int idle_session_wait_time = -1;
+    int shared_cache_size = -1;
+    bool huge_pages = false;
+    bool no_stats_cache = false;
     bool read_only_mode = false;
     bool enable_scripting = false;
 
@@ -75,7 +79,8 @@ struct ProgramSettings {
         {"event_thread_count", &event_thread_count},
         {"exit_timeout", &wait_time},
         {"initial_timeout", &init_wait_time},
-        {"idle_timeout", &idle_session_wait_time}
+        {"idle_timeout", &idle_session_wait_time},
+        {"shared_cache_size", &shared_cache_size}
     };
 
     std::unordered_map<std::string, bool*> bool_keys_map{
@@ -87,7 +92,9 @@ struct ProgramSettings {
         {"read_only_mode", &read_only_mode},
         {"enable_scripting", &enable_scripting},
         {"no_frontend", &no_frontend},
-        {"no_database", &no_database}
+        {"no_database", &no_database},
+        {"huge_pages", &huge_pages},
+        {"no_stats_cache", &no_stats_cache}
     };
 
     std::unordered_map<std::string, std::string*> strings_keys_map{
@@ -95,6 +102,7 @@ struct ProgramSettings {
         {"top_level_folder", &top_level_folder},
         {"starting_folder", &starting_folder},
         {"frontend_folder", &frontend_folder},
+        {"sidecar_folder", &sidecar_folder},
         {"browser", &browser}
     };
 
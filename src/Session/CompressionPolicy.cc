@@ -0,0 +1,100 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "CompressionPolicy.h"
+
+#include <algorithm>
+
+using namespace carta;
+
+// Backlog delays in seconds at which compression is increased by one more step
+static const double CONGESTION_DELAYS[] = {0.25, 1.0, 4.0};
+// Reduction of the tile precision and increase of the contour compression level per congestion level
+static const int CONGESTION_STEPS[] = {0, 2, 4, 8};
+
+// Assumed drain rate before the connection has been measured, in bytes per second
+static const double DEFAULT_DRAIN_RATE = 1.0e6;
+
+static int CongestionLevel(double delay) {
+    int level(0);
+    for (double congestion_delay : CONGESTION_DELAYS) {
+        if (delay >= congestion_delay) {
+            ++level;
+        }
+    }
+    return level;
+}
+
+CompressionPolicy::CompressionPolicy()
+    : _queued_bytes(0), _buffered_bytes(0), _drain_rate(0), _sent_since_update(0), _last_buffered_amount(0), _last_update(Clock::now()) {}
+
+void CompressionPolicy::OnQueued(size_t bytes) {
+    _queued_bytes += bytes;
+}
+
+void CompressionPolicy::OnSent(size_t bytes, size_t buffered_amount, Clock::time_point now) {
+    _queued_bytes -= std::min(bytes, _queued_bytes.load());
+    _sent_since_update += bytes;
+    Update(buffered_amount, now);
+}
+
+void CompressionPolicy::OnDrain(size_t buffered_amount, Clock::time_point now) {
+    Update(buffered_amount, now);
+}
+
+void CompressionPolicy::ClearQueued() {
+    _queued_bytes = 0;
+}
+
+void CompressionPolicy::Update(size_t buffered_amount, Clock::time_point now) {
+    double dt = std::chrono::duration<double>(now - _last_update).count();
+    if (dt < POLICY_MIN_MEASUREMENT_INTERVAL) {
+        _buffered_bytes = buffered_amount;
+        return;
+    }
+
+    // Only a socket which was backpressured during the whole interval was sending at the speed of the connection
+    if (_last_buffered_amount > 0 && buffered_amount > 0) {
+        double drained = (double)_last_buffered_amount + _sent_since_update - buffered_amount;
+        double rate = std::max(drained, 0.0) / dt;
+        double previous_rate = _drain_rate;
+        _drain_rate = previous_rate > 0 ? (1 - POLICY_DRAIN_RATE_SMOOTHING) * previous_rate + POLICY_DRAIN_RATE_SMOOTHING * rate : rate;
+    }
+
+    _sent_since_update = 0;
+    _last_buffered_amount = buffered_amount;
+    _last_update = now;
+    _buffered_bytes = buffered_amount;
+}
+
+double CompressionPolicy::BacklogDelay() const {
+    size_t backlog = _queued_bytes + _buffered_bytes;
+    if (backlog < POLICY_MIN_BACKLOG) {
+        return 0;
+    }
+    double rate = _drain_rate;
+    return backlog / (rate > 0 ? rate : DEFAULT_DRAIN_RATE);
+}
+
+float CompressionPolicy::TileQuality(float requested_quality) const {
+    if (requested_quality <= POLICY_MIN_ZFP_PRECISION) {
+        return requested_quality;
+    }
+    int step = CONGESTION_STEPS[CongestionLevel(BacklogDelay())];
+    return std::max((float)POLICY_MIN_ZFP_PRECISION, requested_quality - step);
+}
+
+bool CompressionPolicy::DeflateRawTiles() const {
+    return BacklogDelay() > 0;
+}
+
+int CompressionPolicy::ContourCompressionLevel(int requested_level) const {
+    if (requested_level < 1 || requested_level >= POLICY_MAX_CONTOUR_LEVEL) {
+        return requested_level;
+    }
+    int step = CONGESTION_STEPS[CongestionLevel(BacklogDelay())];
+    return std::min(POLICY_MAX_CONTOUR_LEVEL, requested_level + step);
+}
@@ -0,0 +1,67 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CompressionPolicy.h: adapts compression settings of a session to the speed of its WebSocket connection
+
+#ifndef CARTA_BACKEND__COMPRESSION_POLICY_H_
+#define CARTA_BACKEND__COMPRESSION_POLICY_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+#define POLICY_MIN_ZFP_PRECISION 8          // tile precision is never reduced below this, or below the requested precision
+#define POLICY_MAX_CONTOUR_LEVEL 19         // contour zstd level is never raised above this
+#define POLICY_MIN_BACKLOG 262144           // bytes; a smaller backlog does not affect compression
+#define POLICY_DRAIN_RATE_SMOOTHING 0.3     // weight of the latest drain rate measurement
+#define POLICY_MIN_MEASUREMENT_INTERVAL 0.01 // seconds
+
+namespace carta {
+
+// The backlog is the data queued for sending plus the data buffered by the socket (backpressure). The drain rate is measured
+// while the socket is backpressured, so it is the speed of the connection rather than the speed at which messages are produced.
+// With no backlog, the requested settings are used unchanged; the longer the backlog takes to drain, the lower the tile precision
+// and the higher the contour compression level. Settings are only ever reduced to within the bounds allowed by the client.
+class CompressionPolicy {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CompressionPolicy();
+
+    // Called by any thread when a message is queued
+    void OnQueued(size_t bytes);
+    // Called by the socket thread after a message has been passed to the socket, and when the socket is drained
+    void OnSent(size_t bytes, size_t buffered_amount, Clock::time_point now = Clock::now());
+    void OnDrain(size_t buffered_amount, Clock::time_point now = Clock::now());
+    // Called when the queued messages are discarded
+    void ClearQueued();
+
+    // Expected time to send the backlog, in seconds
+    double BacklogDelay() const;
+
+    // ZFP precision for raster tiles
+    float TileQuality(float requested_quality) const;
+    // Whether uncompressed tiles should be compressed with per-message deflate; not worth the CPU time on a fast connection
+    bool DeflateRawTiles() const;
+    // zstd level for contour vertices; 0 (no compression) is kept
+    int ContourCompressionLevel(int requested_level) const;
+
+private:
+    void Update(size_t buffered_amount, Clock::time_point now);
+
+    std::atomic<size_t> _queued_bytes;
+    std::atomic<size_t> _buffered_bytes;
+    std::atomic<double> _drain_rate; // bytes per second, 0 if not measured yet
+
+    // Only used by the socket thread
+    size_t _sent_since_update;
+    size_t _last_buffered_amount;
+    Clock::time_point _last_update;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__COMPRESSION_POLICY_H_
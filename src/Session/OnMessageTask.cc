@@ -66,6 +66,16 @@ OnMessageTask* RegionDataStreamsTask::execute() {
     return nullptr;
 }
 
+OnMessageTask* ImageHistogramTask::execute() {
+    _session->SendImageHistogramData(_file_id);
+    return nullptr;
+}
+
+OnMessageTask* PrefetchTilesTask::execute() {
+    _session->PrefetchTiles(_message, _z, _stokes, _prefetch_id);
+    return nullptr;
+}
+
 OnMessageTask* SpectralProfileTask::execute() {
     _session->SendSpectralProfileData(_file_id, _region_id);
     return nullptr;
@@ -96,6 +96,27 @@ public:
     ~RegionDataStreamsTask() = default;
 };
 
+class ImageHistogramTask : public OnMessageTask {
+    OnMessageTask* execute() override;
+    int _file_id;
+
+public:
+    ImageHistogramTask(Session* session, int file_id) : OnMessageTask(session), _file_id(file_id) {}
+    ~ImageHistogramTask() = default;
+};
+
+class PrefetchTilesTask : public OnMessageTask {
+    OnMessageTask* execute() override;
+    CARTA::AddRequiredTiles _message;
+    int _z, _stokes;
+    uint32_t _prefetch_id;
+
+public:
+    PrefetchTilesTask(Session* session, const CARTA::AddRequiredTiles& message, int z, int stokes, uint32_t prefetch_id)
+        : OnMessageTask(session), _message(message), _z(z), _stokes(stokes), _prefetch_id(prefetch_id) {}
+    ~PrefetchTilesTask() = default;
+};
+
 class SpectralProfileTask : public OnMessageTask {
     OnMessageTask* execute() override;
     int _file_id, _region_id;
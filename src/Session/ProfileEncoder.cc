@@ -0,0 +1,171 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "ProfileEncoder.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "Util/File.h"
+
+namespace carta {
+
+static_assert(sizeof(ProfileEncodingHeader) == 16, "ProfileEncodingHeader must not be padded");
+
+template <typename T>
+std::string EncodeProfileValues(const std::string& values, const std::string* previous_values, ProfileCodec codec, uint32_t precision) {
+    const size_t length = values.size() / sizeof(T);
+    size_t start(0);
+    size_t end(length);
+    if (previous_values && previous_values->size() == values.size()) {
+        // Values are compared bitwise, so that NaNs which were not computed yet are unchanged
+        const char* data = values.data();
+        const char* previous = previous_values->data();
+        while (start < end && std::memcmp(data + start * sizeof(T), previous + start * sizeof(T), sizeof(T)) == 0) {
+            ++start;
+        }
+        while (end > start && std::memcmp(data + (end - 1) * sizeof(T), previous + (end - 1) * sizeof(T), sizeof(T)) == 0) {
+            --end;
+        }
+    }
+    const size_t count = end - start;
+    const size_t data_size = count * sizeof(T);
+    if (count < PROFILE_MIN_COMPRESSED_SIZE) {
+        codec = ProfileCodec::None;
+    }
+
+    ProfileEncodingHeader header{static_cast<uint8_t>(codec), static_cast<uint8_t>(codec == ProfileCodec::Zfp ? precision : 0), 0,
+        static_cast<uint32_t>(length), static_cast<uint32_t>(start), static_cast<uint32_t>(count)};
+    std::string encoded_values(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const T* first = reinterpret_cast<const T*>(values.data()) + start;
+    if (CompressProfile(first, count, encoded_values, codec, precision) || encoded_values.size() > sizeof(header) + data_size) {
+        // Send the values as they are if they did not compress
+        header.codec = static_cast<uint8_t>(ProfileCodec::None);
+        header.precision = 0;
+        encoded_values.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+        encoded_values.append(values, start * sizeof(T), data_size);
+    }
+    return encoded_values;
+}
+
+template <typename T>
+bool DecodeProfileValues(const std::string& encoded_values, std::vector<T>& values) {
+    ProfileEncodingHeader header;
+    if (encoded_values.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, encoded_values.data(), sizeof(header));
+    if ((size_t)header.start + header.count > header.length) {
+        return false;
+    }
+
+    std::vector<T> decoded_values;
+    if (DecompressProfile(decoded_values, header.count, encoded_values.data() + sizeof(header), encoded_values.size() - sizeof(header),
+            static_cast<ProfileCodec>(header.codec), header.precision)) {
+        return false;
+    }
+    values.resize(header.length, NAN);
+    std::copy(decoded_values.begin(), decoded_values.end(), values.begin() + header.start);
+    return true;
+}
+
+template std::string EncodeProfileValues<float>(const std::string&, const std::string*, ProfileCodec, uint32_t);
+template std::string EncodeProfileValues<double>(const std::string&, const std::string*, ProfileCodec, uint32_t);
+template bool DecodeProfileValues<float>(const std::string&, std::vector<float>&);
+template bool DecodeProfileValues<double>(const std::string&, std::vector<double>&);
+
+ProfileEncoder::ProfileEncoder() : _codec(ProfileCodec::None) {}
+
+uint32_t ProfileEncoder::Negotiate(uint32_t client_feature_flags) {
+    std::unique_lock<std::mutex> lock(_partial_mutex);
+    // A new or reconnected client has no partial profiles
+    _partial_profiles.clear();
+
+    if (client_feature_flags & PROFILE_FEATURE_ZFP) {
+        _codec = ProfileCodec::Zfp;
+        return PROFILE_FEATURE_ZFP;
+    } else if (client_feature_flags & PROFILE_FEATURE_ZSTD) {
+        _codec = ProfileCodec::Zstd;
+        return PROFILE_FEATURE_ZSTD;
+    }
+    _codec = ProfileCodec::None;
+    return 0;
+}
+
+void ProfileEncoder::EncodeSpectralProfiles(CARTA::SpectralProfileData& message) {
+    ProfileCodec codec = _codec;
+    if (codec == ProfileCodec::None) {
+        return;
+    }
+
+    bool complete = message.progress() >= 1.0;
+    for (auto& profile : *message.mutable_profiles()) {
+        bool fp64 = !profile.raw_values_fp64().empty();
+        std::string& values = fp64 ? *profile.mutable_raw_values_fp64() : *profile.mutable_raw_values_fp32();
+        if (values.empty()) {
+            continue;
+        }
+
+        ProfileKey key(message.file_id(), message.region_id(), message.stokes(), profile.coordinate(), profile.stats_type());
+        std::unique_lock<std::mutex> lock(_partial_mutex);
+        auto partial_profile = _partial_profiles.find(key);
+        const std::string* previous_values = (partial_profile == _partial_profiles.end()) ? nullptr : &partial_profile->second;
+        std::string encoded_values = fp64 ? EncodeProfileValues<double>(values, previous_values, codec, PROFILE_ZFP_PRECISION)
+                                          : EncodeProfileValues<float>(values, previous_values, codec, PROFILE_ZFP_PRECISION);
+
+        if (complete) {
+            if (previous_values) {
+                _partial_profiles.erase(partial_profile);
+            }
+        } else if (previous_values) {
+            partial_profile->second = std::move(values);
+        } else {
+            _partial_profiles.emplace(key, std::move(values));
+        }
+        lock.unlock();
+
+        values = std::move(encoded_values);
+    }
+}
+
+void ProfileEncoder::EncodeSpatialProfiles(CARTA::SpatialProfileData& message) {
+    ProfileCodec codec = _codec;
+    if (codec == ProfileCodec::None) {
+        return;
+    }
+
+    for (auto& profile : *message.mutable_profiles()) {
+        std::string& values = *profile.mutable_raw_values_fp32();
+        if (!values.empty()) {
+            values = EncodeProfileValues<float>(values, nullptr, codec, PROFILE_ZFP_PRECISION);
+        }
+    }
+}
+
+void ProfileEncoder::RemoveFile(int file_id) {
+    std::unique_lock<std::mutex> lock(_partial_mutex);
+    for (auto it = _partial_profiles.begin(); it != _partial_profiles.end();) {
+        if (file_id == ALL_FILES || std::get<0>(it->first) == file_id) {
+            it = _partial_profiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ProfileEncoder::RemoveRegion(int region_id) {
+    std::unique_lock<std::mutex> lock(_partial_mutex);
+    for (auto it = _partial_profiles.begin(); it != _partial_profiles.end();) {
+        if (std::get<1>(it->first) == region_id) {
+            it = _partial_profiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace carta
@@ -0,0 +1,87 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# ProfileEncoder.h: compressed encodings of spectral and spatial profile values, negotiated with the client
+
+#ifndef CARTA_BACKEND__PROFILE_ENCODER_H_
+#define CARTA_BACKEND__PROFILE_ENCODER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <carta-protobuf/spatial_profile.pb.h>
+#include <carta-protobuf/spectral_profile.pb.h>
+
+#include "DataStream/Compression.h"
+
+// Feature flags of RegisterViewer which are not yet part of CARTA::ClientFeatureFlags; the server acknowledges the codec it uses
+// with the same bit in the server feature flags
+#define PROFILE_FEATURE_ZSTD (1 << 8)  // delta + zstd (lossless)
+#define PROFILE_FEATURE_ZFP (1 << 9)   // 1D ZFP (lossy); used if both are requested
+#define PROFILE_ZFP_PRECISION 24       // bits
+#define PROFILE_MIN_COMPRESSED_SIZE 64 // number of values; fewer values are sent uncompressed
+
+namespace carta {
+
+// With an encoding enabled, the raw_values_fp32 or raw_values_fp64 bytes of each profile start with this header, followed by the
+// encoded values [start, start + count) of a profile with the given length. The other values are unchanged since the previous
+// message for the same profile, which only happens in partial spectral profile updates: after the first message of a stream of
+// partial updates, only the values which changed are sent. A profile is identified by file, region, Stokes, coordinate and stats
+// type; the client keeps the values of a profile until its final message (progress 1), or until the file is closed or the region
+// is removed.
+struct ProfileEncodingHeader {
+    uint8_t codec;     // ProfileCodec
+    uint8_t precision; // ZFP precision in bits
+    uint16_t reserved;
+    uint32_t length;
+    uint32_t start;
+    uint32_t count;
+};
+
+// Encodes the values (raw bytes of float or double). If previous_values holds the values last sent for the same profile, only the
+// range that differs from them is encoded.
+template <typename T>
+std::string EncodeProfileValues(const std::string& values, const std::string* previous_values, ProfileCodec codec, uint32_t precision);
+// Decodes the encoded values onto the values last received for the same profile, as the client does
+template <typename T>
+bool DecodeProfileValues(const std::string& encoded_values, std::vector<T>& values);
+
+class ProfileEncoder {
+public:
+    ProfileEncoder();
+
+    // Selects the encoding from the client feature flags of RegisterViewer, and returns the server feature flags to acknowledge it
+    uint32_t Negotiate(uint32_t client_feature_flags);
+
+    // Encode the profiles of a message in place, if an encoding was negotiated
+    void EncodeSpectralProfiles(CARTA::SpectralProfileData& message);
+    void EncodeSpatialProfiles(CARTA::SpatialProfileData& message);
+
+    // Forget the partial profiles of a closed file, or of all files
+    void RemoveFile(int file_id);
+    // Forget the partial profiles of a removed region in all files
+    void RemoveRegion(int region_id);
+
+private:
+    using ProfileKey = std::tuple<int, int, int, std::string, int>; // file, region, stokes, coordinate, stats type
+
+    // Set on the socket thread when the client registers, and read by the tasks which send profiles; None if no encoding was
+    // negotiated
+    std::atomic<ProfileCodec> _codec;
+
+    // Values last sent for spectral profiles which are not complete yet
+    std::mutex _partial_mutex;
+    std::map<ProfileKey, std::string> _partial_profiles;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__PROFILE_ENCODER_H_
@@ -17,8 +17,8 @@
 #include <vector>
 
 #include <casacore/casa/OS/File.h>
-#include <zstd.h>
 
+#include "Cache/BufferPool.h"
 #include "DataStream/Compression.h"
 #include "FileList/FileExtInfoLoader.h"
 #include "FileList/FileInfoLoader.h"
@@ -113,6 +113,7 @@ Session::Session(uWS::WebSocket<false, true, PerSocketData>* ws, uWS::Loop* loop
       _loaders(LOADER_CACHE_SIZE) {
     _histogram_progress = 1.0;
     _ref_count = 0;
+    _tile_prefetch_id = 0;
     _animation_object = nullptr;
     _connected = true;
     ++_num_sessions;
@@ -146,6 +147,12 @@ Session::~Session() {
     spdlog::debug("{} ~Session : num sessions = {}", fmt::ptr(this), _num_sessions);
     if (!_num_sessions) {
         spdlog::info("No remaining sessions.");
+        std::vector<std::pair<std::string, BufferPoolStats>> buffer_pool_stats = {
+            {"Image", FloatBufferPool::GetStats()}, {"Message", CharBufferPool::GetStats()}};
+        for (const auto& [name, stats] : buffer_pool_stats) {
+            spdlog::performance("{} buffer pool: {} local hits, {} shared hits, {} allocations, {} dropped, {:.3f} MB pooled", name,
+                stats.local_hits, stats.global_hits, stats.misses, stats.dropped, stats.pooled_bytes / 1.0e6);
+        }
         if (_exit_when_all_sessions_closed) {
             if (_exit_after_num_seconds == 0) {
                 spdlog::debug("Exiting due to no sessions remaining");
@@ -392,6 +399,7 @@ void Session::OnRegisterViewer(const CARTA::RegisterViewer& message, uint16_t ic
     if (_enable_scripting) {
         feature_flags |= CARTA::ServerFeatureFlags::SCRIPTING;
     }
+    feature_flags |= _profile_encoder.Negotiate(message.client_feature_flags());
     ack_message.set_server_feature_flags(feature_flags);
     SendEvent(CARTA::EventType::REGISTER_VIEWER_ACK, request_id, ack_message);
 }
@@ -558,11 +566,9 @@ bool Session::OnOpenFile(const CARTA::OpenFile& message, uint32_t request_id, bo
     }
 
     if (success) {
-        // send histogram with default requirements
-        if (!SendRegionHistogramData(file_id, IMAGE_REGION_ID)) {
-            std::string message = fmt::format("Image histogram for file id {} failed", file_id);
-            SendLogEvent(message, {"open_file"}, CARTA::ErrorSeverity::ERROR);
-        }
+        // send histogram with default requirements after the tiles, which do not need the full plane
+        OnMessageTask* tsk = new ImageHistogramTask(this, file_id);
+        ThreadManager::QueueTask(tsk);
     } else if (!err_message.empty()) {
         spdlog::error(err_message);
     }
@@ -646,11 +652,15 @@ void Session::DeleteFrame(int file_id) {
     if (_region_handler) {
         _region_handler->RemoveFrame(file_id);
     }
+    _profile_encoder.RemoveFile(file_id);
 }
 
 void Session::OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool skip_data) {
     auto file_id = message.file_id();
 
+    // Cancel any prefetch for the previous request
+    uint32_t prefetch_id = ++_tile_prefetch_id;
+
     if (!_frames.count(file_id)) {
         return;
     }
@@ -671,6 +681,11 @@ void Session::OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool sk
         int num_tiles = message.tiles_size();
         CARTA::CompressionType compression_type = message.compression_type();
         float compression_quality = message.compression_quality();
+        if (compression_type == CARTA::CompressionType::ZFP) {
+            compression_quality = _compression_policy.TileQuality(compression_quality);
+        }
+        // Only use deflate on outgoing messages if the raster image compression type is NONE and the connection is slow
+        bool deflate = compression_type == CARTA::CompressionType::NONE && _compression_policy.DeflateRawTiles();
 
         auto t_start_get_tile_data = std::chrono::high_resolution_clock::now();
 
@@ -687,9 +702,7 @@ void Session::OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool sk
                     auto tile = Tile::Decode(encoded_coordinate);
                     if (_frames.count(file_id) &&
                         _frames.at(file_id)->FillRasterTileData(raster_tile_data, tile, z, stokes, compression_type, compression_quality)) {
-                        // Only use deflate on outgoing message if the raster image compression type is NONE
-                        SendFileEvent(file_id, CARTA::EventType::RASTER_TILE_DATA, 0, raster_tile_data,
-                            compression_type == CARTA::CompressionType::NONE);
+                        SendFileEvent(file_id, CARTA::EventType::RASTER_TILE_DATA, 0, raster_tile_data, deflate);
                     } else {
                         spdlog::warn("Discarding stale tile request for channel={}, layer={}, x={}, y={}", z, tile.layer, tile.x, tile.y);
                     }
@@ -705,9 +718,58 @@ void Session::OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool sk
         // Send final message with no tiles to signify end of the tile stream, for synchronisation purposes
         auto final_message = Message::RasterTileSync(file_id, z, stokes, animation_id, true);
         SendFileEvent(file_id, CARTA::EventType::RASTER_TILE_SYNC, 0, final_message);
+
+        OnMessageTask* tsk = new PrefetchTilesTask(this, message, z, stokes, prefetch_id);
+        ThreadManager::QueueTask(tsk);
     }
 }
 
+void Session::PrefetchTiles(const CARTA::AddRequiredTiles& message, int z, int stokes, uint32_t prefetch_id) {
+    auto is_cancelled = [&]() { return (prefetch_id != _tile_prefetch_id) || _base_context.is_group_execution_cancelled(); };
+
+    std::shared_ptr<Frame> frame;
+    std::unique_lock<std::mutex> lock(_frame_mutex);
+    if (is_cancelled() || !_frames.count(message.file_id())) {
+        return;
+    }
+    frame = _frames.at(message.file_id());
+    lock.unlock();
+
+    std::vector<Tile> tiles;
+    for (const auto& encoded_coordinate : message.tiles()) {
+        tiles.push_back(Tile::Decode(encoded_coordinate));
+    }
+
+    auto t_start_prefetch = std::chrono::high_resolution_clock::now();
+
+    // Prefetched tiles are cached with the quality that the next request is expected to use
+    float compression_quality = message.compression_quality();
+    if (message.compression_type() == CARTA::CompressionType::ZFP) {
+        compression_quality = _compression_policy.TileQuality(compression_quality);
+    }
+
+    // Tiles around the view and in the neighbouring layers; during animation only the next channel is needed
+    if (!AnimationRunning()) {
+        auto prefetch_tiles = Tile::GetPrefetchTiles(tiles, frame->Width(), frame->Height(), TILE_SIZE, TILE_SIZE, MAX_PREFETCH_TILES);
+        frame->PrefetchRasterTiles(prefetch_tiles, z, stokes, message.compression_type(), compression_quality, is_cancelled);
+    }
+
+    // The full plane, if it is not read directly from the file when zooming out
+    if (!_base_context.is_group_execution_cancelled()) {
+        frame->PrefetchImageCache([&]() { return _base_context.is_group_execution_cancelled(); });
+    }
+
+    // The next channel, if the user is stepping through channels or animating
+    int z_step = frame->LastZStep();
+    if (z_step != 0 && !is_cancelled()) {
+        frame->PrefetchImageChannel(tiles, z + z_step, stokes, is_cancelled);
+    }
+
+    auto t_end_prefetch = std::chrono::high_resolution_clock::now();
+    auto dt_prefetch = std::chrono::duration_cast<std::chrono::microseconds>(t_end_prefetch - t_start_prefetch).count();
+    spdlog::performance("Prefetch tile data in {:.3f} ms{}", dt_prefetch * 1e-3, is_cancelled() ? " (cancelled)" : "");
+}
+
 void Session::OnSetImageChannels(const CARTA::SetImageChannels& message) {
     auto file_id(message.file_id());
     std::unique_lock<std::mutex> lock(_frame_mutex);
@@ -810,6 +872,7 @@ void Session::OnRemoveRegion(const CARTA::RemoveRegion& message) {
     if (_region_handler) {
         _region_handler->RemoveRegion(message.region_id());
     }
+    _profile_encoder.RemoveRegion(message.region_id());
 }
 
 void Session::OnImportRegion(const CARTA::ImportRegion& message, uint32_t request_id) {
@@ -1077,6 +1140,7 @@ void Session::OnResumeSession(const CARTA::ResumeSession& message, uint32_t requ
 
     // Clear the message queue
     _out_msgs.clear();
+    _compression_policy.ClearQueued();
 
     // Reconnect the session
     ConnectCalled();
@@ -1416,104 +1480,58 @@ bool Session::CalculateCubeHistogram(int file_id, CARTA::RegionHistogramData& cu
             _histogram_progress = 0.0;
             auto t_start = std::chrono::high_resolution_clock::now();
             int request_id(0);
-            size_t depth(_frames.at(file_id)->Depth());
-            size_t total_z(depth * 2); // for progress; go through z twice, for stats then histogram
-
-            // stats for entire cube
             BasicStats<float> cube_stats;
-            for (size_t z = 0; z < depth; ++z) {
-                // stats for this z
-                BasicStats<float> z_stats;
-                if (!_frames.at(file_id)->GetBasicStats(z, stokes, z_stats)) {
-                    return calculated;
-                }
-                cube_stats.join(z_stats);
-
-                // check for cancel
+            Histogram cube_histogram;
+            auto progress_callback = [&](float progress, const Histogram* partial_histogram) {
                 if (_histogram_context.is_group_execution_cancelled()) {
-                    break;
+                    return false;
                 }
 
-                // check for progress update
                 auto t_end = std::chrono::high_resolution_clock::now();
                 auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
-                if ((dt / 1e6) > UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS) {
-                    // send progress
-                    float this_z(z);
-                    _histogram_progress = this_z / total_z;
+                if ((dt / 1e6) > UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS && progress < 1.0) {
+                    // send progress, with the histogram of the planes binned so far
+                    _histogram_progress = progress;
                     auto progress_msg = Message::RegionHistogramData(file_id, CUBE_REGION_ID, ALL_Z, stokes, _histogram_progress);
                     auto* message_histogram = progress_msg.mutable_histograms();
+                    if (partial_histogram) {
+                        FillHistogram(message_histogram, cube_stats, *partial_histogram);
+                    }
                     SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, progress_msg);
                     t_start = t_end;
                 }
+                return true;
+            };
+
+            // Stats and histogram for entire cube
+            if (!_frames.at(file_id)->CalculateCubeHistogram(stokes, num_bins, cube_stats, cube_histogram, progress_callback)) {
+                _histogram_progress = 1.0;
+                return calculated; // cancelled or failed
             }
 
-            // check cancel and proceed
             if (!_histogram_context.is_group_execution_cancelled()) {
                 _frames.at(file_id)->CacheCubeStats(stokes, cube_stats);
 
-                // send progress message: half done
-                _histogram_progress = 0.50;
-                auto half_progress = Message::RegionHistogramData(file_id, CUBE_REGION_ID, ALL_Z, stokes, _histogram_progress);
-                auto* message_histogram = half_progress.mutable_histograms();
-                SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, half_progress);
-
-                // get histogram bins for each z and accumulate bin counts in cube_bins
-                Histogram z_histogram; // histogram for each z using cube stats
-                Histogram cube_histogram;
-                for (size_t z = 0; z < depth; ++z) {
-                    if (!_frames.at(file_id)->CalculateHistogram(CUBE_REGION_ID, z, stokes, num_bins, cube_stats, z_histogram)) {
-                        return calculated; // z histogram failed
-                    }
-
-                    if (z == 0) {
-                        cube_histogram = std::move(z_histogram);
-                    } else {
-                        cube_histogram.Add(z_histogram);
-                    }
-
-                    // check for cancel
-                    if (_histogram_context.is_group_execution_cancelled()) {
-                        break;
-                    }
-
-                    auto t_end = std::chrono::high_resolution_clock::now();
-                    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
-                    if ((dt / 1e6) > UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS) {
-                        // Send progress update
-                        float this_z(z);
-                        _histogram_progress = 0.5 + (this_z / total_z);
-                        auto progress_msg = Message::RegionHistogramData(file_id, CUBE_REGION_ID, ALL_Z, stokes, _histogram_progress);
-                        auto* message_histogram = progress_msg.mutable_histograms();
-                        FillHistogram(message_histogram, cube_stats, cube_histogram);
-                        SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, progress_msg);
-                        t_start = t_end;
-                    }
-                }
-
                 // set completed cube histogram
-                if (!_histogram_context.is_group_execution_cancelled()) {
-                    cube_histogram_message.set_file_id(file_id);
-                    cube_histogram_message.set_region_id(CUBE_REGION_ID);
-                    cube_histogram_message.set_channel(ALL_Z);
-                    cube_histogram_message.set_stokes(stokes);
-                    cube_histogram_message.set_progress(1.0);
-                    // fill histogram fields from last z histogram
-                    cube_histogram_message.clear_histograms();
-                    auto* message_histogram = cube_histogram_message.mutable_histograms();
-                    FillHistogram(message_histogram, cube_stats, cube_histogram);
-
-                    // cache cube histogram
-                    _frames.at(file_id)->CacheCubeHistogram(stokes, cube_histogram);
-
-                    auto t_end_cube_histogram = std::chrono::high_resolution_clock::now();
-                    auto dt_cube_histogram =
-                        std::chrono::duration_cast<std::chrono::microseconds>(t_end_cube_histogram - t_start_cube_histogram).count();
-                    spdlog::performance("Fill cube histogram in {:.3f} ms at {:.3f} MPix/s", dt_cube_histogram * 1e-3,
-                        (float)cube_stats.num_pixels / dt_cube_histogram);
-
-                    calculated = true;
-                }
+                cube_histogram_message.set_file_id(file_id);
+                cube_histogram_message.set_region_id(CUBE_REGION_ID);
+                cube_histogram_message.set_channel(ALL_Z);
+                cube_histogram_message.set_stokes(stokes);
+                cube_histogram_message.set_progress(1.0);
+                cube_histogram_message.clear_histograms();
+                auto* message_histogram = cube_histogram_message.mutable_histograms();
+                FillHistogram(message_histogram, cube_stats, cube_histogram);
+
+                // cache cube histogram
+                _frames.at(file_id)->CacheCubeHistogram(stokes, cube_histogram);
+
+                auto t_end_cube_histogram = std::chrono::high_resolution_clock::now();
+                auto dt_cube_histogram =
+                    std::chrono::duration_cast<std::chrono::microseconds>(t_end_cube_histogram - t_start_cube_histogram).count();
+                spdlog::performance("Fill cube histogram in {:.3f} ms at {:.3f} MPix/s", dt_cube_histogram * 1e-3,
+                    (float)cube_stats.num_pixels / dt_cube_histogram);
+
+                calculated = true;
             }
             _histogram_progress = 1.0;
         } catch (std::out_of_range& range_error) {
@@ -1536,6 +1554,7 @@ bool Session::SendSpatialProfileData(int file_id, int region_id) {
         for (auto& spatial_profile_data : spatial_profile_data_vec) {
             spatial_profile_data.set_file_id(file_id);
             spatial_profile_data.set_region_id(region_id);
+            _profile_encoder.EncodeSpatialProfiles(spatial_profile_data);
             SendFileEvent(file_id, CARTA::EventType::SPATIAL_PROFILE_DATA, 0, spatial_profile_data);
             data_sent = true;
         }
@@ -1555,6 +1574,7 @@ bool Session::SendSpatialProfileData(int file_id, int region_id) {
         } else if (_region_handler->IsLineRegion(region_id)) {
             data_sent = _region_handler->FillLineSpatialProfileData(file_id, region_id, [&](CARTA::SpatialProfileData profile_data) {
                 if (profile_data.profiles_size() > 0) {
+                    _profile_encoder.EncodeSpatialProfiles(profile_data);
                     SendFileEvent(file_id, CARTA::EventType::SPATIAL_PROFILE_DATA, 0, profile_data);
                 }
             });
@@ -1607,6 +1627,7 @@ bool Session::SendSpectralProfileData(int file_id, int region_id, bool stokes_ch
             [&](CARTA::SpectralProfileData profile_data) {
                 if (profile_data.profiles_size() > 0) {
                     // send (partial) profile data to the frontend for each region/file combo
+                    _profile_encoder.EncodeSpectralProfiles(profile_data);
                     SendFileEvent(profile_data.file_id(), CARTA::EventType::SPECTRAL_PROFILE_DATA, 0, profile_data);
                 }
             },
@@ -1620,6 +1641,7 @@ bool Session::SendSpectralProfileData(int file_id, int region_id, bool stokes_ch
                         profile_data.set_file_id(file_id);
                         profile_data.set_region_id(region_id);
                         // send (partial) profile data to the frontend
+                        _profile_encoder.EncodeSpectralProfiles(profile_data);
                         SendFileEvent(file_id, CARTA::EventType::SPECTRAL_PROFILE_DATA, 0, profile_data);
                     }
                 },
@@ -1658,6 +1680,9 @@ bool Session::SendRegionHistogramData(int file_id, int region_id) {
                     data_sent = true;
                 }
             }
+
+            // Stats calculated for the histogram are kept for the next time the image is opened
+            _frames.at(file_id)->SaveStats();
         }
     } else {
         string error = fmt::format("File id {} not found", file_id);
@@ -1708,18 +1733,18 @@ bool Session::SendContourData(int file_id, bool ignore_empty) {
             }
         }
 
-        int64_t total_vertices = 0;
+        std::atomic<int64_t> total_vertices = 0;
 
         auto callback = [&](double level, double progress, const std::vector<float>& vertices, const std::vector<int>& indices) {
             // Currently only supports identical reference file IDs
             auto partial_response =
                 Message::ContourImageData(file_id, settings.reference_file_id, frame->CurrentZ(), frame->CurrentStokes(), progress);
-            std::vector<char> compression_buffer;
             const float pixel_rounding = std::max(1, std::min(32, settings.decimation));
 #if _DISABLE_CONTOUR_COMPRESSION_
             const int compression_level = 0;
 #else
-            const int compression_level = std::max(0, std::min(20, settings.compression_level));
+            const int compression_level =
+                _compression_policy.ContourCompressionLevel(std::max(0, std::min(20, settings.compression_level)));
 #endif
             // Fill contour set
             auto contour_set = partial_response.add_contour_sets();
@@ -1728,30 +1753,23 @@ bool Session::SendContourData(int file_id, bool ignore_empty) {
             const int N = vertices.size();
             total_vertices += N;
 
+            bool compressed(false);
             if (N) {
-                if (compression_level < 1) {
+                // Compress using Zstd library, directly into the message
+                compressed = compression_level >= 1 &&
+                             CompressVertices(vertices, *contour_set->mutable_raw_coordinates(), pixel_rounding, compression_level) == 0;
+                if (compressed) {
+                    contour_set->set_uncompressed_coordinates_size(N * sizeof(int32_t));
+                    contour_set->set_decimation_factor(pixel_rounding);
+                } else {
                     contour_set->set_raw_coordinates(vertices.data(), N * sizeof(float));
                     contour_set->set_uncompressed_coordinates_size(N * sizeof(float));
-                    contour_set->set_raw_start_indices(indices.data(), indices.size() * sizeof(int32_t));
                     contour_set->set_decimation_factor(0);
-                } else {
-                    std::vector<int32_t> vertices_shuffled;
-                    RoundAndEncodeVertices(vertices, vertices_shuffled, pixel_rounding);
-
-                    // Compress using Zstd library
-                    const size_t src_size = N * sizeof(int32_t);
-                    compression_buffer.resize(ZSTD_compressBound(src_size));
-                    size_t compressed_size = ZSTD_compress(
-                        compression_buffer.data(), compression_buffer.size(), vertices_shuffled.data(), src_size, compression_level);
-
-                    contour_set->set_raw_coordinates(compression_buffer.data(), compressed_size);
-                    contour_set->set_raw_start_indices(indices.data(), indices.size() * sizeof(int32_t));
-                    contour_set->set_uncompressed_coordinates_size(src_size);
-                    contour_set->set_decimation_factor(pixel_rounding);
                 }
+                contour_set->set_raw_start_indices(indices.data(), indices.size() * sizeof(int32_t));
             }
             // Only use deflate compression if contours don't have ZSTD compression
-            SendFileEvent(partial_response.file_id(), CARTA::EventType::CONTOUR_IMAGE_DATA, 0, partial_response, compression_level < 1);
+            SendFileEvent(partial_response.file_id(), CARTA::EventType::CONTOUR_IMAGE_DATA, 0, partial_response, !compressed);
         };
 
         if (frame->ContourImage(callback)) {
@@ -1772,14 +1790,16 @@ void Session::UpdateImageData(int file_id, bool send_image_histogram, bool z_cha
 
         if (z_changed || stokes_changed) {
             if (send_image_histogram) {
-                SendRegionHistogramData(file_id, IMAGE_REGION_ID);
+                OnMessageTask* tsk = new ImageHistogramTask(this, file_id);
+                ThreadManager::QueueTask(tsk);
             }
 
-            SendRegionStatsData(file_id, IMAGE_REGION_ID);
-
+            // Spatial profiles are read from tiles, and are sent before the stats which need the full plane
             if (z_changed) { // requirements sent for stokes change
                 SendSpatialProfileDataByFileId(file_id);
             }
+
+            SendRegionStatsData(file_id, IMAGE_REGION_ID);
         }
     }
 }
@@ -1816,6 +1836,13 @@ void Session::RegionDataStreams(int file_id, int region_id) {
     }
 }
 
+void Session::SendImageHistogramData(int file_id) {
+    if (!SendRegionHistogramData(file_id, IMAGE_REGION_ID) && _frames.count(file_id)) {
+        std::string message = fmt::format("Image histogram for file id {} failed", file_id);
+        SendLogEvent(message, {"histogram"}, CARTA::ErrorSeverity::ERROR);
+    }
+}
+
 bool Session::SendVectorFieldData(int file_id) {
     if (_frames.count(file_id)) {
         auto frame = _frames.at(file_id);
@@ -1858,7 +1885,7 @@ void Session::SendEvent(CARTA::EventType event_type, uint32_t event_id, const go
     size_t required_size = message_length + sizeof(EventHeader);
     std::pair<std::vector<char>, bool> msg_vs_compress;
     std::vector<char>& msg = msg_vs_compress.first;
-    msg.resize(required_size, 0);
+    msg = CharBufferPool::Take(required_size);
     EventHeader* head = (EventHeader*)msg.data();
 
     head->type = event_type;
@@ -1867,7 +1894,8 @@ void Session::SendEvent(CARTA::EventType event_type, uint32_t event_id, const go
     message.SerializeToArray(msg.data() + sizeof(EventHeader), message_length);
     // Skip compression on files smaller than 1 kB
     msg_vs_compress.second = compress && required_size > 1024;
-    _out_msgs.push(msg_vs_compress);
+    _compression_policy.OnQueued(required_size);
+    _out_msgs.push(std::move(msg_vs_compress));
 
     // uWS::Loop::defer(function) is the only thread-safe function, use it to defer the calling of a function to the thread that runs the
     // Loop.
@@ -1883,12 +1911,19 @@ void Session::SendEvent(CARTA::EventType event_type, uint32_t event_id, const go
                             spdlog::error("Failed to send message of size {} kB", sv.size() / 1024.0);
                         }
                     });
+                    // The message has been copied into the socket buffer
+                    _compression_policy.OnSent(sv.size(), _socket->getBufferedAmount());
+                    CharBufferPool::Return(std::move(msg.first));
                 }
             }
         });
     }
 }
 
+void Session::OnDrain(size_t buffered_amount) {
+    _compression_policy.OnDrain(buffered_amount);
+}
+
 void Session::SendFileEvent(
     int32_t file_id, CARTA::EventType event_type, uint32_t event_id, google::protobuf::MessageLite& message, bool compress) {
     // do not send if file is closed
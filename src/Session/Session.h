@@ -24,10 +24,12 @@
 #include <casacore/casa/aips.h>
 
 #include "AnimationObject.h"
+#include "CompressionPolicy.h"
 #include "CursorSettings.h"
 #include "FileList/FileListHandler.h"
 #include "Frame/Frame.h"
 #include "ImageData/StokesFilesConnector.h"
+#include "ProfileEncoder.h"
 #include "Region/RegionHandler.h"
 #include "SessionContext.h"
 #include "ThreadingManager/Concurrency.h"
@@ -38,6 +40,7 @@
 #define HISTOGRAM_CANCEL -1.0
 #define UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS 2.0
 #define LOADER_CACHE_SIZE 25
+#define MAX_PREFETCH_TILES 64
 
 namespace carta {
 
@@ -79,6 +82,8 @@ public:
         CARTA::OpenFileAck* open_file_ack);
     void OnCloseFile(const CARTA::CloseFile& message);
     void OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool skip_data = false);
+    // Warm the tile caches after a tile request; cancelled by the next tile request
+    void PrefetchTiles(const CARTA::AddRequiredTiles& message, int z, int stokes, uint32_t prefetch_id);
     void OnSetImageChannels(const CARTA::SetImageChannels& message);
     void OnSetCursor(const CARTA::SetCursor& message, uint32_t request_id);
     bool OnSetRegion(const CARTA::SetRegion& message, uint32_t request_id, bool silent = false);
@@ -207,6 +212,8 @@ public:
 
     // RegionDataStreams
     void RegionDataStreams(int file_id, int region_id);
+    // Image histogram of the current plane, sent from a task since it may need the full plane
+    void SendImageHistogramData(int file_id);
     bool SendSpectralProfileData(int file_id, int region_id, bool stokes_changed = false);
 
     CursorSettings _file_settings;
@@ -233,6 +240,9 @@ public:
         _animation_active = val;
     }
 
+    // Called by the socket thread when the WebSocket backpressure is drained
+    void OnDrain(size_t buffered_amount);
+
 protected:
     // File info for file list (extended info for each hdu_name)
     bool FillExtendedFileInfo(std::map<std::string, CARTA::FileInfoExtended>& hdu_info_map, CARTA::FileInfo& file_info,
@@ -313,6 +323,12 @@ protected:
     // message queue <msg, compress>
     concurrent_queue<std::pair<std::vector<char>, bool>> _out_msgs;
 
+    // Adapts tile and contour compression to the backlog of outgoing messages
+    CompressionPolicy _compression_policy;
+
+    // Encodes profiles as negotiated with the client
+    ProfileEncoder _profile_encoder;
+
     // context that enables all tasks associated with a session to be cancelled.
     SessionContext _base_context;
 
@@ -322,6 +338,7 @@ protected:
     SessionContext _animation_context;
 
     std::atomic<int> _ref_count;
+    std::atomic<uint32_t> _tile_prefetch_id;
     int _animation_id;
     bool _connected;
     static volatile int _num_sessions;
@@ -119,6 +119,7 @@ void SessionManager::OnDrain(WSType* ws) {
     if (session) {
         spdlog::debug("Draining WebSocket backpressure: client {} [{}]. Remaining buffered amount: {} (bytes).", session->GetId(),
             session->GetAddress(), ws->getBufferedAmount());
+        session->OnDrain(ws->getBufferedAmount());
     } else {
         spdlog::debug("Draining WebSocket backpressure: unknown client. Remaining buffered amount: {} (bytes).", ws->getBufferedAmount());
     }
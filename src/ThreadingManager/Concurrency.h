@@ -11,6 +11,7 @@
 #include <list>
 #include <mutex>
 #include <shared_mutex>
+#include <utility>
 
 namespace carta {
 /*
@@ -27,7 +28,7 @@ public:
 
     void push(T elt) {
         _mtx.lock();
-        _q.push_back(elt);
+        _q.push_back(std::move(elt));
         _mtx.unlock();
     }
 
@@ -36,7 +37,7 @@ public:
         _mtx.lock();
         if (!_q.empty()) {
             ret = true;
-            elt = _q.front();
+            elt = std::move(_q.front());
             _q.pop_front();
         }
         _mtx.unlock();
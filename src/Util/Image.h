@@ -48,6 +48,7 @@
 // raster image data
 #define TILE_SIZE 256
 #define CHUNK_SIZE 512
+#define MAX_CHUNK_PIXELS 4194304 // chunks aligned with the storage of the image
 
 // histograms
 #define AUTO_BIN_SIZE -1
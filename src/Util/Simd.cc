@@ -0,0 +1,60 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "Simd.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace carta {
+
+static SimdLevel DetectSimdLevel() {
+#ifdef SIMD_DISPATCH
+    // Also checks that the operating system saves the AVX and AVX-512 registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("avx")) {
+        return SimdLevel::AVX;
+    }
+#endif
+    return SimdLevel::SSE4;
+}
+
+// Constant initialized, so that kernels can be called during static initialization
+static std::atomic<SimdLevel> simd_level_limit(SimdLevel::AVX512);
+
+SimdLevel GetSimdLevel() {
+    static const SimdLevel detected_simd_level = DetectSimdLevel();
+    return std::min(detected_simd_level, simd_level_limit.load(std::memory_order_relaxed));
+}
+
+void SetSimdLevel(SimdLevel level) {
+    simd_level_limit = level;
+}
+
+std::string SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX512:
+            return "AVX-512";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::AVX:
+            return "AVX";
+        default:
+#ifdef _ARM_ARCH_
+            return "NEON";
+#else
+            return "SSE4";
+#endif
+    }
+}
+
+} // namespace carta
@@ -0,0 +1,33 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND__UTIL_SIMD_H_
+#define CARTA_BACKEND__UTIL_SIMD_H_
+
+#include <string>
+
+// On x86, kernels are compiled for several instruction sets with target attributes, independently of the compiler flags, and the
+// best one supported by the CPU is chosen at runtime. On ARM, only the SSE kernels are compiled (translated to NEON by sse2neon).
+#if !defined(_ARM_ARCH_) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_DISPATCH 1
+#define SIMD_TARGET_AVX __attribute__((target("avx")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
+namespace carta {
+
+enum class SimdLevel { SSE4 = 0, AVX = 1, AVX2 = 2, AVX512 = 3 };
+
+// Best instruction set supported by the CPU and the operating system, detected once; lower if limited with SetSimdLevel
+SimdLevel GetSimdLevel();
+// Limits the instruction set used by the kernels, e.g. to compare their results; levels above the detected one are ignored
+void SetSimdLevel(SimdLevel level);
+std::string SimdLevelName(SimdLevel level);
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__UTIL_SIMD_H_
@@ -12,6 +12,7 @@
 #include <gtest/gtest.h>
 
 #include "DataStream/Smoothing.h"
+#include "Util/Simd.h"
 
 #ifdef COMPILE_PERFORMANCE_TESTS
 #include <spdlog/fmt/fmt.h>
@@ -134,7 +135,7 @@ public:
         return std::move(scalar_result);
     }
 
-#ifdef __AVX__
+#ifdef SIMD_DISPATCH
     Matrix2F DownsampleTileAVX(const Matrix2F& m, int downsample_factor) {
         int result_rows = ceil(m.nrow() / (float)(downsample_factor));
         int result_columns = ceil(m.ncolumn() / (float)(downsample_factor));
@@ -143,9 +144,52 @@ public:
             m.data(), scalar_result.data(), m.ncolumn(), m.nrow(), scalar_result.ncolumn(), scalar_result.nrow(), 0, 0, downsample_factor);
         return std::move(scalar_result);
     }
+
+    Matrix2F DownsampleTileAVX512(const Matrix2F& m, int downsample_factor) {
+        int result_rows = ceil(m.nrow() / (float)(downsample_factor));
+        int result_columns = ceil(m.ncolumn() / (float)(downsample_factor));
+        Matrix2F scalar_result(result_rows, result_columns);
+        BlockSmoothAVX512(
+            m.data(), scalar_result.data(), m.ncolumn(), m.nrow(), scalar_result.ncolumn(), scalar_result.nrow(), 0, 0, downsample_factor);
+        return std::move(scalar_result);
+    }
 #endif
 };
 
+TEST_F(BlockSmoothingTest, TestGaussianSmoothTiles) {
+    // Several tiles in both directions, with partial tiles at the edges
+    auto m1 = RandomMatrix(700, 1100, 0.05f);
+    const int smoothing_factor = 4;
+    const int64_t apron = smoothing_factor - 1;
+    const int64_t src_width = m1.ncolumn();
+    const int64_t src_height = m1.nrow();
+    const int64_t dest_width = src_width - 2 * apron;
+    const int64_t dest_height = src_height - 2 * apron;
+
+    std::vector<float> smoothed(dest_width * dest_height);
+    ASSERT_TRUE(GaussianSmooth(m1.data(), smoothed.data(), src_width, src_height, dest_width, dest_height, smoothing_factor));
+
+    // Untiled horizontal and vertical passes over the whole image
+    std::vector<float> kernel(2 * apron + 1);
+    MakeKernel(kernel, apron / 2.0);
+    std::vector<float> horizontal(dest_width * src_height);
+    std::vector<float> reference(dest_width * dest_height);
+    ASSERT_TRUE(RunKernel(kernel, m1.data(), horizontal.data(), src_width, src_height, dest_width, src_height, false));
+    ASSERT_TRUE(RunKernel(kernel, horizontal.data(), reference.data(), dest_width, src_height, dest_width, dest_height, true));
+
+    for (int64_t j = 0; j < dest_height; j++) {
+        for (int64_t i = 0; i < dest_width; i++) {
+            float value = smoothed[j * dest_width + i];
+            if (std::isnan(m1.data()[(j + apron) * src_width + i + apron])) {
+                EXPECT_TRUE(std::isnan(value));
+            } else {
+                float expected = reference[j * dest_width + i];
+                EXPECT_TRUE(value == expected || (std::isnan(value) && std::isnan(expected)));
+            }
+        }
+    }
+}
+
 TEST_F(BlockSmoothingTest, TestControl) {
     for (auto nan_fraction : nan_fractions) {
         for (auto i = 0; i < NUM_ITERS; i++) {
@@ -207,9 +251,12 @@ TEST_F(BlockSmoothingTest, TestSSEPerformance) {
 }
 #endif
 
-#ifdef __AVX__
+#ifdef SIMD_DISPATCH
 
 TEST_F(BlockSmoothingTest, TestAVXAccuracy) {
+    if (GetSimdLevel() < SimdLevel::AVX) {
+        GTEST_SKIP() << "AVX is not supported";
+    }
     for (auto nan_fraction : nan_fractions) {
         for (auto i = 0; i < NUM_ITERS; i++) {
             auto m1 = RandomMatrix(size_random(mt), size_random(mt), nan_fraction);
@@ -232,6 +279,9 @@ TEST_F(BlockSmoothingTest, TestAVXAccuracy) {
 
 #ifdef COMPILE_PERFORMANCE_TESTS
 TEST_F(BlockSmoothingTest, TestAVXPerformance) {
+    if (GetSimdLevel() < SimdLevel::AVX) {
+        GTEST_SKIP() << "AVX is not supported";
+    }
     carta::Timer t;
     for (auto i = 0; i < NUM_ITERS; i++) {
         auto m1 = RandomMatrix(size_random(mt), size_random(mt), 0);
@@ -251,4 +301,83 @@ TEST_F(BlockSmoothingTest, TestAVXPerformance) {
 }
 #endif
 
+TEST_F(BlockSmoothingTest, TestAVX512Accuracy) {
+    if (GetSimdLevel() < SimdLevel::AVX512) {
+        GTEST_SKIP() << "AVX-512 is not supported";
+    }
+    for (auto nan_fraction : nan_fractions) {
+        for (auto i = 0; i < NUM_ITERS; i++) {
+            auto m1 = RandomMatrix(size_random(mt), size_random(mt), nan_fraction);
+            for (auto j = 16; j <= MAX_DOWNSAMPLE_FACTOR; j *= 2) {
+                auto smoothed_scalar = DownsampleTileScalar(m1, j);
+                auto smoothed_avx512 = DownsampleTileAVX512(m1, j);
+                Matrix2F abs_diff = abs(smoothed_scalar - smoothed_avx512);
+                auto sum_error = nansum(abs_diff);
+                auto max_error = nanmax(abs_diff);
+
+                EXPECT_EQ(MatchingNANs(smoothed_scalar, smoothed_avx512), true);
+                if (std::isfinite(sum_error)) {
+                    EXPECT_LE(sum_error, MAX_SUM_ERROR);
+                    EXPECT_LE(max_error, MAX_ABS_ERROR);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(BlockSmoothingTest, TestDispatchedGaussianSmooth) {
+    // Kernels of each supported instruction set give the same smoothed image
+    auto m1 = RandomMatrix(size_random(mt), size_random(mt), 0.05f);
+    const int smoothing_factor = 3;
+    const int64_t dest_width = m1.ncolumn() - 2 * (smoothing_factor - 1);
+    const int64_t dest_height = m1.nrow() - 2 * (smoothing_factor - 1);
+    auto detected_level = GetSimdLevel();
+
+    std::vector<float> reference(dest_width * dest_height);
+    SetSimdLevel(SimdLevel::SSE4);
+    ASSERT_TRUE(GaussianSmooth(m1.data(), reference.data(), m1.ncolumn(), m1.nrow(), dest_width, dest_height, smoothing_factor));
+
+    for (auto level : {SimdLevel::AVX, SimdLevel::AVX512}) {
+        if (level > detected_level) {
+            continue;
+        }
+        SetSimdLevel(level);
+        std::vector<float> smoothed(dest_width * dest_height);
+        ASSERT_TRUE(GaussianSmooth(m1.data(), smoothed.data(), m1.ncolumn(), m1.nrow(), dest_width, dest_height, smoothing_factor));
+        for (size_t i = 0; i < smoothed.size(); i++) {
+            if (!std::isfinite(reference[i])) {
+                EXPECT_FALSE(std::isfinite(smoothed[i]));
+            } else {
+                EXPECT_NEAR(smoothed[i], reference[i], MAX_ABS_ERROR);
+            }
+        }
+    }
+    SetSimdLevel(SimdLevel::AVX512);
+}
+
+TEST_F(BlockSmoothingTest, TestDispatchedNearestNeighbor) {
+    auto m1 = RandomMatrix(size_random(mt), size_random(mt), 0.1f);
+    auto detected_level = GetSimdLevel();
+    for (int factor : {2, 3, 7, 16}) {
+        int64_t dest_width = (m1.ncolumn() - 1) / factor;
+        int64_t dest_height = (m1.nrow() - 1) / factor;
+        for (auto level : {SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (level > detected_level) {
+                continue;
+            }
+            SetSimdLevel(level);
+            std::vector<float> dest(dest_width * dest_height);
+            NearestNeighbor(m1.data(), dest.data(), m1.ncolumn(), dest_width, dest_height, 1, 1, factor);
+            for (int64_t j = 0; j < dest_height; j++) {
+                for (int64_t i = 0; i < dest_width; i++) {
+                    float expected = m1.data()[(1 + j * factor) * m1.ncolumn() + 1 + i * factor];
+                    float value = dest[j * dest_width + i];
+                    EXPECT_TRUE(value == expected || (std::isnan(value) && std::isnan(expected)));
+                }
+            }
+        }
+    }
+    SetSimdLevel(SimdLevel::AVX512);
+}
+
 #endif
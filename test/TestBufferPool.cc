@@ -0,0 +1,125 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "Cache/BufferPool.h"
+
+using namespace carta;
+
+TEST(BufferPoolTest, SizeClasses) {
+    EXPECT_EQ(BufferPoolBase::SizeClass(1024), 1024);
+    EXPECT_EQ(BufferPoolBase::SizeClass(1025), 1280);
+    EXPECT_EQ(BufferPoolBase::SizeClass(1280), 1280);
+    EXPECT_EQ(BufferPoolBase::SizeClass(2000), 2048);
+    EXPECT_EQ(BufferPoolBase::SizeClass(65536), 65536);
+
+    EXPECT_EQ(BufferPoolBase::FloorSizeClass(1279), 1024);
+    EXPECT_EQ(BufferPoolBase::FloorSizeClass(1280), 1280);
+    EXPECT_EQ(BufferPoolBase::FloorSizeClass(2047), 1792);
+
+    for (size_t size = 5; size < 100000; size += 37) {
+        size_t size_class = BufferPoolBase::SizeClass(size);
+        EXPECT_GE(size_class, size);
+        EXPECT_LE(size_class, size + size / 4);
+        EXPECT_EQ(BufferPoolBase::FloorSizeClass(size_class), size_class);
+    }
+}
+
+TEST(BufferPoolTest, ReusesBuffers) {
+    FloatBufferPool::Clear();
+    auto stats = FloatBufferPool::GetStats();
+
+    auto buffer = FloatBufferPool::Take(65536);
+    EXPECT_EQ(buffer.size(), 65536);
+    const float* data = buffer.data();
+    FloatBufferPool::Return(std::move(buffer));
+
+    // Any size in the same size class gets the same buffer
+    auto reused = FloatBufferPool::Take(60000);
+    EXPECT_EQ(reused.size(), 60000);
+    EXPECT_EQ(reused.data(), data);
+
+    auto new_stats = FloatBufferPool::GetStats();
+    EXPECT_EQ(new_stats.misses, stats.misses + 1);
+    EXPECT_EQ(new_stats.local_hits, stats.local_hits + 1);
+    EXPECT_EQ(new_stats.returned, stats.returned + 1);
+    EXPECT_EQ(new_stats.pooled_bytes, 0);
+}
+
+TEST(BufferPoolTest, SharedBuffersAreReturned) {
+    CharBufferPool::Clear();
+    const char* data;
+    {
+        auto buffer = CharBufferPool::TakeShared(100000);
+        data = buffer->data();
+    }
+    EXPECT_GT(CharBufferPool::GetStats().pooled_bytes, 0);
+    EXPECT_EQ(CharBufferPool::Take(100000).data(), data);
+}
+
+TEST(BufferPoolTest, BuffersMoveBetweenThreads) {
+    StringBufferPool::Clear();
+    auto stats = StringBufferPool::GetStats();
+
+    // Fill the free list of another thread, so that the remaining buffers go to the shared free list
+    std::thread returning_thread([]() {
+        for (int i = 0; i < BUFFER_POOL_LOCAL_COUNT + 2; ++i) {
+            std::string buffer(10000, 'x');
+            StringBufferPool::Return(std::move(buffer));
+        }
+    });
+    returning_thread.join();
+
+    auto buffer = StringBufferPool::Take(8000);
+    EXPECT_EQ(buffer.size(), 8000);
+
+    auto new_stats = StringBufferPool::GetStats();
+    EXPECT_EQ(new_stats.returned, stats.returned + BUFFER_POOL_LOCAL_COUNT + 2);
+    EXPECT_EQ(new_stats.global_hits, stats.global_hits + 1);
+    EXPECT_EQ(new_stats.misses, stats.misses);
+}
+
+TEST(BufferPoolTest, BuffersReturnedOnAnotherThreadAreTakenLocally) {
+    FloatBufferPool::Clear();
+
+    // As for outgoing messages, the buffers are returned on a thread which does not take buffers
+    std::vector<std::vector<float>> buffers;
+    for (int i = 0; i < 2 * BUFFER_POOL_BATCH_SIZE; ++i) {
+        buffers.push_back(FloatBufferPool::Take(5000));
+    }
+    std::thread returning_thread([&]() {
+        for (auto& buffer : buffers) {
+            FloatBufferPool::Return(std::move(buffer));
+        }
+    });
+    returning_thread.join();
+
+    // Only the first take of a batch locks the shared free list
+    auto stats = FloatBufferPool::GetStats();
+    for (int i = 0; i < 2 * BUFFER_POOL_BATCH_SIZE; ++i) {
+        buffers[i] = FloatBufferPool::Take(5000);
+    }
+
+    auto new_stats = FloatBufferPool::GetStats();
+    EXPECT_EQ(new_stats.misses, stats.misses);
+    EXPECT_EQ(new_stats.global_hits, stats.global_hits + 2);
+    EXPECT_EQ(new_stats.local_hits, stats.local_hits + 2 * BUFFER_POOL_BATCH_SIZE - 2);
+    EXPECT_EQ(new_stats.pooled_bytes, 0);
+}
+
+TEST(BufferPoolTest, SmallBuffersAreNotPooled) {
+    auto stats = CharBufferPool::GetStats();
+    auto buffer = CharBufferPool::Take(100);
+    EXPECT_EQ(buffer.size(), 100);
+    CharBufferPool::Return(std::move(buffer));
+
+    auto new_stats = CharBufferPool::GetStats();
+    EXPECT_EQ(new_stats.misses, stats.misses);
+    EXPECT_EQ(new_stats.returned, stats.returned);
+}
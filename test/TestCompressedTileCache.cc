@@ -0,0 +1,45 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <gtest/gtest.h>
+
+#include "Cache/CompressedTileCache.h"
+
+using namespace carta;
+
+static CompressedTileCache::TilePtr MakeTile(size_t compressed_size, float compression_quality = 11) {
+    auto tile = std::make_shared<CompressedTile>();
+    tile->width = 256;
+    tile->height = 256;
+    tile->compression_quality = compression_quality;
+    tile->image_data.resize(compressed_size);
+    return tile;
+}
+
+TEST(CompressedTileCacheTest, KeysDifferByTilePlaneAndCompression) {
+    CompressedTileCache cache(1024);
+    CompressedTileCache::Key key(0, 1, 2, 3, 0, 1, 11);
+    auto tile = MakeTile(100, 16);
+    cache.Add(key, tile);
+    EXPECT_EQ(cache.Get(key), tile);
+
+    EXPECT_EQ(cache.Get(CompressedTileCache::Key(1, 1, 2, 3, 0, 1, 11)), nullptr);
+    EXPECT_EQ(cache.Get(CompressedTileCache::Key(0, 2, 2, 3, 0, 1, 11)), nullptr);
+    EXPECT_EQ(cache.Get(CompressedTileCache::Key(0, 1, 3, 3, 0, 1, 11)), nullptr);
+    EXPECT_EQ(cache.Get(CompressedTileCache::Key(0, 1, 2, 4, 0, 1, 11)), nullptr);
+    EXPECT_EQ(cache.Get(CompressedTileCache::Key(0, 1, 2, 3, 1, 1, 11)), nullptr);
+    EXPECT_EQ(cache.Get(CompressedTileCache::Key(0, 1, 2, 3, 0, 0, 11)), nullptr);
+    EXPECT_EQ(cache.Get(CompressedTileCache::Key(0, 1, 2, 3, 0, 1, 12)), nullptr);
+}
+
+TEST(CompressedTileCacheTest, TileBytesIncludeNanEncodings) {
+    CompressedTileCache cache(1024);
+    auto tile = std::make_shared<CompressedTile>();
+    tile->image_data.resize(100);
+    tile->nan_encodings = {0, 10, 20};
+    cache.Add(CompressedTileCache::Key(0, 0, 0, 0, 0, 1, 11), tile);
+    EXPECT_EQ(cache.GetSize(), 100 + 3 * sizeof(int32_t));
+}
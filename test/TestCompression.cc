@@ -0,0 +1,155 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include <gtest/gtest.h>
+#include <zstd.h>
+
+#include "DataStream/Compression.h"
+
+#ifdef COMPILE_PERFORMANCE_TESTS
+#include <spdlog/fmt/fmt.h>
+#include "CommonTestUtilities.h"
+#include "Timer/Timer.h"
+#endif
+
+using namespace carta;
+
+static std::vector<float> RandomTile(int width, int height) {
+    std::mt19937 mt(1234);
+    std::uniform_real_distribution<float> float_random(0, 1);
+    std::vector<float> tile(width * height);
+    for (auto& value : tile) {
+        value = float_random(mt);
+    }
+    return tile;
+}
+
+TEST(CompressionTest, CompressTileUsesHighPrecisionForEmptyData) {
+    for (int size : {256, 40}) {
+        std::vector<float> tile(size * size, 0.0);
+        std::string compression_buffer;
+        EXPECT_EQ(CompressTile(tile, compression_buffer, size, size, 12, 32), 32);
+        EXPECT_GT((float)(sizeof(float) * tile.size()) / compression_buffer.size(), TILE_HIGH_PRECISION_MIN_RATIO);
+    }
+}
+
+TEST(CompressionTest, CompressTileUsesRequestedPrecisionForNoise) {
+    for (int size : {256, 40}) {
+        auto tile = RandomTile(size, size);
+        std::string compression_buffer;
+        EXPECT_EQ(CompressTile(tile, compression_buffer, size, size, 12, 32), 12);
+
+        std::vector<char> buffer(compression_buffer.begin(), compression_buffer.end());
+        std::vector<float> decompressed;
+        EXPECT_EQ(Decompress(decompressed, buffer, size, size, 12), 0);
+        ASSERT_EQ(decompressed.size(), tile.size());
+        for (size_t i = 0; i < tile.size(); ++i) {
+            EXPECT_NEAR(decompressed[i], tile[i], 0.02);
+        }
+    }
+}
+
+TEST(CompressionTest, StringAndVectorBuffersMatch) {
+    auto tile = RandomTile(256, 256);
+    std::vector<char> vector_buffer;
+    size_t compressed_size;
+    EXPECT_EQ(Compress(tile, 0, vector_buffer, compressed_size, 256, 256, 16), 0);
+
+    std::string string_buffer;
+    EXPECT_EQ(Compress(tile, 0, string_buffer, 256, 256, 16), 0);
+    ASSERT_EQ(string_buffer.size(), compressed_size);
+    EXPECT_TRUE(std::equal(string_buffer.begin(), string_buffer.end(), vector_buffer.begin()));
+}
+
+TEST(CompressionTest, LosslessRoundTrip) {
+    std::vector<std::pair<int, int>> sizes = {{256, 256}, {131, 77}, {1, 5}};
+    for (auto& [width, height] : sizes) {
+        auto tile = RandomTile(width + 3, height);
+        tile[5] = NAN;
+        tile[tile.size() - 1] = -INFINITY;
+
+        // Compress from an offset, as for the other codecs
+        std::string compression_buffer;
+        ASSERT_EQ(CompressLossless(tile, 3, compression_buffer, width, height), 0);
+
+        std::vector<float> decompressed;
+        ASSERT_EQ(DecompressLossless(decompressed, compression_buffer, width, height), 0);
+        ASSERT_EQ(decompressed.size(), width * height);
+        EXPECT_EQ(std::memcmp(decompressed.data(), tile.data() + 3, sizeof(float) * width * height), 0);
+    }
+}
+
+TEST(CompressionTest, CompressVerticesRoundTrip) {
+    // A random walk, as in a contour; the large chunk is compressed by zstd worker threads, if available
+    for (size_t num_vertices : {(size_t)1001, (size_t)VERTEX_MT_MIN_SIZE / 4}) {
+        std::mt19937 mt(1234);
+        std::normal_distribution<float> step(0, 0.5);
+        std::vector<float> vertices(2 * num_vertices);
+        vertices[0] = vertices[1] = 100;
+        for (size_t i = 2; i < vertices.size(); ++i) {
+            vertices[i] = vertices[i - 2] + step(mt);
+        }
+
+        std::vector<int32_t> expected;
+        RoundAndEncodeVertices(vertices, expected, 4);
+
+        for (int level : {1, VERTEX_MT_MIN_LEVEL, 1}) {
+            std::string compression_buffer;
+            ASSERT_EQ(CompressVertices(vertices, compression_buffer, 4, level), 0);
+
+            std::vector<int32_t> decompressed(expected.size());
+            size_t decompressed_size = ZSTD_decompress(
+                decompressed.data(), decompressed.size() * sizeof(int32_t), compression_buffer.data(), compression_buffer.size());
+            ASSERT_EQ(decompressed_size, expected.size() * sizeof(int32_t));
+            EXPECT_EQ(decompressed, expected);
+        }
+    }
+}
+
+#ifdef COMPILE_PERFORMANCE_TESTS
+static void LosslessBenchmark(const std::string& name, const std::vector<float>& image, size_t width, size_t height) {
+    carta::Timer t;
+    size_t raw_size(0);
+    size_t compressed_size(0);
+    std::vector<float> tile(256 * 256);
+    std::string compression_buffer;
+    for (size_t y = 0; y + 256 <= height; y += 256) {
+        for (size_t x = 0; x + 256 <= width; x += 256) {
+            for (size_t row = 0; row < 256; row++) {
+                std::copy_n(image.begin() + (y + row) * width + x, 256, tile.begin() + row * 256);
+            }
+            t.Start("lossless");
+            CompressLossless(tile, 0, compression_buffer, 256, 256);
+            t.End("lossless");
+            raw_size += sizeof(float) * tile.size();
+            compressed_size += compression_buffer.size();
+        }
+    }
+
+    double milliseconds = t.GetMeasurement("lossless").count();
+    fmt::print("Lossless {} tiles: compression ratio {:.2f}, {:.0f} MB/s\n", name, (double)raw_size / compressed_size,
+        raw_size * 1e-3 / milliseconds);
+    EXPECT_GT(raw_size, compressed_size);
+}
+
+TEST(CompressionTest, LosslessPerformance) {
+    // Noise is the worst case for lossless compression
+    FitsDataReader reader(ImageGenerator::GeneratedFitsImagePath("1024 1024"));
+    LosslessBenchmark("noise image", reader.ReadXY(), reader.Width(), reader.Height());
+
+    std::vector<float> smooth(1024 * 1024);
+    for (size_t y = 0; y < 1024; y++) {
+        for (size_t x = 0; x < 1024; x++) {
+            smooth[y * 1024 + x] = std::exp(-((x - 512.0) * (x - 512.0) + (y - 400.0) * (y - 400.0)) / 50000.0);
+        }
+    }
+    LosslessBenchmark("smooth", smooth, 1024, 1024);
+}
+#endif
@@ -0,0 +1,62 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <gtest/gtest.h>
+
+#include "Session/CompressionPolicy.h"
+
+using namespace carta;
+
+using namespace std::chrono_literals;
+
+TEST(CompressionPolicyTest, FastConnectionKeepsRequestedSettings) {
+    CompressionPolicy policy;
+    auto now = CompressionPolicy::Clock::now();
+    for (int i = 0; i < 100; i++) {
+        policy.OnQueued(1000000);
+        now += 10ms;
+        policy.OnSent(1000000, 0, now);
+    }
+
+    EXPECT_EQ(policy.BacklogDelay(), 0);
+    EXPECT_EQ(policy.TileQuality(11), 11);
+    EXPECT_EQ(policy.ContourCompressionLevel(8), 8);
+    EXPECT_FALSE(policy.DeflateRawTiles());
+}
+
+TEST(CompressionPolicyTest, SlowConnectionReducesTileQuality) {
+    CompressionPolicy policy;
+    auto now = CompressionPolicy::Clock::now();
+
+    // 1 MB sent every 100 ms, of which only 100 kB leave the socket: 1 MB/s connection
+    size_t buffered = 0;
+    for (int i = 0; i < 20; i++) {
+        policy.OnQueued(1000000);
+        buffered += 900000;
+        now += 100ms;
+        policy.OnSent(1000000, buffered, now);
+    }
+    EXPECT_GT(policy.BacklogDelay(), 4.0);
+    EXPECT_EQ(policy.TileQuality(20), 12);
+    EXPECT_EQ(policy.TileQuality(11), POLICY_MIN_ZFP_PRECISION);
+    EXPECT_EQ(policy.TileQuality(6), 6);
+    EXPECT_EQ(policy.ContourCompressionLevel(8), 16);
+    EXPECT_EQ(policy.ContourCompressionLevel(0), 0);
+    EXPECT_TRUE(policy.DeflateRawTiles());
+
+    // Back to full quality once the socket is drained
+    now += 10s;
+    policy.OnDrain(0, now);
+    EXPECT_EQ(policy.TileQuality(20), 20);
+}
+
+TEST(CompressionPolicyTest, QueuedMessagesCount) {
+    CompressionPolicy policy;
+    policy.OnQueued(10000000);
+    EXPECT_GT(policy.BacklogDelay(), 0);
+    policy.ClearQueued();
+    EXPECT_EQ(policy.BacklogDelay(), 0);
+}
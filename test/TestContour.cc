@@ -4,11 +4,17 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <algorithm>
+#include <cmath>
+#include <map>
+
 #include <gtest/gtest.h>
 
 #include "CommonTestUtilities.h"
+#include "DataStream/Contouring.h"
 #include "ImageData/FileLoader.h"
 #include "Util/Message.h"
+#include "Util/Simd.h"
 #include "src/Frame/Frame.h"
 
 static const std::string IMAGE_OPTS = "-s 0";
@@ -167,3 +173,127 @@ TEST_F(ContourTest, BlockAverageHdf5File) {
 TEST_F(ContourTest, BlockAverageHdf5FileNaN) {
     GenerateContour(500, 500, IMAGE_OPTS, CARTA::FileType::HDF5, CARTA::SmoothingMode::BlockAverage);
 }
+
+TEST_F(ContourTest, ChunksAreSentInOrder) {
+    int width(400), height(300);
+    std::vector<float> image(width * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            image[y * width + x] = std::sin(x / 7.0) * std::cos(y / 11.0);
+        }
+    }
+    std::vector<double> levels{-0.5, 0, 0.5};
+
+    // Vertices of each level, with start indices relative to the whole level, and the progress of each chunk
+    auto trace = [&](int chunk_size, std::map<double, std::vector<float>>& vertices_map,
+                     std::map<double, std::vector<int32_t>>& indices_map, std::map<double, std::vector<double>>& progress_map) {
+        std::mutex callback_mutex;
+        auto callback = [&](double level, double progress, const std::vector<float>& vertices, const std::vector<int32_t>& indices) {
+            std::unique_lock<std::mutex> ulock(callback_mutex);
+            auto& level_vertices = vertices_map[level];
+            for (auto index : indices) {
+                indices_map[level].push_back(index + level_vertices.size());
+            }
+            level_vertices.insert(level_vertices.end(), vertices.begin(), vertices.end());
+            progress_map[level].push_back(progress);
+        };
+        std::vector<std::vector<float>> vertex_data;
+        std::vector<std::vector<int32_t>> index_data;
+        carta::TraceContours(image.data(), width, height, 1.0, 0, levels, vertex_data, index_data, chunk_size, callback);
+    };
+
+    std::map<double, std::vector<float>> vertices, chunked_vertices;
+    std::map<double, std::vector<int32_t>> indices, chunked_indices;
+    std::map<double, std::vector<double>> progress, chunked_progress;
+    trace(0, vertices, indices, progress);
+    trace(100, chunked_vertices, chunked_indices, chunked_progress);
+
+    for (auto level : levels) {
+        EXPECT_EQ(progress[level].size(), 1);
+        EXPECT_GT(chunked_progress[level].size(), 2);
+        EXPECT_TRUE(std::is_sorted(chunked_progress[level].begin(), chunked_progress[level].end()));
+        EXPECT_DOUBLE_EQ(chunked_progress[level].back(), 1.0);
+        EXPECT_EQ(chunked_vertices[level], vertices[level]);
+        EXPECT_EQ(chunked_indices[level], indices[level]);
+    }
+}
+
+TEST_F(ContourTest, SimdLevelsGiveSameContours) {
+    int width(523), height(311);
+    std::vector<float> image(width * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            image[y * width + x] = ((x * 7 + y * 13) % 29 == 0) ? NAN : std::sin(x / 7.0) * std::cos(y / 11.0);
+        }
+    }
+    // Includes levels which are not representable as floats
+    std::vector<double> levels{-0.5, 0, 0.1, 1.0 / 3, 0.5};
+    carta::ContourCallback callback = [](double, double, const std::vector<float>&, const std::vector<int32_t>&) {};
+
+    auto detected_level = carta::GetSimdLevel();
+    std::vector<std::vector<float>> reference_vertices;
+    std::vector<std::vector<int32_t>> reference_indices;
+    carta::SetSimdLevel(carta::SimdLevel::SSE4);
+    carta::TraceContours(image.data(), width, height, 1.0, 0, levels, reference_vertices, reference_indices, 0, callback);
+
+    for (auto simd_level : {carta::SimdLevel::AVX, carta::SimdLevel::AVX512}) {
+        if (simd_level > detected_level) {
+            continue;
+        }
+        carta::SetSimdLevel(simd_level);
+        std::vector<std::vector<float>> vertices;
+        std::vector<std::vector<int32_t>> indices;
+        carta::TraceContours(image.data(), width, height, 1.0, 0, levels, vertices, indices, 0, callback);
+        EXPECT_EQ(vertices, reference_vertices) << carta::SimdLevelName(simd_level);
+        EXPECT_EQ(indices, reference_indices) << carta::SimdLevelName(simd_level);
+    }
+    carta::SetSimdLevel(carta::SimdLevel::AVX512);
+}
+
+TEST_F(ContourTest, StripsGiveSameContours) {
+    // Closed contours which cross several strips, open contours, and NaN pixels
+    int width(389), height(457);
+    std::vector<float> image(width * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float value = std::sin(x / 23.0) * std::cos(y / 41.0) + 0.1 * std::sin(x * y / 97.0);
+            image[y * width + x] = ((x * 5 + y * 11) % 37 == 0) ? NAN : value;
+        }
+    }
+
+    struct Chunk {
+        double progress;
+        std::vector<float> vertices;
+        std::vector<int32_t> indices;
+    };
+    auto trace = [&](double level, int chunk_size, int num_strips) {
+        std::vector<Chunk> chunks;
+        std::mutex callback_mutex;
+        carta::ContourCallback callback = [&](double, double progress, const std::vector<float>& vertices,
+                                              const std::vector<int32_t>& indices) {
+            std::unique_lock<std::mutex> ulock(callback_mutex);
+            chunks.push_back({progress, vertices, indices});
+        };
+        std::vector<float> vertices;
+        std::vector<int32_t> indices;
+#pragma omp parallel
+#pragma omp single
+        carta::TraceLevel(image.data(), width, height, 1.0, 0, level, vertices, indices, chunk_size, callback, num_strips);
+        return chunks;
+    };
+
+    for (double level : {-0.5, 0.0, 0.3}) {
+        for (int chunk_size : {0, 500}) {
+            auto reference_chunks = trace(level, chunk_size, 1);
+            for (int num_strips : {2, 5, 16, height}) {
+                auto chunks = trace(level, chunk_size, num_strips);
+                ASSERT_EQ(chunks.size(), reference_chunks.size()) << num_strips << " strips";
+                for (int i = 0; i < chunks.size(); ++i) {
+                    EXPECT_EQ(chunks[i].progress, reference_chunks[i].progress);
+                    EXPECT_EQ(chunks[i].vertices, reference_chunks[i].vertices);
+                    EXPECT_EQ(chunks[i].indices, reference_chunks[i].indices);
+                }
+            }
+        }
+    }
+}
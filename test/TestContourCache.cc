@@ -0,0 +1,124 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <map>
+#include <mutex>
+
+#include <gtest/gtest.h>
+
+#include "Cache/ContourCache.h"
+#include "ImageData/FileLoader.h"
+#include "Util/Message.h"
+#include "src/Frame/Frame.h"
+
+#include "CommonTestUtilities.h"
+
+using namespace carta;
+
+#define IMAGE_SIZE 64
+#define CONTOUR_CHUNK_SIZE 20
+
+// Allows access to the contour cache of the frame
+class TestFrame : public Frame {
+public:
+    TestFrame(uint32_t session_id, std::shared_ptr<carta::FileLoader> loader, const std::string& hdu, int default_z = DEFAULT_Z)
+        : Frame(session_id, loader, hdu, default_z) {}
+    FRIEND_TEST(ContourCacheTest, AddedLevelIsTheOnlyOneTraced);
+    FRIEND_TEST(ContourCacheTest, CachedLevelsStreamInChunkOrder);
+};
+
+class ContourCacheTest : public ::testing::Test {
+public:
+    using ChunkList = std::vector<std::pair<double, std::vector<float>>>;
+
+    void SetUp() override {
+        std::string image_path = ImageGenerator::GeneratedFitsImagePath(fmt::format("{} {}", IMAGE_SIZE, IMAGE_SIZE));
+        std::shared_ptr<carta::FileLoader> loader(carta::FileLoader::GetLoader(image_path));
+        _frame = std::make_unique<TestFrame>(0, loader, "0");
+        ASSERT_TRUE(_frame->IsValid());
+    }
+
+    // Progress and vertices of the chunks of each level, in the order in which they were sent
+    std::map<double, ChunkList> Contour(const std::vector<double>& levels) {
+        _frame->SetContourParameters(Message::SetContourParameters(
+            0, 0, 0, IMAGE_SIZE, 0, IMAGE_SIZE, levels, CARTA::SmoothingMode::NoSmoothing, 1, 4, 8, CONTOUR_CHUNK_SIZE));
+
+        std::map<double, ChunkList> chunks;
+        std::mutex chunks_mutex;
+        ContourCallback callback = [&](double level, double progress, const std::vector<float>& vertices, const std::vector<int32_t>&) {
+            std::lock_guard<std::mutex> guard(chunks_mutex);
+            chunks[level].emplace_back(progress, vertices);
+        };
+        EXPECT_TRUE(_frame->ContourImage(callback));
+        return chunks;
+    }
+
+    ContourCache::LevelPtr CachedLevel(double level) {
+        return _frame->_contour_cache.Get(ContourCache::Key(0, 0, CARTA::SmoothingMode::NoSmoothing, 1, level));
+    }
+
+protected:
+    std::unique_ptr<TestFrame> _frame;
+};
+
+TEST(ContourCacheKeyTest, KeysDifferByPlaneSmoothingAndLevel) {
+    ContourCache cache(1024);
+    ContourCache::Key key(3, 0, 0, 1, 0.5);
+    auto level = std::make_shared<ContourLevel>();
+    cache.Add(key, level);
+    EXPECT_EQ(cache.Get(key), level);
+
+    EXPECT_EQ(cache.Get(ContourCache::Key(4, 0, 0, 1, 0.5)), nullptr);
+    EXPECT_EQ(cache.Get(ContourCache::Key(3, 1, 0, 1, 0.5)), nullptr);
+    EXPECT_EQ(cache.Get(ContourCache::Key(3, 0, 1, 4, 0.5)), nullptr);
+    EXPECT_EQ(cache.Get(ContourCache::Key(3, 0, 0, 1, 0.25)), nullptr);
+}
+
+TEST(ContourCacheKeyTest, LevelBytesIncludeAllChunks) {
+    ContourLevel level;
+    level.chunks.push_back({0.5, std::vector<float>(10), std::vector<int32_t>(2)});
+    level.chunks.push_back({1.0, std::vector<float>(6), std::vector<int32_t>(1)});
+    EXPECT_EQ(level.Bytes(), 16 * sizeof(float) + 3 * sizeof(int32_t));
+}
+
+TEST_F(ContourCacheTest, AddedLevelIsTheOnlyOneTraced) {
+    auto first_chunks = Contour({0, 1});
+    auto level_0 = CachedLevel(0);
+    auto level_1 = CachedLevel(1);
+    ASSERT_NE(level_0, nullptr);
+    ASSERT_NE(level_1, nullptr);
+    EXPECT_EQ(CachedLevel(-1), nullptr);
+
+    // Levels traced again would replace the cached levels
+    auto second_chunks = Contour({0, 1, -1});
+    EXPECT_EQ(CachedLevel(0), level_0);
+    EXPECT_EQ(CachedLevel(1), level_1);
+    EXPECT_NE(CachedLevel(-1), nullptr);
+    EXPECT_EQ(second_chunks[0], first_chunks[0]);
+    EXPECT_EQ(second_chunks[1], first_chunks[1]);
+    ASSERT_FALSE(second_chunks[-1].empty());
+    EXPECT_EQ(second_chunks[-1].back().first, 1.0);
+}
+
+TEST_F(ContourCacheTest, CachedLevelsStreamInChunkOrder) {
+    std::vector<double> levels = {-1, 0, 1};
+    auto traced_chunks = Contour(levels);
+    auto cached_chunks = Contour(levels);
+
+    for (double level : levels) {
+        // Small chunks, so that each level is sent in several parts
+        ASSERT_GT(traced_chunks[level].size(), 1);
+        EXPECT_EQ(cached_chunks[level], traced_chunks[level]);
+        EXPECT_EQ(CachedLevel(level)->chunks.size(), traced_chunks[level].size());
+
+        double progress(0);
+        for (auto& chunk : cached_chunks[level]) {
+            EXPECT_GE(chunk.first, progress);
+            progress = chunk.first;
+        }
+        EXPECT_EQ(progress, 1.0);
+    }
+}
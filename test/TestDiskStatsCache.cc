@@ -0,0 +1,155 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <unistd.h>
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include "Cache/DiskStatsCache.h"
+#include "Util/FileSystem.h"
+
+using namespace carta;
+
+class DiskStatsCacheTest : public ::testing::Test {
+public:
+    void SetUp() override {
+        _folder = fs::temp_directory_path() / fmt::format("carta_stats_cache_test_{}", getpid());
+        _image = _folder / "image.fits";
+        DiskStatsCache::SetFolder((_folder / "cache").string());
+        WriteImage(1000);
+
+        _image_basic_stats[10] = BasicStats<float>(100, 50, 0.5, 0.1, -1, 2, 0.6, 36);
+        _cube_basic_stats[0] = BasicStats<float>(1000, 500, 0.5, 0.2, -3, 4, 0.7, 490);
+
+        Histogram image_histogram(4, -1, 2, nullptr, 0);
+        image_histogram.SetHistogramBins({10, 20, 30, 40});
+        _image_histograms[10].push_back(image_histogram);
+
+        Histogram cube_histogram(2, -3, 4, nullptr, 0);
+        cube_histogram.SetHistogramBins({600, 400});
+        _cube_histograms[0].push_back(cube_histogram);
+    }
+
+    void TearDown() override {
+        DiskStatsCache::SetFolder("");
+        std::error_code error_code;
+        fs::remove_all(_folder, error_code);
+    }
+
+    void WriteImage(size_t size) {
+        std::ofstream(_image.string(), std::ios::binary | std::ios::trunc) << std::string(size, ' ');
+    }
+
+    void Save(const SharedImageId& image_id) {
+        ASSERT_TRUE(DiskStatsCache::Save(image_id, DiskStatsCache::GetImageSize(image_id.filename), _image_basic_stats, _image_histograms,
+            _cube_basic_stats, _cube_histograms));
+    }
+
+    bool Load(const SharedImageId& image_id) {
+        _loaded_image_basic_stats.clear();
+        _loaded_cube_basic_stats.clear();
+        _loaded_image_histograms.clear();
+        _loaded_cube_histograms.clear();
+        return DiskStatsCache::Load(image_id, DiskStatsCache::GetImageSize(image_id.filename), _loaded_image_basic_stats,
+            _loaded_image_histograms, _loaded_cube_basic_stats, _loaded_cube_histograms);
+    }
+
+protected:
+    fs::path _folder, _image;
+    DiskStatsCache::StatsMap _image_basic_stats, _cube_basic_stats, _loaded_image_basic_stats, _loaded_cube_basic_stats;
+    DiskStatsCache::HistogramMap _image_histograms, _cube_histograms, _loaded_image_histograms, _loaded_cube_histograms;
+};
+
+TEST_F(DiskStatsCacheTest, SaveAndLoad) {
+    SharedImageId image_id(_image.string(), "0", 1234);
+    Save(image_id);
+    ASSERT_TRUE(Load(image_id));
+
+    ASSERT_EQ(_loaded_image_basic_stats.count(10), 1);
+    auto& stats = _loaded_image_basic_stats[10];
+    EXPECT_EQ(stats.num_pixels, 100);
+    EXPECT_EQ(stats.sum, 50);
+    EXPECT_EQ(stats.stdDev, 0.1);
+    EXPECT_EQ(stats.min_val, -1);
+    EXPECT_EQ(stats.max_val, 2);
+    EXPECT_EQ(stats.sumSq, 36);
+    ASSERT_EQ(_loaded_cube_basic_stats.count(0), 1);
+    EXPECT_EQ(_loaded_cube_basic_stats[0].num_pixels, 1000);
+
+    ASSERT_EQ(_loaded_image_histograms[10].size(), 1);
+    auto& histogram = _loaded_image_histograms[10][0];
+    EXPECT_EQ(histogram.GetMinVal(), -1);
+    EXPECT_EQ(histogram.GetMaxVal(), 2);
+    EXPECT_EQ(histogram.GetBinWidth(), _image_histograms[10][0].GetBinWidth());
+    EXPECT_EQ(histogram.GetHistogramBins(), std::vector<int>({10, 20, 30, 40}));
+    ASSERT_EQ(_loaded_cube_histograms[0].size(), 1);
+    EXPECT_EQ(_loaded_cube_histograms[0][0].GetHistogramBins(), std::vector<int>({600, 400}));
+}
+
+TEST_F(DiskStatsCacheTest, NotUsedForModifiedImage) {
+    Save(SharedImageId(_image.string(), "0", 1234));
+    EXPECT_FALSE(Load(SharedImageId(_image.string(), "0", 5678)));
+    EXPECT_FALSE(Load(SharedImageId(_image.string(), "1", 1234)));
+
+    // Same modify time, different size
+    WriteImage(2000);
+    EXPECT_FALSE(Load(SharedImageId(_image.string(), "0", 1234)));
+    EXPECT_TRUE(_loaded_image_basic_stats.empty());
+
+    // The file is replaced when the stats are saved again
+    Save(SharedImageId(_image.string(), "0", 1234));
+    EXPECT_TRUE(Load(SharedImageId(_image.string(), "0", 1234)));
+}
+
+TEST_F(DiskStatsCacheTest, TruncatedFileIsIgnored) {
+    SharedImageId image_id(_image.string(), "0", 1234);
+    Save(image_id);
+    auto path = DiskStatsCache::GetPath(image_id.filename, image_id.hdu);
+    fs::resize_file(path, fs::file_size(path) - 4);
+
+    EXPECT_FALSE(Load(image_id));
+    EXPECT_TRUE(_loaded_image_basic_stats.empty());
+    EXPECT_TRUE(_loaded_cube_histograms.empty());
+}
+
+TEST_F(DiskStatsCacheTest, DisabledWithoutFolder) {
+    DiskStatsCache::SetFolder("");
+    SharedImageId image_id(_image.string(), "0", 1234);
+    EXPECT_FALSE(DiskStatsCache::Enabled());
+    EXPECT_FALSE(DiskStatsCache::Save(image_id, 1000, _image_basic_stats, _image_histograms, _cube_basic_stats, _cube_histograms));
+    EXPECT_FALSE(Load(image_id));
+
+    // Generated images have no file
+    DiskStatsCache::SetFolder((_folder / "cache").string());
+    EXPECT_FALSE(DiskStatsCache::Save(
+        SharedImageId("", "", 0), 0, _image_basic_stats, _image_histograms, _cube_basic_stats, _cube_histograms));
+}
+
+TEST_F(DiskStatsCacheTest, LeastRecentlyUsedFilesAreRemoved) {
+    // Room for two files of the same size
+    SharedImageId image_id(_image.string(), "0", 1234);
+    Save(image_id);
+    auto file_size = fs::file_size(DiskStatsCache::GetPath(image_id.filename, image_id.hdu));
+    DiskStatsCache::SetFolder((_folder / "cache").string(), 2 * file_size + file_size / 2);
+
+    SharedImageId image_id1(_image.string(), "1", 1234), image_id2(_image.string(), "2", 1234);
+    Save(image_id1);
+    ASSERT_TRUE(Load(image_id));
+    Save(image_id2);
+    EXPECT_TRUE(Load(image_id));
+    EXPECT_FALSE(Load(image_id1));
+    EXPECT_TRUE(Load(image_id2));
+
+    // The order of use is kept by the modify times when the folder is read again
+    DiskStatsCache::SetFolder((_folder / "cache").string(), 2 * file_size + file_size / 2);
+    ASSERT_TRUE(Load(image_id));
+    Save(image_id1);
+    EXPECT_TRUE(Load(image_id));
+    EXPECT_TRUE(Load(image_id1));
+    EXPECT_FALSE(Load(image_id2));
+}
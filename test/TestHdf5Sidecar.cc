@@ -0,0 +1,123 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <casacore/lattices/Lattices/ArrayLattice.h>
+
+#include "ImageData/FileLoader.h"
+#include "ImageData/Hdf5Sidecar.h"
+
+#include "CommonTestUtilities.h"
+
+using namespace carta;
+
+#define IMAGE_SHAPE "40 36 12 2"
+#define WIDTH 40
+#define HEIGHT 36
+#define DEPTH 12
+#define NUM_STOKES 2
+
+class Hdf5SidecarTest : public ::testing::Test, public ImageGenerator {
+public:
+    void SetUp() override {
+        _folder = fs::temp_directory_path() / fmt::format("carta_sidecar_test_{}", getpid());
+        _image_path = GeneratedFitsImagePath(IMAGE_SHAPE);
+    }
+
+    void TearDown() override {
+        Hdf5Sidecar::SetFolder("");
+        std::error_code error_code;
+        fs::remove_all(_folder, error_code);
+    }
+
+    // Writes the sidecar for the image and opens the image with it
+    std::unique_ptr<FileLoader> OpenWithSidecar(size_t swizzle_buffer_size) {
+        Hdf5Sidecar::SetFolder(_folder.string(), swizzle_buffer_size);
+        std::unique_ptr<FileLoader> loader(FileLoader::GetLoader(_image_path));
+        loader->OpenFile("0");
+        casacore::IPosition shape;
+        int spectral_axis, z_axis, stokes_axis;
+        std::string message;
+        EXPECT_TRUE(loader->FindCoordinateAxes(shape, spectral_axis, z_axis, stokes_axis, message));
+        loader->ImageUpdated();
+
+        // The sidecar is written in a background thread
+        std::string path = Hdf5Sidecar::GetPath(_image_path, "0", loader->GetModifyTime());
+        Hdf5Sidecar::Generate(_image_path, "0", loader->GetModifyTime());
+        for (int i = 0; i < 600 && !fs::exists(path); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        EXPECT_TRUE(fs::exists(path));
+
+        loader->OpenSidecar("0");
+        EXPECT_TRUE(loader->HasData(FileInfo::Data::SWIZZLED));
+        return loader;
+    }
+
+    void CheckCursorSpectralData(FileLoader* loader) {
+        FitsDataReader reader(_image_path);
+        for (int stokes = 0; stokes < NUM_STOKES; ++stokes) {
+            for (auto& point : std::vector<std::pair<int, int>>{{0, 0}, {WIDTH - 1, HEIGHT - 1}, {13, 9}, {5, 33}}) {
+                std::vector<float> profile;
+                ASSERT_TRUE(loader->GetCursorSpectralData(profile, stokes, point.first, 1, point.second, 1, _image_mutex));
+                std::vector<float> expected = reader.ReadRegion({(hsize_t)point.first, (hsize_t)point.second, 0, (hsize_t)stokes},
+                    {(hsize_t)point.first + 1, (hsize_t)point.second + 1, DEPTH, (hsize_t)stokes + 1});
+                CmpVectors(profile, expected);
+            }
+        }
+    }
+
+protected:
+    fs::path _folder;
+    std::string _image_path;
+    std::mutex _image_mutex;
+};
+
+TEST_F(Hdf5SidecarTest, SwizzledPlanesMatchImage) {
+    auto loader = OpenWithSidecar(SIDECAR_SWIZZLE_BUFFER_SIZE);
+    CheckCursorSpectralData(loader.get());
+}
+
+TEST_F(Hdf5SidecarTest, SwizzledRowStripsMatchImage) {
+    // Too small for whole planes, so that blocks of 8 rows are read, with a partial strip at the top of the image
+    auto loader = OpenWithSidecar(1);
+    CheckCursorSpectralData(loader.get());
+}
+
+TEST_F(Hdf5SidecarTest, RegionSpectralDataUsesSidecar) {
+    auto loader = OpenWithSidecar(1);
+    casacore::IPosition region_shape(2, WIDTH, HEIGHT);
+    EXPECT_TRUE(loader->UseRegionSpectralData(region_shape, _image_mutex));
+
+    casacore::ArrayLattice<casacore::Bool> mask(region_shape);
+    mask.set(true);
+    std::map<CARTA::StatsType, std::vector<double>> results;
+    float progress(0);
+    while (progress < 1.0) {
+        ASSERT_TRUE(loader->GetRegionSpectralData(1, 1, mask, casacore::IPosition(2, 0, 0), _image_mutex, results, progress));
+    }
+
+    FitsDataReader reader(_image_path);
+    for (int z = 0; z < DEPTH; ++z) {
+        double sum(0);
+        size_t num_pixels(0);
+        for (float value : reader.ReadXY(z, 1)) {
+            if (std::isfinite(value)) {
+                sum += value;
+                num_pixels++;
+            }
+        }
+        EXPECT_EQ(results[CARTA::StatsType::NumPixels][z], num_pixels);
+        EXPECT_NEAR(results[CARTA::StatsType::Sum][z], sum, 1e-3 * std::max(1.0, std::abs(sum)));
+    }
+}
@@ -4,20 +4,41 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <atomic>
+#include <limits>
+#include <numeric>
 #include <random>
 #include <vector>
 
 #include <gtest/gtest.h>
 
 #include "CommonTestUtilities.h"
+#include "ImageData/CartaFitsImage.h"
+#include "ImageData/FileLoader.h"
 #include "ImageStats/Histogram.h"
+#include "ImageStats/StatsCalculator.h"
 #include "ThreadingManager/ThreadingManager.h"
+#include "Util/Simd.h"
+#include "src/Frame/Frame.h"
 
 #ifdef COMPILE_PERFORMANCE_TESTS
 #include <spdlog/fmt/fmt.h>
 #include "Timer/Timer.h"
 #endif
 
+// Counts the slices read from a FITS image
+class CountingFitsImage : public carta::CartaFitsImage {
+public:
+    CountingFitsImage(const std::string& filename) : carta::CartaFitsImage(filename), num_slices(0) {}
+
+    casacore::Bool doGetSlice(casacore::Array<float>& buffer, const casacore::Slicer& section) override {
+        ++num_slices;
+        return carta::CartaFitsImage::doGetSlice(buffer, section);
+    }
+
+    std::atomic<int> num_slices;
+};
+
 class HistogramTest : public ::testing::Test {
 public:
     std::random_device rd;
@@ -118,6 +139,191 @@ TEST_F(HistogramTest, TestMultithreading) {
         EXPECT_TRUE(CmpHistograms(hist_st, hist_mt));
     }
 }
+
+TEST_F(HistogramTest, TestSimdLevels) {
+    std::vector<float> data(100003);
+    for (auto& value : data) {
+        value = float_random(mt) * 1.2f - 0.1f;
+    }
+    data[3] = NAN;
+    data[17] = INFINITY;
+    data[18] = 1.0f;
+
+    auto detected_level = carta::GetSimdLevel();
+    carta::SetSimdLevel(carta::SimdLevel::SSE4);
+    carta::Histogram reference(100, 0.0f, 1.0f, data.data(), data.size());
+    for (auto level : {carta::SimdLevel::AVX, carta::SimdLevel::AVX512}) {
+        if (level > detected_level) {
+            continue;
+        }
+        carta::SetSimdLevel(level);
+        carta::Histogram hist(100, 0.0f, 1.0f, data.data(), data.size());
+        EXPECT_TRUE(CmpHistograms(hist, reference)) << carta::SimdLevelName(level);
+    }
+    carta::SetSimdLevel(carta::SimdLevel::AVX512);
+}
+
+TEST_F(HistogramTest, TestHistogramWithStats) {
+    std::vector<float> data(1000003);
+    for (auto& value : data) {
+        value = float_random(mt) * 1.2f - 0.1f;
+    }
+    data[3] = NAN;
+    data[17] = -INFINITY;
+
+    carta::BasicStatsCalculator<float> calculator(data.data(), data.size());
+    calculator.reduce();
+    auto reference_stats = calculator.GetStats();
+    carta::Histogram reference(100, 0.0f, 1.0f, data.data(), data.size());
+
+    for (int threads : {1, 7}) {
+        carta::ThreadManager::SetThreadLimit(threads);
+        carta::BasicStats<float> stats;
+        carta::Histogram hist(100, 0.0f, 1.0f, data.data(), data.size(), stats);
+        EXPECT_TRUE(CmpHistograms(hist, reference));
+        EXPECT_EQ(stats.num_pixels, data.size() - 2);
+        EXPECT_EQ(stats.min_val, reference_stats.min_val);
+        EXPECT_EQ(stats.max_val, reference_stats.max_val);
+        EXPECT_NEAR(stats.sum, reference_stats.sum, 1e-12 * std::fabs(reference_stats.sum));
+        EXPECT_NEAR(stats.sumSq, reference_stats.sumSq, 1e-12 * reference_stats.sumSq);
+    }
+}
+
+TEST_F(HistogramTest, TestCalcHistogramRange) {
+    // The smallest positive float is a valid maximum; only the initial stats of no values give a single empty bin
+    std::vector<float> data{-1.0f, 0.0f, std::numeric_limits<float>::min(), NAN};
+    carta::BasicStats<float> stats;
+    carta::CalcBasicStats(stats, data.data(), data.size());
+    ASSERT_EQ(stats.max_val, std::numeric_limits<float>::min());
+    EXPECT_EQ(carta::CalcHistogram(10, stats, data.data(), data.size()).GetNbins(), 10);
+
+    carta::BasicStats<float> fused_stats;
+    EXPECT_EQ(carta::CalcHistogram(10, stats, data.data(), data.size(), fused_stats).GetNbins(), 10);
+    EXPECT_EQ(fused_stats.num_pixels, 3);
+
+    std::vector<float> nan_data(10, NAN);
+    carta::CalcBasicStats(stats, nan_data.data(), nan_data.size());
+    EXPECT_EQ(carta::CalcHistogram(10, stats, nan_data.data(), nan_data.size()).GetNbins(), 1);
+    EXPECT_EQ(carta::CalcHistogram(10, stats, nan_data.data(), nan_data.size(), fused_stats).GetNbins(), 1);
+    EXPECT_EQ(fused_stats.num_pixels, 0);
+}
+
+TEST_F(HistogramTest, TestCompensatedSum) {
+    // Chunk sums which are lost in a plain double sum
+    carta::CompensatedSum sum;
+    double plain_sum(1e17);
+    sum.Add(1e17);
+    for (int i = 0; i < 1000; ++i) {
+        sum.Add(1.0);
+        plain_sum += 1.0;
+    }
+    sum.Add(-1e17);
+    plain_sum -= 1e17;
+    EXPECT_EQ(sum.Get(), 1000.0);
+    EXPECT_NE(plain_sum, 1000.0);
+
+    // The sum of a large constant plane is exact, and the sum of squares is only rounded within the chunks
+    std::vector<float> data(10000000, 0.1f);
+    carta::BasicStatsCalculator<float> calculator(data.data(), data.size());
+    calculator.reduce();
+    auto stats = calculator.GetStats();
+    double square = (double)0.1f * (double)0.1f;
+    EXPECT_EQ(stats.sum, (double)0.1f * data.size());
+    EXPECT_NEAR(stats.sumSq, square * data.size(), 1e-14 * square * data.size());
+}
+
+TEST_F(HistogramTest, TestProvisionalHistogram) {
+    // Planes of a cube whose ranges widen in both directions, starting with a constant plane
+    std::vector<std::vector<float>> planes;
+    planes.push_back(std::vector<float>(1000, 0.5f));
+    for (int p = 1; p < 20; ++p) {
+        std::vector<float> plane(10000);
+        for (auto& value : plane) {
+            value = (float_random(mt) - 0.5f) * p * p + 0.1f * p;
+        }
+        plane[p] = NAN;
+        planes.push_back(plane);
+    }
+
+    std::vector<float> cube;
+    carta::ProvisionalHistogram provisional(100);
+    for (auto& plane : planes) {
+        carta::BasicStats<float> plane_stats;
+        carta::CalcBasicStats(plane_stats, plane.data(), plane.size());
+        provisional.Fill(plane.data(), plane.size(), plane_stats.min_val, plane_stats.max_val);
+        cube.insert(cube.end(), plane.begin(), plane.end());
+    }
+
+    carta::BasicStats<float> cube_stats;
+    carta::CalcBasicStats(cube_stats, cube.data(), cube.size());
+    carta::Histogram reference(100, cube_stats.min_val, cube_stats.max_val, cube.data(), cube.size());
+    carta::Histogram hist = provisional.GetHistogram(100, cube_stats.min_val, cube_stats.max_val);
+    EXPECT_EQ(hist.GetMinVal(), reference.GetMinVal());
+    EXPECT_EQ(hist.GetBinWidth(), reference.GetBinWidth());
+
+    // The fine bins which straddle the histogram bin edges are split
+    const auto& bins = hist.GetHistogramBins();
+    const auto& reference_bins = reference.GetHistogramBins();
+    EXPECT_EQ(std::accumulate(bins.begin(), bins.end(), 0), std::accumulate(reference_bins.begin(), reference_bins.end(), 0));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_NEAR(bins[i], reference_bins[i], 0.01 * reference_bins[i] + 5) << i;
+    }
+
+    // A constant cube
+    carta::ProvisionalHistogram constant(10);
+    constant.Fill(planes[0].data(), planes[0].size(), 0.5f, 0.5f);
+    EXPECT_EQ(constant.GetHistogram(10, 0.5f, 0.5f).GetHistogramBins()[9], 1000);
+}
+
+TEST_F(HistogramTest, TestCubeHistogramReadsPlanesOnce) {
+    std::string image_path = ImageGenerator::GeneratedFitsImagePath("64 48 10");
+    auto image = std::make_shared<CountingFitsImage>(image_path);
+    std::shared_ptr<carta::FileLoader> loader(carta::FileLoader::GetLoader(std::shared_ptr<casacore::ImageInterface<float>>(image)));
+    Frame frame(0, loader, "0");
+    ASSERT_TRUE(frame.IsValid());
+    ASSERT_EQ(frame.Depth(), 10);
+
+    // Two-pass reference: the range of the cube, then the planes binned into it
+    FitsDataReader reader(image_path);
+    std::vector<float> cube = reader.ReadRegion({0, 0, 0}, {64, 48, 10});
+    carta::BasicStats<float> reference_stats;
+    carta::CalcBasicStats(reference_stats, cube.data(), cube.size());
+    carta::Histogram reference(100, reference_stats.min_val, reference_stats.max_val, cube.data(), cube.size());
+
+    int num_progress(0);
+    auto progress_callback = [&](float, const carta::Histogram*) {
+        ++num_progress;
+        return true;
+    };
+
+    // The range of the cold cube is not known, so the provisional histogram is rebinned into it
+    carta::BasicStats<float> cube_stats;
+    carta::Histogram cube_histogram;
+    image->num_slices = 0;
+    ASSERT_TRUE(frame.CalculateCubeHistogram(0, 100, cube_stats, cube_histogram, progress_callback));
+    EXPECT_EQ(image->num_slices, frame.Depth());
+    EXPECT_EQ(num_progress, frame.Depth());
+    EXPECT_EQ(cube_stats.num_pixels, reference_stats.num_pixels);
+    EXPECT_EQ(cube_stats.min_val, reference_stats.min_val);
+    EXPECT_EQ(cube_stats.max_val, reference_stats.max_val);
+    EXPECT_EQ(cube_histogram.GetMinVal(), reference.GetMinVal());
+    EXPECT_EQ(cube_histogram.GetBinWidth(), reference.GetBinWidth());
+
+    const auto& bins = cube_histogram.GetHistogramBins();
+    const auto& reference_bins = reference.GetHistogramBins();
+    ASSERT_EQ(bins.size(), reference_bins.size());
+    EXPECT_EQ(std::accumulate(bins.begin(), bins.end(), 0), std::accumulate(reference_bins.begin(), reference_bins.end(), 0));
+    for (size_t i = 0; i < bins.size(); ++i) {
+        EXPECT_NEAR(bins[i], reference_bins[i], 0.01 * reference_bins[i] + 5) << i;
+    }
+
+    // Once the range of the cube is known, the planes are binned exactly
+    image->num_slices = 0;
+    ASSERT_TRUE(frame.CalculateCubeHistogram(0, 50, cube_stats, cube_histogram, progress_callback));
+    EXPECT_EQ(image->num_slices, frame.Depth());
+    EXPECT_TRUE(CmpHistograms(cube_histogram, carta::CalcHistogram(50, reference_stats, cube.data(), cube.size())));
+}
+
 #ifdef COMPILE_PERFORMANCE_TESTS
 
 TEST_F(HistogramTest, TestMultithreadingPerformance) {
@@ -71,6 +71,8 @@ public:
 
         _dummy_backend->Receive(open_file);
 
+        _dummy_backend->WaitForJobFinished();
+
         _message_count = 0;
 
         while (_dummy_backend->TryPopMessagesQueue(_message_pair)) {
@@ -166,6 +168,8 @@ public:
 
         _dummy_backend->Receive(open_file);
 
+        _dummy_backend->WaitForJobFinished();
+
         _dummy_backend->ClearMessagesQueue();
 
         CARTA::SetImageChannels set_image_channels = Message::SetImageChannels(0, 0, 0, CARTA::CompressionType::ZFP, 11);
@@ -195,6 +199,8 @@ public:
 
         _dummy_backend->Receive(open_file);
 
+        _dummy_backend->WaitForJobFinished();
+
         _message_count = 0;
 
         while (_dummy_backend->TryPopMessagesQueue(_message_pair)) {
@@ -273,6 +279,8 @@ public:
 
         _dummy_backend->Receive(open_file);
 
+        _dummy_backend->WaitForJobFinished();
+
         _message_count = 0;
 
         while (_dummy_backend->TryPopMessagesQueue(_message_pair)) {
@@ -462,6 +470,8 @@ public:
 
         _dummy_backend->Receive(open_file);
 
+        _dummy_backend->WaitForJobFinished();
+
         _dummy_backend->ClearMessagesQueue();
 
         auto set_region = Message::SetRegion(0, -1, CARTA::RegionType::RECTANGLE, {Message::Point(197, 489), Message::Point(10, 10)}, 0.0);
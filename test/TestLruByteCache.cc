@@ -0,0 +1,92 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <gtest/gtest.h>
+
+#include "Cache/LruByteCache.h"
+
+using namespace carta;
+
+struct TestValue {
+    size_t bytes;
+
+    size_t Bytes() const {
+        return bytes;
+    }
+};
+
+using TestCache = LruByteCache<int, TestValue>;
+
+static TestCache::ValuePtr MakeValue(size_t bytes) {
+    return std::make_shared<TestValue>(TestValue{bytes});
+}
+
+TEST(LruByteCacheTest, AddAndGet) {
+    TestCache cache(1024);
+    EXPECT_EQ(cache.Get(1), nullptr);
+
+    auto value = MakeValue(100);
+    cache.Add(1, value);
+    EXPECT_EQ(cache.Get(1), value);
+    EXPECT_EQ(cache.Get(2), nullptr);
+    EXPECT_EQ(cache.GetSize(), 100);
+
+    cache.Add(2, nullptr);
+    EXPECT_EQ(cache.Get(2), nullptr);
+    EXPECT_EQ(cache.GetSize(), 100);
+}
+
+TEST(LruByteCacheTest, ReplacesExistingValue) {
+    TestCache cache(1024);
+    cache.Add(1, MakeValue(100));
+    auto value = MakeValue(40);
+    cache.Add(1, value);
+    EXPECT_EQ(cache.Get(1), value);
+    EXPECT_EQ(cache.GetSize(), 40);
+}
+
+TEST(LruByteCacheTest, EvictsLeastRecentlyUsed) {
+    TestCache cache(300);
+    cache.Add(0, MakeValue(100));
+    cache.Add(1, MakeValue(100));
+    cache.Get(0);
+    cache.Add(2, MakeValue(150));
+
+    EXPECT_NE(cache.Get(0), nullptr);
+    EXPECT_EQ(cache.Get(1), nullptr);
+    EXPECT_NE(cache.Get(2), nullptr);
+    EXPECT_EQ(cache.GetSize(), 250);
+
+    // Several values are evicted to make room for a large one
+    cache.Add(3, MakeValue(300));
+    EXPECT_EQ(cache.Get(0), nullptr);
+    EXPECT_EQ(cache.Get(2), nullptr);
+    EXPECT_NE(cache.Get(3), nullptr);
+    EXPECT_EQ(cache.GetSize(), 300);
+
+    // Values larger than the budget are not cached
+    cache.Add(1, MakeValue(400));
+    EXPECT_EQ(cache.Get(1), nullptr);
+    EXPECT_NE(cache.Get(3), nullptr);
+    EXPECT_EQ(cache.GetSize(), 300);
+
+    cache.Clear();
+    EXPECT_EQ(cache.Get(3), nullptr);
+    EXPECT_EQ(cache.GetSize(), 0);
+}
+
+TEST(LruByteCacheTest, ClearedWhenImageModified) {
+    TestCache cache(1024);
+    cache.SetSharedImageId(SharedImageId("/data/image.fits", "0", 1234));
+    cache.Add(1, MakeValue(100));
+
+    cache.SetSharedImageId(SharedImageId("/data/image.fits", "0", 1234));
+    EXPECT_NE(cache.Get(1), nullptr);
+
+    cache.SetSharedImageId(SharedImageId("/data/image.fits", "0", 5678));
+    EXPECT_EQ(cache.Get(1), nullptr);
+    EXPECT_EQ(cache.GetSize(), 0);
+}
@@ -0,0 +1,105 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Cache/MipPyramid.h"
+#include "DataStream/Smoothing.h"
+
+using namespace carta;
+
+static std::vector<float> RandomImage(int64_t width, int64_t height, float nan_fraction) {
+    std::mt19937 mt(width * height);
+    std::uniform_real_distribution<float> random(0, 1);
+    std::vector<float> image(width * height);
+    for (auto& value : image) {
+        float r = random(mt);
+        value = r < nan_fraction ? NAN : (r < nan_fraction * 1.1f ? INFINITY : random(mt) - 0.5f);
+    }
+    // An all-NaN region
+    for (int64_t j = 0; j < std::min(height, (int64_t)40); j++) {
+        for (int64_t i = 0; i < std::min(width, (int64_t)70); i++) {
+            image[j * width + i] = NAN;
+        }
+    }
+    return image;
+}
+
+// Compares the means of the blocks of the region [x, x_end) x [y, y_end) of the image
+static void ExpectBlockSmoothMeans(MipPyramid& pyramid, const std::vector<float>& image, int64_t width, int64_t height, int64_t x,
+    int64_t y, int64_t x_end, int64_t y_end, int mip) {
+    int64_t dest_width = std::ceil((float)(x_end - x) / mip);
+    int64_t dest_height = std::ceil((float)(y_end - y) / mip);
+    std::vector<float> means(dest_width * dest_height);
+    std::vector<float> reference(dest_width * dest_height);
+    ASSERT_TRUE(pyramid.GetBlockMeans(means.data(), x, y, dest_width, dest_height, mip));
+    BlockSmoothScalar(image.data(), reference.data(), width, height, dest_width, dest_height, x, y, mip);
+    for (size_t i = 0; i < means.size(); i++) {
+        if (std::isnan(reference[i])) {
+            EXPECT_TRUE(std::isnan(means[i])) << "mip " << mip << " index " << i;
+        } else {
+            EXPECT_NEAR(means[i], reference[i], 1e-5) << "mip " << mip << " index " << i;
+        }
+    }
+}
+
+TEST(MipPyramidTest, MatchesBlockSmooth) {
+    for (auto [width, height] : std::vector<std::pair<int64_t, int64_t>>{{1000, 700}, {513, 1025}, {3, 5}}) {
+        auto image = RandomImage(width, height, 0.1f);
+        MipPyramid pyramid;
+        pyramid.Reset(image.data(), width, height);
+        // Coarse levels first, so that finer ones are partly computed already
+        for (int mip : {64, 4, 2, 16, 256, 2048}) {
+            ExpectBlockSmoothMeans(pyramid, image, width, height, 0, 0, width, height, mip);
+        }
+        if (width > 512 && height > 512) {
+            ExpectBlockSmoothMeans(pyramid, image, width, height, 256, 512, width, height, 4);
+        }
+    }
+}
+
+TEST(MipPyramidTest, UnalignedBlocksAreNotSupported) {
+    auto image = RandomImage(100, 100, 0);
+    MipPyramid pyramid;
+    std::vector<float> means(100 * 100);
+    EXPECT_FALSE(pyramid.GetBlockMeans(means.data(), 0, 0, 50, 50, 2));
+
+    pyramid.Reset(image.data(), 100, 100);
+    EXPECT_TRUE(pyramid.GetBlockMeans(means.data(), 0, 0, 50, 50, 2));
+    EXPECT_FALSE(pyramid.GetBlockMeans(means.data(), 0, 0, 34, 34, 3));
+    EXPECT_FALSE(pyramid.GetBlockMeans(means.data(), 2, 0, 25, 25, 4));
+    EXPECT_FALSE(pyramid.GetBlockMeans(means.data(), 0, 0, 51, 50, 2));
+    EXPECT_FALSE(pyramid.GetBlockMeans(means.data(), 0, 0, 100, 100, 1));
+}
+
+TEST(MipPyramidTest, ConcurrentTiles) {
+    const int64_t width(2000), height(1500);
+    const int mip(8), tile_size(64);
+    auto image = RandomImage(width, height, 0.05f);
+    MipPyramid pyramid;
+    pyramid.Reset(image.data(), width, height);
+
+    // Tiles of a zoomed-out view requested by several threads, as for a tile request
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            for (int64_t y = t * tile_size * mip; y < height; y += 4 * tile_size * mip) {
+                for (int64_t x = 0; x < width; x += tile_size * mip) {
+                    ExpectBlockSmoothMeans(pyramid, image, width, height, x, y, std::min(width, x + tile_size * mip),
+                        std::min(height, y + tile_size * mip), mip);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
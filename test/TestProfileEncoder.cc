@@ -0,0 +1,167 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "Session/ProfileEncoder.h"
+
+using namespace carta;
+
+template <typename T>
+static std::vector<T> RandomProfile(size_t length) {
+    std::mt19937 mt(1234);
+    std::normal_distribution<T> noise(0, 1);
+    std::vector<T> profile(length);
+    T value(0);
+    for (auto& element : profile) {
+        value += noise(mt);
+        element = value;
+    }
+    return profile;
+}
+
+template <typename T>
+static std::string ToBytes(const std::vector<T>& values) {
+    return std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+static ProfileEncodingHeader GetHeader(const std::string& encoded_values) {
+    ProfileEncodingHeader header;
+    std::memcpy(&header, encoded_values.data(), sizeof(header));
+    return header;
+}
+
+TEST(ProfileEncoderTest, LosslessRoundTrip) {
+    auto values = RandomProfile<double>(10000);
+    values[17] = NAN;
+    std::string bytes = ToBytes(values);
+
+    std::string encoded_values = EncodeProfileValues<double>(bytes, nullptr, ProfileCodec::Zstd, 0);
+    auto header = GetHeader(encoded_values);
+    EXPECT_EQ(header.length, values.size());
+    EXPECT_EQ(header.start, 0);
+    EXPECT_EQ(header.count, values.size());
+
+    std::vector<double> decoded;
+    ASSERT_TRUE(DecodeProfileValues(encoded_values, decoded));
+    ASSERT_EQ(decoded.size(), values.size());
+    EXPECT_EQ(std::memcmp(decoded.data(), values.data(), bytes.size()), 0);
+}
+
+TEST(ProfileEncoderTest, LossyRoundTrip) {
+    auto values = RandomProfile<float>(10000);
+    std::string encoded_values = EncodeProfileValues<float>(ToBytes(values), nullptr, ProfileCodec::Zfp, PROFILE_ZFP_PRECISION);
+
+    std::vector<float> decoded;
+    ASSERT_TRUE(DecodeProfileValues(encoded_values, decoded));
+    ASSERT_EQ(decoded.size(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        EXPECT_NEAR(decoded[i], values[i], 1e-3 * (std::fabs(values[i]) + 1));
+    }
+}
+
+TEST(ProfileEncoderTest, ShortProfilesAreNotCompressed) {
+    std::vector<float> values{1, 2, NAN};
+    std::string encoded_values = EncodeProfileValues<float>(ToBytes(values), nullptr, ProfileCodec::Zstd, 0);
+    EXPECT_EQ(GetHeader(encoded_values).codec, static_cast<uint8_t>(ProfileCodec::None));
+    EXPECT_EQ(encoded_values.size(), sizeof(ProfileEncodingHeader) + sizeof(float) * values.size());
+
+    std::vector<float> decoded;
+    ASSERT_TRUE(DecodeProfileValues(encoded_values, decoded));
+    EXPECT_EQ(decoded[1], 2);
+    EXPECT_TRUE(std::isnan(decoded[2]));
+}
+
+TEST(ProfileEncoderTest, PartialUpdatesSendNewRange) {
+    ProfileEncoder encoder;
+    EXPECT_EQ(encoder.Negotiate(PROFILE_FEATURE_ZSTD), PROFILE_FEATURE_ZSTD);
+
+    const size_t length = 100000;
+    auto values = RandomProfile<double>(length);
+    std::vector<double> client_values;
+
+    // Partial updates of a region spectral profile, which computes channels from the start
+    for (size_t computed : {(size_t)20000, (size_t)50000, length}) {
+        std::vector<double> partial_values(length, NAN);
+        std::copy(values.begin(), values.begin() + computed, partial_values.begin());
+
+        CARTA::SpectralProfileData message;
+        message.set_file_id(0);
+        message.set_region_id(1);
+        message.set_progress((float)computed / length);
+        auto profile = message.add_profiles();
+        profile->set_coordinate("z");
+        profile->set_stats_type(CARTA::StatsType::Mean);
+        profile->set_raw_values_fp64(partial_values.data(), length * sizeof(double));
+
+        encoder.EncodeSpectralProfiles(message);
+        const auto& encoded_values = message.profiles(0).raw_values_fp64();
+        auto header = GetHeader(encoded_values);
+        EXPECT_EQ(header.start, computed == 20000 ? 0 : (computed == 50000 ? 20000 : 50000));
+        EXPECT_EQ(header.start + header.count, computed == 20000 ? length : computed);
+
+        ASSERT_TRUE(DecodeProfileValues(encoded_values, client_values));
+        ASSERT_EQ(client_values.size(), length);
+        EXPECT_EQ(std::memcmp(client_values.data(), partial_values.data(), length * sizeof(double)), 0);
+    }
+
+    // The profile is complete, so the next request is sent in full
+    CARTA::SpectralProfileData message;
+    message.set_file_id(0);
+    message.set_region_id(1);
+    message.set_progress(1.0);
+    auto profile = message.add_profiles();
+    profile->set_coordinate("z");
+    profile->set_stats_type(CARTA::StatsType::Mean);
+    profile->set_raw_values_fp64(values.data(), length * sizeof(double));
+    encoder.EncodeSpectralProfiles(message);
+    EXPECT_EQ(GetHeader(message.profiles(0).raw_values_fp64()).count, length);
+}
+
+TEST(ProfileEncoderTest, RemovedRegionIsSentInFull) {
+    ProfileEncoder encoder;
+    encoder.Negotiate(PROFILE_FEATURE_ZSTD);
+
+    const size_t length = 1000;
+    auto values = RandomProfile<float>(length);
+    auto partial_message = [&](int region_id) {
+        CARTA::SpectralProfileData message;
+        message.set_file_id(0);
+        message.set_region_id(region_id);
+        message.set_progress(0.5);
+        auto profile = message.add_profiles();
+        profile->set_coordinate("z");
+        profile->set_stats_type(CARTA::StatsType::Sum);
+        profile->set_raw_values_fp32(values.data(), length * sizeof(float));
+        encoder.EncodeSpectralProfiles(message);
+        return GetHeader(message.profiles(0).raw_values_fp32());
+    };
+
+    EXPECT_EQ(partial_message(1).count, length);
+    EXPECT_EQ(partial_message(2).count, length);
+    EXPECT_EQ(partial_message(1).count, 0); // unchanged
+
+    // A new region with the same id does not start from the values of the removed region
+    encoder.RemoveRegion(1);
+    EXPECT_EQ(partial_message(1).count, length);
+    EXPECT_EQ(partial_message(2).count, 0);
+}
+
+TEST(ProfileEncoderTest, DisabledWithoutFeatureFlag) {
+    ProfileEncoder encoder;
+    EXPECT_EQ(encoder.Negotiate(0), 0);
+
+    auto values = RandomProfile<float>(1000);
+    CARTA::SpatialProfileData message;
+    auto profile = message.add_profiles();
+    profile->set_raw_values_fp32(values.data(), values.size() * sizeof(float));
+    encoder.EncodeSpatialProfiles(message);
+    EXPECT_EQ(message.profiles(0).raw_values_fp32(), ToBytes(values));
+}
@@ -0,0 +1,133 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ImageStats/QuantileSketch.h"
+
+using namespace carta;
+
+static std::vector<float> RandomPlane(size_t size, unsigned int seed) {
+    std::mt19937 mt(seed);
+    std::normal_distribution<float> noise(0, 1);
+    std::vector<float> plane(size);
+    for (auto& value : plane) {
+        value = noise(mt);
+    }
+    return plane;
+}
+
+static void AddPlane(QuantileSketch& sketch, const std::vector<float>& plane) {
+    float min_val(INFINITY), max_val(-INFINITY);
+    for (float value : plane) {
+        if (std::isfinite(value)) {
+            min_val = std::min(min_val, value);
+            max_val = std::max(max_val, value);
+        }
+    }
+    sketch.Add(plane.data(), plane.size(), min_val, max_val);
+}
+
+// Rank of a value in the sorted finite values, in [0, 1]
+static double Rank(const std::vector<float>& sorted_values, float value) {
+    return (double)(std::lower_bound(sorted_values.begin(), sorted_values.end(), value) - sorted_values.begin()) / sorted_values.size();
+}
+
+static std::vector<float> SortedFinite(const std::vector<float>& values) {
+    std::vector<float> sorted_values;
+    std::copy_if(values.begin(), values.end(), std::back_inserter(sorted_values), [](float value) { return std::isfinite(value); });
+    std::sort(sorted_values.begin(), sorted_values.end());
+    return sorted_values;
+}
+
+TEST(QuantileSketchTest, SmallPlaneIsAccurate) {
+    auto plane = RandomPlane(50000, 1);
+    plane[10] = NAN;
+    plane[20] = INFINITY;
+    QuantileSketch sketch;
+    AddPlane(sketch, plane);
+    EXPECT_EQ(sketch.GetCount(), plane.size() - 2);
+    EXPECT_LE(sketch.GetCentroids().size(), QUANTILE_SKETCH_COMPRESSION);
+
+    auto sorted_values = SortedFinite(plane);
+    EXPECT_EQ(sketch.GetQuantile(0), sorted_values.front());
+    EXPECT_EQ(sketch.GetQuantile(1), sorted_values.back());
+    EXPECT_NEAR(Rank(sorted_values, sketch.GetQuantile(0.5)), 0.5, 0.01);
+    for (double quantile : {0.001, 0.005, 0.01, 0.99, 0.995, 0.999}) {
+        EXPECT_NEAR(Rank(sorted_values, sketch.GetQuantile(quantile)), quantile, 0.0002) << quantile;
+    }
+}
+
+TEST(QuantileSketchTest, LargePlaneIsAccurate) {
+    // Every value is added, so that the tails are not distorted by sampling
+    auto plane = RandomPlane(4000000, 2);
+    plane[12345] = NAN;
+    QuantileSketch sketch;
+    AddPlane(sketch, plane);
+    EXPECT_EQ(sketch.GetCount(), plane.size() - 1);
+    EXPECT_LE(sketch.GetCentroids().size(), QUANTILE_SKETCH_COMPRESSION);
+
+    auto sorted_values = SortedFinite(plane);
+    auto percentiles = sketch.GetPercentiles({0.5, 50, 99, 99.5, 99.9});
+    ASSERT_EQ(percentiles.size(), 5);
+    EXPECT_NEAR(Rank(sorted_values, percentiles[0]), 0.005, 0.001);
+    EXPECT_NEAR(Rank(sorted_values, percentiles[1]), 0.5, 0.01);
+    EXPECT_NEAR(Rank(sorted_values, percentiles[2]), 0.99, 0.001);
+    EXPECT_NEAR(Rank(sorted_values, percentiles[3]), 0.995, 0.001);
+    EXPECT_NEAR(Rank(sorted_values, percentiles[4]), 0.999, 0.0005);
+}
+
+TEST(QuantileSketchTest, MergedPlanes) {
+    // Planes with different ranges, as in a cube with a bright source in a few channels
+    std::vector<float> cube;
+    QuantileSketch cube_sketch;
+    for (int z = 0; z < 20; ++z) {
+        auto plane = RandomPlane(20000, z + 10);
+        for (auto& value : plane) {
+            value = value * (1 + z % 5) + z;
+        }
+        QuantileSketch plane_sketch;
+        AddPlane(plane_sketch, plane);
+        cube_sketch.Merge(plane_sketch);
+        cube.insert(cube.end(), plane.begin(), plane.end());
+    }
+    EXPECT_EQ(cube_sketch.GetCount(), cube.size());
+    EXPECT_LE(cube_sketch.GetCentroids().size(), QUANTILE_SKETCH_COMPRESSION);
+
+    auto sorted_values = SortedFinite(cube);
+    EXPECT_EQ(cube_sketch.GetMinVal(), sorted_values.front());
+    EXPECT_EQ(cube_sketch.GetMaxVal(), sorted_values.back());
+    for (double quantile : {0.001, 0.01, 0.25, 0.5, 0.75, 0.99, 0.999}) {
+        EXPECT_NEAR(Rank(sorted_values, cube_sketch.GetQuantile(quantile)), quantile, 0.01 * std::min(quantile, 1 - quantile) + 0.0002)
+            << quantile;
+    }
+
+    // A copy from the centroids, as read from the stats cache
+    QuantileSketch copy(cube_sketch.GetCentroids(), cube_sketch.GetMinVal(), cube_sketch.GetMaxVal());
+    EXPECT_EQ(copy.GetCount(), cube_sketch.GetCount());
+    EXPECT_EQ(copy.GetQuantile(0.999), cube_sketch.GetQuantile(0.999));
+}
+
+TEST(QuantileSketchTest, EmptyAndConstantData) {
+    QuantileSketch sketch;
+    EXPECT_TRUE(std::isnan(sketch.GetQuantile(0.5)));
+
+    std::vector<float> nans(100, NAN);
+    sketch.Add(nans.data(), nans.size(), std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+    EXPECT_TRUE(std::isnan(sketch.GetQuantile(0.5)));
+    EXPECT_EQ(sketch.GetCount(), 0);
+
+    std::vector<float> constant(1000, 2.5f);
+    sketch.Add(constant.data(), constant.size(), 2.5f, 2.5f);
+    EXPECT_EQ(sketch.GetQuantile(0), 2.5f);
+    EXPECT_EQ(sketch.GetQuantile(0.999), 2.5f);
+    EXPECT_EQ(sketch.GetQuantile(1), 2.5f);
+}
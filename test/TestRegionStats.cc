@@ -0,0 +1,252 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <memory>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include <casacore/coordinates/Coordinates/CoordinateUtil.h>
+#include <casacore/images/Images/ImageInfo.h>
+#include <casacore/images/Images/SubImage.h>
+#include <casacore/images/Images/TempImage.h>
+#include <casacore/images/Regions/ImageRegion.h>
+#include <casacore/lattices/LRegions/LCEllipsoid.h>
+#include <casacore/lattices/Lattices/ArrayLattice.h>
+#include <casacore/scimath/Mathematics/GaussianBeam.h>
+
+#include "ImageStats/RegionStatsCalculator.h"
+#include "ImageStats/StatsCalculator.h"
+
+using namespace carta;
+
+static std::vector<float> RandomData(size_t size, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> distribution(1, 3);
+    std::vector<float> data(size);
+    for (auto& value : data) {
+        value = distribution(generator);
+    }
+    return data;
+}
+
+// Stats of one plane in a single loop, without chunks or SIMD
+static RegionStats ExpectedStats(const float* data, const bool* mask, size_t size, size_t index_offset) {
+    RegionStats stats;
+    double sum(0), sum_squares(0);
+    for (size_t i = 0; i < size; ++i) {
+        if (mask && !mask[i]) {
+            continue;
+        }
+        float value = data[i];
+        if (!std::isfinite(value)) {
+            stats.nan_count++;
+            continue;
+        }
+        if (value < stats.min_val) {
+            stats.min_val = value;
+            stats.min_index = index_offset + i;
+        }
+        if (value > stats.max_val) {
+            stats.max_val = value;
+            stats.max_index = index_offset + i;
+        }
+        stats.num_pixels++;
+        sum += value;
+        sum_squares += (double)value * value;
+    }
+    stats.sum.Add(sum);
+    stats.sum_squares.Add(sum_squares);
+    return stats;
+}
+
+static void CompareStats(const RegionStats& stats, const RegionStats& expected) {
+    EXPECT_EQ(stats.num_pixels, expected.num_pixels);
+    EXPECT_EQ(stats.nan_count, expected.nan_count);
+    EXPECT_NEAR(stats.sum.Get(), expected.sum.Get(), 1e-9 * expected.num_pixels);
+    EXPECT_NEAR(stats.sum_squares.Get(), expected.sum_squares.Get(), 1e-9 * expected.sum_squares.Get());
+    EXPECT_EQ(stats.min_val, expected.min_val);
+    EXPECT_EQ(stats.max_val, expected.max_val);
+    EXPECT_EQ(stats.min_index, expected.min_index);
+    EXPECT_EQ(stats.max_index, expected.max_index);
+}
+
+TEST(RegionStatsTest, PlanesWithMaskAndNans) {
+    // Planes which are not a multiple of the chunk size or the SIMD width
+    const size_t plane_size(101 * 97), num_planes(5), index_offset(3 * plane_size);
+    auto data = RandomData(plane_size * num_planes, 0);
+    std::unique_ptr<bool[]> mask(new bool[data.size()]);
+    for (size_t i = 0; i < data.size(); ++i) {
+        mask[i] = (i % 7) != 0;
+        if (i % 11 == 0) {
+            data[i] = (i % 2) ? NAN : INFINITY;
+        }
+    }
+
+    std::vector<RegionStats> stats(num_planes);
+    CalcRegionStats(data.data(), mask.get(), plane_size, num_planes, index_offset, true, stats.data());
+    for (size_t plane = 0; plane < num_planes; ++plane) {
+        size_t start = plane * plane_size;
+        CompareStats(stats[plane], ExpectedStats(data.data() + start, mask.get() + start, plane_size, index_offset + start));
+    }
+}
+
+TEST(RegionStatsTest, LargePlaneWithoutMask) {
+    const size_t plane_size(1000 * 1000 + 3);
+    auto data = RandomData(plane_size, 1);
+    data[12345] = NAN;
+
+    RegionStats stats;
+    CalcRegionStats(data.data(), nullptr, plane_size, 1, 0, true, &stats);
+    CompareStats(stats, ExpectedStats(data.data(), nullptr, plane_size, 0));
+    EXPECT_EQ(stats.nan_count, 1);
+}
+
+TEST(RegionStatsTest, FirstPositionOfEqualValues) {
+    std::vector<float> data(10000, 1);
+    data[5000] = data[9000] = 5;
+    data[7000] = data[7001] = -5;
+
+    RegionStats stats;
+    CalcRegionStats(data.data(), nullptr, data.size(), 1, 0, true, &stats);
+    EXPECT_EQ(stats.max_index, 5000);
+    EXPECT_EQ(stats.min_index, 7000);
+    EXPECT_EQ(stats.Extrema(), 5); // positive for equal magnitudes
+}
+
+TEST(RegionStatsTest, EmptyRegion) {
+    std::vector<float> data{1, NAN, 3, 4};
+    bool mask[] = {false, true, false, false};
+
+    RegionStats stats;
+    CalcRegionStats(data.data(), mask, data.size(), 1, 0, true, &stats);
+    EXPECT_EQ(stats.num_pixels, 0);
+    EXPECT_EQ(stats.nan_count, 1);
+    EXPECT_EQ(stats.min_index, -1);
+    EXPECT_TRUE(std::isnan(stats.Mean()));
+    EXPECT_TRUE(std::isnan(stats.Sigma()));
+    EXPECT_TRUE(std::isnan(stats.Extrema()));
+}
+
+class RegionStatsImageTest : public ::testing::Test {
+public:
+    void SetUp() override {
+        _image.reset(new casacore::TempImage<float>(casacore::TiledShape(_shape), casacore::CoordinateUtil::defaultCoords3D()));
+        auto data = RandomData(_shape.product(), 2);
+        _image->put(casacore::Array<float>(_shape, data.data()));
+        SetEllipsoidRegion();
+    }
+
+    // An ellipsoid has a different region in each plane
+    void SetEllipsoidRegion() {
+        casacore::Vector<casacore::Float> center(3), radii(3);
+        center(0) = 25.5;
+        center(1) = 18;
+        center(2) = 3;
+        radii(0) = 14;
+        radii(1) = 9;
+        radii(2) = 5;
+        _sub_image.reset(new casacore::SubImage<float>(*_image, casacore::ImageRegion(casacore::LCEllipsoid(center, radii, _shape))));
+    }
+
+    // Results of the native engine and of ImageStatistics
+    void CompareResults(const std::vector<CARTA::StatsType>& stats_types, bool per_channel, size_t block_size = REGION_STATS_BLOCK_SIZE) {
+        std::map<CARTA::StatsType, std::vector<double>> results, expected_results;
+        ASSERT_TRUE(CalcRegionStatsValues(results, stats_types, *_sub_image, per_channel, block_size));
+        ASSERT_TRUE(CalcStatsValues(expected_results, stats_types, *_sub_image, per_channel));
+
+        for (auto& [stats_type, expected_values] : expected_results) {
+            ASSERT_EQ(results.count(stats_type), 1) << "stats type " << stats_type;
+            auto& values = results[stats_type];
+            ASSERT_EQ(values.size(), expected_values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                EXPECT_NEAR(values[i], expected_values[i], 1e-10 * std::max(std::abs(expected_values[i]), 1.0))
+                    << "stats type " << stats_type << " index " << i << " block size " << block_size;
+            }
+        }
+    }
+
+protected:
+    casacore::IPosition _shape = casacore::IPosition(3, 50, 40, 7);
+    std::unique_ptr<casacore::TempImage<float>> _image;
+    std::unique_ptr<casacore::SubImage<float>> _sub_image;
+    std::vector<CARTA::StatsType> _stats_types = {CARTA::StatsType::NumPixels, CARTA::StatsType::Sum, CARTA::StatsType::Mean,
+        CARTA::StatsType::RMS, CARTA::StatsType::Sigma, CARTA::StatsType::SumSq, CARTA::StatsType::Min, CARTA::StatsType::Max,
+        CARTA::StatsType::Extrema, CARTA::StatsType::Blc, CARTA::StatsType::Trc};
+};
+
+TEST_F(RegionStatsImageTest, PerChannelMatchesImageStatistics) {
+    CompareResults(_stats_types, true);
+}
+
+TEST_F(RegionStatsImageTest, RegionMatchesImageStatistics) {
+    auto stats_types = _stats_types;
+    stats_types.push_back(CARTA::StatsType::MinPos);
+    stats_types.push_back(CARTA::StatsType::MaxPos);
+    CompareResults(stats_types, false);
+}
+
+TEST_F(RegionStatsImageTest, FluxDensity) {
+    casacore::ImageInfo image_info;
+    image_info.setRestoringBeam(casacore::GaussianBeam(
+        casacore::Quantity(5, "arcmin"), casacore::Quantity(3, "arcmin"), casacore::Quantity(30, "deg")));
+    _image->setImageInfo(image_info);
+    _image->setUnits(casacore::Unit("Jy/beam"));
+    casacore::Slicer slicer(casacore::IPosition(3, 5, 5, 0), casacore::IPosition(3, 40, 30, 7));
+    _sub_image.reset(new casacore::SubImage<float>(*_image, slicer));
+    CompareResults({CARTA::StatsType::FluxDensity, CARTA::StatsType::Sum}, true);
+
+    // Other units are left to ImageStatistics
+    _image->setUnits(casacore::Unit("K"));
+    _sub_image.reset(new casacore::SubImage<float>(*_image, slicer));
+    std::map<CARTA::StatsType, std::vector<double>> results;
+    EXPECT_FALSE(CalcRegionStatsValues(results, {CARTA::StatsType::FluxDensity, CARTA::StatsType::Sum}, *_sub_image, true));
+    EXPECT_TRUE(results.empty());
+}
+
+TEST_F(RegionStatsImageTest, NanCount) {
+    casacore::Array<float> data;
+    _image->get(data);
+    data(casacore::IPosition(3, 25, 18, 3)) = NAN;
+    data(casacore::IPosition(3, 0, 0, 3)) = NAN; // outside the region
+    _image->put(data);
+
+    std::map<CARTA::StatsType, std::vector<double>> results;
+    ASSERT_TRUE(CalcRegionStatsValues(results, {CARTA::StatsType::NanCount, CARTA::StatsType::NumPixels}, *_sub_image, true));
+    ASSERT_EQ(results[CARTA::StatsType::NanCount].size(), _shape(2));
+    EXPECT_EQ(results[CARTA::StatsType::NanCount][3], 1);
+    EXPECT_EQ(results[CARTA::StatsType::NanCount][2], 0);
+}
+
+TEST_F(RegionStatsImageTest, MaskAndNansMatchImageStatistics) {
+    // NaNs and infinities inside and outside the region, and a pixel mask which excludes some of the pixels of the region
+    casacore::Array<float> data;
+    _image->get(data);
+    casacore::Array<bool> mask(_shape, true);
+    auto data_iter = data.begin();
+    auto mask_iter = mask.begin();
+    for (size_t i = 0; data_iter != data.end(); ++i, ++data_iter, ++mask_iter) {
+        if (i % 13 == 0) {
+            *data_iter = (i % 2) ? NAN : -INFINITY;
+        }
+        *mask_iter = (i % 5) != 0;
+    }
+    _image->put(data);
+    _image->attachMask(casacore::ArrayLattice<casacore::Bool>(mask));
+    SetEllipsoidRegion();
+    ASSERT_TRUE(_sub_image->isMasked());
+
+    auto stats_types = _stats_types;
+    stats_types.push_back(CARTA::StatsType::MinPos);
+    stats_types.push_back(CARTA::StatsType::MaxPos);
+
+    // Blocks of several planes, of single planes, and of rows of a plane
+    const size_t plane_size = _sub_image->shape()(0) * _sub_image->shape()(1);
+    for (size_t block_size : {(size_t)REGION_STATS_BLOCK_SIZE, plane_size, 7 * (size_t)_sub_image->shape()(0), (size_t)1}) {
+        CompareResults(_stats_types, true, block_size);
+        CompareResults(stats_types, false, block_size);
+    }
+}
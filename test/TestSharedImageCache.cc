@@ -0,0 +1,90 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <gtest/gtest.h>
+
+#include "Cache/SharedImageCache.h"
+
+using namespace carta;
+
+class SharedImageCacheTest : public ::testing::Test {
+public:
+    SharedImageId image_id = SharedImageId("/data/image.fits", "0", 1234);
+
+    void SetUp() override {
+        SharedImageCache::Clear();
+        SharedImageCache::SetCapacity(1);
+    }
+
+    void TearDown() override {
+        SharedImageCache::Clear();
+        SharedImageCache::SetCapacity(DEFAULT_SHARED_IMAGE_CACHE_SIZE);
+    }
+
+    static SharedImageCache::DataPtr MakeData(size_t size, float value = 0) {
+        return std::make_shared<std::vector<float>>(size, value);
+    }
+};
+
+TEST_F(SharedImageCacheTest, AddAndGet) {
+    SharedImageCache::Key key(image_id, 0, 0);
+    EXPECT_EQ(SharedImageCache::Get(key), nullptr);
+
+    auto data = MakeData(16, 1.0f);
+    EXPECT_EQ(SharedImageCache::Add(key, data), data);
+    EXPECT_EQ(SharedImageCache::Get(key), data);
+    EXPECT_EQ(SharedImageCache::GetSize(), 16 * sizeof(float));
+
+    // Keys differ by plane, tile and file version
+    EXPECT_EQ(SharedImageCache::Get(SharedImageCache::Key(image_id, 1, 0)), nullptr);
+    EXPECT_EQ(SharedImageCache::Get(SharedImageCache::Key(image_id, 0, 0, 0, 0)), nullptr);
+    EXPECT_EQ(SharedImageCache::Get(SharedImageCache::Key(SharedImageId("/data/image.fits", "0", 5678), 0, 0)), nullptr);
+}
+
+TEST_F(SharedImageCacheTest, FirstAddWins) {
+    SharedImageCache::Key key(image_id, 0, 0, 256, 0);
+    auto first = MakeData(16, 1.0f);
+    auto second = MakeData(16, 2.0f);
+    EXPECT_EQ(SharedImageCache::Add(key, first), first);
+    EXPECT_EQ(SharedImageCache::Add(key, second), first);
+}
+
+TEST_F(SharedImageCacheTest, InvalidImageNotCached) {
+    SharedImageCache::Key key(SharedImageId("", "", 0), 0, 0);
+    auto data = MakeData(16);
+    EXPECT_EQ(SharedImageCache::Add(key, data), data);
+    EXPECT_EQ(SharedImageCache::Get(key), nullptr);
+    EXPECT_EQ(SharedImageCache::GetSize(), 0);
+}
+
+TEST_F(SharedImageCacheTest, EvictsOnlyUnusedData) {
+    // Two planes of 0.75 MB each exceed the 1 MB budget
+    const size_t plane_size = 3 * 1024 * 1024 / (4 * sizeof(float));
+    SharedImageCache::Key key0(image_id, 0, 0);
+    SharedImageCache::Key key1(image_id, 1, 0);
+
+    auto plane0 = SharedImageCache::Add(key0, MakeData(plane_size));
+    auto plane1 = SharedImageCache::Add(key1, MakeData(plane_size));
+
+    // Both planes are still referenced, so neither can be evicted
+    EXPECT_NE(SharedImageCache::Get(key0), nullptr);
+    EXPECT_NE(SharedImageCache::Get(key1), nullptr);
+    EXPECT_GT(SharedImageCache::GetSize(), SharedImageCache::GetCapacity());
+
+    // Release the least recently used plane; it is evicted on the next insertion
+    plane0.reset();
+    SharedImageCache::Add(SharedImageCache::Key(image_id, 2, 0), MakeData(1));
+    EXPECT_EQ(SharedImageCache::Get(key0), nullptr);
+    EXPECT_NE(SharedImageCache::Get(key1), nullptr);
+}
+
+TEST_F(SharedImageCacheTest, Disabled) {
+    SharedImageCache::SetCapacity(0);
+    EXPECT_FALSE(SharedImageCache::Enabled());
+    SharedImageCache::Key key(image_id, 0, 0);
+    SharedImageCache::Add(key, MakeData(16));
+    EXPECT_EQ(SharedImageCache::Get(key), nullptr);
+}
@@ -0,0 +1,146 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cmath>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "Cache/TileCache.h"
+#include "Util/Image.h"
+
+using namespace carta;
+
+#define IMAGE_WIDTH 1000
+#define IMAGE_HEIGHT 700
+#define TILE_BYTES (TILE_SIZE * TILE_SIZE * sizeof(float))
+
+// Chunks of a generated image, in which each pixel holds its z, stokes and tile indices
+class GeneratedChunkLoader : public FileLoader {
+public:
+    GeneratedChunkLoader() : FileLoader("generated", "generated"), num_chunks_read(0) {}
+
+    void OpenFile(const std::string& hdu) override {}
+
+    bool GetChunk(std::vector<float>& data, int& data_width, int& data_height, int min_x, int min_y, int z, int stokes,
+        std::mutex& image_mutex) override {
+        data_width = std::min(data_width, IMAGE_WIDTH - min_x);
+        data_height = std::min(data_height, IMAGE_HEIGHT - min_y);
+        data.resize(data_width * data_height);
+        for (int y = 0; y < data_height; ++y) {
+            for (int x = 0; x < data_width; ++x) {
+                data[y * data_width + x] = PixelValue(min_x + x, min_y + y, z, stokes);
+            }
+        }
+        num_chunks_read++;
+        return true;
+    }
+
+    static float PixelValue(int x, int y, int z, int stokes) {
+        return z * 1000 + stokes * 100 + (y / TILE_SIZE) * 10 + (x / TILE_SIZE);
+    }
+
+    int num_chunks_read;
+};
+
+class TileCacheTest : public ::testing::Test {
+public:
+    void SetUp() override {
+        // Tiles are only read from the loader
+        SharedImageCache::Clear();
+        SharedImageCache::SetCapacity(0);
+        _loader = std::make_shared<GeneratedChunkLoader>();
+    }
+
+    void TearDown() override {
+        SharedImageCache::SetCapacity(DEFAULT_SHARED_IMAGE_CACHE_SIZE);
+    }
+
+    // Value of the first pixel of the tile, or NaN if it was not found
+    float GetTile(TileCache& cache, TileCache::Key key) {
+        auto tile = cache.Get(key, _loader, _image_mutex);
+        return tile ? tile->front() : NAN;
+    }
+
+protected:
+    std::shared_ptr<GeneratedChunkLoader> _loader;
+    std::mutex _image_mutex;
+};
+
+TEST_F(TileCacheTest, TilesFromDifferentPlanesCoexist) {
+    TileCache cache(16 * TILE_BYTES);
+    std::vector<TileCache::Key> keys = {TileCache::Key(0, 0, 0, 0), TileCache::Key(0, 0, 1, 0), TileCache::Key(0, 0, 0, 1)};
+    for (auto& key : keys) {
+        EXPECT_EQ(GetTile(cache, key), GeneratedChunkLoader::PixelValue(key.x, key.y, key.z, key.stokes));
+    }
+    EXPECT_EQ(_loader->num_chunks_read, 3);
+
+    // All planes are still cached, as are the other tiles of their chunks
+    for (auto& key : keys) {
+        EXPECT_NE(cache.Peek(key), nullptr);
+        EXPECT_EQ(GetTile(cache, key), GeneratedChunkLoader::PixelValue(key.x, key.y, key.z, key.stokes));
+        EXPECT_NE(cache.Peek(TileCache::Key(TILE_SIZE, TILE_SIZE, key.z, key.stokes)), nullptr);
+    }
+    EXPECT_EQ(_loader->num_chunks_read, 3);
+}
+
+TEST_F(TileCacheTest, EvictsLeastRecentlyUsedBytes) {
+    // One tile per chunk, and room for two full tiles
+    TileCache cache(2 * TILE_BYTES);
+    cache.SetChunkShape(TILE_SIZE, TILE_SIZE);
+    TileCache::Key key0(0, 0, 0, 0), key1(TILE_SIZE, 0, 0, 0), key2(0, 0, 1, 0);
+
+    GetTile(cache, key0);
+    GetTile(cache, key1);
+    GetTile(cache, key0);
+    GetTile(cache, key2);
+    EXPECT_NE(cache.Peek(key0), nullptr);
+    EXPECT_EQ(cache.Peek(key1), nullptr);
+    EXPECT_NE(cache.Peek(key2), nullptr);
+    EXPECT_EQ(_loader->num_chunks_read, 3);
+
+    // A tile at the edge of the image is smaller, so that it only evicts one full tile
+    TileCache::Key edge_key(3 * TILE_SIZE, 2 * TILE_SIZE, 0, 0);
+    EXPECT_EQ(GetTile(cache, edge_key), GeneratedChunkLoader::PixelValue(edge_key.x, edge_key.y, 0, 0));
+    EXPECT_EQ(cache.Peek(edge_key)->size(), (IMAGE_WIDTH - 3 * TILE_SIZE) * (IMAGE_HEIGHT - 2 * TILE_SIZE));
+    EXPECT_EQ(cache.Peek(key0), nullptr);
+    EXPECT_NE(cache.Peek(key2), nullptr);
+
+    // An evicted tile is read again
+    EXPECT_EQ(GetTile(cache, key1), GeneratedChunkLoader::PixelValue(key1.x, key1.y, 0, 0));
+    EXPECT_EQ(cache.Peek(key2), nullptr);
+    EXPECT_NE(cache.Peek(edge_key), nullptr);
+    EXPECT_EQ(_loader->num_chunks_read, 5);
+}
+
+TEST_F(TileCacheTest, ClearedWhenImageModified) {
+    TileCache cache(16 * TILE_BYTES);
+    TileCache::Key key(0, 0, 0, 0);
+    cache.SetSharedImageId(SharedImageId("/data/image.fits", "0", 1234));
+    GetTile(cache, key);
+
+    cache.SetSharedImageId(SharedImageId("/data/image.fits", "0", 1234));
+    EXPECT_NE(cache.Peek(key), nullptr);
+
+    cache.SetSharedImageId(SharedImageId("/data/image.fits", "0", 5678));
+    EXPECT_EQ(cache.Peek(key), nullptr);
+    GetTile(cache, key);
+    EXPECT_EQ(_loader->num_chunks_read, 2);
+}
+
+TEST_F(TileCacheTest, KeysDifferingInYOrStokesDoNotCollide) {
+    std::hash<TileCacheKey> hash;
+    TileCacheKey key(TILE_SIZE, 0, 0, 0);
+    EXPECT_NE(hash(key), hash(TileCacheKey(TILE_SIZE, TILE_SIZE, 0, 0)));
+    EXPECT_NE(hash(key), hash(TileCacheKey(TILE_SIZE, 0, 0, 1)));
+    EXPECT_NE(hash(TileCacheKey(0, TILE_SIZE, 0, 0)), hash(TileCacheKey(TILE_SIZE, 0, 0, 0)));
+
+    TileCache cache(16 * TILE_BYTES);
+    for (auto& other_key : {key, TileCache::Key(TILE_SIZE, TILE_SIZE, 0, 0), TileCache::Key(TILE_SIZE, 0, 0, 1)}) {
+        EXPECT_EQ(GetTile(cache, other_key), GeneratedChunkLoader::PixelValue(other_key.x, other_key.y, other_key.z, other_key.stokes));
+    }
+    EXPECT_EQ(GetTile(cache, key), GeneratedChunkLoader::PixelValue(key.x, key.y, key.z, key.stokes));
+}
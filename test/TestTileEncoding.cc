@@ -4,12 +4,16 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <random>
 
 #include <gtest/gtest.h>
 
+#include "DataStream/Compression.h"
 #include "DataStream/Tile.h"
+#include "Util/Simd.h"
 
 using namespace carta;
 
@@ -51,6 +55,215 @@ TEST(TileEncodingTest, RoundTrip) {
     }
 }
 
+TEST(TileEncodingTest, PrefetchTiles) {
+    // 2048x2048 image: layer 2 has 4x4 tiles, layer 3 (full resolution) has 8x8 tiles
+    std::vector<Tile> view = {Tile{1, 1, 2}, Tile{2, 1, 2}, Tile{1, 2, 2}, Tile{2, 2, 2}};
+    auto tiles = Tile::GetPrefetchTiles(view, 2048, 2048, 256, 256, 100);
+
+    std::vector<int> count_per_layer(4, 0);
+    for (const auto& tile : tiles) {
+        ASSERT_GE(tile.layer, 1);
+        ASSERT_LE(tile.layer, 3);
+        count_per_layer[tile.layer]++;
+        for (const auto& requested : view) {
+            ASSERT_FALSE(tile.x == requested.x && tile.y == requested.y && tile.layer == requested.layer);
+        }
+    }
+    EXPECT_EQ(count_per_layer[2], 12); // ring around the view
+    EXPECT_EQ(count_per_layer[1], 4);  // coarser layer
+    EXPECT_EQ(count_per_layer[3], 16); // finer layer
+
+    // The ring comes first, and the finer layer starts at the centre of the view
+    EXPECT_EQ(tiles.front().layer, 2);
+    EXPECT_EQ(tiles[16].layer, 3);
+    EXPECT_TRUE(tiles[16].x >= 3 && tiles[16].x <= 4 && tiles[16].y >= 3 && tiles[16].y <= 4);
+
+    // Limited number of tiles, and nothing outside the image
+    EXPECT_EQ(Tile::GetPrefetchTiles(view, 2048, 2048, 256, 256, 5).size(), 5);
+    auto corner_tiles = Tile::GetPrefetchTiles({Tile{0, 0, 3}}, 2048, 2048, 256, 256, 100);
+    EXPECT_EQ(corner_tiles.size(), 4); // 3 ring tiles and 1 coarser tile
+}
+
+// Random data with isolated NaNs, NaN runs and rows, and all-NaN and NaN-free regions
+static std::vector<float> TileWithNans(int width, int height, unsigned int seed) {
+    std::mt19937 mt(seed);
+    std::uniform_real_distribution<float> float_random(-10, 10);
+    std::uniform_int_distribution<> pattern_random(0, 9);
+    std::vector<float> data(width * height);
+    for (auto& value : data) {
+        value = float_random(mt);
+    }
+
+    for (int y = 0; y < height; y++) {
+        int pattern = pattern_random(mt);
+        for (int x = 0; x < width; x++) {
+            bool nan = (pattern == 0) || (pattern < 3 && x > width / 3 && x < width / 2) || (pattern_random(mt) == 0);
+            if (nan || (y >= height / 2 && x < width / 4)) {
+                data[y * width + x] = NAN;
+            }
+        }
+    }
+    return data;
+}
+
+// Scalar reference implementations of GetNanEncodingsSimple and GetNanEncodingsBlock
+static std::vector<int32_t> GetNanEncodingsSimpleScalar(std::vector<float>& array, int offset, int length) {
+    int32_t prev_index = offset;
+    bool prev = false;
+    std::vector<int32_t> encoded_array;
+    // Find first non-NaN number in the array
+    float prev_valid_num = 0;
+    for (auto i = offset; i < offset + length; i++) {
+        if (!std::isnan(array[i])) {
+            prev_valid_num = array[i];
+            break;
+        }
+    }
+
+    // Generate RLE list and replace NaNs with neighbouring valid values. Ideally, this should take into account
+    // the width and height of the image, and look for neighbouring values in vertical and horizontal directions,
+    // but this is only an issue with NaNs right at the edge of images.
+    for (auto i = offset; i < offset + length; i++) {
+        bool current = std::isnan(array[i]);
+        if (current != prev) {
+            encoded_array.push_back(i - prev_index);
+            prev_index = i;
+            prev = current;
+        }
+        if (current) {
+            array[i] = prev_valid_num;
+        } else {
+            prev_valid_num = array[i];
+        }
+    }
+    encoded_array.push_back(offset + length - prev_index);
+    return encoded_array;
+}
+
+static std::vector<int32_t> GetNanEncodingsBlockScalar(std::vector<float>& array, int offset, int w, int h) {
+    // Generate RLE NaN list
+    int length = w * h;
+    int32_t prev_index = offset;
+    bool prev = false;
+    std::vector<int32_t> encoded_array;
+
+    for (auto i = offset; i < offset + length; i++) {
+        bool current = std::isnan(array[i]);
+        if (current != prev) {
+            encoded_array.push_back(i - prev_index);
+            prev_index = i;
+            prev = current;
+        }
+    }
+    encoded_array.push_back(offset + length - prev_index);
+
+    // Skip all-NaN images and NaN-free images
+    if (encoded_array.size() > 1) {
+        // Calculate average of 4x4 blocks (matching blocks used in ZFP), and replace NaNs with block average
+        for (auto i = 0; i < w; i += 4) {
+            for (auto j = 0; j < h; j += 4) {
+                int block_start = offset + j * w + i;
+                int valid_count = 0;
+                float sum = 0;
+                // Limit the block size when at the edges of the image
+                int block_width = std::min(4, w - i);
+                int block_height = std::min(4, h - j);
+                for (int x = 0; x < block_width; x++) {
+                    for (int y = 0; y < block_height; y++) {
+                        float v = array[block_start + (y * w) + x];
+                        if (!std::isnan(v)) {
+                            valid_count++;
+                            sum += v;
+                        }
+                    }
+                }
+
+                // Only process blocks which have at least one valid value AND at least one NaN. All-NaN blocks won't affect ZFP compression
+                if (valid_count && valid_count != block_width * block_height) {
+                    float average = sum / valid_count;
+                    for (int x = 0; x < block_width; x++) {
+                        for (int y = 0; y < block_height; y++) {
+                            float v = array[block_start + (y * w) + x];
+                            if (std::isnan(v)) {
+                                array[block_start + (y * w) + x] = average;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return encoded_array;
+}
+
+static void ExpectSameValues(const std::vector<float>& a, const std::vector<float>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::isnan(b[i])) {
+            EXPECT_TRUE(std::isnan(a[i])) << "index " << i;
+        } else {
+            // Block averages may be summed in a different order
+            EXPECT_NEAR(a[i], b[i], 1e-4) << "index " << i;
+        }
+    }
+}
+
+TEST(TileEncodingTest, NanEncodingsMatchScalar) {
+    std::vector<std::pair<int, int>> sizes = {{256, 256}, {257, 131}, {64, 3}, {3, 5}, {1, 1}, {0, 0}};
+    unsigned int seed = 0;
+    for (auto& [width, height] : sizes) {
+        auto data = TileWithNans(width, height, seed++);
+
+        auto block_data = data;
+        auto block_reference = data;
+        EXPECT_EQ(GetNanEncodingsBlock(block_data, 0, width, height), GetNanEncodingsBlockScalar(block_reference, 0, width, height));
+        ExpectSameValues(block_data, block_reference);
+
+        auto simple_data = data;
+        auto simple_reference = data;
+        EXPECT_EQ(GetNanEncodingsSimple(simple_data, 0, data.size()), GetNanEncodingsSimpleScalar(simple_reference, 0, data.size()));
+        ExpectSameValues(simple_data, simple_reference);
+
+        // Offset into a larger array
+        if (data.size() > 10) {
+            simple_data = data;
+            simple_reference = data;
+            EXPECT_EQ(GetNanEncodingsSimple(simple_data, 7, data.size() - 10),
+                GetNanEncodingsSimpleScalar(simple_reference, 7, data.size() - 10));
+            ExpectSameValues(simple_data, simple_reference);
+        }
+    }
+
+    // No NaNs and only NaNs
+    for (float value : {1.0f, NAN}) {
+        std::vector<float> data(256 * 256, value);
+        auto reference = data;
+        EXPECT_EQ(GetNanEncodingsBlock(data, 0, 256, 256), GetNanEncodingsBlockScalar(reference, 0, 256, 256));
+        ExpectSameValues(data, reference);
+    }
+}
+
+TEST(TileEncodingTest, NanEncodingsMatchForEachSimdLevel) {
+    auto detected_level = GetSimdLevel();
+    auto data = TileWithNans(257, 131, 42);
+    for (auto level : {SimdLevel::SSE4, SimdLevel::AVX, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (level > detected_level) {
+            continue;
+        }
+        SetSimdLevel(level);
+        auto block_data = data;
+        auto block_reference = data;
+        EXPECT_EQ(GetNanEncodingsBlock(block_data, 0, 257, 131), GetNanEncodingsBlockScalar(block_reference, 0, 257, 131))
+            << SimdLevelName(level);
+        auto simple_data = data;
+        auto simple_reference = data;
+        EXPECT_EQ(GetNanEncodingsSimple(simple_data, 5, data.size() - 5), GetNanEncodingsSimpleScalar(simple_reference, 5, data.size() - 5))
+            << SimdLevelName(level);
+        ExpectSameValues(simple_data, simple_reference);
+    }
+    SetSimdLevel(SimdLevel::AVX512);
+}
+
 #ifdef COMPILE_PERFORMANCE_TESTS
 
 TEST(TileEncoding, PerformanceTestEncoding) {
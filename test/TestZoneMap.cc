@@ -0,0 +1,115 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018-2022 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Cache/ZoneMap.h"
+#include "DataStream/Contouring.h"
+
+using namespace carta;
+
+// Smooth values with NaN and infinite pixels, and an all-NaN corner which is not aligned with the blocks
+static std::vector<float> TestImage(int64_t width, int64_t height) {
+    std::mt19937 mt(width + height);
+    std::uniform_real_distribution<float> random(0, 1);
+    std::vector<float> image(width * height);
+    for (int64_t y = 0; y < height; y++) {
+        for (int64_t x = 0; x < width; x++) {
+            float r = random(mt);
+            float value = std::sin(x / 29.0) * std::cos(y / 17.0);
+            image[y * width + x] = (x + y < 150) ? NAN : (r < 0.01 ? NAN : (r < 0.011 ? -INFINITY : value));
+        }
+    }
+    return image;
+}
+
+TEST(ZoneMapTest, BlocksMatchPixels) {
+    int64_t width(300), height(200);
+    auto image = TestImage(width, height);
+    ZoneMap zone_map;
+    EXPECT_EQ(zone_map.GetBlocks(), nullptr);
+
+    zone_map.Reset(image.data(), width, height);
+    const ZoneMapBlock* blocks = zone_map.GetBlocks();
+    ASSERT_NE(blocks, nullptr);
+    ASSERT_EQ(zone_map.NumBlocksX(), 5);
+    ASSERT_EQ(zone_map.NumBlocksY(), 4);
+
+    for (int64_t block_y = 0; block_y < zone_map.NumBlocksY(); block_y++) {
+        for (int64_t block_x = 0; block_x < zone_map.NumBlocksX(); block_x++) {
+            float min_val = INFINITY;
+            float max_val = -INFINITY;
+            int nan_count = 0;
+            int finite_count = 0;
+            for (int64_t y = block_y * ZONE_MAP_BLOCK_SIZE; y < std::min(height, (block_y + 1) * ZONE_MAP_BLOCK_SIZE); y++) {
+                for (int64_t x = block_x * ZONE_MAP_BLOCK_SIZE; x < std::min(width, (block_x + 1) * ZONE_MAP_BLOCK_SIZE); x++) {
+                    float value = image[y * width + x];
+                    if (std::isnan(value)) {
+                        nan_count++;
+                    } else {
+                        min_val = std::min(min_val, value);
+                        max_val = std::max(max_val, value);
+                        finite_count += std::isfinite(value);
+                    }
+                }
+            }
+            const auto& block = blocks[block_y * zone_map.NumBlocksX() + block_x];
+            EXPECT_EQ(block.min, min_val);
+            EXPECT_EQ(block.max, max_val);
+            EXPECT_EQ(block.nan_count, nan_count);
+            EXPECT_EQ(block.finite_count, finite_count);
+        }
+    }
+}
+
+TEST(ZoneMapTest, AllNanRegions) {
+    int64_t width(300), height(200);
+    auto image = TestImage(width, height);
+    ZoneMap zone_map;
+    zone_map.Reset(image.data(), width, height);
+
+    EXPECT_TRUE(zone_map.IsAllNan(0, 0, 64, 64));
+    EXPECT_TRUE(zone_map.IsAllNan(0, 0, 100, 50));
+    EXPECT_TRUE(zone_map.IsAllNan(100, 0, 150, 1));
+    EXPECT_FALSE(zone_map.IsAllNan(0, 0, 160, 1));
+    EXPECT_FALSE(zone_map.IsAllNan(0, 0, 100, 60));
+    EXPECT_FALSE(zone_map.IsAllNan(200, 100, 300, 200));
+    EXPECT_FALSE(zone_map.IsAllNan(10, 10, 10, 20));
+
+    zone_map.Reset(nullptr, 0, 0);
+    EXPECT_FALSE(zone_map.IsAllNan(0, 0, 64, 64));
+}
+
+TEST(ZoneMapTest, ContoursSkipBlocks) {
+    // A peak in a flat background, so that most blocks cannot cross the levels
+    int64_t width(517), height(389);
+    std::vector<float> image(width * height);
+    for (int64_t y = 0; y < height; y++) {
+        for (int64_t x = 0; x < width; x++) {
+            double r2 = std::pow(x - 300.5, 2) + std::pow(y - 150.5, 2);
+            image[y * width + x] = (x == 100 && y % 5) ? NAN : std::exp(-r2 / 2000.0);
+        }
+    }
+    ZoneMap zone_map;
+    zone_map.Reset(image.data(), width, height);
+    const ZoneMapBlock* blocks = zone_map.GetBlocks();
+
+    ContourCallback callback = [](double, double, const std::vector<float>&, const std::vector<int32_t>&) {};
+    for (double level : {0.0, 0.1, 0.5, 0.9, 1.0}) {
+        for (int num_strips : {1, 4}) {
+            std::vector<float> vertices, zone_map_vertices;
+            std::vector<int32_t> indices, zone_map_indices;
+            TraceLevel(image.data(), width, height, 1.0, 0, level, vertices, indices, 0, callback, num_strips);
+            TraceLevel(image.data(), width, height, 1.0, 0, level, zone_map_vertices, zone_map_indices, 0, callback, num_strips, blocks);
+            EXPECT_EQ(zone_map_vertices, vertices) << level;
+            EXPECT_EQ(zone_map_indices, indices) << level;
+        }
+    }
+}